@@ -0,0 +1,1170 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <libjaylink/libjaylink.h>
+
+#include "emulator/emulator.h"
+
+/**
+ * @file
+ *
+ * Benchmark of the round-trip latency and throughput of device operations.
+ *
+ * The bit vector functions used to prepare and evaluate the data of large
+ * JTAG and SWD operations are measured against naive bit-by-bit loops as well.
+ *
+ * The operations are performed on an in-process emulator by default, or on a
+ * device connected via TCP/IP or USB. With the libusb stand-in, the USB device
+ * is an emulator started with the --usb option.
+ */
+
+/** Maximum number of bytes of an operation. */
+#define MAX_LENGTH		8192
+
+/** Source bit offset of the bit vector benchmarks. */
+#define BITVEC_SRC_OFFSET	3
+
+/** Destination bit offset of the bit vector benchmarks. */
+#define BITVEC_DST_OFFSET	5
+
+/** Distance between the fields of the field extraction benchmarks in bits. */
+#define BITVEC_FIELD_STEP	37
+
+/** Target address read by the DAP benchmarks. */
+#define DAP_ADDRESS		0x20000000
+
+#define DP_IDCODE		0x0
+#define DP_CTRL_STAT		0x4
+#define CTRL_STAT_PWRUPREQ	0x50000000
+
+#define AP_CSW			0x00
+#define AP_TAR			0x04
+#define AP_DRW			0x0c
+#define CSW_SIZE_32		0x02
+
+#define DM_DATA0		0x04
+
+/*
+ * IDCODE, instruction register length and capture of a single TAP. The
+ * capture contains further 01b pairs besides the two least significant bits.
+ */
+#define SINGLE_TAP_IDCODE	0x13631093
+#define SINGLE_TAP_IR_LENGTH	6
+#define SINGLE_TAP_IR_CAPTURE	0x35
+
+/** SVF statements of the SVF benchmark. */
+#define SVF_HEADER		"SIR 9 TDI (01E);\n"
+#define SVF_IDCODE		"SDR 64 TDI (0) TDO (200009134BA00477);\n"
+
+/** Name of the file used by the file I/O benchmarks. */
+#define FILE_NAME		"bench.bin"
+
+/** Output formats. */
+enum format {
+	FORMAT_TEXT,
+	FORMAT_CSV,
+	FORMAT_JSON
+};
+
+/** Benchmark state. */
+struct state {
+	struct jaylink_context *ctx;
+	struct emu *emu;
+	struct jaylink_device_handle *devh;
+	struct jaylink_dap *dap;
+	struct jaylink_jtag_scan *scan;
+	struct jaylink_dap *jtag_dap;
+	struct jaylink_dmi *dmi;
+	uint8_t caps[JAYLINK_DEV_EXT_CAPS_SIZE];
+	uint8_t out[2][MAX_LENGTH];
+	uint8_t in[MAX_LENGTH];
+	char svf[MAX_LENGTH];
+	size_t svf_length;
+};
+
+/** Benchmark of a single operation. */
+struct bench {
+	/** Name of the benchmark. */
+	const char *name;
+	/**
+	 * Length of the operation in bits for I/O operations, and in bytes
+	 * otherwise.
+	 */
+	uint32_t length;
+	/** Divisor of the number of iterations for slow operations. */
+	unsigned int divisor;
+	/** Prepare the benchmark. Can be NULL. */
+	int (*setup)(struct state *state, const struct bench *bench);
+	/** Perform the operation once. */
+	int (*run)(struct state *state, const struct bench *bench);
+	/** Number of bytes transferred by the operation. */
+	size_t (*bytes)(const struct bench *bench);
+};
+
+/** Result of a benchmark. */
+struct result {
+	/** Number of performed operations. */
+	size_t count;
+	/** Total time in nanoseconds. */
+	uint64_t total;
+	/** Median latency in nanoseconds. */
+	uint64_t p50;
+	/** 99th percentile latency in nanoseconds. */
+	uint64_t p99;
+	/** Maximum latency in nanoseconds. */
+	uint64_t max;
+};
+
+static uint64_t get_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t x;
+	uint64_t y;
+
+	x = *(const uint64_t *)a;
+	y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static size_t io_bytes(const struct bench *bench)
+{
+	/* Two output vectors and one input vector. */
+	return 3 * ((bench->length + 7) / 8);
+}
+
+static size_t data_bytes(const struct bench *bench)
+{
+	return bench->length;
+}
+
+static int select_jtag(struct state *state, const struct bench *bench)
+{
+	enum jaylink_target_interface iface;
+
+	(void)bench;
+
+	if (!jaylink_has_cap(state->caps, JAYLINK_DEV_CAP_SELECT_TIF))
+		return JAYLINK_OK;
+
+	return jaylink_select_interface(state->devh, JAYLINK_TIF_JTAG, &iface);
+}
+
+static int run_jtag_io(struct state *state, const struct bench *bench)
+{
+	return jaylink_jtag_io(state->devh, state->out[0], state->out[1],
+		state->in, bench->length, JAYLINK_JTAG_VERSION_3);
+}
+
+static int select_swd(struct state *state, const struct bench *bench)
+{
+	enum jaylink_target_interface iface;
+
+	(void)bench;
+
+	if (!jaylink_has_cap(state->caps, JAYLINK_DEV_CAP_SELECT_TIF))
+		return JAYLINK_ERR_DEV_NOT_SUPPORTED;
+
+	return jaylink_select_interface(state->devh, JAYLINK_TIF_SWD, &iface);
+}
+
+static int run_swd_io(struct state *state, const struct bench *bench)
+{
+	/*
+	 * Only host-driven high bits are sent such that the target sees line
+	 * resets only.
+	 */
+	return jaylink_swd_io(state->devh, state->out[0], state->out[0],
+		state->in, bench->length);
+}
+
+static int setup_dap(struct state *state, const struct bench *bench)
+{
+	int ret;
+
+	ret = select_swd(state, bench);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	if (!state->dap) {
+		ret = jaylink_dap_new(state->devh, &state->dap);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+	}
+
+	jaylink_dap_line_reset(state->dap);
+	jaylink_dap_dp_read(state->dap, DP_IDCODE, NULL);
+	jaylink_dap_dp_write(state->dap, DP_CTRL_STAT, CTRL_STAT_PWRUPREQ);
+
+	/* Read 32-bit words without address increment. */
+	jaylink_dap_ap_write(state->dap, 0, AP_CSW, CSW_SIZE_32);
+	jaylink_dap_ap_write(state->dap, 0, AP_TAR, DAP_ADDRESS);
+
+	return jaylink_dap_flush(state->dap);
+}
+
+static int run_dap_read(struct state *state, const struct bench *bench)
+{
+	int ret;
+	uint32_t i;
+
+	/* All reads are transferred with a single SWD I/O operation. */
+	for (i = 0; i < bench->length / 4; i++) {
+		ret = jaylink_dap_ap_read(state->dap, 0, AP_DRW,
+			(uint32_t *)state->in + i);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+	}
+
+	return jaylink_dap_flush(state->dap);
+}
+
+static int run_mem_read(struct state *state, const struct bench *bench)
+{
+	return jaylink_dap_mem_read(state->dap, 0, DAP_ADDRESS, state->in,
+		bench->length);
+}
+
+static int run_mem_write(struct state *state, const struct bench *bench)
+{
+	return jaylink_dap_mem_write(state->dap, 0, DAP_ADDRESS,
+		state->out[1], bench->length);
+}
+
+static int setup_scan(struct state *state)
+{
+	int ret;
+	size_t ir_lengths[2];
+
+	if (state->scan)
+		return JAYLINK_OK;
+
+	ret = jaylink_jtag_scan_new(state->devh, JAYLINK_JTAG_VERSION_3,
+		&state->scan);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	/* The chain consists of a JTAG-DP and a RISC-V DTM. */
+	ir_lengths[0] = 4;
+	ir_lengths[1] = 5;
+
+	return jaylink_jtag_scan_set_chain(state->scan, ir_lengths, 2);
+}
+
+static int setup_jtag_dap(struct state *state, const struct bench *bench)
+{
+	int ret;
+
+	ret = select_jtag(state, bench);
+
+	if (ret == JAYLINK_OK)
+		ret = setup_scan(state);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	if (!state->jtag_dap) {
+		ret = jaylink_jtag_scan_select_tap(state->scan, 0);
+
+		if (ret == JAYLINK_OK)
+			ret = jaylink_dap_new_jtag(state->scan,
+				&state->jtag_dap);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+	}
+
+	jaylink_dap_dp_write(state->jtag_dap, DP_CTRL_STAT,
+		CTRL_STAT_PWRUPREQ);
+
+	return jaylink_dap_flush(state->jtag_dap);
+}
+
+static int run_jtag_mem_read(struct state *state, const struct bench *bench)
+{
+	return jaylink_dap_mem_read(state->jtag_dap, 0, DAP_ADDRESS,
+		state->in, bench->length);
+}
+
+static int run_jtag_mem_write(struct state *state, const struct bench *bench)
+{
+	return jaylink_dap_mem_write(state->jtag_dap, 0, DAP_ADDRESS,
+		state->out[1], bench->length);
+}
+
+static int setup_dmi(struct state *state, const struct bench *bench)
+{
+	int ret;
+
+	ret = select_jtag(state, bench);
+
+	if (ret == JAYLINK_OK)
+		ret = setup_scan(state);
+
+	if (ret != JAYLINK_OK || state->dmi)
+		return ret;
+
+	ret = jaylink_jtag_scan_select_tap(state->scan, 1);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	return jaylink_dmi_new(state->scan, &state->dmi);
+}
+
+static int run_dmi_read(struct state *state, const struct bench *bench)
+{
+	int ret;
+	uint32_t i;
+
+	/* All reads are transferred with a single JTAG I/O operation. */
+	for (i = 0; i < bench->length / 4; i++) {
+		ret = jaylink_dmi_read(state->dmi, DM_DATA0,
+			(uint32_t *)state->in + i);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+	}
+
+	return jaylink_dmi_flush(state->dmi);
+}
+
+static int run_dmi_mem_read(struct state *state, const struct bench *bench)
+{
+	return jaylink_dmi_mem_read(state->dmi, DAP_ADDRESS, state->in,
+		bench->length);
+}
+
+static int run_dmi_mem_write(struct state *state, const struct bench *bench)
+{
+	return jaylink_dmi_mem_write(state->dmi, DAP_ADDRESS, state->out[1],
+		bench->length);
+}
+
+static int run_dmi_reg_read(struct state *state, const struct bench *bench)
+{
+	uint16_t regnos[MAX_LENGTH / 4];
+	uint32_t i;
+
+	/* Read the GPRs of hart 0. */
+	for (i = 0; i < bench->length / 4; i++)
+		regnos[i] = 0x1000 + i % 32;
+
+	return jaylink_dmi_reg_read(state->dmi, 0, regnos,
+		(uint32_t *)state->in, bench->length / 4);
+}
+
+static int run_dmi_prog_mem_read(struct state *state,
+		const struct bench *bench)
+{
+	return jaylink_dmi_prog_mem_read(state->dmi, 0, DAP_ADDRESS, state->in,
+		bench->length);
+}
+
+static int setup_svf(struct state *state, const struct bench *bench)
+{
+	int ret;
+	size_t length;
+
+	ret = select_jtag(state, bench);
+
+	if (ret == JAYLINK_OK)
+		ret = setup_scan(state);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	/* Select the IDCODE instruction and check both IDCODEs repeatedly. */
+	length = strlen(SVF_HEADER);
+	memcpy(state->svf, SVF_HEADER, length);
+
+	while (length + strlen(SVF_IDCODE) <= bench->length) {
+		memcpy(state->svf + length, SVF_IDCODE, strlen(SVF_IDCODE));
+		length += strlen(SVF_IDCODE);
+	}
+
+	state->svf_length = length;
+
+	return JAYLINK_OK;
+}
+
+static int run_svf_play(struct state *state, const struct bench *bench)
+{
+	(void)bench;
+
+	return jaylink_svf_play(state->scan, state->svf, state->svf_length, 0,
+		NULL);
+}
+
+static int setup_jtag_detect(struct state *state, const struct bench *bench)
+{
+	int ret;
+
+	ret = select_jtag(state, bench);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	return setup_scan(state);
+}
+
+static int run_jtag_detect(struct state *state, const struct bench *bench)
+{
+	(void)bench;
+
+	return jaylink_jtag_scan_detect(state->scan, NULL);
+}
+
+/*
+ * Replace the scan chain of the in-process emulator with a single TAP. The
+ * benchmarks which follow must not depend on the default scan chain.
+ */
+static int setup_jtag_detect_tap(struct state *state,
+		const struct bench *bench)
+{
+	if (!state->emu)
+		return JAYLINK_ERR_DEV_NOT_SUPPORTED;
+
+	emu_jtag_init(&state->emu->jtag);
+
+	if (!emu_jtag_add_tap(&state->emu->jtag, SINGLE_TAP_IDCODE,
+			SINGLE_TAP_IR_LENGTH))
+		return JAYLINK_ERR;
+
+	if (!emu_jtag_set_ir_capture(&state->emu->jtag,
+			SINGLE_TAP_IR_CAPTURE))
+		return JAYLINK_ERR;
+
+	return setup_jtag_detect(state, bench);
+}
+
+static int run_jtag_detect_tap(struct state *state, const struct bench *bench)
+{
+	int ret;
+	size_t num_taps;
+	struct jaylink_jtag_tap tap;
+
+	(void)bench;
+
+	ret = jaylink_jtag_scan_detect(state->scan, &num_taps);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	ret = jaylink_jtag_scan_get_tap(state->scan, 0, &tap);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	/* The detected scan chain must match the emulated one. */
+	if (num_taps != 1 || tap.idcode != SINGLE_TAP_IDCODE ||
+			tap.ir_length != SINGLE_TAP_IR_LENGTH)
+		return JAYLINK_ERR_TARGET;
+
+	return JAYLINK_OK;
+}
+
+static int setup_swo(struct state *state, const struct bench *bench)
+{
+	(void)bench;
+
+	if (!jaylink_has_cap(state->caps, JAYLINK_DEV_CAP_SWO))
+		return JAYLINK_ERR_DEV_NOT_SUPPORTED;
+
+	jaylink_swo_stop(state->devh);
+
+	return jaylink_swo_start(state->devh, JAYLINK_SWO_MODE_UART, 1000000,
+		MAX_LENGTH);
+}
+
+static int run_swo_read(struct state *state, const struct bench *bench)
+{
+	uint32_t length;
+
+	length = bench->length;
+
+	return jaylink_swo_read(state->devh, state->in, &length);
+}
+
+static int setup_emucom(struct state *state, const struct bench *bench)
+{
+	(void)bench;
+
+	if (!jaylink_has_cap(state->caps, JAYLINK_DEV_CAP_EMUCOM))
+		return JAYLINK_ERR_DEV_NOT_SUPPORTED;
+
+	return JAYLINK_OK;
+}
+
+static int run_emucom_write(struct state *state, const struct bench *bench)
+{
+	uint32_t length;
+
+	length = bench->length;
+
+	return jaylink_emucom_write(state->devh, JAYLINK_EMUCOM_CHANNEL_USER,
+		state->out[0], &length);
+}
+
+static int run_emucom_read(struct state *state, const struct bench *bench)
+{
+	int ret;
+	uint32_t length;
+
+	length = bench->length;
+	ret = jaylink_emucom_read(state->devh, JAYLINK_EMUCOM_CHANNEL_USER,
+		state->in, &length);
+
+	/* An empty channel is not an error of the operation. */
+	if (ret == JAYLINK_ERR_DEV_NOT_AVAILABLE)
+		return JAYLINK_OK;
+
+	return ret;
+}
+
+static int setup_file(struct state *state, const struct bench *bench)
+{
+	uint32_t length;
+
+	if (!jaylink_has_cap(state->caps, JAYLINK_DEV_CAP_FILE_IO))
+		return JAYLINK_ERR_DEV_NOT_SUPPORTED;
+
+	length = bench->length;
+
+	return jaylink_file_write(state->devh, FILE_NAME, state->out[0], 0,
+		&length);
+}
+
+static int run_file_write(struct state *state, const struct bench *bench)
+{
+	uint32_t length;
+
+	length = bench->length;
+
+	return jaylink_file_write(state->devh, FILE_NAME, state->out[0], 0,
+		&length);
+}
+
+static int run_file_read(struct state *state, const struct bench *bench)
+{
+	uint32_t length;
+
+	length = bench->length;
+
+	return jaylink_file_read(state->devh, FILE_NAME, state->in, 0,
+		&length);
+}
+
+/* Prevent that the compiler removes the evaluation of the results. */
+static volatile uint64_t bitvec_sink;
+
+static size_t bit_bytes(const struct bench *bench)
+{
+	return (bench->length + 7) / 8;
+}
+
+static int run_naive_copy(struct state *state, const struct bench *bench)
+{
+	size_t i;
+	size_t src;
+	size_t dst;
+
+	for (i = 0; i < bench->length; i++) {
+		src = BITVEC_SRC_OFFSET + i;
+		dst = BITVEC_DST_OFFSET + i;
+
+		if (state->out[0][src / 8] & (1 << (src % 8)))
+			state->out[1][dst / 8] |= 1 << (dst % 8);
+		else
+			state->out[1][dst / 8] &= ~(1 << (dst % 8));
+	}
+
+	return JAYLINK_OK;
+}
+
+static int run_bitvec_copy(struct state *state, const struct bench *bench)
+{
+	jaylink_bitvec_copy(state->out[1], BITVEC_DST_OFFSET, state->out[0],
+		BITVEC_SRC_OFFSET, bench->length);
+
+	return JAYLINK_OK;
+}
+
+static int run_naive_field(struct state *state, const struct bench *bench)
+{
+	uint64_t result;
+	uint32_t value;
+	size_t offset;
+	size_t i;
+
+	result = 0;
+
+	for (offset = 0; offset + 32 <= bench->length;
+			offset += BITVEC_FIELD_STEP) {
+		value = 0;
+
+		for (i = 0; i < 32; i++) {
+			if (state->in[(offset + i) / 8] & (1 << ((offset + i) % 8)))
+				value |= (uint32_t)1 << i;
+		}
+
+		result ^= value;
+	}
+
+	bitvec_sink = result;
+
+	return JAYLINK_OK;
+}
+
+static int run_bitvec_field(struct state *state, const struct bench *bench)
+{
+	uint64_t result;
+	size_t offset;
+
+	result = 0;
+
+	for (offset = 0; offset + 32 <= bench->length;
+			offset += BITVEC_FIELD_STEP)
+		result ^= jaylink_bitvec_get_field(state->in, offset, 32);
+
+	bitvec_sink = result;
+
+	return JAYLINK_OK;
+}
+
+static int run_naive_parity(struct state *state, const struct bench *bench)
+{
+	bool parity;
+	size_t i;
+
+	parity = false;
+
+	for (i = 0; i < bench->length; i++) {
+		if (state->in[i / 8] & (1 << (i % 8)))
+			parity = !parity;
+	}
+
+	bitvec_sink = parity;
+
+	return JAYLINK_OK;
+}
+
+static int run_bitvec_parity(struct state *state, const struct bench *bench)
+{
+	bitvec_sink = jaylink_bitvec_parity(state->in, 0, bench->length);
+
+	return JAYLINK_OK;
+}
+
+static int setup_compare(struct state *state, const struct bench *bench)
+{
+	(void)bench;
+
+	/* Expect the data of the second output buffer. */
+	memcpy(state->in, state->out[1], MAX_LENGTH);
+
+	return JAYLINK_OK;
+}
+
+static int run_naive_compare(struct state *state, const struct bench *bench)
+{
+	size_t i;
+	uint8_t bit;
+
+	for (i = 0; i < bench->length; i++) {
+		bit = 1 << (i % 8);
+
+		if (!(state->out[0][i / 8] & bit))
+			continue;
+
+		if ((state->in[i / 8] & bit) != (state->out[1][i / 8] & bit))
+			break;
+	}
+
+	bitvec_sink = i;
+
+	return JAYLINK_OK;
+}
+
+static int run_bitvec_compare(struct state *state, const struct bench *bench)
+{
+	bitvec_sink = jaylink_bitvec_compare(state->in, state->out[1],
+		state->out[0], 0, bench->length);
+
+	return JAYLINK_OK;
+}
+
+static int run_discovery(struct state *state, const struct bench *bench)
+{
+	(void)bench;
+
+	return jaylink_discovery_scan(state->ctx, JAYLINK_HIF_TCP);
+}
+
+static const struct bench benches[] = {
+	{"jtag_io", 8, 1, select_jtag, run_jtag_io, io_bytes},
+	{"jtag_io", 64, 1, select_jtag, run_jtag_io, io_bytes},
+	{"jtag_io", 512, 1, select_jtag, run_jtag_io, io_bytes},
+	{"jtag_io", 4096, 1, select_jtag, run_jtag_io, io_bytes},
+	{"jtag_io", 32768, 1, select_jtag, run_jtag_io, io_bytes},
+	{"swd_io", 8, 1, select_swd, run_swd_io, io_bytes},
+	{"swd_io", 64, 1, select_swd, run_swd_io, io_bytes},
+	{"swd_io", 512, 1, select_swd, run_swd_io, io_bytes},
+	{"swd_io", 4096, 1, select_swd, run_swd_io, io_bytes},
+	{"dap_read", 4, 1, setup_dap, run_dap_read, data_bytes},
+	{"dap_read", 128, 1, setup_dap, run_dap_read, data_bytes},
+	{"mem_read", 8192, 1, setup_dap, run_mem_read, data_bytes},
+	{"mem_write", 8192, 1, setup_dap, run_mem_write, data_bytes},
+	{"jtag_mem_read", 8192, 1, setup_jtag_dap, run_jtag_mem_read,
+		data_bytes},
+	{"jtag_mem_write", 8192, 1, setup_jtag_dap, run_jtag_mem_write,
+		data_bytes},
+	{"dmi_read", 4, 1, setup_dmi, run_dmi_read, data_bytes},
+	{"dmi_read", 1024, 1, setup_dmi, run_dmi_read, data_bytes},
+	{"dmi_mem_read", 8192, 1, setup_dmi, run_dmi_mem_read, data_bytes},
+	{"dmi_mem_write", 8192, 1, setup_dmi, run_dmi_mem_write, data_bytes},
+	{"dmi_reg_read", 128, 1, setup_dmi, run_dmi_reg_read, data_bytes},
+	{"dmi_prog_mem_read", 8192, 1, setup_dmi, run_dmi_prog_mem_read,
+		data_bytes},
+	{"svf_play", 8192, 1, setup_svf, run_svf_play, data_bytes},
+	{"jtag_detect", 0, 1, setup_jtag_detect, run_jtag_detect, NULL},
+	{"jtag_detect_tap", 0, 1, setup_jtag_detect_tap, run_jtag_detect_tap,
+		NULL},
+	{"swo_read", 256, 1, setup_swo, run_swo_read, data_bytes},
+	{"emucom_write", 64, 1, setup_emucom, run_emucom_write, data_bytes},
+	{"emucom_read", 64, 1, setup_emucom, run_emucom_read, data_bytes},
+	{"file_write", 1024, 1, setup_file, run_file_write, data_bytes},
+	{"file_read", 1024, 1, setup_file, run_file_read, data_bytes},
+	{"naive_copy", 65000, 1, NULL, run_naive_copy, bit_bytes},
+	{"bitvec_copy", 65000, 1, NULL, run_bitvec_copy, bit_bytes},
+	{"naive_field", 65000, 1, NULL, run_naive_field, bit_bytes},
+	{"bitvec_field", 65000, 1, NULL, run_bitvec_field, bit_bytes},
+	{"naive_parity", 65000, 1, NULL, run_naive_parity, bit_bytes},
+	{"bitvec_parity", 65000, 1, NULL, run_bitvec_parity, bit_bytes},
+	{"naive_compare", 65000, 1, setup_compare, run_naive_compare,
+		bit_bytes},
+	{"bitvec_compare", 65000, 1, setup_compare, run_bitvec_compare,
+		bit_bytes},
+	{"discovery", 0, 100, NULL, run_discovery, NULL}
+};
+
+static int run_bench(struct state *state, const struct bench *bench,
+		size_t iterations, struct result *result)
+{
+	int ret;
+	uint64_t *latencies;
+	uint64_t start;
+	uint64_t end;
+	size_t i;
+
+	if (bench->setup) {
+		ret = bench->setup(state, bench);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+	}
+
+	latencies = malloc(iterations * sizeof(uint64_t));
+
+	if (!latencies)
+		return JAYLINK_ERR_MALLOC;
+
+	result->total = 0;
+
+	for (i = 0; i < iterations; i++) {
+		start = get_time();
+		ret = bench->run(state, bench);
+		end = get_time();
+
+		if (ret != JAYLINK_OK) {
+			free(latencies);
+			return ret;
+		}
+
+		latencies[i] = end - start;
+		result->total += latencies[i];
+	}
+
+	qsort(latencies, iterations, sizeof(uint64_t), compare_u64);
+
+	result->count = iterations;
+	result->p50 = latencies[(iterations - 1) / 2];
+	result->p99 = latencies[(iterations - 1) * 99 / 100];
+	result->max = latencies[iterations - 1];
+
+	free(latencies);
+
+	return JAYLINK_OK;
+}
+
+static void print_header(enum format format)
+{
+	if (format == FORMAT_TEXT)
+		printf("%-14s %6s %8s %12s %10s %10s %10s %12s\n", "name",
+			"length", "count", "ops/s", "p50/us", "p99/us",
+			"max/us", "bytes/s");
+	else if (format == FORMAT_CSV)
+		printf("name,length,count,ops_per_sec,p50_ns,p99_ns,max_ns,"
+			"bytes_per_sec,error\n");
+}
+
+static void print_result(enum format format, const struct bench *bench,
+		const struct result *result, int error)
+{
+	double ops;
+	double bytes;
+
+	ops = 0;
+	bytes = 0;
+
+	if (error == JAYLINK_OK && result->total > 0) {
+		ops = result->count * 1e9 / result->total;
+
+		if (bench->bytes)
+			bytes = ops * bench->bytes(bench);
+	}
+
+	switch (format) {
+	case FORMAT_TEXT:
+		if (error != JAYLINK_OK) {
+			printf("%-14s %6u %s\n", bench->name, bench->length,
+				jaylink_strerror(error));
+			break;
+		}
+
+		printf("%-14s %6u %8zu %12.0f %10.1f %10.1f %10.1f %12.0f\n",
+			bench->name, bench->length, result->count, ops,
+			result->p50 / 1e3, result->p99 / 1e3,
+			result->max / 1e3, bytes);
+		break;
+	case FORMAT_CSV:
+		if (error != JAYLINK_OK) {
+			printf("%s,%u,0,0,0,0,0,0,%s\n", bench->name,
+				bench->length, jaylink_strerror_name(error));
+			break;
+		}
+
+		printf("%s,%u,%zu,%.0f,%llu,%llu,%llu,%.0f,\n", bench->name,
+			bench->length, result->count, ops,
+			(unsigned long long)result->p50,
+			(unsigned long long)result->p99,
+			(unsigned long long)result->max, bytes);
+		break;
+	case FORMAT_JSON:
+		if (error != JAYLINK_OK) {
+			printf("{\"name\": \"%s\", \"length\": %u, "
+				"\"error\": \"%s\"}\n", bench->name,
+				bench->length, jaylink_strerror_name(error));
+			break;
+		}
+
+		printf("{\"name\": \"%s\", \"length\": %u, \"count\": %zu, "
+			"\"ops_per_sec\": %.0f, \"p50_ns\": %llu, "
+			"\"p99_ns\": %llu, \"max_ns\": %llu, "
+			"\"bytes_per_sec\": %.0f}\n", bench->name,
+			bench->length, result->count, ops,
+			(unsigned long long)result->p50,
+			(unsigned long long)result->p99,
+			(unsigned long long)result->max, bytes);
+		break;
+	}
+}
+
+static void usage(const char *name)
+{
+	printf("Usage: %s [OPTION]...\n\n"
+		"Measure the latency and throughput of device operations and "
+		"bit vector\nfunctions.\n\n"
+		"  -n, --iterations=N    number of operations per benchmark "
+		"(default: 1000)\n"
+		"  -t, --tcp=ADDRESS     use the device at the IPv4 address "
+		"instead of the\n"
+		"                        in-process emulator\n"
+		"  -p, --port=PORT       port of the device (default: %u)\n"
+		"  -u, --usb             use the first USB device instead of "
+		"the in-process\n"
+		"                        emulator\n"
+		"  -l, --latency=CYCLES  clock cycles of a SWD or system bus "
+		"memory access of\n"
+		"                        the in-process emulator (default: 0)\n"
+		"  -f, --filter=NAME     run only the benchmarks whose name "
+		"contains NAME\n"
+		"  -o, --format=FORMAT   output format: text, csv or json "
+		"(default: text)\n"
+		"  -h, --help            display this help and exit\n",
+		name, EMU_DEFAULT_PORT);
+}
+
+static int open_usb_device(struct state *state, struct jaylink_device **dev)
+{
+	int ret;
+	struct jaylink_device **devs;
+	size_t count;
+
+	ret = jaylink_discovery_scan(state->ctx, JAYLINK_HIF_USB);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	ret = jaylink_get_devices(state->ctx, &devs, &count);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	if (!count) {
+		jaylink_free_devices(devs, true);
+		return JAYLINK_ERR_NOT_AVAILABLE;
+	}
+
+	*dev = jaylink_ref_device(devs[0]);
+	jaylink_free_devices(devs, true);
+
+	return JAYLINK_OK;
+}
+
+static int open_device(struct state *state, struct emu **emu,
+		const char *address, uint16_t port, bool usb,
+		unsigned int latency)
+{
+	int ret;
+	struct jaylink_device *dev;
+
+	*emu = NULL;
+
+	if (usb) {
+		ret = open_usb_device(state, &dev);
+	} else if (address) {
+		ret = jaylink_tcp_device_new(state->ctx, address, port, &dev);
+	} else {
+		*emu = emu_new();
+
+		if (!*emu)
+			return JAYLINK_ERR_MALLOC;
+
+		(*emu)->swd.latency = latency;
+		(*emu)->riscv.sb_latency = latency;
+		ret = emu_loopback_new(*emu, state->ctx, &dev);
+	}
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	ret = jaylink_open(dev, &state->devh);
+	jaylink_unref_device(dev);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	ret = jaylink_get_caps(state->devh, state->caps);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	if (!jaylink_has_cap(state->caps, JAYLINK_DEV_CAP_GET_EXT_CAPS))
+		return JAYLINK_OK;
+
+	return jaylink_get_extended_caps(state->devh, state->caps);
+}
+
+int main(int argc, char **argv)
+{
+	int ret;
+	int opt;
+	struct state *state;
+	struct emu *emu;
+	struct result result;
+	const struct bench *bench;
+	enum format format;
+	const char *address;
+	const char *filter;
+	unsigned long iterations;
+	unsigned long port;
+	unsigned long latency;
+	bool usb;
+	size_t count;
+	size_t i;
+	char *end;
+	static const struct option options[] = {
+		{"iterations", required_argument, NULL, 'n'},
+		{"tcp", required_argument, NULL, 't'},
+		{"port", required_argument, NULL, 'p'},
+		{"usb", no_argument, NULL, 'u'},
+		{"latency", required_argument, NULL, 'l'},
+		{"filter", required_argument, NULL, 'f'},
+		{"format", required_argument, NULL, 'o'},
+		{"help", no_argument, NULL, 'h'},
+		{NULL, 0, NULL, 0}
+	};
+
+	iterations = 1000;
+	address = NULL;
+	port = EMU_DEFAULT_PORT;
+	usb = false;
+	latency = 0;
+	filter = NULL;
+	format = FORMAT_TEXT;
+
+	while ((opt = getopt_long(argc, argv, "n:t:p:ul:f:o:h", options,
+			NULL)) != -1) {
+		switch (opt) {
+		case 'n':
+			iterations = strtoul(optarg, &end, 10);
+
+			if (*end != '\0' || !iterations) {
+				fprintf(stderr, "Invalid number of "
+					"iterations: %s.\n", optarg);
+				return EXIT_FAILURE;
+			}
+
+			break;
+		case 't':
+			address = optarg;
+			break;
+		case 'p':
+			port = strtoul(optarg, &end, 10);
+
+			if (*end != '\0' || !port || port > UINT16_MAX) {
+				fprintf(stderr, "Invalid port: %s.\n", optarg);
+				return EXIT_FAILURE;
+			}
+
+			break;
+		case 'u':
+			usb = true;
+			break;
+		case 'l':
+			latency = strtoul(optarg, &end, 10);
+
+			if (*end != '\0' || latency > UINT16_MAX) {
+				fprintf(stderr, "Invalid latency: %s.\n",
+					optarg);
+				return EXIT_FAILURE;
+			}
+
+			break;
+		case 'f':
+			filter = optarg;
+			break;
+		case 'o':
+			if (!strcmp(optarg, "text")) {
+				format = FORMAT_TEXT;
+			} else if (!strcmp(optarg, "csv")) {
+				format = FORMAT_CSV;
+			} else if (!strcmp(optarg, "json")) {
+				format = FORMAT_JSON;
+			} else {
+				fprintf(stderr, "Invalid format: %s.\n",
+					optarg);
+				return EXIT_FAILURE;
+			}
+
+			break;
+		case 'h':
+			usage(argv[0]);
+			return EXIT_SUCCESS;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	state = calloc(1, sizeof(struct state));
+
+	if (!state) {
+		fprintf(stderr, "Failed to allocate benchmark state.\n");
+		return EXIT_FAILURE;
+	}
+
+	memset(state->out[0], 0xff, MAX_LENGTH);
+	memset(state->out[1], 0x5a, MAX_LENGTH);
+
+	ret = jaylink_init(&state->ctx);
+
+	if (ret != JAYLINK_OK) {
+		fprintf(stderr, "jaylink_init() failed: %s.\n",
+			jaylink_strerror(ret));
+		free(state);
+		return EXIT_FAILURE;
+	}
+
+	ret = open_device(state, &emu, address, port, usb, latency);
+	state->emu = emu;
+
+	if (ret != JAYLINK_OK) {
+		fprintf(stderr, "Failed to open device: %s.\n",
+			jaylink_strerror(ret));
+
+		if (state->devh)
+			jaylink_close(state->devh);
+
+		jaylink_exit(state->ctx);
+		emu_free(emu);
+		free(state);
+		return EXIT_FAILURE;
+	}
+
+	print_header(format);
+
+	for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+		bench = &benches[i];
+
+		if (filter && !strstr(bench->name, filter))
+			continue;
+
+		count = iterations / bench->divisor;
+
+		if (!count)
+			count = 1;
+
+		ret = run_bench(state, bench, count, &result);
+		print_result(format, bench, &result, ret);
+		fflush(stdout);
+	}
+
+	jaylink_dap_free(state->dap);
+	jaylink_dap_free(state->jtag_dap);
+	jaylink_dmi_free(state->dmi);
+	jaylink_jtag_scan_free(state->scan);
+	jaylink_close(state->devh);
+	jaylink_exit(state->ctx);
+	emu_free(emu);
+	free(state);
+
+	return EXIT_SUCCESS;
+}
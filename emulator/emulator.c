@@ -0,0 +1,1117 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include "emulator.h"
+
+/**
+ * @file
+ *
+ * Device side of the J-Link protocol.
+ */
+
+#define CMD_SERVER		0x00
+#define CMD_CLIENT		0x07
+
+#define CMD_GET_VERSION		0x01
+#define CMD_SET_SPEED		0x05
+#define CMD_GET_HW_STATUS	0x07
+#define CMD_SET_TARGET_POWER	0x08
+#define CMD_REGISTER		0x09
+#define CMD_FILE_IO		0x1e
+#define CMD_GET_SPEEDS		0xc0
+#define CMD_GET_HW_INFO		0xc1
+#define CMD_GET_COUNTERS	0xc2
+#define CMD_SELECT_TIF		0xc7
+#define CMD_JTAG_IO_V2		0xce
+#define CMD_JTAG_IO_V3		0xcf
+#define CMD_GET_FREE_MEMORY	0xd4
+#define CMD_CLEAR_RESET		0xdc
+#define CMD_SET_RESET		0xdd
+#define CMD_JTAG_CLEAR_TRST	0xde
+#define CMD_JTAG_SET_TRST	0xdf
+#define CMD_GET_CAPS		0xe8
+#define CMD_SWO			0xeb
+#define CMD_GET_EXT_CAPS	0xed
+#define CMD_EMUCOM		0xee
+#define CMD_GET_HW_VERSION	0xf0
+#define CMD_READ_CONFIG		0xf2
+#define CMD_WRITE_CONFIG	0xf3
+
+#define REG_CMD_REGISTER	0x64
+#define REG_CMD_UNREGISTER	0x65
+#define REG_HEADER_SIZE		8
+#define REG_MIN_SIZE		0x4c
+
+#define TIF_GET_SELECTED	0xfe
+#define TIF_GET_AVAILABLE	0xff
+
+#define SWO_CMD_START		0x64
+#define SWO_CMD_STOP		0x65
+#define SWO_CMD_READ		0x66
+#define SWO_CMD_GET_SPEEDS	0x6e
+#define SWO_PARAM_BUFFER_SIZE	0x04
+#define SWO_PARAM_READ_SIZE	0x03
+#define SWO_ERR			0x80000000
+
+#define EMUCOM_CMD_READ			0x00
+#define EMUCOM_CMD_WRITE		0x01
+#define EMUCOM_ERR_NOT_SUPPORTED	0x80000001
+#define EMUCOM_ERR_NOT_AVAILABLE	0x81000000
+/** Capacity of the EMUCOM loopback channel in bytes. */
+#define EMUCOM_LOOPBACK_SIZE		4096
+
+#define FILE_IO_CMD_READ	0x64
+#define FILE_IO_CMD_WRITE	0x65
+#define FILE_IO_CMD_GET_SIZE	0x66
+#define FILE_IO_CMD_DELETE	0x67
+#define FILE_IO_PARAM_FILENAME	0x01
+#define FILE_IO_PARAM_OFFSET	0x02
+#define FILE_IO_PARAM_LENGTH	0x03
+#define FILE_IO_ERR		0x80000000
+
+/** Status code of an I/O operation without enough free memory. */
+#define IO_ERR_NO_MEMORY	0x06
+
+/** Version of the TCP/IP protocol sent with the hello message. */
+#define PROTO_VERSION		0x0001
+/** Server name sent with the hello message. */
+#define SERVER_NAME		"libjaylink emulator"
+
+/** Maximum number of bytes of a single I/O operation vector. */
+#define IO_MAX_BYTES		(0xffff / 8 + 1)
+
+/** Size of the receive and send buffers of a connection. */
+#define CONN_BUFFER_SIZE	4096
+
+/** Connection of a host to the emulator. */
+struct connection {
+	struct emu *emu;
+	int fd;
+	uint8_t in[CONN_BUFFER_SIZE];
+	size_t in_pos;
+	size_t in_length;
+	uint8_t out[CONN_BUFFER_SIZE];
+	size_t out_length;
+};
+
+static bool flush(struct connection *conn)
+{
+	ssize_t ret;
+	size_t pos;
+
+	pos = 0;
+
+	while (pos < conn->out_length) {
+		ret = send(conn->fd, conn->out + pos, conn->out_length - pos,
+			MSG_NOSIGNAL);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+
+		if (ret <= 0)
+			return false;
+
+		pos += ret;
+	}
+
+	conn->out_length = 0;
+
+	return true;
+}
+
+static bool conn_send(struct connection *conn, const uint8_t *buffer,
+		size_t length)
+{
+	size_t tmp;
+
+	while (length > 0) {
+		if (conn->out_length == CONN_BUFFER_SIZE && !flush(conn))
+			return false;
+
+		tmp = CONN_BUFFER_SIZE - conn->out_length;
+
+		if (tmp > length)
+			tmp = length;
+
+		memcpy(conn->out + conn->out_length, buffer, tmp);
+		conn->out_length += tmp;
+		buffer += tmp;
+		length -= tmp;
+	}
+
+	return true;
+}
+
+static bool send_u32(struct connection *conn, uint32_t value)
+{
+	uint8_t buf[4];
+
+	emu_set_u32(buf, value, 0);
+
+	return conn_send(conn, buf, sizeof(buf));
+}
+
+static bool send_zeros(struct connection *conn, size_t length)
+{
+	uint8_t buf[256];
+	size_t tmp;
+
+	memset(buf, 0, sizeof(buf));
+
+	while (length > 0) {
+		tmp = length;
+
+		if (tmp > sizeof(buf))
+			tmp = sizeof(buf);
+
+		if (!conn_send(conn, buf, tmp))
+			return false;
+
+		length -= tmp;
+	}
+
+	return true;
+}
+
+/*
+ * Receive data from the host. Pending responses are sent before the
+ * connection is waited on such that the host and the emulator can not wait for
+ * each other.
+ */
+static bool conn_recv(struct connection *conn, uint8_t *buffer, size_t length)
+{
+	ssize_t ret;
+	size_t tmp;
+
+	while (length > 0) {
+		if (conn->in_pos == conn->in_length) {
+			if (!flush(conn))
+				return false;
+
+			ret = recv(conn->fd, conn->in, CONN_BUFFER_SIZE, 0);
+
+			if (ret < 0 && errno == EINTR)
+				continue;
+
+			if (ret <= 0)
+				return false;
+
+			conn->in_pos = 0;
+			conn->in_length = ret;
+		}
+
+		tmp = conn->in_length - conn->in_pos;
+
+		if (tmp > length)
+			tmp = length;
+
+		memcpy(buffer, conn->in + conn->in_pos, tmp);
+		conn->in_pos += tmp;
+		buffer += tmp;
+		length -= tmp;
+	}
+
+	return true;
+}
+
+static bool recv_u8(struct connection *conn, uint8_t *value)
+{
+	return conn_recv(conn, value, 1);
+}
+
+static bool recv_u16(struct connection *conn, uint16_t *value)
+{
+	uint8_t buf[2];
+
+	if (!conn_recv(conn, buf, sizeof(buf)))
+		return false;
+
+	*value = emu_get_u16(buf, 0);
+
+	return true;
+}
+
+static bool recv_u32(struct connection *conn, uint32_t *value)
+{
+	uint8_t buf[4];
+
+	if (!conn_recv(conn, buf, sizeof(buf)))
+		return false;
+
+	*value = emu_get_u32(buf, 0);
+
+	return true;
+}
+
+static uint32_t get_uptime(const struct emu *emu)
+{
+	return (emu_get_time() - emu->start_time) / 1000;
+}
+
+static bool handle_get_version(struct connection *conn)
+{
+	uint8_t buf[2];
+	size_t length;
+
+	length = strlen(conn->emu->firmware_version) + 1;
+	emu_set_u16(buf, length, 0);
+
+	if (!conn_send(conn, buf, sizeof(buf)))
+		return false;
+
+	return conn_send(conn, (const uint8_t *)conn->emu->firmware_version,
+		length);
+}
+
+static bool handle_get_hw_status(struct connection *conn)
+{
+	struct emu *emu;
+	uint8_t buf[8];
+
+	emu = conn->emu;
+
+	emu_set_u16(buf, 3300, 0);
+	buf[2] = 1;
+	buf[3] = 1;
+	buf[4] = 1;
+	buf[5] = 1;
+	buf[6] = emu->reset;
+	buf[7] = emu->trst;
+
+	return conn_send(conn, buf, sizeof(buf));
+}
+
+static void remove_connection(struct emu *emu, uint16_t handle)
+{
+	size_t i;
+
+	for (i = 0; i < emu->num_connections; i++) {
+		if (emu_get_u16(emu->connections[i], 10) != handle)
+			continue;
+
+		emu->num_connections--;
+		memmove(emu->connections[i], emu->connections[i + 1],
+			(emu->num_connections - i) * EMU_CONN_ENTRY_SIZE);
+		return;
+	}
+}
+
+static bool handle_register(struct connection *conn)
+{
+	struct emu *emu;
+	uint8_t request[13];
+	uint8_t buf[REG_HEADER_SIZE + JAYLINK_MAX_CONNECTIONS *
+		EMU_CONN_ENTRY_SIZE];
+	uint8_t *entry;
+	uint16_t handle;
+	size_t length;
+
+	emu = conn->emu;
+
+	if (!conn_recv(conn, request, sizeof(request)))
+		return false;
+
+	handle = emu_get_u16(request, 11);
+
+	if (request[0] == REG_CMD_REGISTER) {
+		if (!handle) {
+			handle = emu->next_handle++;
+
+			if (!emu->next_handle)
+				emu->next_handle = 1;
+		}
+
+		remove_connection(emu, handle);
+
+		if (emu->num_connections < JAYLINK_MAX_CONNECTIONS) {
+			entry = emu->connections[emu->num_connections];
+			memcpy(entry, request + 1, 10);
+			emu_set_u16(entry, handle, 10);
+			emu_set_u32(entry, get_uptime(emu), 12);
+			emu->num_connections++;
+		}
+	} else if (request[0] == REG_CMD_UNREGISTER) {
+		remove_connection(emu, handle);
+	}
+
+	memset(buf, 0, sizeof(buf));
+	emu_set_u16(buf, handle, 0);
+	emu_set_u16(buf, emu->num_connections, 2);
+	emu_set_u16(buf, EMU_CONN_ENTRY_SIZE, 4);
+	emu_set_u16(buf, 0, 6);
+	memcpy(buf + REG_HEADER_SIZE, emu->connections,
+		emu->num_connections * EMU_CONN_ENTRY_SIZE);
+
+	length = REG_HEADER_SIZE + emu->num_connections * EMU_CONN_ENTRY_SIZE;
+
+	if (length < REG_MIN_SIZE)
+		length = REG_MIN_SIZE;
+
+	return conn_send(conn, buf, length);
+}
+
+static bool handle_get_hw_info(struct connection *conn, bool counters)
+{
+	struct emu *emu;
+	uint32_t mask;
+	uint32_t value;
+	unsigned int i;
+
+	emu = conn->emu;
+
+	if (!recv_u32(conn, &mask))
+		return false;
+
+	for (i = 0; i < 32; i++) {
+		if (!(mask & (1 << i)))
+			continue;
+
+		value = 0;
+
+		if (counters && (1 << i) == JAYLINK_COUNTER_TARGET_TIME)
+			value = get_uptime(emu);
+		else if (!counters && (1 << i) == JAYLINK_HW_INFO_TARGET_POWER)
+			value = emu->target_power;
+
+		if (!send_u32(conn, value))
+			return false;
+	}
+
+	return true;
+}
+
+static uint32_t hw_version_value(const struct jaylink_hardware_version *hw)
+{
+	return hw->type * 1000000 + hw->major * 10000 + hw->minor * 100 +
+		hw->revision;
+}
+
+static bool handle_get_speeds(struct connection *conn)
+{
+	uint8_t buf[6];
+
+	emu_set_u32(buf, conn->emu->base_freq, 0);
+	emu_set_u16(buf, conn->emu->min_div, 4);
+
+	return conn_send(conn, buf, sizeof(buf));
+}
+
+static bool handle_select_tif(struct connection *conn)
+{
+	struct emu *emu;
+	uint8_t iface;
+	uint32_t tmp;
+
+	emu = conn->emu;
+
+	if (!recv_u8(conn, &iface))
+		return false;
+
+	if (iface == TIF_GET_AVAILABLE)
+		return send_u32(conn, (1 << JAYLINK_TIF_JTAG) |
+			(1 << JAYLINK_TIF_SWD));
+
+	if (iface == TIF_GET_SELECTED)
+		return send_u32(conn, emu->iface);
+
+	tmp = emu->iface;
+
+	if (iface == JAYLINK_TIF_JTAG || iface == JAYLINK_TIF_SWD)
+		emu->iface = iface;
+
+	return send_u32(conn, tmp);
+}
+
+/*
+ * Handle a JTAG or SWD I/O operation. The operation is rejected if it requires
+ * more than the free memory of the device, like the firmware of a real device
+ * does.
+ */
+static bool handle_io(struct connection *conn, uint8_t cmd)
+{
+	struct emu *emu;
+	uint8_t buf[3];
+	uint8_t out[2][IO_MAX_BYTES];
+	uint8_t in[IO_MAX_BYTES];
+	uint16_t length;
+	size_t num_bytes;
+	uint8_t status;
+
+	emu = conn->emu;
+
+	if (!conn_recv(conn, buf, sizeof(buf)))
+		return false;
+
+	length = emu_get_u16(buf, 1);
+	num_bytes = (length + 7) / 8;
+
+	if (!conn_recv(conn, out[0], num_bytes))
+		return false;
+
+	if (!conn_recv(conn, out[1], num_bytes))
+		return false;
+
+	status = 0;
+
+	if (cmd == CMD_JTAG_IO_V3 && 4 + 2 * num_bytes > emu->free_memory) {
+		memset(in, 0, num_bytes);
+		status = IO_ERR_NO_MEMORY;
+	} else if (cmd == CMD_JTAG_IO_V3 && emu->iface == JAYLINK_TIF_SWD) {
+		emu_swd_io(&emu->swd, out[0], out[1], in, length);
+	} else {
+		emu_jtag_io(&emu->jtag, out[0], out[1], in, length);
+	}
+
+	if (!conn_send(conn, in, num_bytes))
+		return false;
+
+	/* Version 2 of the JTAG I/O operation has no status byte. */
+	if (cmd == CMD_JTAG_IO_V2)
+		return true;
+
+	return conn_send(conn, &status, 1);
+}
+
+static bool handle_swo(struct connection *conn)
+{
+	struct emu *emu;
+	uint8_t cmd;
+	uint8_t param[2];
+	uint8_t value[4];
+	uint32_t read_size;
+	uint32_t i;
+	uint8_t buf[24];
+	uint8_t data;
+
+	emu = conn->emu;
+	read_size = 0;
+
+	if (!recv_u8(conn, &cmd))
+		return false;
+
+	/* Parameters consist of length, identifier and value. */
+	while (true) {
+		if (!recv_u8(conn, &param[0]))
+			return false;
+
+		if (!param[0])
+			break;
+
+		if (param[0] > sizeof(value))
+			return false;
+
+		if (!recv_u8(conn, &param[1]))
+			return false;
+
+		memset(value, 0, sizeof(value));
+
+		if (!conn_recv(conn, value, param[0]))
+			return false;
+
+		if (param[1] == SWO_PARAM_BUFFER_SIZE)
+			emu->swo_buffer_size = emu_get_u32(value, 0);
+		else if (param[1] == SWO_PARAM_READ_SIZE)
+			read_size = emu_get_u32(value, 0);
+	}
+
+	switch (cmd) {
+	case SWO_CMD_START:
+		emu->swo_running = true;
+		return send_u32(conn, 0);
+	case SWO_CMD_STOP:
+		emu->swo_running = false;
+		return send_u32(conn, 0);
+	case SWO_CMD_READ:
+		if (!emu->swo_running)
+			read_size = 0;
+
+		if (read_size > emu->swo_buffer_size)
+			read_size = emu->swo_buffer_size;
+
+		if (!send_u32(conn, 0) || !send_u32(conn, read_size))
+			return false;
+
+		/* The captured data is a simple counter pattern. */
+		for (i = 0; i < read_size; i++) {
+			data = emu->swo_counter++;
+
+			if (!conn_send(conn, &data, 1))
+				return false;
+		}
+
+		return true;
+	case SWO_CMD_GET_SPEEDS:
+		memset(buf, 0, sizeof(buf));
+		emu_set_u32(buf, emu->base_freq, 4);
+		emu_set_u32(buf, 1, 8);
+		emu_set_u32(buf, 8192, 12);
+		emu_set_u32(buf, 1, 16);
+		emu_set_u32(buf, 1, 20);
+
+		if (!send_u32(conn, 4 + sizeof(buf)))
+			return false;
+
+		return conn_send(conn, buf, sizeof(buf));
+	default:
+		return send_u32(conn, SWO_ERR);
+	}
+}
+
+static bool handle_emucom_read(struct connection *conn, uint32_t channel,
+		uint32_t length)
+{
+	struct emu *emu;
+	uint8_t buf[4];
+
+	emu = conn->emu;
+
+	if (channel == JAYLINK_EMUCOM_CHANNEL_TIME) {
+		if (length < 4)
+			return send_u32(conn, EMUCOM_ERR_NOT_AVAILABLE | 4);
+
+		emu_set_u32(buf, get_uptime(emu), 0);
+
+		if (!send_u32(conn, 4))
+			return false;
+
+		return conn_send(conn, buf, sizeof(buf));
+	}
+
+	if (channel != JAYLINK_EMUCOM_CHANNEL_USER)
+		return send_u32(conn, EMUCOM_ERR_NOT_SUPPORTED);
+
+	if (length > emu->emucom_length)
+		length = emu->emucom_length;
+
+	if (!send_u32(conn, length))
+		return false;
+
+	if (!conn_send(conn, emu->emucom_data, length))
+		return false;
+
+	emu->emucom_length -= length;
+	memmove(emu->emucom_data, emu->emucom_data + length,
+		emu->emucom_length);
+
+	return true;
+}
+
+static bool handle_emucom_write(struct connection *conn, uint32_t channel,
+		uint32_t length)
+{
+	struct emu *emu;
+	uint8_t buf[256];
+	uint32_t written;
+	size_t tmp;
+
+	emu = conn->emu;
+	written = 0;
+
+	/* The data is always sent by the host, even for unknown channels. */
+	while (length > 0) {
+		tmp = length;
+
+		if (tmp > sizeof(buf))
+			tmp = sizeof(buf);
+
+		if (!conn_recv(conn, buf, tmp))
+			return false;
+
+		length -= tmp;
+
+		if (channel != JAYLINK_EMUCOM_CHANNEL_USER)
+			continue;
+
+		if (tmp > EMUCOM_LOOPBACK_SIZE - emu->emucom_length)
+			tmp = EMUCOM_LOOPBACK_SIZE - emu->emucom_length;
+
+		memcpy(emu->emucom_data + emu->emucom_length, buf, tmp);
+		emu->emucom_length += tmp;
+		written += tmp;
+	}
+
+	if (channel != JAYLINK_EMUCOM_CHANNEL_USER)
+		return send_u32(conn, EMUCOM_ERR_NOT_SUPPORTED);
+
+	return send_u32(conn, written);
+}
+
+static bool handle_emucom(struct connection *conn)
+{
+	uint8_t cmd;
+	uint32_t channel;
+	uint32_t length;
+
+	if (!recv_u8(conn, &cmd))
+		return false;
+
+	if (!recv_u32(conn, &channel) || !recv_u32(conn, &length))
+		return false;
+
+	if (cmd == EMUCOM_CMD_READ)
+		return handle_emucom_read(conn, channel, length);
+	else if (cmd == EMUCOM_CMD_WRITE)
+		return handle_emucom_write(conn, channel, length);
+
+	return false;
+}
+
+static struct emu_file *find_file(struct emu *emu, const char *name)
+{
+	struct emu_file *file;
+
+	for (file = emu->files; file; file = file->next) {
+		if (!strcmp(file->name, name))
+			return file;
+	}
+
+	return NULL;
+}
+
+static bool delete_file(struct emu *emu, const char *name)
+{
+	struct emu_file **file;
+	struct emu_file *tmp;
+
+	for (file = &emu->files; *file; file = &(*file)->next) {
+		if (strcmp((*file)->name, name))
+			continue;
+
+		tmp = *file;
+		*file = tmp->next;
+		free(tmp->data);
+		free(tmp);
+
+		return true;
+	}
+
+	return false;
+}
+
+static bool file_read(struct connection *conn, const char *name,
+		uint32_t offset, uint32_t length)
+{
+	struct emu_file *file;
+	size_t tmp;
+
+	file = find_file(conn->emu, name);
+	tmp = 0;
+
+	if (file && offset < file->size) {
+		tmp = file->size - offset;
+
+		if (tmp > length)
+			tmp = length;
+	}
+
+	/* The requested number of bytes is always sent. */
+	if (tmp > 0 && !conn_send(conn, file->data + offset, tmp))
+		return false;
+
+	if (!send_zeros(conn, length - tmp))
+		return false;
+
+	if (!file)
+		return send_u32(conn, FILE_IO_ERR);
+
+	return send_u32(conn, tmp);
+}
+
+static bool file_write(struct connection *conn, const char *name,
+		uint32_t offset, uint32_t length)
+{
+	struct emu *emu;
+	struct emu_file *file;
+	uint8_t *data;
+	uint8_t prefix;
+	size_t size;
+
+	emu = conn->emu;
+
+	/*
+	 * The data is sent with a separate write operation which has its own
+	 * prefix on TCP/IP.
+	 */
+	if (!emu->usb && (!recv_u8(conn, &prefix) || prefix != CMD_CLIENT))
+		return false;
+
+	file = find_file(emu, name);
+
+	if (!file) {
+		file = malloc(sizeof(struct emu_file));
+
+		if (!file)
+			return false;
+
+		strcpy(file->name, name);
+		file->data = NULL;
+		file->size = 0;
+		file->next = emu->files;
+		emu->files = file;
+	}
+
+	size = (size_t)offset + length;
+
+	if (size > file->size) {
+		data = realloc(file->data, size);
+
+		if (!data)
+			return false;
+
+		memset(data + file->size, 0, size - file->size);
+		file->data = data;
+		file->size = size;
+	}
+
+	if (!conn_recv(conn, file->data + offset, length))
+		return false;
+
+	return send_u32(conn, length);
+}
+
+static bool handle_file_io(struct connection *conn)
+{
+	struct emu_file *file;
+	uint8_t buf[2];
+	uint8_t param[2];
+	char name[JAYLINK_FILE_NAME_MAX_LENGTH + 1];
+	uint32_t offset;
+	uint32_t length;
+
+	if (!conn_recv(conn, buf, sizeof(buf)))
+		return false;
+
+	name[0] = '\0';
+	offset = 0;
+	length = 0;
+
+	while (true) {
+		if (!recv_u8(conn, &param[0]))
+			return false;
+
+		if (!param[0])
+			break;
+
+		if (!recv_u8(conn, &param[1]))
+			return false;
+
+		if (param[1] == FILE_IO_PARAM_FILENAME) {
+			if (!conn_recv(conn, (uint8_t *)name, param[0]))
+				return false;
+
+			name[param[0]] = '\0';
+		} else if (param[0] == 4) {
+			if (!recv_u32(conn, param[1] == FILE_IO_PARAM_OFFSET ?
+					&offset : &length))
+				return false;
+		} else {
+			return false;
+		}
+	}
+
+	switch (buf[0]) {
+	case FILE_IO_CMD_READ:
+		return file_read(conn, name, offset, length);
+	case FILE_IO_CMD_WRITE:
+		return file_write(conn, name, offset, length);
+	case FILE_IO_CMD_GET_SIZE:
+		file = find_file(conn->emu, name);
+
+		if (!file)
+			return send_u32(conn, FILE_IO_ERR);
+
+		return send_u32(conn, file->size);
+	case FILE_IO_CMD_DELETE:
+		if (!delete_file(conn->emu, name))
+			return send_u32(conn, FILE_IO_ERR);
+
+		return send_u32(conn, 0);
+	default:
+		return false;
+	}
+}
+
+static bool handle_command(struct connection *conn, uint8_t cmd)
+{
+	struct emu *emu;
+	uint8_t buf[4];
+	uint16_t speed;
+
+	emu = conn->emu;
+
+	switch (cmd) {
+	case CMD_GET_VERSION:
+		return handle_get_version(conn);
+	case CMD_SET_SPEED:
+		if (!recv_u16(conn, &speed))
+			return false;
+
+		emu->speed = speed;
+		return true;
+	case CMD_GET_HW_STATUS:
+		return handle_get_hw_status(conn);
+	case CMD_SET_TARGET_POWER:
+		if (!recv_u8(conn, buf))
+			return false;
+
+		emu->target_power = buf[0];
+		return true;
+	case CMD_REGISTER:
+		return handle_register(conn);
+	case CMD_FILE_IO:
+		return handle_file_io(conn);
+	case CMD_GET_SPEEDS:
+		return handle_get_speeds(conn);
+	case CMD_GET_HW_INFO:
+		return handle_get_hw_info(conn, false);
+	case CMD_GET_COUNTERS:
+		return handle_get_hw_info(conn, true);
+	case CMD_SELECT_TIF:
+		return handle_select_tif(conn);
+	case CMD_JTAG_IO_V2:
+	case CMD_JTAG_IO_V3:
+		return handle_io(conn, cmd);
+	case CMD_GET_FREE_MEMORY:
+		return send_u32(conn, emu->free_memory);
+	case CMD_CLEAR_RESET:
+		emu->reset = false;
+		return true;
+	case CMD_SET_RESET:
+		emu->reset = true;
+		return true;
+	case CMD_JTAG_CLEAR_TRST:
+		emu->trst = false;
+		emu_jtag_reset(&emu->jtag);
+		return true;
+	case CMD_JTAG_SET_TRST:
+		emu->trst = true;
+		return true;
+	case CMD_GET_CAPS:
+		return conn_send(conn, emu->caps, JAYLINK_DEV_CAPS_SIZE);
+	case CMD_SWO:
+		return handle_swo(conn);
+	case CMD_GET_EXT_CAPS:
+		return conn_send(conn, emu->caps, JAYLINK_DEV_EXT_CAPS_SIZE);
+	case CMD_EMUCOM:
+		return handle_emucom(conn);
+	case CMD_GET_HW_VERSION:
+		return send_u32(conn, hw_version_value(&emu->hw_version));
+	case CMD_READ_CONFIG:
+		return conn_send(conn, emu->config, JAYLINK_DEV_CONFIG_SIZE);
+	case CMD_WRITE_CONFIG:
+		return conn_recv(conn, emu->config, JAYLINK_DEV_CONFIG_SIZE);
+	default:
+		fprintf(stderr, "Unknown command: 0x%02x.\n", cmd);
+		return false;
+	}
+}
+
+static bool send_hello(struct connection *conn)
+{
+	uint8_t buf[4];
+
+	buf[0] = CMD_SERVER;
+	emu_set_u16(buf, PROTO_VERSION, 1);
+	buf[3] = strlen(SERVER_NAME);
+
+	if (!conn_send(conn, buf, sizeof(buf)))
+		return false;
+
+	if (!conn_send(conn, (const uint8_t *)SERVER_NAME, buf[3]))
+		return false;
+
+	return flush(conn);
+}
+
+/**
+ * Serve a connection.
+ *
+ * The function returns when the connection was closed by the host or on a
+ * protocol violation. Commands of different connections to the same emulator
+ * are processed one after the other.
+ *
+ * @param[in,out] emu Emulator.
+ * @param[in] fd Connected stream socket.
+ *
+ * @return 0 if the connection was closed by the host, or -1 on a protocol
+ *         violation or I/O error.
+ */
+int emu_serve(struct emu *emu, int fd)
+{
+	struct connection *conn;
+	uint8_t buf[2];
+	bool ret;
+
+	conn = malloc(sizeof(struct connection));
+
+	if (!conn)
+		return -1;
+
+	conn->emu = emu;
+	conn->fd = fd;
+	conn->in_pos = 0;
+	conn->in_length = 0;
+	conn->out_length = 0;
+
+	if (!emu->usb && !send_hello(conn)) {
+		free(conn);
+		return -1;
+	}
+
+	while (true) {
+		/* Commands are not prefixed on USB. */
+		if (!conn_recv(conn, emu->usb ? &buf[1] : buf, 1)) {
+			free(conn);
+			return 0;
+		}
+
+		if (!emu->usb && buf[0] != CMD_CLIENT) {
+			fprintf(stderr, "Invalid command prefix: 0x%02x.\n",
+				buf[0]);
+			break;
+		}
+
+		if (!emu->usb && !recv_u8(conn, &buf[1]))
+			break;
+
+		if (emu->verbose)
+			fprintf(stderr, "Command 0x%02x.\n", buf[1]);
+
+		pthread_mutex_lock(&emu->mutex);
+		ret = handle_command(conn, buf[1]);
+		pthread_mutex_unlock(&emu->mutex);
+
+		if (!ret)
+			break;
+	}
+
+	flush(conn);
+	free(conn);
+
+	return -1;
+}
+
+/**
+ * Allocate an emulator.
+ *
+ * The emulator has a JTAG chain with a single TAP and an SWD target with an
+ * ADIv5 debug port and a MEM-AP.
+ *
+ * @return The emulator on success, or NULL on failure.
+ */
+struct emu *emu_new(void)
+{
+	struct emu *emu;
+	static const unsigned int caps[] = {
+		JAYLINK_DEV_CAP_GET_HW_VERSION,
+		JAYLINK_DEV_CAP_READ_CONFIG,
+		JAYLINK_DEV_CAP_WRITE_CONFIG,
+		JAYLINK_DEV_CAP_GET_SPEEDS,
+		JAYLINK_DEV_CAP_GET_FREE_MEMORY,
+		JAYLINK_DEV_CAP_GET_HW_INFO,
+		JAYLINK_DEV_CAP_SET_TARGET_POWER,
+		JAYLINK_DEV_CAP_SELECT_TIF,
+		JAYLINK_DEV_CAP_GET_COUNTERS,
+		JAYLINK_DEV_CAP_SWO,
+		JAYLINK_DEV_CAP_FILE_IO,
+		JAYLINK_DEV_CAP_REGISTER,
+		JAYLINK_DEV_CAP_GET_EXT_CAPS,
+		JAYLINK_DEV_CAP_EMUCOM
+	};
+	size_t i;
+
+	emu = calloc(1, sizeof(struct emu));
+
+	if (!emu)
+		return NULL;
+
+	emu->emucom_data = malloc(EMUCOM_LOOPBACK_SIZE);
+
+	if (!emu->emucom_data) {
+		free(emu);
+		return NULL;
+	}
+
+	if (pthread_mutex_init(&emu->mutex, NULL)) {
+		free(emu->emucom_data);
+		free(emu);
+		return NULL;
+	}
+
+	emu->serial_number = 123456789;
+	snprintf(emu->firmware_version, sizeof(emu->firmware_version),
+		"J-Link Emulator compiled %s", __DATE__);
+
+	for (i = 0; i < sizeof(caps) / sizeof(caps[0]); i++)
+		emu->caps[caps[i] / 8] |= 1 << (caps[i] % 8);
+
+	emu->hw_version.type = JAYLINK_HW_TYPE_JLINK;
+	emu->hw_version.major = 9;
+	emu->hw_version.minor = 0;
+	emu->hw_version.revision = 0;
+
+	memset(emu->config, 0xff, sizeof(emu->config));
+
+	emu->free_memory = 32 * 1024;
+	emu->base_freq = 60000000;
+	emu->min_div = 4;
+	emu->speed = 4000;
+	emu->iface = JAYLINK_TIF_JTAG;
+	emu->reset = true;
+	emu->trst = true;
+	emu->next_handle = 1;
+	emu->swo_buffer_size = 0;
+	emu->start_time = emu_get_time();
+
+	emu_jtag_init(&emu->jtag);
+	emu_jtag_add_dp(&emu->jtag, 0x4ba00477, &emu->swd);
+	emu_jtag_add_dtm(&emu->jtag, 0x20000913, &emu->riscv);
+	emu_swd_init(&emu->swd);
+	emu_riscv_init(&emu->riscv, emu->swd.ram);
+
+	return emu;
+}
+
+/**
+ * Free an emulator.
+ *
+ * @param[in,out] emu Emulator. All connections to the emulator must be closed.
+ */
+void emu_free(struct emu *emu)
+{
+	if (!emu)
+		return;
+
+	while (emu->files)
+		delete_file(emu, emu->files->name);
+
+	pthread_mutex_destroy(&emu->mutex);
+	free(emu->emucom_data);
+	free(emu);
+}
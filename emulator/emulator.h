@@ -0,0 +1,349 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JAYLINK_EMULATOR_EMULATOR_H
+#define JAYLINK_EMULATOR_EMULATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include <libjaylink/libjaylink.h>
+
+/**
+ * @file
+ *
+ * J-Link device emulator.
+ *
+ * The emulator implements the device side of the J-Link protocol including the
+ * framing of the TCP/IP protocol, see transport_tcp.c. It can be used as TCP/IP
+ * server or in-process through a custom transport. As TCP/IP server, it can
+ * serve the USB protocol for the libusb stand-in in usbemu/ as well.
+ */
+
+/** Default TCP port of the emulator. */
+#define EMU_DEFAULT_PORT	19020
+
+/** Maximum number of TAPs in the simulated JTAG chain. */
+#define EMU_MAX_TAPS		8
+
+/** Size of a connection table entry in bytes. */
+#define EMU_CONN_ENTRY_SIZE	16
+
+/** Start address of the simulated target memory. */
+#define EMU_RAM_ADDRESS		0x20000000
+/** Size of the simulated target memory in bytes. */
+#define EMU_RAM_SIZE		0x10000
+
+/** Number of address bits of the simulated RISC-V DMI. */
+#define EMU_RISCV_ABITS		7
+/** Number of abstract data registers of the simulated RISC-V DM. */
+#define EMU_RISCV_DATA_COUNT	12
+/** Number of program buffer words of the simulated RISC-V DM. */
+#define EMU_RISCV_PROGBUF_SIZE	16
+/** Number of harts of the simulated RISC-V target. */
+#define EMU_RISCV_NUM_HARTS	4
+/** Number of CSRs of each simulated RISC-V hart. */
+#define EMU_RISCV_NUM_CSRS	4096
+
+/** JTAG TAP controller states. */
+enum emu_tap_state {
+	EMU_TAP_RESET = 0,
+	EMU_TAP_IDLE,
+	EMU_TAP_DRSELECT,
+	EMU_TAP_DRCAPTURE,
+	EMU_TAP_DRSHIFT,
+	EMU_TAP_DREXIT1,
+	EMU_TAP_DRPAUSE,
+	EMU_TAP_DREXIT2,
+	EMU_TAP_DRUPDATE,
+	EMU_TAP_IRSELECT,
+	EMU_TAP_IRCAPTURE,
+	EMU_TAP_IRSHIFT,
+	EMU_TAP_IREXIT1,
+	EMU_TAP_IRPAUSE,
+	EMU_TAP_IREXIT2,
+	EMU_TAP_IRUPDATE
+};
+
+/** Simulated JTAG TAP. */
+struct emu_tap {
+	/** IDCODE of the TAP. */
+	uint32_t idcode;
+	/** Length of the instruction register in bits. */
+	unsigned int ir_length;
+	/** Instruction which selects the IDCODE register. */
+	uint32_t idcode_instruction;
+	/** Value captured by the instruction register. */
+	uint32_t ir_capture;
+	/** Current instruction. */
+	uint32_t ir;
+	/** Shift register. */
+	uint64_t shift;
+	/** Length of the shift register in bits. */
+	unsigned int shift_length;
+	/** DP accessed by the TAP, or NULL if the TAP is no JTAG-DP. */
+	struct emu_swd *dp;
+	/** DM accessed by the TAP, or NULL if the TAP is no RISC-V DTM. */
+	struct emu_riscv *dtm;
+};
+
+/** Simulated JTAG scan chain. */
+struct emu_jtag {
+	/** State of the TAP controllers. */
+	enum emu_tap_state state;
+	/**
+	 * TAPs of the scan chain.
+	 *
+	 * TAP 0 is connected to TDO and the last TAP is connected to TDI.
+	 */
+	struct emu_tap taps[EMU_MAX_TAPS];
+	/** Number of TAPs. */
+	size_t num_taps;
+};
+
+/** Simulated Serial Wire Debug (SWD) Debug Port (DP) and MEM-AP. */
+struct emu_swd {
+	/** State of the SWD line protocol. */
+	int state;
+	/** Number of bits processed in the current state. */
+	unsigned int num_bits;
+	/** Shift register of the current state. */
+	uint64_t shift;
+	/** Packet request. */
+	uint8_t request;
+	/** Acknowledge of the current transaction. */
+	uint8_t ack;
+	/** Data to be sent to the host for the current transaction. */
+	uint32_t data;
+	/** Number of consecutive host-driven high bits. */
+	unsigned int num_ones;
+	/** Indicates whether a high bit starts a packet request. */
+	bool armed;
+	/**
+	 * Number of clock cycles of a memory access of the MEM-AP. AP accesses
+	 * during a memory access are acknowledged with WAIT.
+	 */
+	unsigned int latency;
+	/** Number of clock cycles until the pending memory access completes. */
+	unsigned int busy;
+	/** Indicates whether the current JTAG-DP access is ignored. */
+	bool jtag_wait;
+	/** Result of the previous JTAG-DP access. */
+	uint32_t jtag_result;
+	/** DP CTRL/STAT register. */
+	uint32_t ctrl_stat;
+	/** DP SELECT register. */
+	uint32_t select;
+	/** DP RDBUFF register. */
+	uint32_t rdbuff;
+	/** MEM-AP CSW register. */
+	uint32_t csw;
+	/** MEM-AP TAR register. */
+	uint32_t tar;
+	/** Simulated target memory. */
+	uint8_t ram[EMU_RAM_SIZE];
+};
+
+/** Simulated RISC-V Debug Transport Module (DTM) and Debug Module (DM). */
+struct emu_riscv {
+	/**
+	 * Number of clock cycles of a DMI access. Accesses during a DMI
+	 * access set the sticky busy status.
+	 */
+	unsigned int latency;
+	/** Number of clock cycles until the pending DMI access completes. */
+	unsigned int busy;
+	/** Run-Test/Idle hint of the dtmcs register. */
+	unsigned int idle;
+	/** Sticky status of the DMI. */
+	uint8_t dmistat;
+	/** Data of the dmi register. */
+	uint32_t dmi_data;
+	/** Address of the dmi register. */
+	uint32_t dmi_address;
+	/** DM dmcontrol register. */
+	uint32_t dmcontrol;
+	/** DM abstractauto register. */
+	uint32_t abstractauto;
+	/** DM abstract data registers. */
+	uint32_t data[EMU_RISCV_DATA_COUNT];
+	/** DM program buffer. */
+	uint32_t progbuf[EMU_RISCV_PROGBUF_SIZE];
+	/**
+	 * Number of clock cycles of a system bus access or an abstract command.
+	 * Accesses during a system bus access set the sbbusyerror bit, and
+	 * accesses during an abstract command set the busy command error.
+	 */
+	unsigned int sb_latency;
+	/** Number of clock cycles until the pending system bus access ends. */
+	unsigned int sb_busy;
+	/** DM sbcs register without the read-only bits. */
+	uint32_t sbcs;
+	/** DM sbaddress0 register. */
+	uint32_t sbaddress;
+	/** DM sbdata0 register. */
+	uint32_t sbdata;
+	/** Memory on the system bus at EMU_RAM_ADDRESS. */
+	uint8_t *ram;
+	/** Number of clock cycles until the abstract command completes. */
+	unsigned int cmd_busy;
+	/** DM command register. */
+	uint32_t command;
+	/** Error of the last abstract command. */
+	uint8_t cmderr;
+	/** General purpose registers of the harts. */
+	uint32_t gprs[EMU_RISCV_NUM_HARTS][32];
+	/** CSRs of the harts. */
+	uint32_t csrs[EMU_RISCV_NUM_HARTS][EMU_RISCV_NUM_CSRS];
+};
+
+/** Emulator file. */
+struct emu_file {
+	/** Filename. */
+	char name[JAYLINK_FILE_NAME_MAX_LENGTH + 1];
+	/** File content. */
+	uint8_t *data;
+	/** File size in bytes. */
+	size_t size;
+	/** Next file. */
+	struct emu_file *next;
+};
+
+/** J-Link device emulator. */
+struct emu {
+	/** Mutex to serialize the command processing of all connections. */
+	pthread_mutex_t mutex;
+	/** Serial number. */
+	uint32_t serial_number;
+	/** Firmware version string. */
+	char firmware_version[112];
+	/** Device capabilities. */
+	uint8_t caps[JAYLINK_DEV_EXT_CAPS_SIZE];
+	/** Hardware version. */
+	struct jaylink_hardware_version hw_version;
+	/** Device configuration. */
+	uint8_t config[JAYLINK_DEV_CONFIG_SIZE];
+	/** Free memory in bytes. */
+	uint32_t free_memory;
+	/** Base frequency in Hz. */
+	uint32_t base_freq;
+	/** Minimum frequency divider. */
+	uint16_t min_div;
+	/** Current target interface speed in kHz. */
+	uint16_t speed;
+	/** Target power supply state. */
+	bool target_power;
+	/** Selected target interface. */
+	uint32_t iface;
+	/** Target reset signal state. */
+	bool reset;
+	/** TRST signal state. */
+	bool trst;
+	/** Table of registered connections in device representation. */
+	uint8_t connections[JAYLINK_MAX_CONNECTIONS][EMU_CONN_ENTRY_SIZE];
+	/** Number of registered connections. */
+	size_t num_connections;
+	/** Handle of the next registered connection. */
+	uint16_t next_handle;
+	/** Simulated JTAG scan chain. */
+	struct emu_jtag jtag;
+	/** Simulated SWD target. */
+	struct emu_swd swd;
+	/** Simulated RISC-V target. */
+	struct emu_riscv riscv;
+	/** Indicates whether SWO capturing is running. */
+	bool swo_running;
+	/** SWO buffer size in bytes. */
+	uint32_t swo_buffer_size;
+	/** Number of SWO bytes generated so far. */
+	uint32_t swo_counter;
+	/** Data of the EMUCOM loopback channel. */
+	uint8_t *emucom_data;
+	/** Number of bytes in the EMUCOM loopback channel. */
+	size_t emucom_length;
+	/** Files. */
+	struct emu_file *files;
+	/** Start time of the emulator in microseconds. */
+	uint64_t start_time;
+	/**
+	 * Indicates whether connections use the USB protocol, which is the
+	 * TCP/IP protocol without the hello message and command prefixes.
+	 */
+	bool usb;
+	/** Indicates whether verbose output is enabled. */
+	bool verbose;
+};
+
+/*--- emulator.c ------------------------------------------------------------*/
+
+struct emu *emu_new(void);
+void emu_free(struct emu *emu);
+int emu_serve(struct emu *emu, int fd);
+
+/*--- jtag.c ----------------------------------------------------------------*/
+
+void emu_jtag_init(struct emu_jtag *jtag);
+bool emu_jtag_add_tap(struct emu_jtag *jtag, uint32_t idcode,
+		unsigned int ir_length);
+bool emu_jtag_add_dp(struct emu_jtag *jtag, uint32_t idcode,
+		struct emu_swd *dp);
+bool emu_jtag_add_dtm(struct emu_jtag *jtag, uint32_t idcode,
+		struct emu_riscv *dtm);
+bool emu_jtag_set_ir_capture(struct emu_jtag *jtag, uint32_t capture);
+void emu_jtag_reset(struct emu_jtag *jtag);
+void emu_jtag_io(struct emu_jtag *jtag, const uint8_t *tms,
+		const uint8_t *tdi, uint8_t *tdo, size_t length);
+
+/*--- riscv.c ---------------------------------------------------------------*/
+
+void emu_riscv_init(struct emu_riscv *riscv, uint8_t *ram);
+uint64_t emu_riscv_dtmcs_capture(const struct emu_riscv *riscv);
+void emu_riscv_dtmcs_update(struct emu_riscv *riscv, uint64_t shift);
+uint64_t emu_riscv_dmi_capture(struct emu_riscv *riscv);
+void emu_riscv_dmi_update(struct emu_riscv *riscv, uint64_t shift);
+
+/*--- server.c --------------------------------------------------------------*/
+
+int emu_tcp_listen(const char *address, uint16_t port);
+int emu_tcp_run(struct emu *emu, int sock);
+int emu_loopback_new(struct emu *emu, struct jaylink_context *ctx,
+		struct jaylink_device **dev);
+
+/*--- swd.c -----------------------------------------------------------------*/
+
+void emu_swd_init(struct emu_swd *swd);
+uint64_t emu_swd_jtag_capture(struct emu_swd *swd);
+void emu_swd_jtag_update(struct emu_swd *swd, bool ap, uint64_t shift);
+void emu_swd_jtag_abort(struct emu_swd *swd, uint32_t value);
+void emu_swd_io(struct emu_swd *swd, const uint8_t *direction,
+		const uint8_t *out, uint8_t *in, size_t length);
+
+/*--- util.c ----------------------------------------------------------------*/
+
+uint16_t emu_get_u16(const uint8_t *buffer, size_t offset);
+uint32_t emu_get_u32(const uint8_t *buffer, size_t offset);
+void emu_set_u16(uint8_t *buffer, uint16_t value, size_t offset);
+void emu_set_u32(uint8_t *buffer, uint32_t value, size_t offset);
+bool emu_get_bit(const uint8_t *buffer, size_t offset);
+void emu_set_bit(uint8_t *buffer, size_t offset, bool value);
+uint64_t emu_get_time(void);
+
+#endif /* JAYLINK_EMULATOR_EMULATOR_H */
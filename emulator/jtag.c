@@ -0,0 +1,363 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "emulator.h"
+
+/**
+ * @file
+ *
+ * Simulated JTAG scan chain.
+ */
+
+/** Instruction register length of a JTAG-DP in bits. */
+#define DP_IR_LENGTH		4
+
+#define DP_IR_ABORT		0x08
+#define DP_IR_DPACC		0x0a
+#define DP_IR_APACC		0x0b
+#define DP_IR_IDCODE		0x0e
+
+/** Length of the ABORT, DPACC and APACC scan chains in bits. */
+#define DP_ACC_LENGTH		35
+
+/** Instruction register length of a RISC-V DTM in bits. */
+#define DTM_IR_LENGTH		5
+
+#define DTM_IR_DTMCS		0x10
+#define DTM_IR_DMI		0x11
+
+/** Length of the dtmcs register in bits. */
+#define DTM_DTMCS_LENGTH	32
+
+/* Next TAP controller state indexed by the current state and TMS. */
+static const enum emu_tap_state next_state[16][2] = {
+	[EMU_TAP_RESET] = {EMU_TAP_IDLE, EMU_TAP_RESET},
+	[EMU_TAP_IDLE] = {EMU_TAP_IDLE, EMU_TAP_DRSELECT},
+	[EMU_TAP_DRSELECT] = {EMU_TAP_DRCAPTURE, EMU_TAP_IRSELECT},
+	[EMU_TAP_DRCAPTURE] = {EMU_TAP_DRSHIFT, EMU_TAP_DREXIT1},
+	[EMU_TAP_DRSHIFT] = {EMU_TAP_DRSHIFT, EMU_TAP_DREXIT1},
+	[EMU_TAP_DREXIT1] = {EMU_TAP_DRPAUSE, EMU_TAP_DRUPDATE},
+	[EMU_TAP_DRPAUSE] = {EMU_TAP_DRPAUSE, EMU_TAP_DREXIT2},
+	[EMU_TAP_DREXIT2] = {EMU_TAP_DRSHIFT, EMU_TAP_DRUPDATE},
+	[EMU_TAP_DRUPDATE] = {EMU_TAP_IDLE, EMU_TAP_DRSELECT},
+	[EMU_TAP_IRSELECT] = {EMU_TAP_IRCAPTURE, EMU_TAP_RESET},
+	[EMU_TAP_IRCAPTURE] = {EMU_TAP_IRSHIFT, EMU_TAP_IREXIT1},
+	[EMU_TAP_IRSHIFT] = {EMU_TAP_IRSHIFT, EMU_TAP_IREXIT1},
+	[EMU_TAP_IREXIT1] = {EMU_TAP_IRPAUSE, EMU_TAP_IRUPDATE},
+	[EMU_TAP_IRPAUSE] = {EMU_TAP_IRPAUSE, EMU_TAP_IREXIT2},
+	[EMU_TAP_IREXIT2] = {EMU_TAP_IRSHIFT, EMU_TAP_IRUPDATE},
+	[EMU_TAP_IRUPDATE] = {EMU_TAP_IDLE, EMU_TAP_DRSELECT}
+};
+
+static uint32_t bypass_instruction(const struct emu_tap *tap)
+{
+	return (uint32_t)((1ULL << tap->ir_length) - 1);
+}
+
+static void capture_dr(struct emu_tap *tap)
+{
+	if (tap->dp && (tap->ir == DP_IR_DPACC || tap->ir == DP_IR_APACC)) {
+		tap->shift = emu_swd_jtag_capture(tap->dp);
+		tap->shift_length = DP_ACC_LENGTH;
+		return;
+	}
+
+	if (tap->dp && tap->ir == DP_IR_ABORT) {
+		tap->shift = 0;
+		tap->shift_length = DP_ACC_LENGTH;
+		return;
+	}
+
+	if (tap->dtm && tap->ir == DTM_IR_DTMCS) {
+		tap->shift = emu_riscv_dtmcs_capture(tap->dtm);
+		tap->shift_length = DTM_DTMCS_LENGTH;
+		return;
+	}
+
+	if (tap->dtm && tap->ir == DTM_IR_DMI) {
+		tap->shift = emu_riscv_dmi_capture(tap->dtm);
+		tap->shift_length = EMU_RISCV_ABITS + 34;
+		return;
+	}
+
+	if (tap->ir == tap->idcode_instruction && tap->idcode) {
+		tap->shift = tap->idcode;
+		tap->shift_length = 32;
+		return;
+	}
+
+	/* All other instructions select the bypass register. */
+	tap->shift = 0;
+	tap->shift_length = 1;
+}
+
+static void update_dr(struct emu_tap *tap)
+{
+	if (tap->dtm && tap->ir == DTM_IR_DTMCS)
+		emu_riscv_dtmcs_update(tap->dtm, tap->shift);
+	else if (tap->dtm && tap->ir == DTM_IR_DMI)
+		emu_riscv_dmi_update(tap->dtm, tap->shift);
+
+	if (!tap->dp)
+		return;
+
+	if (tap->ir == DP_IR_DPACC || tap->ir == DP_IR_APACC)
+		emu_swd_jtag_update(tap->dp, tap->ir == DP_IR_APACC,
+			tap->shift);
+	else if (tap->ir == DP_IR_ABORT)
+		emu_swd_jtag_abort(tap->dp, tap->shift >> 3);
+}
+
+static void capture_ir(struct emu_tap *tap)
+{
+	tap->shift = tap->ir_capture;
+	tap->shift_length = tap->ir_length;
+}
+
+static void update_ir(struct emu_tap *tap)
+{
+	tap->ir = tap->shift & bypass_instruction(tap);
+}
+
+static void reset_tap(struct emu_tap *tap)
+{
+	/*
+	 * The IDCODE instruction is selected on reset, or the bypass
+	 * instruction if the TAP has no IDCODE register.
+	 */
+	if (tap->idcode)
+		tap->ir = tap->idcode_instruction;
+	else
+		tap->ir = bypass_instruction(tap);
+}
+
+void emu_jtag_init(struct emu_jtag *jtag)
+{
+	jtag->num_taps = 0;
+	jtag->state = EMU_TAP_RESET;
+}
+
+/*
+ * Add a TAP to the end of the scan chain, which is the TDI side. The IDCODE
+ * instruction of the TAP is 1, an IDCODE of 0 indicates a TAP without IDCODE
+ * register.
+ */
+bool emu_jtag_add_tap(struct emu_jtag *jtag, uint32_t idcode,
+		unsigned int ir_length)
+{
+	struct emu_tap *tap;
+
+	if (jtag->num_taps == EMU_MAX_TAPS)
+		return false;
+
+	if (ir_length < 2 || ir_length > 32)
+		return false;
+
+	tap = &jtag->taps[jtag->num_taps];
+	tap->idcode = idcode;
+	tap->ir_length = ir_length;
+	tap->idcode_instruction = 0x01;
+	tap->ir_capture = 0x01;
+	tap->shift = 0;
+	tap->shift_length = 1;
+	tap->dp = NULL;
+	tap->dtm = NULL;
+
+	reset_tap(tap);
+	jtag->num_taps++;
+
+	return true;
+}
+
+/*
+ * Add an ARM JTAG-DP to the end of the scan chain. The DPACC and APACC scan
+ * chains access the specified DP.
+ */
+bool emu_jtag_add_dp(struct emu_jtag *jtag, uint32_t idcode,
+		struct emu_swd *dp)
+{
+	struct emu_tap *tap;
+
+	if (!emu_jtag_add_tap(jtag, idcode, DP_IR_LENGTH))
+		return false;
+
+	tap = &jtag->taps[jtag->num_taps - 1];
+	tap->idcode_instruction = DP_IR_IDCODE;
+	tap->dp = dp;
+
+	reset_tap(tap);
+
+	return true;
+}
+
+/*
+ * Add a RISC-V DTM to the end of the scan chain. The dmi register accesses
+ * the specified DM.
+ */
+bool emu_jtag_add_dtm(struct emu_jtag *jtag, uint32_t idcode,
+		struct emu_riscv *dtm)
+{
+	if (!emu_jtag_add_tap(jtag, idcode, DTM_IR_LENGTH))
+		return false;
+
+	jtag->taps[jtag->num_taps - 1].dtm = dtm;
+
+	return true;
+}
+
+/*
+ * Set the value captured by the instruction register of the last TAP. The two
+ * least significant bits must be 01b, the default value is 1.
+ */
+bool emu_jtag_set_ir_capture(struct emu_jtag *jtag, uint32_t capture)
+{
+	struct emu_tap *tap;
+
+	if (!jtag->num_taps || (capture & 0x03) != 0x01)
+		return false;
+
+	tap = &jtag->taps[jtag->num_taps - 1];
+
+	if (tap->ir_length < 32 && capture >> tap->ir_length)
+		return false;
+
+	tap->ir_capture = capture;
+
+	return true;
+}
+
+/* Advance the pending accesses of the debug modules by one clock cycle. */
+static void clock_taps(struct emu_jtag *jtag)
+{
+	struct emu_tap *tap;
+	size_t i;
+
+	for (i = 0; i < jtag->num_taps; i++) {
+		tap = &jtag->taps[i];
+
+		if (tap->dp && tap->dp->busy > 0)
+			tap->dp->busy--;
+
+		if (tap->dtm && tap->dtm->busy > 0)
+			tap->dtm->busy--;
+
+		if (tap->dtm && tap->dtm->sb_busy > 0)
+			tap->dtm->sb_busy--;
+
+		if (tap->dtm && tap->dtm->cmd_busy > 0)
+			tap->dtm->cmd_busy--;
+	}
+}
+
+void emu_jtag_reset(struct emu_jtag *jtag)
+{
+	size_t i;
+
+	jtag->state = EMU_TAP_RESET;
+
+	for (i = 0; i < jtag->num_taps; i++)
+		reset_tap(&jtag->taps[i]);
+}
+
+/* Shift one bit through the scan chain and return the bit shifted out. */
+static bool shift_chain(struct emu_jtag *jtag, bool tdi)
+{
+	struct emu_tap *tap;
+	bool bit;
+	size_t i;
+
+	bit = tdi;
+
+	for (i = jtag->num_taps; i > 0; i--) {
+		tap = &jtag->taps[i - 1];
+
+		tdi = bit;
+		bit = tap->shift & 1;
+		tap->shift >>= 1;
+
+		if (tdi)
+			tap->shift |= 1ULL << (tap->shift_length - 1);
+	}
+
+	return bit;
+}
+
+static void enter_state(struct emu_jtag *jtag, enum emu_tap_state state)
+{
+	size_t i;
+
+	jtag->state = state;
+
+	for (i = 0; i < jtag->num_taps; i++) {
+		switch (state) {
+		case EMU_TAP_RESET:
+			reset_tap(&jtag->taps[i]);
+			break;
+		case EMU_TAP_DRCAPTURE:
+			capture_dr(&jtag->taps[i]);
+			break;
+		case EMU_TAP_DRUPDATE:
+			update_dr(&jtag->taps[i]);
+			break;
+		case EMU_TAP_IRCAPTURE:
+			capture_ir(&jtag->taps[i]);
+			break;
+		case EMU_TAP_IRUPDATE:
+			update_ir(&jtag->taps[i]);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+void emu_jtag_io(struct emu_jtag *jtag, const uint8_t *tms,
+		const uint8_t *tdi, uint8_t *tdo, size_t length)
+{
+	enum emu_tap_state state;
+	bool bit;
+	size_t i;
+
+	memset(tdo, 0, (length + 7) / 8);
+
+	for (i = 0; i < length; i++) {
+		state = jtag->state;
+		bit = false;
+
+		clock_taps(jtag);
+
+		if (state == EMU_TAP_DRSHIFT || state == EMU_TAP_IRSHIFT) {
+			/* Without TAPs, TDI is directly connected to TDO. */
+			if (jtag->num_taps > 0)
+				bit = shift_chain(jtag, emu_get_bit(tdi, i));
+			else
+				bit = emu_get_bit(tdi, i);
+		}
+
+		emu_set_bit(tdo, i, bit);
+		state = next_state[state][emu_get_bit(tms, i)];
+
+		if (state != jtag->state)
+			enter_state(jtag, state);
+	}
+}
@@ -0,0 +1,264 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "emulator.h"
+
+static void usage(const char *name)
+{
+	printf("Usage: %s [OPTION]...\n\n"
+		"J-Link device emulator using the TCP/IP protocol.\n\n"
+		"  -a, --address=ADDRESS  IPv4 address to listen on\n"
+		"  -p, --port=PORT        port to listen on (default: %u)\n"
+		"  -t, --tap=IDCODE:IRLEN[:CAPTURE]\n"
+		"                         add a TAP to the JTAG chain, replaces "
+		"the default\n"
+		"                         TAP, CAPTURE is the instruction register "
+		"capture\n"
+		"                         (default: 1)\n"
+		"  -d, --dp=IDCODE        add a JTAG-DP to the JTAG chain, "
+		"replaces the default\n"
+		"                         TAP\n"
+		"  -r, --dtm=IDCODE       add a RISC-V DTM to the JTAG chain, "
+		"replaces the\n"
+		"                         default TAP\n"
+		"  -l, --latency=CYCLES   clock cycles of a memory or DMI access "
+		"(default: 0)\n"
+		"  -b, --bus-latency=CYCLES\n"
+		"                         clock cycles of a RISC-V system bus "
+		"access or abstract\n"
+		"                         command (default: 0)\n"
+		"  -u, --usb              serve the USB protocol for the libusb "
+		"stand-in\n"
+		"  -v, --verbose          print the received commands\n"
+		"  -h, --help             display this help and exit\n",
+		name, EMU_DEFAULT_PORT);
+}
+
+static bool parse_dp(struct emu *emu, const char *arg, bool *has_taps)
+{
+	unsigned long idcode;
+	char *end;
+
+	idcode = strtoul(arg, &end, 0);
+
+	if (*end != '\0')
+		return false;
+
+	if (!*has_taps) {
+		emu_jtag_init(&emu->jtag);
+		*has_taps = true;
+	}
+
+	return emu_jtag_add_dp(&emu->jtag, idcode, &emu->swd);
+}
+
+static bool parse_dtm(struct emu *emu, const char *arg, bool *has_taps)
+{
+	unsigned long idcode;
+	char *end;
+
+	idcode = strtoul(arg, &end, 0);
+
+	if (*end != '\0')
+		return false;
+
+	if (!*has_taps) {
+		emu_jtag_init(&emu->jtag);
+		*has_taps = true;
+	}
+
+	return emu_jtag_add_dtm(&emu->jtag, idcode, &emu->riscv);
+}
+
+static bool parse_tap(struct emu *emu, const char *arg, bool *has_taps)
+{
+	unsigned long idcode;
+	unsigned long ir_length;
+	unsigned long capture;
+	char *end;
+
+	idcode = strtoul(arg, &end, 0);
+
+	if (*end != ':')
+		return false;
+
+	ir_length = strtoul(end + 1, &end, 0);
+	capture = 0x01;
+
+	if (*end == ':')
+		capture = strtoul(end + 1, &end, 0);
+
+	if (*end != '\0')
+		return false;
+
+	if (!*has_taps) {
+		emu_jtag_init(&emu->jtag);
+		*has_taps = true;
+	}
+
+	if (!emu_jtag_add_tap(&emu->jtag, idcode, ir_length))
+		return false;
+
+	return emu_jtag_set_ir_capture(&emu->jtag, capture);
+}
+
+int main(int argc, char **argv)
+{
+	int ret;
+	int opt;
+	int sock;
+	struct emu *emu;
+	const char *address;
+	unsigned long port;
+	bool has_taps;
+	unsigned long latency;
+	char *end;
+	static const struct option options[] = {
+		{"address", required_argument, NULL, 'a'},
+		{"port", required_argument, NULL, 'p'},
+		{"tap", required_argument, NULL, 't'},
+		{"dp", required_argument, NULL, 'd'},
+		{"dtm", required_argument, NULL, 'r'},
+		{"latency", required_argument, NULL, 'l'},
+		{"bus-latency", required_argument, NULL, 'b'},
+		{"usb", no_argument, NULL, 'u'},
+		{"verbose", no_argument, NULL, 'v'},
+		{"help", no_argument, NULL, 'h'},
+		{NULL, 0, NULL, 0}
+	};
+
+	emu = emu_new();
+
+	if (!emu) {
+		fprintf(stderr, "Failed to allocate emulator.\n");
+		return EXIT_FAILURE;
+	}
+
+	address = NULL;
+	port = EMU_DEFAULT_PORT;
+	has_taps = false;
+
+	while ((opt = getopt_long(argc, argv, "a:p:t:d:r:l:b:uvh", options,
+			NULL)) != -1) {
+		switch (opt) {
+		case 'a':
+			address = optarg;
+			break;
+		case 'p':
+			port = strtoul(optarg, &end, 10);
+
+			if (*end != '\0' || !port || port > UINT16_MAX) {
+				fprintf(stderr, "Invalid port: %s.\n", optarg);
+				emu_free(emu);
+				return EXIT_FAILURE;
+			}
+
+			break;
+		case 't':
+			if (!parse_tap(emu, optarg, &has_taps)) {
+				fprintf(stderr, "Invalid TAP: %s.\n", optarg);
+				emu_free(emu);
+				return EXIT_FAILURE;
+			}
+
+			break;
+		case 'd':
+			if (!parse_dp(emu, optarg, &has_taps)) {
+				fprintf(stderr, "Invalid JTAG-DP: %s.\n",
+					optarg);
+				emu_free(emu);
+				return EXIT_FAILURE;
+			}
+
+			break;
+		case 'r':
+			if (!parse_dtm(emu, optarg, &has_taps)) {
+				fprintf(stderr, "Invalid RISC-V DTM: %s.\n",
+					optarg);
+				emu_free(emu);
+				return EXIT_FAILURE;
+			}
+
+			break;
+		case 'l':
+			latency = strtoul(optarg, &end, 10);
+
+			if (*end != '\0' || latency > UINT16_MAX) {
+				fprintf(stderr, "Invalid latency: %s.\n",
+					optarg);
+				emu_free(emu);
+				return EXIT_FAILURE;
+			}
+
+			emu->swd.latency = latency;
+			emu->riscv.latency = latency;
+			break;
+		case 'b':
+			latency = strtoul(optarg, &end, 10);
+
+			if (*end != '\0' || latency > UINT16_MAX) {
+				fprintf(stderr, "Invalid bus latency: %s.\n",
+					optarg);
+				emu_free(emu);
+				return EXIT_FAILURE;
+			}
+
+			emu->riscv.sb_latency = latency;
+			break;
+		case 'u':
+			emu->usb = true;
+			break;
+		case 'v':
+			emu->verbose = true;
+			break;
+		case 'h':
+			usage(argv[0]);
+			emu_free(emu);
+			return EXIT_SUCCESS;
+		default:
+			usage(argv[0]);
+			emu_free(emu);
+			return EXIT_FAILURE;
+		}
+	}
+
+	sock = emu_tcp_listen(address, port);
+
+	if (sock < 0) {
+		emu_free(emu);
+		return EXIT_FAILURE;
+	}
+
+	if (emu->verbose)
+		fprintf(stderr, "Listening on port %lu.\n", port);
+
+	ret = emu_tcp_run(emu, sock);
+
+	close(sock);
+	emu_free(emu);
+
+	return ret < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
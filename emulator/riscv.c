@@ -0,0 +1,586 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "emulator.h"
+
+/**
+ * @file
+ *
+ * Simulated RISC-V Debug Transport Module (DTM) and Debug Module (DM).
+ *
+ * The DTM implements the dtmcs and dmi registers of the RISC-V debug
+ * specification 0.13. The DM provides the Access Register abstract command
+ * with a program buffer interpreter for multiple halted harts, and System Bus
+ * Access (SBA). Both access the memory of the SWD target.
+ */
+
+#define DTMCS_VERSION		0x01
+#define DTMCS_DMIRESET		(1 << 16)
+#define DTMCS_DMIHARDRESET	(1 << 17)
+
+#define DMI_OP_NOP		0x00
+#define DMI_OP_READ		0x01
+#define DMI_OP_WRITE		0x02
+
+#define DMI_STATUS_SUCCESS	0x00
+#define DMI_STATUS_FAILED	0x02
+#define DMI_STATUS_BUSY		0x03
+
+#define DM_DATA0		0x04
+#define DM_DATA11		0x0f
+#define DM_DMCONTROL		0x10
+#define DM_DMSTATUS		0x11
+#define DM_HARTINFO		0x12
+#define DM_ABSTRACTCS		0x16
+#define DM_COMMAND		0x17
+#define DM_ABSTRACTAUTO		0x18
+#define DM_PROGBUF0		0x20
+#define DM_PROGBUF15		0x2f
+#define DM_SBCS			0x38
+#define DM_SBADDRESS0		0x39
+#define DM_SBDATA0		0x3c
+
+/** Number of DM registers. Accesses beyond them fail. */
+#define DM_NUM_REGISTERS	0x40
+
+#define DMCONTROL_DMACTIVE	(1 << 0)
+
+#define DMCONTROL_HARTSELLO_SHIFT	16
+#define DMCONTROL_HARTSELHI_SHIFT	6
+#define DMCONTROL_HARTSEL_MASK		0x3ff
+
+/* Version 0.13, authenticated and the selected hart is halted. */
+#define DMSTATUS_VALUE		0x00000382
+/* Version 0.13, authenticated and the selected hart does not exist. */
+#define DMSTATUS_NONEXISTENT	0x0000c082
+
+#define ABSTRACTCS_DATACOUNT	EMU_RISCV_DATA_COUNT
+#define ABSTRACTCS_PROGBUFSIZE	(EMU_RISCV_PROGBUF_SIZE << 24)
+#define ABSTRACTCS_CMDERR_SHIFT	8
+#define ABSTRACTCS_CMDERR_MASK	(0x07 << ABSTRACTCS_CMDERR_SHIFT)
+#define ABSTRACTCS_BUSY		(1 << 12)
+
+#define CMDERR_NONE		0
+#define CMDERR_BUSY		1
+#define CMDERR_NOT_SUPPORTED	2
+#define CMDERR_EXCEPTION	3
+#define CMDERR_HALT_RESUME	4
+
+#define COMMAND_CMDTYPE_SHIFT	24
+#define COMMAND_AARSIZE_SHIFT	20
+#define COMMAND_AARSIZE_MASK	0x07
+#define COMMAND_AARSIZE_32	2
+#define COMMAND_POSTEXEC	(1 << 18)
+#define COMMAND_TRANSFER	(1 << 17)
+#define COMMAND_WRITE		(1 << 16)
+#define COMMAND_REGNO_MASK	0xffff
+
+#define REGNO_GPR0		0x1000
+
+#define OPCODE_LOAD		0x03
+#define OPCODE_OP_IMM		0x13
+#define OPCODE_STORE		0x23
+#define FUNCT3_W		0x02
+#define FUNCT3_ADDI		0x00
+#define INSN_EBREAK		0x00100073
+
+#define SBCS_SBVERSION		(1 << 29)
+#define SBCS_SBBUSYERROR	(1 << 22)
+#define SBCS_SBBUSY		(1 << 21)
+#define SBCS_SBREADONADDR	(1 << 20)
+#define SBCS_SBACCESS_SHIFT	17
+#define SBCS_SBACCESS_MASK	(0x07 << SBCS_SBACCESS_SHIFT)
+#define SBCS_SBAUTOINCREMENT	(1 << 16)
+#define SBCS_SBREADONDATA	(1 << 15)
+#define SBCS_SBERROR_SHIFT	12
+#define SBCS_SBERROR_MASK	(0x07 << SBCS_SBERROR_SHIFT)
+/* 32-bit addresses, and 8-, 16- and 32-bit accesses. */
+#define SBCS_CAPS		((32 << 5) | 0x07)
+
+#define SBERROR_BAD_ADDRESS	2
+#define SBERROR_ALIGNMENT	3
+#define SBERROR_SIZE		4
+
+/** Writable bits of the sbcs register. */
+#define SBCS_RW_MASK		(SBCS_SBREADONADDR | SBCS_SBACCESS_MASK | \
+	SBCS_SBAUTOINCREMENT | SBCS_SBREADONDATA)
+
+void emu_riscv_init(struct emu_riscv *riscv, uint8_t *ram)
+{
+	riscv->latency = 0;
+	riscv->busy = 0;
+	riscv->idle = 0;
+	riscv->dmistat = DMI_STATUS_SUCCESS;
+	riscv->dmi_data = 0;
+	riscv->dmi_address = 0;
+	riscv->dmcontrol = 0;
+	riscv->abstractauto = 0;
+	riscv->sb_latency = 0;
+	riscv->sb_busy = 0;
+	riscv->sbcs = 0;
+	riscv->sbaddress = 0;
+	riscv->sbdata = 0;
+	riscv->ram = ram;
+	riscv->cmd_busy = 0;
+	riscv->command = 0;
+	riscv->cmderr = CMDERR_NONE;
+
+	memset(riscv->data, 0, sizeof(riscv->data));
+	memset(riscv->progbuf, 0, sizeof(riscv->progbuf));
+	memset(riscv->gprs, 0, sizeof(riscv->gprs));
+	memset(riscv->csrs, 0, sizeof(riscv->csrs));
+}
+
+/*
+ * Perform a system bus access with the address of the sbaddress0 register. A
+ * failed access sets the sberror field.
+ */
+static void sb_access(struct emu_riscv *riscv, bool read)
+{
+	uint32_t offset;
+	uint32_t size;
+	uint32_t i;
+
+	size = 1 << ((riscv->sbcs & SBCS_SBACCESS_MASK) >>
+		SBCS_SBACCESS_SHIFT);
+	offset = riscv->sbaddress - EMU_RAM_ADDRESS;
+
+	if (size > 4) {
+		riscv->sbcs |= SBERROR_SIZE << SBCS_SBERROR_SHIFT;
+		return;
+	}
+
+	if (riscv->sbaddress & (size - 1)) {
+		riscv->sbcs |= SBERROR_ALIGNMENT << SBCS_SBERROR_SHIFT;
+		return;
+	}
+
+	if (riscv->sbaddress < EMU_RAM_ADDRESS ||
+			offset > EMU_RAM_SIZE - size) {
+		riscv->sbcs |= SBERROR_BAD_ADDRESS << SBCS_SBERROR_SHIFT;
+		return;
+	}
+
+	if (read) {
+		riscv->sbdata = 0;
+
+		for (i = 0; i < size; i++)
+			riscv->sbdata |= (uint32_t)riscv->ram[offset + i] <<
+				(i * 8);
+	} else {
+		for (i = 0; i < size; i++)
+			riscv->ram[offset + i] = riscv->sbdata >> (i * 8);
+	}
+
+	if (riscv->sbcs & SBCS_SBAUTOINCREMENT)
+		riscv->sbaddress += size;
+
+	riscv->sb_busy = riscv->sb_latency;
+}
+
+/*
+ * Check whether a system bus access can be started. An attempt during a
+ * pending access sets the sbbusyerror bit. No access is started while an
+ * error is set.
+ */
+static bool sb_ready(struct emu_riscv *riscv)
+{
+	if (riscv->sb_busy) {
+		riscv->sbcs |= SBCS_SBBUSYERROR;
+		return false;
+	}
+
+	return !(riscv->sbcs & (SBCS_SBBUSYERROR | SBCS_SBERROR_MASK));
+}
+
+static uint32_t sbdata_read(struct emu_riscv *riscv)
+{
+	uint32_t value;
+
+	value = riscv->sbdata;
+
+	if (sb_ready(riscv) && (riscv->sbcs & SBCS_SBREADONDATA))
+		sb_access(riscv, true);
+
+	return value;
+}
+
+static void sbcs_write(struct emu_riscv *riscv, uint32_t value)
+{
+	/* The error bits are cleared by writing one. */
+	riscv->sbcs &= ~(value & (SBCS_SBBUSYERROR | SBCS_SBERROR_MASK));
+	riscv->sbcs &= ~SBCS_RW_MASK;
+	riscv->sbcs |= value & SBCS_RW_MASK;
+}
+
+static uint32_t selected_hart(const struct emu_riscv *riscv)
+{
+	return ((riscv->dmcontrol >> DMCONTROL_HARTSELLO_SHIFT) &
+		DMCONTROL_HARTSEL_MASK) |
+		(((riscv->dmcontrol >> DMCONTROL_HARTSELHI_SHIFT) &
+		DMCONTROL_HARTSEL_MASK) << 10);
+}
+
+static bool access_word(struct emu_riscv *riscv, uint32_t address,
+		uint32_t *value, bool write)
+{
+	uint32_t offset;
+
+	offset = address - EMU_RAM_ADDRESS;
+
+	if (address < EMU_RAM_ADDRESS || offset > EMU_RAM_SIZE - 4 ||
+			(address & 3))
+		return false;
+
+	if (write) {
+		riscv->ram[offset] = *value;
+		riscv->ram[offset + 1] = *value >> 8;
+		riscv->ram[offset + 2] = *value >> 16;
+		riscv->ram[offset + 3] = *value >> 24;
+	} else {
+		*value = riscv->ram[offset] | (riscv->ram[offset + 1] << 8) |
+			(riscv->ram[offset + 2] << 16) |
+			((uint32_t)riscv->ram[offset + 3] << 24);
+	}
+
+	return true;
+}
+
+/*
+ * Execute the program buffer on a hart. Only the lw, sw, addi and ebreak
+ * instructions are supported, all others cause an exception.
+ */
+static bool execute_progbuf(struct emu_riscv *riscv, uint32_t hart)
+{
+	uint32_t *x;
+	uint32_t insn;
+	uint32_t rd;
+	uint32_t rs1;
+	uint32_t rs2;
+	uint32_t funct3;
+	int32_t imm;
+	uint32_t value;
+	size_t i;
+
+	x = riscv->gprs[hart];
+
+	for (i = 0; i < EMU_RISCV_PROGBUF_SIZE; i++) {
+		insn = riscv->progbuf[i];
+
+		if (insn == INSN_EBREAK)
+			return true;
+
+		rd = (insn >> 7) & 0x1f;
+		funct3 = (insn >> 12) & 0x07;
+		rs1 = (insn >> 15) & 0x1f;
+		rs2 = (insn >> 20) & 0x1f;
+
+		switch (insn & 0x7f) {
+		case OPCODE_LOAD:
+			imm = (int32_t)insn >> 20;
+
+			if (funct3 != FUNCT3_W ||
+					!access_word(riscv, x[rs1] + imm,
+					&value, false))
+				return false;
+
+			if (rd)
+				x[rd] = value;
+
+			break;
+		case OPCODE_STORE:
+			imm = ((int32_t)(insn & 0xfe000000) >> 20) |
+				((insn >> 7) & 0x1f);
+
+			if (funct3 != FUNCT3_W ||
+					!access_word(riscv, x[rs1] + imm,
+					&x[rs2], true))
+				return false;
+
+			break;
+		case OPCODE_OP_IMM:
+			if (funct3 != FUNCT3_ADDI)
+				return false;
+
+			if (rd)
+				x[rd] = x[rs1] + ((int32_t)insn >> 20);
+
+			break;
+		default:
+			return false;
+		}
+	}
+
+	/* The program buffer is followed by an implicit ebreak. */
+	return true;
+}
+
+/* Execute the Access Register command of the command register. */
+static void execute_command(struct emu_riscv *riscv)
+{
+	uint32_t hart;
+	uint32_t regno;
+	uint32_t *reg;
+
+	hart = selected_hart(riscv);
+	regno = riscv->command & COMMAND_REGNO_MASK;
+
+	if (riscv->command >> COMMAND_CMDTYPE_SHIFT) {
+		riscv->cmderr = CMDERR_NOT_SUPPORTED;
+		return;
+	}
+
+	if (hart >= EMU_RISCV_NUM_HARTS) {
+		riscv->cmderr = CMDERR_HALT_RESUME;
+		return;
+	}
+
+	riscv->cmd_busy = riscv->sb_latency;
+
+	if (riscv->command & COMMAND_TRANSFER) {
+		if (((riscv->command >> COMMAND_AARSIZE_SHIFT) &
+				COMMAND_AARSIZE_MASK) != COMMAND_AARSIZE_32) {
+			riscv->cmderr = CMDERR_NOT_SUPPORTED;
+			return;
+		}
+
+		if (regno < EMU_RISCV_NUM_CSRS) {
+			reg = &riscv->csrs[hart][regno];
+		} else if (regno >= REGNO_GPR0 && regno < REGNO_GPR0 + 32) {
+			reg = &riscv->gprs[hart][regno - REGNO_GPR0];
+		} else {
+			riscv->cmderr = CMDERR_EXCEPTION;
+			return;
+		}
+
+		if (!(riscv->command & COMMAND_WRITE))
+			riscv->data[0] = *reg;
+		else if (reg != &riscv->gprs[hart][0])
+			*reg = riscv->data[0];
+	}
+
+	if ((riscv->command & COMMAND_POSTEXEC) &&
+			!execute_progbuf(riscv, hart))
+		riscv->cmderr = CMDERR_EXCEPTION;
+}
+
+/*
+ * Check whether an abstract command register can be accessed. An access
+ * during an abstract command sets the busy command error.
+ */
+static bool cmd_ready(struct emu_riscv *riscv)
+{
+	if (riscv->cmd_busy) {
+		if (riscv->cmderr == CMDERR_NONE)
+			riscv->cmderr = CMDERR_BUSY;
+
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Execute the command again after an access of an abstract data or program
+ * buffer register if enabled in the abstractauto register.
+ */
+static void auto_execute(struct emu_riscv *riscv, uint32_t bit)
+{
+	if ((riscv->abstractauto & (1 << bit)) && riscv->cmderr == CMDERR_NONE)
+		execute_command(riscv);
+}
+
+static uint32_t dm_read(struct emu_riscv *riscv, uint32_t address)
+{
+	uint32_t value;
+
+	if (address >= DM_DATA0 && address <= DM_DATA11) {
+		if (!cmd_ready(riscv))
+			return 0;
+
+		value = riscv->data[address - DM_DATA0];
+		auto_execute(riscv, address - DM_DATA0);
+
+		return value;
+	}
+
+	if (address >= DM_PROGBUF0 && address <= DM_PROGBUF15) {
+		if (!cmd_ready(riscv))
+			return 0;
+
+		value = riscv->progbuf[address - DM_PROGBUF0];
+		auto_execute(riscv, 16 + address - DM_PROGBUF0);
+
+		return value;
+	}
+
+	switch (address) {
+	case DM_DMCONTROL:
+		return riscv->dmcontrol;
+	case DM_DMSTATUS:
+		if (selected_hart(riscv) >= EMU_RISCV_NUM_HARTS)
+			return DMSTATUS_NONEXISTENT;
+
+		return DMSTATUS_VALUE;
+	case DM_ABSTRACTCS:
+		return ABSTRACTCS_DATACOUNT | ABSTRACTCS_PROGBUFSIZE |
+			(riscv->cmderr << ABSTRACTCS_CMDERR_SHIFT) |
+			(riscv->cmd_busy ? ABSTRACTCS_BUSY : 0);
+	case DM_ABSTRACTAUTO:
+		return riscv->abstractauto;
+	case DM_SBCS:
+		return SBCS_SBVERSION | SBCS_CAPS | riscv->sbcs |
+			(riscv->sb_busy ? SBCS_SBBUSY : 0);
+	case DM_SBADDRESS0:
+		return riscv->sbaddress;
+	case DM_SBDATA0:
+		return sbdata_read(riscv);
+	default:
+		return 0;
+	}
+}
+
+static void dm_write(struct emu_riscv *riscv, uint32_t address,
+		uint32_t value)
+{
+	if (address >= DM_DATA0 && address <= DM_DATA11) {
+		if (!cmd_ready(riscv))
+			return;
+
+		riscv->data[address - DM_DATA0] = value;
+		auto_execute(riscv, address - DM_DATA0);
+		return;
+	}
+
+	if (address >= DM_PROGBUF0 && address <= DM_PROGBUF15) {
+		if (!cmd_ready(riscv))
+			return;
+
+		riscv->progbuf[address - DM_PROGBUF0] = value;
+		auto_execute(riscv, 16 + address - DM_PROGBUF0);
+		return;
+	}
+
+	switch (address) {
+	case DM_DMCONTROL:
+		riscv->dmcontrol = value;
+		break;
+	case DM_ABSTRACTCS:
+		/* The command error is cleared by writing one. */
+		riscv->cmderr &= ~((value & ABSTRACTCS_CMDERR_MASK) >>
+			ABSTRACTCS_CMDERR_SHIFT);
+		break;
+	case DM_COMMAND:
+		if (!cmd_ready(riscv) || riscv->cmderr != CMDERR_NONE)
+			break;
+
+		riscv->command = value;
+		execute_command(riscv);
+		break;
+	case DM_ABSTRACTAUTO:
+		if (!cmd_ready(riscv))
+			break;
+
+		riscv->abstractauto = value;
+		break;
+	case DM_SBCS:
+		sbcs_write(riscv, value);
+		break;
+	case DM_SBADDRESS0:
+		if (!sb_ready(riscv))
+			break;
+
+		riscv->sbaddress = value;
+
+		if (riscv->sbcs & SBCS_SBREADONADDR)
+			sb_access(riscv, true);
+
+		break;
+	case DM_SBDATA0:
+		if (!sb_ready(riscv))
+			break;
+
+		riscv->sbdata = value;
+		sb_access(riscv, false);
+		break;
+	default:
+		break;
+	}
+}
+
+uint64_t emu_riscv_dtmcs_capture(const struct emu_riscv *riscv)
+{
+	return DTMCS_VERSION | (EMU_RISCV_ABITS << 4) |
+		(riscv->dmistat << 10) | (riscv->idle << 12);
+}
+
+void emu_riscv_dtmcs_update(struct emu_riscv *riscv, uint64_t shift)
+{
+	if (shift & DTMCS_DMIHARDRESET)
+		riscv->busy = 0;
+
+	if (shift & (DTMCS_DMIRESET | DTMCS_DMIHARDRESET))
+		riscv->dmistat = DMI_STATUS_SUCCESS;
+}
+
+/*
+ * Capture the dmi register. An access while the previous one is in progress
+ * sets the sticky busy status.
+ */
+uint64_t emu_riscv_dmi_capture(struct emu_riscv *riscv)
+{
+	if (riscv->busy && riscv->dmistat == DMI_STATUS_SUCCESS)
+		riscv->dmistat = DMI_STATUS_BUSY;
+
+	return riscv->dmistat | ((uint64_t)riscv->dmi_data << 2) |
+		((uint64_t)riscv->dmi_address << 34);
+}
+
+/* Update the dmi register. The access is ignored with a sticky status. */
+void emu_riscv_dmi_update(struct emu_riscv *riscv, uint64_t shift)
+{
+	uint32_t address;
+	uint32_t op;
+
+	if (riscv->dmistat != DMI_STATUS_SUCCESS)
+		return;
+
+	op = shift & 0x03;
+	address = (shift >> 34) & ((1 << EMU_RISCV_ABITS) - 1);
+
+	if (op != DMI_OP_READ && op != DMI_OP_WRITE)
+		return;
+
+	riscv->dmi_address = address;
+	riscv->busy = riscv->latency;
+
+	if (address >= DM_NUM_REGISTERS) {
+		riscv->dmistat = DMI_STATUS_FAILED;
+		return;
+	}
+
+	if (op == DMI_OP_READ)
+		riscv->dmi_data = dm_read(riscv, address);
+	else
+		dm_write(riscv, address, (shift >> 2) & 0xffffffff);
+}
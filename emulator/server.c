@@ -0,0 +1,411 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "emulator.h"
+
+/**
+ * @file
+ *
+ * TCP/IP server and in-process loopback connection of the emulator.
+ */
+
+#define CMD_CLIENT		0x07
+
+/** Size of the server's hello message in bytes. */
+#define SERVER_HELLO_SIZE	4
+
+/** Initial size of the write buffer of a loopback connection. */
+#define LOOPBACK_BUFFER_SIZE	2048
+
+/** In-process connection to an emulator. */
+struct loopback {
+	/** Emulator. */
+	struct emu *emu;
+	/** Host side of the connection. */
+	int fd;
+	/** Emulator side of the connection. */
+	int emu_fd;
+	/** Thread which serves the connection. */
+	pthread_t thread;
+	/** Indicates whether the connection is open. */
+	bool is_open;
+	/** Buffer of the current write operation including the prefix. */
+	uint8_t *buffer;
+	/** Size of the buffer in bytes. */
+	size_t size;
+	/** Number of bytes in the buffer. */
+	size_t length;
+	/** Number of bytes of the current write operation not written yet. */
+	size_t write_length;
+};
+
+/**
+ * Create a listening TCP/IP socket.
+ *
+ * @param[in] address IPv4 address to listen on, or NULL for all addresses.
+ * @param[in] port Port number.
+ *
+ * @return The socket on success, or -1 on failure.
+ */
+int emu_tcp_listen(const char *address, uint16_t port)
+{
+	int sock;
+	int opt;
+	struct sockaddr_in addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+	if (address && inet_pton(AF_INET, address, &addr.sin_addr) != 1) {
+		fprintf(stderr, "Invalid IPv4 address: %s.\n", address);
+		return -1;
+	}
+
+	sock = socket(AF_INET, SOCK_STREAM, 0);
+
+	if (sock < 0) {
+		perror("socket");
+		return -1;
+	}
+
+	opt = 1;
+	setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		perror("bind");
+		close(sock);
+		return -1;
+	}
+
+	if (listen(sock, 4) < 0) {
+		perror("listen");
+		close(sock);
+		return -1;
+	}
+
+	return sock;
+}
+
+/**
+ * Serve TCP/IP connections.
+ *
+ * Connections are served one after the other.
+ *
+ * @param[in,out] emu Emulator.
+ * @param[in] sock Listening socket.
+ *
+ * @return -1 on failure, the function does not return otherwise.
+ */
+int emu_tcp_run(struct emu *emu, int sock)
+{
+	int fd;
+	int opt;
+
+	while (true) {
+		fd = accept(sock, NULL, NULL);
+
+		if (fd < 0) {
+			if (errno == EINTR)
+				continue;
+
+			perror("accept");
+			return -1;
+		}
+
+		/* Responses are small and must not be delayed. */
+		opt = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+		if (emu->verbose)
+			fprintf(stderr, "Connection accepted.\n");
+
+		if (emu_serve(emu, fd) < 0)
+			fprintf(stderr, "Connection closed on error.\n");
+		else if (emu->verbose)
+			fprintf(stderr, "Connection closed.\n");
+
+		close(fd);
+	}
+}
+
+static void *loopback_thread(void *arg)
+{
+	struct loopback *lb;
+
+	lb = arg;
+	emu_serve(lb->emu, lb->emu_fd);
+
+	return NULL;
+}
+
+static int loopback_recv(struct loopback *lb, uint8_t *buffer, size_t length)
+{
+	ssize_t ret;
+
+	while (length > 0) {
+		ret = recv(lb->fd, buffer, length, 0);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+
+		if (ret <= 0)
+			return JAYLINK_ERR_IO;
+
+		buffer += ret;
+		length -= ret;
+	}
+
+	return JAYLINK_OK;
+}
+
+static int loopback_send(struct loopback *lb)
+{
+	ssize_t ret;
+	size_t pos;
+
+	pos = 0;
+
+	while (pos < lb->length) {
+		ret = send(lb->fd, lb->buffer + pos, lb->length - pos,
+			MSG_NOSIGNAL);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+
+		if (ret <= 0)
+			return JAYLINK_ERR_IO;
+
+		pos += ret;
+	}
+
+	lb->length = 0;
+
+	return JAYLINK_OK;
+}
+
+static int loopback_close(void *user_data)
+{
+	struct loopback *lb;
+
+	lb = user_data;
+
+	if (!lb->is_open)
+		return JAYLINK_OK;
+
+	/* The emulator thread terminates when the connection is closed. */
+	shutdown(lb->fd, SHUT_RDWR);
+	pthread_join(lb->thread, NULL);
+
+	close(lb->fd);
+	close(lb->emu_fd);
+	lb->is_open = false;
+
+	return JAYLINK_OK;
+}
+
+static int loopback_open(void *user_data)
+{
+	int ret;
+	struct loopback *lb;
+	int fds[2];
+	uint8_t buf[SERVER_HELLO_SIZE + 255];
+
+	lb = user_data;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+		return JAYLINK_ERR_IO;
+
+	lb->fd = fds[0];
+	lb->emu_fd = fds[1];
+	lb->length = 0;
+	lb->write_length = 0;
+
+	if (pthread_create(&lb->thread, NULL, loopback_thread, lb)) {
+		close(fds[0]);
+		close(fds[1]);
+		return JAYLINK_ERR;
+	}
+
+	lb->is_open = true;
+	ret = loopback_recv(lb, buf, SERVER_HELLO_SIZE);
+
+	if (ret == JAYLINK_OK)
+		ret = loopback_recv(lb, buf + SERVER_HELLO_SIZE, buf[3]);
+
+	if (ret != JAYLINK_OK)
+		loopback_close(lb);
+
+	return ret;
+}
+
+static int loopback_start_write(void *user_data, size_t length,
+		bool has_command)
+{
+	struct loopback *lb;
+	uint8_t *buffer;
+
+	lb = user_data;
+
+	if (lb->write_length > 0)
+		return JAYLINK_ERR;
+
+	/* Allocate space for the data and the prefix. */
+	if (length + 1 > lb->size) {
+		buffer = realloc(lb->buffer, length + 1);
+
+		if (!buffer)
+			return JAYLINK_ERR_MALLOC;
+
+		lb->buffer = buffer;
+		lb->size = length + 1;
+	}
+
+	/* Commands are framed like with the TCP/IP protocol. */
+	if (has_command)
+		lb->buffer[lb->length++] = CMD_CLIENT;
+
+	lb->write_length = length;
+
+	return JAYLINK_OK;
+}
+
+static int loopback_start_read(void *user_data, size_t length)
+{
+	(void)user_data;
+	(void)length;
+
+	return JAYLINK_OK;
+}
+
+static int loopback_start_write_read(void *user_data, size_t write_length,
+		size_t read_length, bool has_command)
+{
+	(void)read_length;
+
+	return loopback_start_write(user_data, write_length, has_command);
+}
+
+static int loopback_write(void *user_data, const uint8_t *buffer,
+		size_t length)
+{
+	struct loopback *lb;
+
+	lb = user_data;
+
+	if (length > lb->write_length)
+		return JAYLINK_ERR;
+
+	memcpy(lb->buffer + lb->length, buffer, length);
+	lb->length += length;
+	lb->write_length -= length;
+
+	if (lb->write_length > 0)
+		return JAYLINK_OK;
+
+	return loopback_send(lb);
+}
+
+static int loopback_read(void *user_data, uint8_t *buffer, size_t length)
+{
+	return loopback_recv(user_data, buffer, length);
+}
+
+static void loopback_free(void *user_data)
+{
+	struct loopback *lb;
+
+	lb = user_data;
+
+	loopback_close(lb);
+	free(lb->buffer);
+	free(lb);
+}
+
+static const struct jaylink_transport_ops loopback_ops = {
+	.open = loopback_open,
+	.close = loopback_close,
+	.start_write = loopback_start_write,
+	.start_read = loopback_start_read,
+	.start_write_read = loopback_start_write_read,
+	.write = loopback_write,
+	.read = loopback_read,
+	.free = loopback_free
+};
+
+/**
+ * Create a device instance for an in-process connection to an emulator.
+ *
+ * Each time the device is opened, a new connection is served by a separate
+ * thread. The emulator must not be freed before the device instance.
+ *
+ * @param[in,out] emu Emulator.
+ * @param[in,out] ctx libjaylink context.
+ * @param[out] dev Newly allocated device instance on success.
+ *
+ * @return A libjaylink error code.
+ */
+int emu_loopback_new(struct emu *emu, struct jaylink_context *ctx,
+		struct jaylink_device **dev)
+{
+	int ret;
+	struct loopback *lb;
+
+	lb = malloc(sizeof(struct loopback));
+
+	if (!lb)
+		return JAYLINK_ERR_MALLOC;
+
+	lb->buffer = malloc(LOOPBACK_BUFFER_SIZE);
+
+	if (!lb->buffer) {
+		free(lb);
+		return JAYLINK_ERR_MALLOC;
+	}
+
+	lb->emu = emu;
+	lb->is_open = false;
+	lb->size = LOOPBACK_BUFFER_SIZE;
+	lb->length = 0;
+	lb->write_length = 0;
+
+	ret = jaylink_transport_register(ctx, &loopback_ops, lb, dev);
+
+	if (ret != JAYLINK_OK) {
+		free(lb->buffer);
+		free(lb);
+	}
+
+	return ret;
+}
@@ -0,0 +1,688 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "emulator.h"
+
+/**
+ * @file
+ *
+ * Simulated SWD target.
+ *
+ * The target consists of an ADIv5 SW-DP and a MEM-AP with a single RAM region.
+ * The SWD line protocol is decoded bit by bit from the data of the SWD I/O
+ * operations. The DP and the MEM-AP are also accessible through the DPACC and
+ * APACC scan chains of a simulated JTAG-DP.
+ */
+
+/** SWD line protocol states. */
+enum swd_state {
+	/** Waiting for a packet request. */
+	SWD_STATE_IDLE = 0,
+	/** Turnaround before the acknowledge. */
+	SWD_STATE_ACK_TRN,
+	/** Acknowledge driven by the target. */
+	SWD_STATE_ACK,
+	/** Data phase of a read transaction. */
+	SWD_STATE_RDATA,
+	/** Turnaround before the data phase of a write transaction. */
+	SWD_STATE_WDATA_TRN,
+	/** Data phase of a write transaction. */
+	SWD_STATE_WDATA
+};
+
+/** Number of high bits that cause a line reset. */
+#define LINE_RESET_BITS		50
+
+#define ACK_OK			0x01
+#define ACK_WAIT		0x02
+#define ACK_FAULT		0x04
+
+#define JTAG_ACK_WAIT		0x01
+#define JTAG_ACK_OK_FAULT	0x02
+
+#define REQ_START		(1 << 0)
+#define REQ_APNDP		(1 << 1)
+#define REQ_RNW			(1 << 2)
+#define REQ_STOP		(1 << 6)
+#define REQ_PARK		(1 << 7)
+
+#define DP_IDCODE_VALUE		0x2ba01477
+
+#define DP_ABORT		0x0
+#define DP_IDCODE		0x0
+#define DP_CTRL_STAT		0x4
+#define DP_SELECT		0x8
+#define DP_RESEND		0x8
+#define DP_RDBUFF		0xc
+
+#define ABORT_STKCMPCLR		(1 << 1)
+#define ABORT_STKERRCLR		(1 << 2)
+#define ABORT_WDERRCLR		(1 << 3)
+#define ABORT_ORUNERRCLR	(1 << 4)
+
+#define CTRL_STAT_ORUNDETECT	(1 << 0)
+#define CTRL_STAT_STICKYORUN	(1 << 1)
+#define CTRL_STAT_STICKYCMP	(1 << 4)
+#define CTRL_STAT_STICKYERR	(1 << 5)
+#define CTRL_STAT_WDATAERR	(1 << 7)
+#define CTRL_STAT_CDBGPWRUPREQ	(1 << 28)
+#define CTRL_STAT_CDBGPWRUPACK	(1 << 29)
+#define CTRL_STAT_CSYSPWRUPREQ	(1 << 30)
+#define CTRL_STAT_CSYSPWRUPACK	(1U << 31)
+
+#define CTRL_STAT_STICKY	(CTRL_STAT_STICKYORUN | CTRL_STAT_STICKYCMP | \
+	CTRL_STAT_STICKYERR | CTRL_STAT_WDATAERR)
+#define CTRL_STAT_ERRORS	(CTRL_STAT_STICKYORUN | CTRL_STAT_STICKYERR | \
+	CTRL_STAT_WDATAERR)
+
+#define AP_CSW			0x00
+#define AP_TAR			0x04
+#define AP_DRW			0x0c
+#define AP_BD0			0x10
+#define AP_BD3			0x1c
+#define AP_CFG			0xf4
+#define AP_BASE			0xf8
+#define AP_IDR			0xfc
+
+#define AP_BASE_VALUE		0xe00ff003
+#define AP_IDR_VALUE		0x24770011
+
+#define CSW_SIZE_MASK		0x07
+#define CSW_SIZE_8		0x00
+#define CSW_SIZE_16		0x01
+#define CSW_ADDRINC_MASK	0x30
+#define CSW_ADDRINC_OFF		0x00
+#define CSW_DEVICEEN		(1 << 6)
+
+/* Size of the address range within which TAR is incremented automatically. */
+#define TAR_WRAP_SIZE		0x400
+
+static bool parity(uint64_t value)
+{
+	bool tmp;
+
+	tmp = false;
+
+	while (value) {
+		tmp = !tmp;
+		value &= value - 1;
+	}
+
+	return tmp;
+}
+
+void emu_swd_init(struct emu_swd *swd)
+{
+	swd->state = SWD_STATE_IDLE;
+	swd->num_bits = 0;
+	swd->shift = 0;
+	swd->num_ones = 0;
+	swd->armed = true;
+	swd->latency = 0;
+	swd->busy = 0;
+	swd->jtag_wait = false;
+	swd->jtag_result = 0;
+	swd->ctrl_stat = 0;
+	swd->select = 0;
+	swd->rdbuff = 0;
+	swd->csw = 0;
+	swd->tar = 0;
+
+	memset(swd->ram, 0, sizeof(swd->ram));
+}
+
+static bool mem_read(struct emu_swd *swd, uint32_t address, uint32_t *value)
+{
+	uint32_t offset;
+
+	if (address < EMU_RAM_ADDRESS)
+		return false;
+
+	offset = (address - EMU_RAM_ADDRESS) & ~3U;
+
+	if (offset >= EMU_RAM_SIZE)
+		return false;
+
+	*value = emu_get_u32(swd->ram, offset);
+
+	return true;
+}
+
+static bool mem_write(struct emu_swd *swd, uint32_t address, uint32_t value,
+		uint32_t size)
+{
+	uint32_t offset;
+
+	if (address < EMU_RAM_ADDRESS)
+		return false;
+
+	offset = address - EMU_RAM_ADDRESS;
+
+	if (offset >= EMU_RAM_SIZE)
+		return false;
+
+	/* Take the data from the byte lanes of the address. */
+	value >>= (address & 3) * 8;
+
+	switch (size) {
+	case CSW_SIZE_8:
+		swd->ram[offset] = value;
+		break;
+	case CSW_SIZE_16:
+		emu_set_u16(swd->ram, value, offset & ~1U);
+		break;
+	default:
+		emu_set_u32(swd->ram, value, offset & ~3U);
+		break;
+	}
+
+	return true;
+}
+
+static uint32_t access_size(const struct emu_swd *swd)
+{
+	uint32_t size;
+
+	size = swd->csw & CSW_SIZE_MASK;
+
+	if (size > 2)
+		return 4;
+
+	return 1 << size;
+}
+
+static void increment_tar(struct emu_swd *swd)
+{
+	uint32_t tmp;
+
+	if ((swd->csw & CSW_ADDRINC_MASK) == CSW_ADDRINC_OFF)
+		return;
+
+	tmp = (swd->tar + access_size(swd)) & (TAR_WRAP_SIZE - 1);
+	swd->tar = (swd->tar & ~(TAR_WRAP_SIZE - 1)) | tmp;
+}
+
+static uint32_t ap_read(struct emu_swd *swd, uint32_t reg)
+{
+	uint32_t value;
+
+	/* Only the MEM-AP with APSEL 0 is implemented. */
+	if (swd->select >> 24)
+		return 0;
+
+	switch (reg) {
+	case AP_CSW:
+		return swd->csw | CSW_DEVICEEN;
+	case AP_TAR:
+		return swd->tar;
+	case AP_DRW:
+		if (!mem_read(swd, swd->tar, &value)) {
+			swd->ctrl_stat |= CTRL_STAT_STICKYERR;
+			value = 0;
+		}
+
+		swd->busy = swd->latency;
+		increment_tar(swd);
+		return value;
+	case AP_CFG:
+		return 0;
+	case AP_BASE:
+		return AP_BASE_VALUE;
+	case AP_IDR:
+		return AP_IDR_VALUE;
+	default:
+		break;
+	}
+
+	if (reg >= AP_BD0 && reg <= AP_BD3) {
+		if (!mem_read(swd, (swd->tar & ~0xfU) | (reg & 0xc), &value)) {
+			swd->ctrl_stat |= CTRL_STAT_STICKYERR;
+			value = 0;
+		}
+
+		swd->busy = swd->latency;
+		return value;
+	}
+
+	return 0;
+}
+
+static void ap_write(struct emu_swd *swd, uint32_t reg, uint32_t value)
+{
+	bool ret;
+
+	if (swd->select >> 24)
+		return;
+
+	switch (reg) {
+	case AP_CSW:
+		swd->csw = value & ~CSW_DEVICEEN;
+		return;
+	case AP_TAR:
+		swd->tar = value;
+		return;
+	case AP_DRW:
+		ret = mem_write(swd, swd->tar, value, swd->csw & CSW_SIZE_MASK);
+
+		if (!ret)
+			swd->ctrl_stat |= CTRL_STAT_STICKYERR;
+
+		swd->busy = swd->latency;
+		increment_tar(swd);
+		return;
+	default:
+		break;
+	}
+
+	if (reg >= AP_BD0 && reg <= AP_BD3) {
+		ret = mem_write(swd, (swd->tar & ~0xfU) | (reg & 0xc), value,
+			2);
+
+		if (!ret)
+			swd->ctrl_stat |= CTRL_STAT_STICKYERR;
+
+		swd->busy = swd->latency;
+	}
+}
+
+static uint32_t dp_read(struct emu_swd *swd, uint32_t address)
+{
+	uint32_t tmp;
+
+	switch (address) {
+	case DP_IDCODE:
+		return DP_IDCODE_VALUE;
+	case DP_CTRL_STAT:
+		tmp = swd->ctrl_stat;
+
+		/* Power-up requests are acknowledged immediately. */
+		if (tmp & CTRL_STAT_CDBGPWRUPREQ)
+			tmp |= CTRL_STAT_CDBGPWRUPACK;
+
+		if (tmp & CTRL_STAT_CSYSPWRUPREQ)
+			tmp |= CTRL_STAT_CSYSPWRUPACK;
+
+		return tmp;
+	case DP_RESEND:
+	case DP_RDBUFF:
+		return swd->rdbuff;
+	default:
+		return 0;
+	}
+}
+
+static void dp_write(struct emu_swd *swd, uint32_t address, uint32_t value)
+{
+	switch (address) {
+	case DP_ABORT:
+		if (value & ABORT_STKCMPCLR)
+			swd->ctrl_stat &= ~CTRL_STAT_STICKYCMP;
+
+		if (value & ABORT_STKERRCLR)
+			swd->ctrl_stat &= ~CTRL_STAT_STICKYERR;
+
+		if (value & ABORT_WDERRCLR)
+			swd->ctrl_stat &= ~CTRL_STAT_WDATAERR;
+
+		if (value & ABORT_ORUNERRCLR)
+			swd->ctrl_stat &= ~CTRL_STAT_STICKYORUN;
+
+		break;
+	case DP_CTRL_STAT:
+		swd->ctrl_stat = (swd->ctrl_stat & CTRL_STAT_STICKY) |
+			(value & ~(CTRL_STAT_STICKY | CTRL_STAT_CDBGPWRUPACK |
+			CTRL_STAT_CSYSPWRUPACK));
+		break;
+	case DP_SELECT:
+		swd->select = value;
+		break;
+	default:
+		break;
+	}
+}
+
+static bool is_valid_request(uint8_t request)
+{
+	if (!(request & REQ_START) || (request & REQ_STOP))
+		return false;
+
+	if (!(request & REQ_PARK))
+		return false;
+
+	return parity((request >> 1) & 0x0f) == ((request >> 5) & 1);
+}
+
+/* Process a packet request and determine the acknowledge and read data. */
+static void process_request(struct emu_swd *swd)
+{
+	uint32_t address;
+	bool error_pending;
+
+	address = (swd->request >> 1) & 0x0c;
+	error_pending = (swd->ctrl_stat & CTRL_STAT_ERRORS) != 0;
+	swd->ack = ACK_OK;
+	swd->data = 0;
+
+	if (!(swd->request & REQ_APNDP)) {
+		/*
+		 * With a sticky error flag set, only reads of IDCODE, CTRL/STAT
+		 * and RESEND, and writes to ABORT are accepted.
+		 */
+		if (error_pending && (swd->request & REQ_RNW) &&
+				address == DP_RDBUFF)
+			swd->ack = ACK_FAULT;
+		else if (error_pending && !(swd->request & REQ_RNW) &&
+				address != DP_ABORT)
+			swd->ack = ACK_FAULT;
+		else if ((swd->request & REQ_RNW) && address == DP_RDBUFF &&
+				swd->busy)
+			swd->ack = ACK_WAIT;
+		else if (swd->request & REQ_RNW)
+			swd->data = dp_read(swd, address);
+	} else if (error_pending) {
+		swd->ack = ACK_FAULT;
+	} else if (swd->busy) {
+		/* The memory access of the previous transaction is pending. */
+		swd->ack = ACK_WAIT;
+	} else if (swd->request & REQ_RNW) {
+		/*
+		 * AP reads are posted, the result is returned by the next
+		 * read.
+		 */
+		swd->data = swd->rdbuff;
+		swd->rdbuff = ap_read(swd,
+			(swd->select & 0xf0) | address);
+	}
+
+	/*
+	 * With overrun detection, all transactions after a WAIT or FAULT
+	 * response fail until the sticky overrun flag is cleared.
+	 */
+	if (swd->ack != ACK_OK && (swd->ctrl_stat & CTRL_STAT_ORUNDETECT))
+		swd->ctrl_stat |= CTRL_STAT_STICKYORUN;
+}
+
+static void finish_write(struct emu_swd *swd)
+{
+	uint32_t address;
+	uint32_t value;
+
+	address = (swd->request >> 1) & 0x0c;
+	value = swd->shift & 0xffffffff;
+
+	if (parity(value) != ((swd->shift >> 32) & 1)) {
+		swd->ctrl_stat |= CTRL_STAT_WDATAERR;
+		return;
+	}
+
+	if (swd->request & REQ_APNDP)
+		ap_write(swd, (swd->select & 0xf0) | address, value);
+	else
+		dp_write(swd, address, value);
+}
+
+static void idle_bit(struct emu_swd *swd, bool bit)
+{
+	if (bit) {
+		swd->num_ones++;
+
+		if (swd->num_ones == LINE_RESET_BITS) {
+			swd->num_bits = 0;
+			swd->shift = 0;
+			swd->armed = false;
+		}
+	} else {
+		swd->num_ones = 0;
+	}
+
+	/*
+	 * A packet request starts with a high bit after an idle cycle or
+	 * after a transaction, but not directly after a line reset.
+	 */
+	if (!swd->num_bits) {
+		if (!bit) {
+			swd->armed = true;
+			return;
+		}
+
+		if (!swd->armed)
+			return;
+	}
+
+	swd->shift = (swd->shift >> 1) | ((uint64_t)bit << 7);
+	swd->num_bits++;
+
+	if (swd->num_bits < 8)
+		return;
+
+	swd->request = swd->shift & 0xff;
+	swd->num_bits = 0;
+	swd->shift = 0;
+
+	/* Wait for an idle cycle after an invalid packet request. */
+	if (!is_valid_request(swd->request)) {
+		swd->armed = false;
+		return;
+	}
+
+	process_request(swd);
+	swd->state = SWD_STATE_ACK_TRN;
+}
+
+static void abort_transaction(struct emu_swd *swd)
+{
+	swd->state = SWD_STATE_IDLE;
+	swd->num_bits = 0;
+	swd->shift = 0;
+	swd->armed = true;
+}
+
+/*
+ * Process a single bit. Returns the bit driven by the target, or false if the
+ * target does not drive the line.
+ */
+static bool process_bit(struct emu_swd *swd, bool host_drive, bool bit)
+{
+	bool tmp;
+
+	if (swd->busy > 0)
+		swd->busy--;
+
+	switch (swd->state) {
+	case SWD_STATE_IDLE:
+		if (host_drive)
+			idle_bit(swd, bit);
+		else
+			swd->num_bits = 0;
+
+		return false;
+	case SWD_STATE_ACK_TRN:
+		swd->state = SWD_STATE_ACK;
+		return false;
+	case SWD_STATE_ACK:
+		if (host_drive) {
+			abort_transaction(swd);
+			return false;
+		}
+
+		tmp = (swd->ack >> swd->num_bits) & 1;
+		swd->num_bits++;
+
+		if (swd->num_bits < 3)
+			return tmp;
+
+		swd->num_bits = 0;
+
+		/*
+		 * With overrun detection, the data phase is performed for
+		 * WAIT and FAULT responses as well but is ignored.
+		 */
+		if (swd->ack != ACK_OK &&
+				!(swd->ctrl_stat & CTRL_STAT_ORUNDETECT))
+			swd->state = SWD_STATE_IDLE;
+		else if (swd->request & REQ_RNW)
+			swd->state = SWD_STATE_RDATA;
+		else
+			swd->state = SWD_STATE_WDATA_TRN;
+
+		return tmp;
+	case SWD_STATE_RDATA:
+		if (host_drive) {
+			abort_transaction(swd);
+			return false;
+		}
+
+		if (swd->ack != ACK_OK)
+			tmp = false;
+		else if (swd->num_bits < 32)
+			tmp = (swd->data >> swd->num_bits) & 1;
+		else
+			tmp = parity(swd->data);
+
+		swd->num_bits++;
+
+		if (swd->num_bits == 33)
+			abort_transaction(swd);
+
+		return tmp;
+	case SWD_STATE_WDATA_TRN:
+		swd->state = SWD_STATE_WDATA;
+		return false;
+	case SWD_STATE_WDATA:
+		if (!host_drive) {
+			abort_transaction(swd);
+			return false;
+		}
+
+		swd->shift |= (uint64_t)bit << swd->num_bits;
+		swd->num_bits++;
+
+		if (swd->num_bits == 33) {
+			if (swd->ack == ACK_OK)
+				finish_write(swd);
+
+			abort_transaction(swd);
+		}
+
+		return false;
+	default:
+		abort_transaction(swd);
+		return false;
+	}
+}
+
+void emu_swd_io(struct emu_swd *swd, const uint8_t *direction,
+		const uint8_t *out, uint8_t *in, size_t length)
+{
+	bool host_drive;
+	bool bit;
+	size_t i;
+
+	memset(in, 0, (length + 7) / 8);
+
+	for (i = 0; i < length; i++) {
+		host_drive = emu_get_bit(direction, i);
+		bit = process_bit(swd, host_drive, emu_get_bit(out, i));
+
+		/* Host-driven bits are read back. */
+		if (host_drive)
+			bit = emu_get_bit(out, i);
+
+		emu_set_bit(in, i, bit);
+	}
+}
+
+/*
+ * Capture the DPACC or APACC scan chain of the JTAG-DP. The acknowledge
+ * indicates whether the previous access is complete, the read result is the
+ * one of the previous access.
+ */
+uint64_t emu_swd_jtag_capture(struct emu_swd *swd)
+{
+	if (swd->busy) {
+		swd->jtag_wait = true;
+
+		if (swd->ctrl_stat & CTRL_STAT_ORUNDETECT)
+			swd->ctrl_stat |= CTRL_STAT_STICKYORUN;
+
+		return JTAG_ACK_WAIT;
+	}
+
+	swd->jtag_wait = false;
+
+	return JTAG_ACK_OK_FAULT | ((uint64_t)swd->jtag_result << 3);
+}
+
+/*
+ * Update the DPACC or APACC scan chain of the JTAG-DP. The access is ignored
+ * if the capture was acknowledged with WAIT.
+ */
+void emu_swd_jtag_update(struct emu_swd *swd, bool ap, uint64_t shift)
+{
+	uint32_t address;
+	uint32_t value;
+	bool read;
+
+	if (swd->jtag_wait)
+		return;
+
+	read = shift & 1;
+	address = (shift << 1) & 0x0c;
+	value = (shift >> 3) & 0xffffffff;
+
+	/* Only writes of CTRL/STAT are accepted until an overrun is cleared. */
+	if (swd->ctrl_stat & CTRL_STAT_STICKYORUN) {
+		if (ap || read || address != DP_CTRL_STAT)
+			return;
+	}
+
+	if (!ap && read) {
+		/* Reads of RDBUFF return zero, the result is already captured. */
+		if (address == DP_RDBUFF)
+			swd->jtag_result = 0;
+		else
+			swd->jtag_result = dp_read(swd, address);
+	} else if (!ap && address == DP_CTRL_STAT) {
+		/* The sticky flags are cleared by writing one to them. */
+		swd->ctrl_stat &= ~(value & CTRL_STAT_STICKY);
+		dp_write(swd, address, value);
+	} else if (!ap && address == DP_SELECT) {
+		dp_write(swd, address, value);
+	} else if (ap && (swd->ctrl_stat & CTRL_STAT_ERRORS)) {
+		/* AP accesses are discarded while a sticky error flag is set. */
+		swd->jtag_result = 0;
+	} else if (ap && read) {
+		swd->jtag_result = ap_read(swd,
+			(swd->select & 0xf0) | address);
+	} else if (ap) {
+		ap_write(swd, (swd->select & 0xf0) | address, value);
+	}
+}
+
+/* Update the ABORT scan chain of the JTAG-DP. */
+void emu_swd_jtag_abort(struct emu_swd *swd, uint32_t value)
+{
+	/* DAPABORT terminates the pending memory access. */
+	if (value & 1)
+		swd->busy = 0;
+}
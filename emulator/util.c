@@ -0,0 +1,83 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "emulator.h"
+
+/**
+ * @file
+ *
+ * Utility functions.
+ *
+ * Multi-byte values are stored in device byte order, which is little-endian.
+ */
+
+uint16_t emu_get_u16(const uint8_t *buffer, size_t offset)
+{
+	return buffer[offset] | (buffer[offset + 1] << 8);
+}
+
+uint32_t emu_get_u32(const uint8_t *buffer, size_t offset)
+{
+	return (uint32_t)buffer[offset] |
+		((uint32_t)buffer[offset + 1] << 8) |
+		((uint32_t)buffer[offset + 2] << 16) |
+		((uint32_t)buffer[offset + 3] << 24);
+}
+
+void emu_set_u16(uint8_t *buffer, uint16_t value, size_t offset)
+{
+	buffer[offset] = value;
+	buffer[offset + 1] = value >> 8;
+}
+
+void emu_set_u32(uint8_t *buffer, uint32_t value, size_t offset)
+{
+	buffer[offset] = value;
+	buffer[offset + 1] = value >> 8;
+	buffer[offset + 2] = value >> 16;
+	buffer[offset + 3] = value >> 24;
+}
+
+/* Bits are numbered starting with the least significant bit of byte 0. */
+bool emu_get_bit(const uint8_t *buffer, size_t offset)
+{
+	return (buffer[offset / 8] >> (offset % 8)) & 1;
+}
+
+void emu_set_bit(uint8_t *buffer, size_t offset, bool value)
+{
+	if (value)
+		buffer[offset / 8] |= (1 << (offset % 8));
+	else
+		buffer[offset / 8] &= ~(1 << (offset % 8));
+}
+
+/* Get the time of a monotonic clock in microseconds. */
+uint64_t emu_get_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
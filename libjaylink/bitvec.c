@@ -0,0 +1,910 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(HAVE_AVX2)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "libjaylink.h"
+#include "libjaylink-internal.h"
+
+/**
+ * @file
+ *
+ * Bit vector functions.
+ *
+ * A bit vector is a buffer where the first bit is the least significant bit
+ * of the first byte and the following bits are numbered in order of
+ * increasing bit significance and byte index. This is the layout of the data
+ * of JTAG and SWD I/O operations.
+ *
+ * The processing of whole bytes uses SSE2 or NEON instructions if the
+ * library is compiled for a target with these instruction sets, and AVX2
+ * instructions if the CPU supports them at runtime. Otherwise, the data is
+ * processed in 64-bit words.
+ */
+
+/** @cond PRIVATE */
+/** Minimum number of bytes for which vector instructions are used. */
+#define VECTOR_MIN_LENGTH	32
+/** @endcond */
+
+#ifdef HAVE_AVX2
+static bool has_avx2(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+#endif
+
+static uint64_t load_u64(const uint8_t *buffer)
+{
+	uint64_t value;
+
+#ifdef WORDS_BIGENDIAN
+	size_t i;
+
+	value = 0;
+
+	for (i = 0; i < 8; i++)
+		value |= (uint64_t)buffer[i] << (8 * i);
+#else
+	memcpy(&value, buffer, sizeof(value));
+#endif
+
+	return value;
+}
+
+static void store_u64(uint8_t *buffer, uint64_t value)
+{
+#ifdef WORDS_BIGENDIAN
+	size_t i;
+
+	for (i = 0; i < 8; i++)
+		buffer[i] = value >> (8 * i);
+#else
+	memcpy(buffer, &value, sizeof(value));
+#endif
+}
+
+/*
+ * The shift functions store length bytes into dst where each byte consists of
+ * the bits of src starting at bit position shift, 0 < shift < 8. They read
+ * length + 1 bytes from src and return the number of bytes processed.
+ */
+
+#if defined(__SSE2__)
+static size_t shift_bytes_sse2(uint8_t *dst, const uint8_t *src,
+		size_t length, unsigned int shift)
+{
+	__m128i lo_mask;
+	__m128i hi_mask;
+	__m128i lo_count;
+	__m128i hi_count;
+	__m128i a;
+	__m128i b;
+	size_t i;
+
+	lo_mask = _mm_set1_epi8((char)(0xff >> shift));
+	hi_mask = _mm_set1_epi8((char)(0xff << (8 - shift)));
+	lo_count = _mm_cvtsi32_si128(shift);
+	hi_count = _mm_cvtsi32_si128(8 - shift);
+
+	for (i = 0; i + 16 <= length; i += 16) {
+		a = _mm_loadu_si128((const __m128i *)(src + i));
+		b = _mm_loadu_si128((const __m128i *)(src + i + 1));
+		a = _mm_and_si128(_mm_srl_epi16(a, lo_count), lo_mask);
+		b = _mm_and_si128(_mm_sll_epi16(b, hi_count), hi_mask);
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(a, b));
+	}
+
+	return i;
+}
+#endif
+
+#ifdef HAVE_AVX2
+__attribute__((target("avx2")))
+static size_t shift_bytes_avx2(uint8_t *dst, const uint8_t *src,
+		size_t length, unsigned int shift)
+{
+	__m256i lo_mask;
+	__m256i hi_mask;
+	__m128i lo_count;
+	__m128i hi_count;
+	__m256i a;
+	__m256i b;
+	size_t i;
+
+	lo_mask = _mm256_set1_epi8((char)(0xff >> shift));
+	hi_mask = _mm256_set1_epi8((char)(0xff << (8 - shift)));
+	lo_count = _mm_cvtsi32_si128(shift);
+	hi_count = _mm_cvtsi32_si128(8 - shift);
+
+	for (i = 0; i + 32 <= length; i += 32) {
+		a = _mm256_loadu_si256((const __m256i *)(src + i));
+		b = _mm256_loadu_si256((const __m256i *)(src + i + 1));
+		a = _mm256_and_si256(_mm256_srl_epi16(a, lo_count), lo_mask);
+		b = _mm256_and_si256(_mm256_sll_epi16(b, hi_count), hi_mask);
+		_mm256_storeu_si256((__m256i *)(dst + i),
+			_mm256_or_si256(a, b));
+	}
+
+	return i;
+}
+#endif
+
+#if defined(__ARM_NEON)
+static size_t shift_bytes_neon(uint8_t *dst, const uint8_t *src,
+		size_t length, unsigned int shift)
+{
+	int8x16_t lo_count;
+	int8x16_t hi_count;
+	uint8x16_t a;
+	uint8x16_t b;
+	size_t i;
+
+	/* Negative counts shift to the right. */
+	lo_count = vdupq_n_s8(-(int8_t)shift);
+	hi_count = vdupq_n_s8(8 - shift);
+
+	for (i = 0; i + 16 <= length; i += 16) {
+		a = vshlq_u8(vld1q_u8(src + i), lo_count);
+		b = vshlq_u8(vld1q_u8(src + i + 1), hi_count);
+		vst1q_u8(dst + i, vorrq_u8(a, b));
+	}
+
+	return i;
+}
+#endif
+
+static void shift_bytes(uint8_t *dst, const uint8_t *src, size_t length,
+		unsigned int shift)
+{
+	size_t i;
+
+	i = 0;
+
+	if (length >= VECTOR_MIN_LENGTH) {
+#ifdef HAVE_AVX2
+		if (has_avx2())
+			i = shift_bytes_avx2(dst, src, length, shift);
+#endif
+#if defined(__SSE2__)
+		if (!i)
+			i = shift_bytes_sse2(dst, src, length, shift);
+#elif defined(__ARM_NEON)
+		if (!i)
+			i = shift_bytes_neon(dst, src, length, shift);
+#endif
+	}
+
+	/* The next byte is read separately to stay within the source. */
+	for (; i + 8 <= length; i += 8)
+		store_u64(dst + i, (load_u64(src + i) >> shift) |
+			((uint64_t)src[i + 8] << (64 - shift)));
+
+	for (; i < length; i++)
+		dst[i] = (src[i] >> shift) | (src[i + 1] << (8 - shift));
+}
+
+/**
+ * Extract a bit field from a bit vector.
+ *
+ * @param[in] buffer Bit vector.
+ * @param[in] offset Offset of the first bit of the field.
+ * @param[in] length Number of bits of the field, at most 64.
+ *
+ * @return The value of the field, or 0 on invalid arguments.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API uint64_t jaylink_bitvec_get_field(const uint8_t *buffer,
+		size_t offset, unsigned int length)
+{
+	uint64_t value;
+	unsigned int shift;
+	unsigned int num_bits;
+	size_t i;
+
+	if (!buffer || !length || length > 64)
+		return 0;
+
+	buffer += offset / 8;
+	shift = offset % 8;
+	value = buffer[0] >> shift;
+	num_bits = 8 - shift;
+
+	for (i = 1; num_bits < length; i++) {
+		value |= (uint64_t)buffer[i] << num_bits;
+		num_bits += 8;
+	}
+
+	if (length < 64)
+		value &= ((uint64_t)1 << length) - 1;
+
+	return value;
+}
+
+/**
+ * Insert a bit field into a bit vector.
+ *
+ * The other bits of the bit vector are not changed.
+ *
+ * @param[in,out] buffer Bit vector.
+ * @param[in] offset Offset of the first bit of the field.
+ * @param[in] value Value of the field.
+ * @param[in] length Number of bits of the field, at most 64.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API void jaylink_bitvec_set_field(uint8_t *buffer, size_t offset,
+		uint64_t value, unsigned int length)
+{
+	unsigned int shift;
+	unsigned int num_bits;
+	uint8_t mask;
+
+	if (!buffer || !length || length > 64)
+		return;
+
+	buffer += offset / 8;
+	shift = offset % 8;
+
+	while (length > 0) {
+		num_bits = MIN(8 - shift, length);
+		mask = (0xff >> (8 - num_bits)) << shift;
+		*buffer = (*buffer & ~mask) | ((value << shift) & mask);
+
+		value >>= num_bits;
+		length -= num_bits;
+		shift = 0;
+		buffer++;
+	}
+}
+
+/**
+ * Copy bits from one bit vector to another.
+ *
+ * @param[out] dst Bit vector to copy the bits into. It must not overlap with
+ *                 the source bit vector.
+ * @param[in] dst_offset Offset of the first bit within the destination.
+ * @param[in] src Bit vector to copy the bits from.
+ * @param[in] src_offset Offset of the first bit within the source.
+ * @param[in] length Number of bits to copy.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API void jaylink_bitvec_copy(uint8_t *dst, size_t dst_offset,
+		const uint8_t *src, size_t src_offset, size_t length)
+{
+	size_t num_bits;
+	size_t num_bytes;
+
+	if (!dst || !src || !length)
+		return;
+
+	/* Copy the bits up to the next byte boundary of the destination. */
+	num_bits = MIN((8 - dst_offset % 8) % 8, length);
+
+	if (num_bits > 0) {
+		jaylink_bitvec_set_field(dst, dst_offset,
+			jaylink_bitvec_get_field(src, src_offset, num_bits),
+			num_bits);
+
+		dst_offset += num_bits;
+		src_offset += num_bits;
+		length -= num_bits;
+	}
+
+	num_bytes = length / 8;
+
+	if (num_bytes > 0) {
+		if (src_offset % 8)
+			shift_bytes(dst + dst_offset / 8, src + src_offset / 8,
+				num_bytes, src_offset % 8);
+		else
+			memcpy(dst + dst_offset / 8, src + src_offset / 8,
+				num_bytes);
+
+		dst_offset += 8 * num_bytes;
+		src_offset += 8 * num_bytes;
+		length -= 8 * num_bytes;
+	}
+
+	if (length > 0)
+		jaylink_bitvec_set_field(dst, dst_offset,
+			jaylink_bitvec_get_field(src, src_offset, length),
+			length);
+}
+
+/**
+ * Set bits of a bit vector to the same value.
+ *
+ * @param[out] buffer Bit vector.
+ * @param[in] offset Offset of the first bit to set.
+ * @param[in] value Value to set the bits to.
+ * @param[in] length Number of bits to set.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API void jaylink_bitvec_fill(uint8_t *buffer, size_t offset,
+		bool value, size_t length)
+{
+	size_t num_bits;
+	size_t num_bytes;
+
+	if (!buffer || !length)
+		return;
+
+	num_bits = MIN((8 - offset % 8) % 8, length);
+
+	if (num_bits > 0) {
+		jaylink_bitvec_set_field(buffer, offset, value ? UINT64_MAX : 0,
+			num_bits);
+
+		offset += num_bits;
+		length -= num_bits;
+	}
+
+	num_bytes = length / 8;
+	memset(buffer + offset / 8, value ? 0xff : 0x00, num_bytes);
+
+	offset += 8 * num_bytes;
+	length -= 8 * num_bytes;
+
+	if (length > 0)
+		jaylink_bitvec_set_field(buffer, offset, value ? UINT64_MAX : 0,
+			length);
+}
+
+/*
+ * The count functions return the number of set bits of the first bytes of
+ * the buffer and store the number of processed bytes in processed.
+ */
+
+#if defined(__SSE2__)
+static size_t count_bytes_sse2(const uint8_t *buffer, size_t length,
+		size_t *processed)
+{
+	__m128i m1;
+	__m128i m2;
+	__m128i m4;
+	__m128i sum;
+	__m128i x;
+	uint64_t tmp[2];
+	size_t i;
+
+	m1 = _mm_set1_epi8(0x55);
+	m2 = _mm_set1_epi8(0x33);
+	m4 = _mm_set1_epi8(0x0f);
+	sum = _mm_setzero_si128();
+
+	for (i = 0; i + 16 <= length; i += 16) {
+		x = _mm_loadu_si128((const __m128i *)(buffer + i));
+		x = _mm_sub_epi8(x, _mm_and_si128(_mm_srli_epi16(x, 1), m1));
+		x = _mm_add_epi8(_mm_and_si128(x, m2),
+			_mm_and_si128(_mm_srli_epi16(x, 2), m2));
+		x = _mm_and_si128(_mm_add_epi8(x, _mm_srli_epi16(x, 4)), m4);
+		sum = _mm_add_epi64(sum, _mm_sad_epu8(x, _mm_setzero_si128()));
+	}
+
+	*processed = i;
+	_mm_storeu_si128((__m128i *)tmp, sum);
+
+	return tmp[0] + tmp[1];
+}
+#endif
+
+#ifdef HAVE_AVX2
+__attribute__((target("avx2")))
+static size_t count_bytes_avx2(const uint8_t *buffer, size_t length,
+		size_t *processed)
+{
+	__m256i table;
+	__m256i m4;
+	__m256i sum;
+	__m256i x;
+	__m256i count;
+	uint64_t tmp[4];
+	size_t i;
+
+	/* Number of set bits of each 4-bit value. */
+	table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3,
+		4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	m4 = _mm256_set1_epi8(0x0f);
+	sum = _mm256_setzero_si256();
+
+	for (i = 0; i + 32 <= length; i += 32) {
+		x = _mm256_loadu_si256((const __m256i *)(buffer + i));
+		count = _mm256_add_epi8(
+			_mm256_shuffle_epi8(table, _mm256_and_si256(x, m4)),
+			_mm256_shuffle_epi8(table,
+				_mm256_and_si256(_mm256_srli_epi16(x, 4),
+				m4)));
+		sum = _mm256_add_epi64(sum,
+			_mm256_sad_epu8(count, _mm256_setzero_si256()));
+	}
+
+	*processed = i;
+	_mm256_storeu_si256((__m256i *)tmp, sum);
+
+	return tmp[0] + tmp[1] + tmp[2] + tmp[3];
+}
+#endif
+
+#if defined(__ARM_NEON)
+static size_t count_bytes_neon(const uint8_t *buffer, size_t length,
+		size_t *processed)
+{
+	uint64x2_t sum;
+	size_t i;
+
+	sum = vdupq_n_u64(0);
+
+	for (i = 0; i + 16 <= length; i += 16)
+		sum = vpadalq_u32(sum, vpaddlq_u16(vpaddlq_u8(
+			vcntq_u8(vld1q_u8(buffer + i)))));
+
+	*processed = i;
+
+	return vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1);
+}
+#endif
+
+static size_t count_bytes(const uint8_t *buffer, size_t length)
+{
+	size_t count;
+	size_t i;
+
+	count = 0;
+	i = 0;
+
+	if (length >= VECTOR_MIN_LENGTH) {
+#ifdef HAVE_AVX2
+		if (has_avx2())
+			count = count_bytes_avx2(buffer, length, &i);
+#endif
+#if defined(__SSE2__)
+		if (!i)
+			count = count_bytes_sse2(buffer, length, &i);
+#elif defined(__ARM_NEON)
+		if (!i)
+			count = count_bytes_neon(buffer, length, &i);
+#endif
+	}
+
+	for (; i + 8 <= length; i += 8)
+		count += __builtin_popcountll(load_u64(buffer + i));
+
+	for (; i < length; i++)
+		count += __builtin_popcount(buffer[i]);
+
+	return count;
+}
+
+/**
+ * Count the set bits of a bit vector.
+ *
+ * @param[in] buffer Bit vector.
+ * @param[in] offset Offset of the first bit to count.
+ * @param[in] length Number of bits to count.
+ *
+ * @return The number of set bits, or 0 on invalid arguments.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API size_t jaylink_bitvec_popcount(const uint8_t *buffer,
+		size_t offset, size_t length)
+{
+	size_t count;
+	size_t num_bits;
+	size_t num_bytes;
+
+	if (!buffer || !length)
+		return 0;
+
+	count = 0;
+	num_bits = MIN((8 - offset % 8) % 8, length);
+
+	if (num_bits > 0) {
+		count += __builtin_popcountll(jaylink_bitvec_get_field(buffer,
+			offset, num_bits));
+
+		offset += num_bits;
+		length -= num_bits;
+	}
+
+	num_bytes = length / 8;
+	count += count_bytes(buffer + offset / 8, num_bytes);
+
+	offset += 8 * num_bytes;
+	length -= 8 * num_bytes;
+
+	if (length > 0)
+		count += __builtin_popcountll(jaylink_bitvec_get_field(buffer,
+			offset, length));
+
+	return count;
+}
+
+/*
+ * The fold functions combine the first bytes of the buffer with XOR into a
+ * 64-bit value whose parity is the parity of these bytes, and store the
+ * number of processed bytes in processed.
+ */
+
+#if defined(__SSE2__)
+static uint64_t fold_bytes_sse2(const uint8_t *buffer, size_t length,
+		size_t *processed)
+{
+	__m128i x;
+	uint64_t tmp[2];
+	size_t i;
+
+	x = _mm_setzero_si128();
+
+	for (i = 0; i + 16 <= length; i += 16)
+		x = _mm_xor_si128(x,
+			_mm_loadu_si128((const __m128i *)(buffer + i)));
+
+	*processed = i;
+	_mm_storeu_si128((__m128i *)tmp, x);
+
+	return tmp[0] ^ tmp[1];
+}
+#endif
+
+#ifdef HAVE_AVX2
+__attribute__((target("avx2")))
+static uint64_t fold_bytes_avx2(const uint8_t *buffer, size_t length,
+		size_t *processed)
+{
+	__m256i x;
+	uint64_t tmp[4];
+	size_t i;
+
+	x = _mm256_setzero_si256();
+
+	for (i = 0; i + 32 <= length; i += 32)
+		x = _mm256_xor_si256(x,
+			_mm256_loadu_si256((const __m256i *)(buffer + i)));
+
+	*processed = i;
+	_mm256_storeu_si256((__m256i *)tmp, x);
+
+	return tmp[0] ^ tmp[1] ^ tmp[2] ^ tmp[3];
+}
+#endif
+
+#if defined(__ARM_NEON)
+static uint64_t fold_bytes_neon(const uint8_t *buffer, size_t length,
+		size_t *processed)
+{
+	uint8x16_t x;
+	uint64x2_t tmp;
+	size_t i;
+
+	x = vdupq_n_u8(0);
+
+	for (i = 0; i + 16 <= length; i += 16)
+		x = veorq_u8(x, vld1q_u8(buffer + i));
+
+	*processed = i;
+	tmp = vreinterpretq_u64_u8(x);
+
+	return vgetq_lane_u64(tmp, 0) ^ vgetq_lane_u64(tmp, 1);
+}
+#endif
+
+static uint64_t fold_bytes(const uint8_t *buffer, size_t length)
+{
+	uint64_t value;
+	size_t i;
+
+	value = 0;
+	i = 0;
+
+	if (length >= VECTOR_MIN_LENGTH) {
+#ifdef HAVE_AVX2
+		if (has_avx2())
+			value = fold_bytes_avx2(buffer, length, &i);
+#endif
+#if defined(__SSE2__)
+		if (!i)
+			value = fold_bytes_sse2(buffer, length, &i);
+#elif defined(__ARM_NEON)
+		if (!i)
+			value = fold_bytes_neon(buffer, length, &i);
+#endif
+	}
+
+	for (; i + 8 <= length; i += 8)
+		value ^= load_u64(buffer + i);
+
+	for (; i < length; i++)
+		value ^= buffer[i];
+
+	return value;
+}
+
+/**
+ * Calculate the parity of a bit vector.
+ *
+ * @param[in] buffer Bit vector.
+ * @param[in] offset Offset of the first bit.
+ * @param[in] length Number of bits.
+ *
+ * @retval true Odd number of set bits.
+ * @retval false Even number of set bits or invalid arguments.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API bool jaylink_bitvec_parity(const uint8_t *buffer, size_t offset,
+		size_t length)
+{
+	uint64_t value;
+	size_t num_bits;
+	size_t num_bytes;
+
+	if (!buffer || !length)
+		return false;
+
+	value = 0;
+	num_bits = MIN((8 - offset % 8) % 8, length);
+
+	if (num_bits > 0) {
+		value = jaylink_bitvec_get_field(buffer, offset, num_bits);
+		offset += num_bits;
+		length -= num_bits;
+	}
+
+	num_bytes = length / 8;
+	value ^= fold_bytes(buffer + offset / 8, num_bytes);
+
+	offset += 8 * num_bytes;
+	length -= 8 * num_bytes;
+
+	if (length > 0)
+		value ^= jaylink_bitvec_get_field(buffer, offset, length);
+
+	return __builtin_parityll(value);
+}
+
+/*
+ * The compare functions return the number of leading bytes of the buffer
+ * which match the expected bytes under the mask. A mask of NULL compares all
+ * bits. The returned number is a multiple of the vector size and the
+ * mismatching byte, if any, is located in the following vector.
+ */
+
+#if defined(__SSE2__)
+static size_t compare_bytes_sse2(const uint8_t *buffer,
+		const uint8_t *expected, const uint8_t *mask, size_t length)
+{
+	__m128i x;
+	size_t i;
+
+	for (i = 0; i + 16 <= length; i += 16) {
+		x = _mm_xor_si128(
+			_mm_loadu_si128((const __m128i *)(buffer + i)),
+			_mm_loadu_si128((const __m128i *)(expected + i)));
+
+		if (mask)
+			x = _mm_and_si128(x,
+				_mm_loadu_si128((const __m128i *)(mask + i)));
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(x,
+				_mm_setzero_si128())) != 0xffff)
+			break;
+	}
+
+	return i;
+}
+#endif
+
+#ifdef HAVE_AVX2
+__attribute__((target("avx2")))
+static size_t compare_bytes_avx2(const uint8_t *buffer,
+		const uint8_t *expected, const uint8_t *mask, size_t length)
+{
+	__m256i x;
+	size_t i;
+
+	for (i = 0; i + 32 <= length; i += 32) {
+		x = _mm256_xor_si256(
+			_mm256_loadu_si256((const __m256i *)(buffer + i)),
+			_mm256_loadu_si256((const __m256i *)(expected + i)));
+
+		if (mask)
+			x = _mm256_and_si256(x, _mm256_loadu_si256(
+				(const __m256i *)(mask + i)));
+
+		if (!_mm256_testz_si256(x, x))
+			break;
+	}
+
+	return i;
+}
+#endif
+
+#if defined(__ARM_NEON)
+static size_t compare_bytes_neon(const uint8_t *buffer,
+		const uint8_t *expected, const uint8_t *mask, size_t length)
+{
+	uint8x16_t x;
+	uint64x2_t tmp;
+	size_t i;
+
+	for (i = 0; i + 16 <= length; i += 16) {
+		x = veorq_u8(vld1q_u8(buffer + i), vld1q_u8(expected + i));
+
+		if (mask)
+			x = vandq_u8(x, vld1q_u8(mask + i));
+
+		tmp = vreinterpretq_u64_u8(x);
+
+		if (vgetq_lane_u64(tmp, 0) | vgetq_lane_u64(tmp, 1))
+			break;
+	}
+
+	return i;
+}
+#endif
+
+static size_t compare_bytes(const uint8_t *buffer, const uint8_t *expected,
+		const uint8_t *mask, size_t length)
+{
+	uint64_t value;
+	size_t i;
+
+	i = 0;
+
+	if (length >= VECTOR_MIN_LENGTH) {
+#ifdef HAVE_AVX2
+		if (has_avx2())
+			i = compare_bytes_avx2(buffer, expected, mask, length);
+#endif
+#if defined(__SSE2__)
+		i += compare_bytes_sse2(buffer + i, expected + i,
+			mask ? mask + i : NULL, length - i);
+#elif defined(__ARM_NEON)
+		i += compare_bytes_neon(buffer + i, expected + i,
+			mask ? mask + i : NULL, length - i);
+#endif
+	}
+
+	for (; i + 8 <= length; i += 8) {
+		value = load_u64(buffer + i) ^ load_u64(expected + i);
+
+		if (mask)
+			value &= load_u64(mask + i);
+
+		if (value)
+			return 8 * i + __builtin_ctzll(value);
+	}
+
+	for (; i < length; i++) {
+		value = buffer[i] ^ expected[i];
+
+		if (mask)
+			value &= mask[i];
+
+		if (value)
+			return 8 * i + __builtin_ctzll(value);
+	}
+
+	return 8 * length;
+}
+
+static size_t compare_field(const uint8_t *buffer, const uint8_t *expected,
+		const uint8_t *mask, size_t offset, unsigned int length)
+{
+	uint64_t value;
+
+	value = jaylink_bitvec_get_field(buffer, offset, length) ^
+		jaylink_bitvec_get_field(expected, offset, length);
+
+	if (mask)
+		value &= jaylink_bitvec_get_field(mask, offset, length);
+
+	if (value)
+		return __builtin_ctzll(value);
+
+	return length;
+}
+
+/**
+ * Compare a bit vector with expected values under a mask.
+ *
+ * This is used to verify the TDO data of JTAG I/O operations, for example.
+ *
+ * @param[in] buffer Bit vector to verify.
+ * @param[in] expected Bit vector with the expected values.
+ * @param[in] mask Bit vector where only set bits are compared, or NULL to
+ *                 compare all bits.
+ * @param[in] offset Offset of the first bit to compare within all bit
+ *                   vectors.
+ * @param[in] length Number of bits to compare.
+ *
+ * @return The index of the first mismatching bit relative to the offset, or
+ *         the number of bits to compare if all bits match or on invalid
+ *         arguments.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API size_t jaylink_bitvec_compare(const uint8_t *buffer,
+		const uint8_t *expected, const uint8_t *mask, size_t offset,
+		size_t length)
+{
+	size_t pos;
+	size_t num_bits;
+	size_t num_bytes;
+	size_t index;
+
+	if (!buffer || !expected || !length)
+		return length;
+
+	pos = 0;
+	num_bits = MIN((8 - offset % 8) % 8, length);
+
+	if (num_bits > 0) {
+		index = compare_field(buffer, expected, mask, offset,
+			num_bits);
+
+		if (index < num_bits)
+			return index;
+
+		pos += num_bits;
+	}
+
+	num_bytes = (length - pos) / 8;
+
+	if (num_bytes > 0) {
+		index = compare_bytes(buffer + (offset + pos) / 8,
+			expected + (offset + pos) / 8,
+			mask ? mask + (offset + pos) / 8 : NULL, num_bytes);
+
+		if (index < 8 * num_bytes)
+			return pos + index;
+
+		pos += 8 * num_bytes;
+	}
+
+	if (pos < length) {
+		index = compare_field(buffer, expected, mask, offset + pos,
+			length - pos);
+
+		return pos + index;
+	}
+
+	return length;
+}
@@ -0,0 +1,740 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "libjaylink.h"
+#include "libjaylink-internal.h"
+
+/**
+ * @file
+ *
+ * Execution of a command sequence on multiple devices.
+ */
+
+/** @cond PRIVATE */
+/** Initial number of steps of a broadcast. */
+#define BROADCAST_INITIAL_SIZE	16
+/** @endcond */
+
+static int add_step(struct jaylink_broadcast *bc,
+		enum broadcast_step_type type, struct broadcast_step **step)
+{
+	struct broadcast_step *steps;
+	struct broadcast_step *tmp;
+	size_t size;
+
+	if (bc->num_steps == bc->size) {
+		size = bc->size * 2;
+		steps = realloc(bc->steps, size * sizeof(*steps));
+
+		if (!steps)
+			return JAYLINK_ERR_MALLOC;
+
+		bc->steps = steps;
+		bc->size = size;
+	}
+
+	tmp = &bc->steps[bc->num_steps];
+	bc->num_steps++;
+
+	tmp->type = type;
+	tmp->data[0] = NULL;
+	tmp->data[1] = NULL;
+	tmp->response = NULL;
+	tmp->length = 0;
+	tmp->offset = 0;
+
+	if (step)
+		*step = tmp;
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Create a broadcast.
+ *
+ * A broadcast executes the same sequence of operations on multiple devices in
+ * parallel. The operations are added with the jaylink_broadcast_*() functions
+ * and executed with jaylink_broadcast_execute().
+ *
+ * @param[in] devhs Device handles to execute the operations on. Each device
+ *                  handle must not be used more than once and must remain
+ *                  valid until the broadcast is freed.
+ * @param[in] num_devhs Number of device handles.
+ * @param[out] bc Newly allocated broadcast on success. Its content is undefined
+ *                on failure.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_broadcast_new(struct jaylink_device_handle **devhs,
+		size_t num_devhs, struct jaylink_broadcast **bc)
+{
+	int ret;
+	struct jaylink_broadcast *tmp;
+	size_t i;
+	size_t j;
+
+	if (!devhs || !num_devhs || !bc)
+		return JAYLINK_ERR_ARG;
+
+	for (i = 0; i < num_devhs; i++) {
+		if (!devhs[i])
+			return JAYLINK_ERR_ARG;
+
+		for (j = 0; j < i; j++) {
+			if (devhs[i] == devhs[j])
+				return JAYLINK_ERR_ARG;
+		}
+	}
+
+	tmp = malloc(sizeof(struct jaylink_broadcast));
+
+	if (!tmp)
+		return JAYLINK_ERR_MALLOC;
+
+	tmp->probes = calloc(num_devhs, sizeof(struct broadcast_probe));
+
+	if (!tmp->probes) {
+		free(tmp);
+		return JAYLINK_ERR_MALLOC;
+	}
+
+	tmp->steps = malloc(BROADCAST_INITIAL_SIZE *
+		sizeof(struct broadcast_step));
+
+	if (!tmp->steps) {
+		free(tmp->probes);
+		free(tmp);
+		return JAYLINK_ERR_MALLOC;
+	}
+
+	tmp->ctx = devhs[0]->dev->ctx;
+	tmp->num_probes = num_devhs;
+	tmp->num_steps = 0;
+	tmp->size = BROADCAST_INITIAL_SIZE;
+	tmp->num_workers = 0;
+	tmp->scratch_length = 0;
+	ret = JAYLINK_OK;
+
+	for (i = 0; i < num_devhs; i++) {
+		tmp->probes[i].devh = devhs[i];
+		tmp->probes[i].index = i;
+		tmp->probes[i].result = JAYLINK_OK;
+
+		ret = jaylink_queue_new(devhs[i], &tmp->probes[i].queue);
+
+		if (ret != JAYLINK_OK)
+			break;
+	}
+
+	if (ret != JAYLINK_OK) {
+		jaylink_broadcast_free(tmp);
+		return ret;
+	}
+
+	*bc = tmp;
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Free a broadcast.
+ *
+ * @param[in,out] bc Broadcast. If NULL, the function does nothing.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API void jaylink_broadcast_free(struct jaylink_broadcast *bc)
+{
+	size_t i;
+
+	if (!bc)
+		return;
+
+	for (i = 0; i < bc->num_probes; i++)
+		jaylink_queue_free(bc->probes[i].queue);
+
+	free(bc->steps);
+	free(bc->probes);
+	free(bc);
+}
+
+/**
+ * Set the number of worker threads of a broadcast.
+ *
+ * Each worker executes the operations on one device after the other until
+ * there is no device left. By default, there is a worker for each device such
+ * that a slow device does not delay any other device.
+ *
+ * @param[in,out] bc Broadcast.
+ * @param[in] num_workers Maximum number of workers, including the thread that
+ *                        calls jaylink_broadcast_execute(), or 0 to use a
+ *                        worker for each device.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_broadcast_set_workers(struct jaylink_broadcast *bc,
+		size_t num_workers)
+{
+	if (!bc)
+		return JAYLINK_ERR_ARG;
+
+	bc->num_workers = num_workers;
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Remove all operations from a broadcast.
+ *
+ * The operations of a broadcast are retained after its execution such that
+ * the same sequence can be executed again, for example on the next set of
+ * targets.
+ *
+ * @param[in,out] bc Broadcast.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_broadcast_clear(struct jaylink_broadcast *bc)
+{
+	if (!bc)
+		return JAYLINK_ERR_ARG;
+
+	bc->num_steps = 0;
+	bc->scratch_length = 0;
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Add a JTAG I/O operation to a broadcast.
+ *
+ * See jaylink_jtag_io() for a description of the operation.
+ *
+ * The buffers must remain valid until the broadcast is executed.
+ *
+ * @param[in,out] bc Broadcast.
+ * @param[in] tms Buffer to read TMS data from.
+ * @param[in] tdi Buffer to read TDI data from.
+ * @param[out] tdo Buffer to store the TDO data of all devices, or NULL to
+ *                 discard the TDO data. The data of the device with index i
+ *                 is stored at offset i * ((length + 7) / 8) bytes, in the
+ *                 order of the device handles passed to
+ *                 jaylink_broadcast_new(). The content for a device is
+ *                 undefined if the broadcast fails on that device.
+ * @param[in] length Number of bits to transfer.
+ * @param[in] version Version of the JTAG command to use.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_broadcast_jtag_io(struct jaylink_broadcast *bc,
+		const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
+		uint16_t length, enum jaylink_jtag_version version)
+{
+	int ret;
+	struct broadcast_step *step;
+	size_t num_bytes;
+
+	if (!bc || !tms || !tdi || !length)
+		return JAYLINK_ERR_ARG;
+
+	if (version != JAYLINK_JTAG_VERSION_2 &&
+			version != JAYLINK_JTAG_VERSION_3)
+		return JAYLINK_ERR_ARG;
+
+	ret = add_step(bc, BROADCAST_STEP_JTAG_IO, &step);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	step->data[0] = tms;
+	step->data[1] = tdi;
+	step->response = tdo;
+	step->length = length;
+	step->version = version;
+
+	num_bytes = (length + 7) / 8;
+
+	if (!tdo && bc->scratch_length < num_bytes)
+		bc->scratch_length = num_bytes;
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Add an operation to clear the JTAG test reset (TRST) signal to a broadcast.
+ *
+ * @param[in,out] bc Broadcast.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_broadcast_jtag_clear_trst(
+		struct jaylink_broadcast *bc)
+{
+	if (!bc)
+		return JAYLINK_ERR_ARG;
+
+	return add_step(bc, BROADCAST_STEP_JTAG_CLEAR_TRST, NULL);
+}
+
+/**
+ * Add an operation to set the JTAG test reset (TRST) signal to a broadcast.
+ *
+ * @param[in,out] bc Broadcast.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_broadcast_jtag_set_trst(struct jaylink_broadcast *bc)
+{
+	if (!bc)
+		return JAYLINK_ERR_ARG;
+
+	return add_step(bc, BROADCAST_STEP_JTAG_SET_TRST, NULL);
+}
+
+/**
+ * Add an SWD I/O operation to a broadcast.
+ *
+ * See jaylink_swd_io() for a description of the operation.
+ *
+ * The buffers must remain valid until the broadcast is executed.
+ *
+ * @param[in,out] bc Broadcast.
+ * @param[in] direction Buffer to read the transfer direction from.
+ * @param[in] out Buffer to read host-to-target data from.
+ * @param[out] in Buffer to store the target-to-host data of all devices, or
+ *                NULL to discard the data. The layout is the same as for the
+ *                TDO data of jaylink_broadcast_jtag_io().
+ * @param[in] length Number of bits to transfer.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_broadcast_swd_io(struct jaylink_broadcast *bc,
+		const uint8_t *direction, const uint8_t *out, uint8_t *in,
+		uint16_t length)
+{
+	int ret;
+	struct broadcast_step *step;
+	size_t num_bytes;
+
+	if (!bc || !direction || !out || !length)
+		return JAYLINK_ERR_ARG;
+
+	ret = add_step(bc, BROADCAST_STEP_SWD_IO, &step);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	step->data[0] = direction;
+	step->data[1] = out;
+	step->response = in;
+	step->length = length;
+
+	num_bytes = (length + 7) / 8;
+
+	if (!in && bc->scratch_length < num_bytes)
+		bc->scratch_length = num_bytes;
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Add an operation to clear the target reset signal to a broadcast.
+ *
+ * @param[in,out] bc Broadcast.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_broadcast_clear_reset(struct jaylink_broadcast *bc)
+{
+	if (!bc)
+		return JAYLINK_ERR_ARG;
+
+	return add_step(bc, BROADCAST_STEP_CLEAR_RESET, NULL);
+}
+
+/**
+ * Add an operation to set the target reset signal to a broadcast.
+ *
+ * @param[in,out] bc Broadcast.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_broadcast_set_reset(struct jaylink_broadcast *bc)
+{
+	if (!bc)
+		return JAYLINK_ERR_ARG;
+
+	return add_step(bc, BROADCAST_STEP_SET_RESET, NULL);
+}
+
+/**
+ * Add a file write operation to a broadcast.
+ *
+ * Unlike jaylink_file_write(), the data is not limited to
+ * #JAYLINK_FILE_MAX_TRANSFER_SIZE bytes but written in multiple transfers
+ * if necessary.
+ *
+ * @param[in,out] bc Broadcast.
+ * @param[in] filename Name of the file to write to. The length of the name
+ *                     must not exceed #JAYLINK_FILE_NAME_MAX_LENGTH bytes.
+ * @param[in] buffer Buffer to read the data from. It must remain valid until
+ *                   the broadcast is executed.
+ * @param[in] offset Offset in bytes relative to the beginning of the file from
+ *                   where to start writing.
+ * @param[in] length Number of bytes to write.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @see jaylink_file_write()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_broadcast_file_write(struct jaylink_broadcast *bc,
+		const char *filename, const uint8_t *buffer, uint32_t offset,
+		uint32_t length)
+{
+	int ret;
+	struct broadcast_step *step;
+	size_t filename_length;
+
+	if (!bc || !filename || !buffer || !length)
+		return JAYLINK_ERR_ARG;
+
+	filename_length = strlen(filename);
+
+	if (!filename_length)
+		return JAYLINK_ERR_ARG;
+
+	if (filename_length > JAYLINK_FILE_NAME_MAX_LENGTH)
+		return JAYLINK_ERR_ARG;
+
+	ret = add_step(bc, BROADCAST_STEP_FILE_WRITE, &step);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	memcpy(step->filename, filename, filename_length + 1);
+	step->data[0] = buffer;
+	step->offset = offset;
+	step->length = length;
+
+	return JAYLINK_OK;
+}
+
+static int file_write(struct jaylink_device_handle *devh,
+		const struct broadcast_step *step)
+{
+	int ret;
+	uint32_t pos;
+	uint32_t length;
+
+	pos = 0;
+
+	while (pos < step->length) {
+		length = MIN(step->length - pos,
+			JAYLINK_FILE_MAX_TRANSFER_SIZE);
+		ret = jaylink_file_write(devh, step->filename,
+			step->data[0] + pos, step->offset + pos, &length);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+
+		/* Avoid an endless loop if the device does not accept data. */
+		if (!length)
+			return JAYLINK_ERR_DEV;
+
+		pos += length;
+	}
+
+	return JAYLINK_OK;
+}
+
+static int queue_step(const struct jaylink_broadcast *bc,
+		struct broadcast_probe *probe, const struct broadcast_step *step)
+{
+	uint8_t *response;
+
+	response = probe->scratch;
+
+	if (step->response)
+		response = step->response +
+			probe->index * ((step->length + 7) / 8);
+
+	switch (step->type) {
+	case BROADCAST_STEP_JTAG_IO:
+		return jaylink_queue_jtag_io(probe->queue, step->data[0],
+			step->data[1], response, step->length, step->version);
+	case BROADCAST_STEP_JTAG_CLEAR_TRST:
+		return jaylink_queue_jtag_clear_trst(probe->queue);
+	case BROADCAST_STEP_JTAG_SET_TRST:
+		return jaylink_queue_jtag_set_trst(probe->queue);
+	case BROADCAST_STEP_SWD_IO:
+		return jaylink_queue_swd_io(probe->queue, step->data[0],
+			step->data[1], response, step->length);
+	case BROADCAST_STEP_CLEAR_RESET:
+		return jaylink_queue_clear_reset(probe->queue);
+	case BROADCAST_STEP_SET_RESET:
+		return jaylink_queue_set_reset(probe->queue);
+	default:
+		log_err(bc->ctx, "Invalid broadcast step type: %u.",
+			step->type);
+		return JAYLINK_ERR;
+	}
+}
+
+/*
+ * Execute all operations on a single device.
+ *
+ * Consecutive operations which can be queued are sent to the device at once.
+ */
+static int run_probe(const struct jaylink_broadcast *bc,
+		struct broadcast_probe *probe)
+{
+	int ret;
+	size_t i;
+	size_t length;
+	const struct broadcast_step *step;
+
+	for (i = 0; i < bc->num_steps; i++) {
+		step = &bc->steps[i];
+
+		if (step->type != BROADCAST_STEP_FILE_WRITE) {
+			ret = queue_step(bc, probe, step);
+
+			if (ret != JAYLINK_OK)
+				return ret;
+
+			continue;
+		}
+
+		ret = jaylink_queue_execute(probe->queue);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+
+		ret = file_write(probe->devh, step);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+	}
+
+	ret = jaylink_queue_get_length(probe->queue, &length);
+
+	if (ret != JAYLINK_OK || !length)
+		return ret;
+
+	return jaylink_queue_execute(probe->queue);
+}
+
+static void run_worker(void *arg)
+{
+	struct jaylink_broadcast *bc;
+	struct broadcast_probe *probe;
+	size_t index;
+
+	bc = arg;
+
+	while (true) {
+		index = thread_atomic_inc(&bc->next_probe) - 1;
+
+		if (index >= bc->num_probes)
+			break;
+
+		probe = &bc->probes[index];
+		probe->result = run_probe(bc, probe);
+
+		if (probe->result == JAYLINK_OK)
+			continue;
+
+		log_err(probe->devh->dev->ctx, "Broadcast failed on device "
+			"%zu: %s.", index, jaylink_strerror(probe->result));
+
+		/* Discard the operations not executed due to the failure. */
+		queue_reset(probe->queue);
+	}
+}
+
+/**
+ * Execute the operations of a broadcast on all devices.
+ *
+ * The devices are served by independent workers. A failure on one device does
+ * not affect the execution on any other device. Consecutive operations other
+ * than file operations are sent to a device at once like with
+ * jaylink_queue_execute().
+ *
+ * The operations are retained and can be executed again.
+ *
+ * @param[in,out] bc Broadcast.
+ *
+ * @retval JAYLINK_OK Success on all devices.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ * @retval JAYLINK_ERR The execution failed on at least one device. Use
+ *                     jaylink_broadcast_get_result() to get the result of
+ *                     each device.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_broadcast_execute(struct jaylink_broadcast *bc)
+{
+	int ret;
+	struct thread *threads;
+	uint8_t *scratch;
+	size_t num_threads;
+	size_t i;
+
+	if (!bc)
+		return JAYLINK_ERR_ARG;
+
+	num_threads = bc->num_probes;
+
+	if (bc->num_workers > 0)
+		num_threads = MIN(bc->num_workers, num_threads);
+
+	/* The calling thread is a worker as well. */
+	num_threads--;
+	threads = NULL;
+
+	if (num_threads > 0) {
+		threads = malloc(num_threads * sizeof(struct thread));
+
+		if (!threads)
+			return JAYLINK_ERR_MALLOC;
+	}
+
+	scratch = NULL;
+
+	if (bc->scratch_length > 0) {
+		scratch = malloc(bc->num_probes * bc->scratch_length);
+
+		if (!scratch) {
+			free(threads);
+			return JAYLINK_ERR_MALLOC;
+		}
+	}
+
+	for (i = 0; i < bc->num_probes; i++) {
+		bc->probes[i].scratch = NULL;
+		bc->probes[i].result = JAYLINK_OK;
+
+		if (scratch)
+			bc->probes[i].scratch = scratch + i * bc->scratch_length;
+	}
+
+	bc->next_probe = 0;
+
+	for (i = 0; i < num_threads; i++) {
+		/*
+		 * Continue with fewer workers if a thread can not be created,
+		 * the devices are served anyway.
+		 */
+		if (!thread_create(&threads[i], run_worker, bc)) {
+			log_warn(bc->ctx, "Failed to create worker thread.");
+			break;
+		}
+	}
+
+	num_threads = i;
+	run_worker(bc);
+
+	for (i = 0; i < num_threads; i++)
+		thread_join(&threads[i]);
+
+	free(threads);
+	free(scratch);
+
+	ret = JAYLINK_OK;
+
+	for (i = 0; i < bc->num_probes; i++) {
+		if (bc->probes[i].result != JAYLINK_OK)
+			ret = JAYLINK_ERR;
+	}
+
+	return ret;
+}
+
+/**
+ * Retrieve the result of the last execution of a broadcast on a device.
+ *
+ * @param[in] bc Broadcast.
+ * @param[in] index Index of the device in the array of device handles passed
+ *                  to jaylink_broadcast_new().
+ * @param[out] result Result of the execution on the device, which is a
+ *                    libjaylink error code. It is #JAYLINK_OK if the broadcast
+ *                    was not executed yet.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_broadcast_get_result(
+		const struct jaylink_broadcast *bc, size_t index, int *result)
+{
+	if (!bc || !result)
+		return JAYLINK_ERR_ARG;
+
+	if (index >= bc->num_probes)
+		return JAYLINK_ERR_ARG;
+
+	*result = bc->probes[index].result;
+
+	return JAYLINK_OK;
+}
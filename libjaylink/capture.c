@@ -0,0 +1,724 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libjaylink.h"
+#include "libjaylink-internal.h"
+
+/**
+ * @file
+ *
+ * Capture and replay of transport operations.
+ *
+ * A capture file starts with a header which consists of an 8 byte magic string
+ * and a 32-bit version number. The header is followed by one record for each
+ * transport operation. A record starts with its type and the time in
+ * microseconds elapsed since the previous record. Multi-byte values are stored
+ * in little-endian byte order.
+ *
+ * The remaining content of a record depends on its type:
+ *
+ *  - Start write: length (32-bit), command flag (8-bit)
+ *  - Start read: length (32-bit)
+ *  - Start write read: write length (32-bit), read length (32-bit), command
+ *    flag (8-bit)
+ *  - Write: length (32-bit), data
+ *  - Read: length (32-bit), data
+ */
+
+/** @cond PRIVATE */
+/** Magic string at the beginning of a capture file. */
+#define CAPTURE_MAGIC		"JAYLCAP"
+/** Size of the magic string including null-terminator in bytes. */
+#define CAPTURE_MAGIC_SIZE	8
+/** Version of the capture file format. */
+#define CAPTURE_VERSION		1
+/** Size of the capture file header in bytes. */
+#define CAPTURE_HEADER_SIZE	12
+
+/** Size of the type and time of a record in bytes. */
+#define RECORD_HEADER_SIZE	5
+/** Maximum size of a record without data in bytes. */
+#define RECORD_MAX_SIZE		(RECORD_HEADER_SIZE + 9)
+
+#define RECORD_START_WRITE	0x01
+#define RECORD_START_READ	0x02
+#define RECORD_START_WRITE_READ	0x03
+#define RECORD_WRITE		0x04
+#define RECORD_READ		0x05
+
+/** Capture of the transport operations of a device handle. */
+struct capture {
+	/** Capture file. */
+	FILE *file;
+	/** Time of the previous record in microseconds. */
+	uint64_t time;
+};
+
+/** Replay of a capture file. */
+struct replay {
+	/** libjaylink context. */
+	struct jaylink_context *ctx;
+	/** Content of the capture file. */
+	uint8_t *data;
+	/** Size of the capture file in bytes. */
+	size_t size;
+	/** Position of the next record. */
+	size_t pos;
+	/** Number of data bytes of the current record not consumed yet. */
+	size_t length;
+	/** Position of the data of the current record not consumed yet. */
+	size_t data_pos;
+};
+/** @endcond */
+
+static void close_capture(struct jaylink_device_handle *devh)
+{
+	if (fclose(devh->capture->file))
+		log_warn(devh->dev->ctx, "Failed to close capture file.");
+
+	free(devh->capture);
+	devh->capture = NULL;
+}
+
+static void write_record(struct jaylink_device_handle *devh, uint8_t *record,
+		size_t length, const uint8_t *data, size_t data_length)
+{
+	struct capture *capture;
+	uint64_t time;
+	uint64_t delta;
+	bool ret;
+
+	capture = devh->capture;
+	time = util_get_time();
+	delta = time - capture->time;
+	capture->time = time;
+
+	if (delta > UINT32_MAX)
+		delta = UINT32_MAX;
+
+	buffer_set_u32(record, delta, 1);
+	ret = fwrite(record, 1, length, capture->file) == length;
+
+	if (ret && data_length > 0)
+		ret = fwrite(data, 1, data_length, capture->file) ==
+			data_length;
+
+	/* Stop capturing such that the capture file stays consistent. */
+	if (!ret) {
+		log_warn(devh->dev->ctx, "Failed to write capture file, "
+			"capturing stopped.");
+		close_capture(devh);
+	}
+}
+
+/**
+ * Capture the start of a write operation.
+ *
+ * @param[in,out] devh Device handle.
+ * @param[in] length Number of bytes of the write operation.
+ * @param[in] has_command Determines whether the data of the write operation
+ *                        contains the protocol command.
+ */
+JAYLINK_PRIV void capture_start_write(struct jaylink_device_handle *devh,
+		size_t length, bool has_command)
+{
+	uint8_t record[RECORD_MAX_SIZE];
+
+	if (!devh->capture)
+		return;
+
+	record[0] = RECORD_START_WRITE;
+	buffer_set_u32(record, length, RECORD_HEADER_SIZE);
+	record[RECORD_HEADER_SIZE + 4] = has_command;
+
+	write_record(devh, record, RECORD_HEADER_SIZE + 5, NULL, 0);
+}
+
+/**
+ * Capture the start of a read operation.
+ *
+ * @param[in,out] devh Device handle.
+ * @param[in] length Number of bytes of the read operation.
+ */
+JAYLINK_PRIV void capture_start_read(struct jaylink_device_handle *devh,
+		size_t length)
+{
+	uint8_t record[RECORD_MAX_SIZE];
+
+	if (!devh->capture)
+		return;
+
+	record[0] = RECORD_START_READ;
+	buffer_set_u32(record, length, RECORD_HEADER_SIZE);
+
+	write_record(devh, record, RECORD_HEADER_SIZE + 4, NULL, 0);
+}
+
+/**
+ * Capture the start of a write operation followed by a read operation.
+ *
+ * @param[in,out] devh Device handle.
+ * @param[in] write_length Number of bytes of the write operation.
+ * @param[in] read_length Number of bytes of the read operation.
+ * @param[in] has_command Determines whether the data of the write operation
+ *                        contains the protocol command.
+ */
+JAYLINK_PRIV void capture_start_write_read(struct jaylink_device_handle *devh,
+		size_t write_length, size_t read_length, bool has_command)
+{
+	uint8_t record[RECORD_MAX_SIZE];
+
+	if (!devh->capture)
+		return;
+
+	record[0] = RECORD_START_WRITE_READ;
+	buffer_set_u32(record, write_length, RECORD_HEADER_SIZE);
+	buffer_set_u32(record, read_length, RECORD_HEADER_SIZE + 4);
+	record[RECORD_HEADER_SIZE + 8] = has_command;
+
+	write_record(devh, record, RECORD_HEADER_SIZE + 9, NULL, 0);
+}
+
+/**
+ * Capture written data.
+ *
+ * @param[in,out] devh Device handle.
+ * @param[in] buffer Buffer with the written data.
+ * @param[in] length Number of written bytes.
+ */
+JAYLINK_PRIV void capture_write(struct jaylink_device_handle *devh,
+		const uint8_t *buffer, size_t length)
+{
+	uint8_t record[RECORD_MAX_SIZE];
+
+	if (!devh->capture || !length)
+		return;
+
+	record[0] = RECORD_WRITE;
+	buffer_set_u32(record, length, RECORD_HEADER_SIZE);
+
+	write_record(devh, record, RECORD_HEADER_SIZE + 4, buffer, length);
+}
+
+/**
+ * Capture read data.
+ *
+ * @param[in,out] devh Device handle.
+ * @param[in] buffer Buffer with the read data.
+ * @param[in] length Number of read bytes.
+ */
+JAYLINK_PRIV void capture_read(struct jaylink_device_handle *devh,
+		const uint8_t *buffer, size_t length)
+{
+	uint8_t record[RECORD_MAX_SIZE];
+
+	if (!devh->capture || !length)
+		return;
+
+	record[0] = RECORD_READ;
+	buffer_set_u32(record, length, RECORD_HEADER_SIZE);
+
+	write_record(devh, record, RECORD_HEADER_SIZE + 4, buffer, length);
+}
+
+/**
+ * Stop capturing the transport operations of a device handle, if any.
+ *
+ * @param[in,out] devh Device handle.
+ */
+JAYLINK_PRIV void capture_close(struct jaylink_device_handle *devh)
+{
+	if (devh->capture)
+		close_capture(devh);
+}
+
+static int _capture_start(struct jaylink_device_handle *devh,
+		const char *filename)
+{
+	struct jaylink_context *ctx;
+	struct capture *capture;
+	uint8_t header[CAPTURE_HEADER_SIZE];
+
+	if (!devh || !filename)
+		return JAYLINK_ERR_ARG;
+
+	ctx = devh->dev->ctx;
+	capture_close(devh);
+
+	capture = malloc(sizeof(struct capture));
+
+	if (!capture) {
+		log_err(ctx, "Capture malloc failed.");
+		return JAYLINK_ERR_MALLOC;
+	}
+
+	capture->file = fopen(filename, "wb");
+
+	if (!capture->file) {
+		log_err(ctx, "Failed to open capture file: %s.", filename);
+		free(capture);
+		return JAYLINK_ERR_IO;
+	}
+
+	memcpy(header, CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE);
+	buffer_set_u32(header, CAPTURE_VERSION, CAPTURE_MAGIC_SIZE);
+
+	if (fwrite(header, 1, sizeof(header), capture->file) !=
+			sizeof(header)) {
+		log_err(ctx, "Failed to write capture file header.");
+		fclose(capture->file);
+		free(capture);
+		return JAYLINK_ERR_IO;
+	}
+
+	capture->time = util_get_time();
+	devh->capture = capture;
+
+	log_dbg(ctx, "Capturing to file: %s.", filename);
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Start capturing the transport operations of a device.
+ *
+ * All data exchanged with the device is written to a capture file together
+ * with timestamps until the capture is stopped or the device is closed. The
+ * capture file can be replayed with a device instance created by
+ * jaylink_replay_device_new().
+ *
+ * If the device is already being captured, the previous capture is stopped.
+ *
+ * @param[in,out] devh Device handle.
+ * @param[in] filename Name of the capture file. An existing file is
+ *                     overwritten.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ *
+ * @see jaylink_capture_stop()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_capture_start(struct jaylink_device_handle *devh,
+		const char *filename)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _capture_start(devh, filename);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+/**
+ * Stop capturing the transport operations of a device.
+ *
+ * @param[in,out] devh Device handle.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ *
+ * @see jaylink_capture_start()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_capture_stop(struct jaylink_device_handle *devh)
+{
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	capture_close(devh);
+	thread_mutex_unlock(&devh->lock);
+
+	return JAYLINK_OK;
+}
+
+/*
+ * Get the next record of a replay and check that it is of the expected type.
+ * Returns the position of the record content after the type and the time.
+ */
+static bool next_record(struct replay *replay, uint8_t type, size_t length,
+		size_t *pos)
+{
+	size_t size;
+
+	if (replay->length > 0) {
+		log_err(replay->ctx, "Replay: %zu bytes of the previous "
+			"operation left.", replay->length);
+		return false;
+	}
+
+	size = RECORD_HEADER_SIZE + length;
+
+	if (replay->pos + size > replay->size) {
+		log_err(replay->ctx, "Replay: end of capture reached.");
+		return false;
+	}
+
+	if (replay->data[replay->pos] != type) {
+		log_err(replay->ctx, "Replay: expected record type 0x%02x, "
+			"but got 0x%02x at offset %zu.", type,
+			replay->data[replay->pos], replay->pos);
+		return false;
+	}
+
+	*pos = replay->pos + RECORD_HEADER_SIZE;
+	replay->pos += size;
+
+	return true;
+}
+
+static int check_length(struct replay *replay, size_t pos, size_t length)
+{
+	uint32_t tmp;
+
+	tmp = buffer_get_u32(replay->data, pos);
+
+	if (tmp != length) {
+		log_err(replay->ctx, "Replay: expected %u bytes, but got %zu "
+			"bytes at offset %zu.", tmp, length, pos);
+		return JAYLINK_ERR_PROTO;
+	}
+
+	return JAYLINK_OK;
+}
+
+static int replay_open(void *user_data)
+{
+	struct replay *replay;
+
+	replay = user_data;
+	replay->pos = CAPTURE_HEADER_SIZE;
+	replay->length = 0;
+
+	return JAYLINK_OK;
+}
+
+static int replay_start_write(void *user_data, size_t length,
+		bool has_command)
+{
+	struct replay *replay;
+	size_t pos;
+
+	replay = user_data;
+
+	if (!next_record(replay, RECORD_START_WRITE, 5, &pos))
+		return JAYLINK_ERR_PROTO;
+
+	if (replay->data[pos + 4] != has_command) {
+		log_err(replay->ctx, "Replay: command flag mismatch at offset "
+			"%zu.", pos);
+		return JAYLINK_ERR_PROTO;
+	}
+
+	return check_length(replay, pos, length);
+}
+
+static int replay_start_read(void *user_data, size_t length)
+{
+	struct replay *replay;
+	size_t pos;
+
+	replay = user_data;
+
+	if (!next_record(replay, RECORD_START_READ, 4, &pos))
+		return JAYLINK_ERR_PROTO;
+
+	return check_length(replay, pos, length);
+}
+
+static int replay_start_write_read(void *user_data, size_t write_length,
+		size_t read_length, bool has_command)
+{
+	int ret;
+	struct replay *replay;
+	size_t pos;
+
+	replay = user_data;
+
+	if (!next_record(replay, RECORD_START_WRITE_READ, 9, &pos))
+		return JAYLINK_ERR_PROTO;
+
+	if (replay->data[pos + 8] != has_command) {
+		log_err(replay->ctx, "Replay: command flag mismatch at offset "
+			"%zu.", pos);
+		return JAYLINK_ERR_PROTO;
+	}
+
+	ret = check_length(replay, pos, write_length);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	return check_length(replay, pos + 4, read_length);
+}
+
+/*
+ * Consume data of write or read records. The data of an operation may span
+ * several records and a record may be consumed by several operations.
+ */
+static int consume_data(struct replay *replay, uint8_t type,
+		const uint8_t **data, size_t *length)
+{
+	size_t pos;
+	size_t tmp;
+
+	if (!replay->length) {
+		if (!next_record(replay, type, 4, &pos))
+			return JAYLINK_ERR_PROTO;
+
+		tmp = buffer_get_u32(replay->data, pos);
+
+		if (tmp > replay->size - replay->pos) {
+			log_err(replay->ctx, "Replay: truncated record at "
+				"offset %zu.", pos);
+			return JAYLINK_ERR_PROTO;
+		}
+
+		replay->data_pos = replay->pos;
+		replay->length = tmp;
+		replay->pos += tmp;
+	}
+
+	if (*length > replay->length)
+		*length = replay->length;
+
+	*data = replay->data + replay->data_pos;
+	replay->data_pos += *length;
+	replay->length -= *length;
+
+	return JAYLINK_OK;
+}
+
+static int replay_write(void *user_data, const uint8_t *buffer,
+		size_t length)
+{
+	int ret;
+	struct replay *replay;
+	const uint8_t *data;
+	size_t tmp;
+
+	replay = user_data;
+
+	while (length > 0) {
+		tmp = length;
+		ret = consume_data(replay, RECORD_WRITE, &data, &tmp);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+
+		/*
+		 * Differences of the written data are not treated as error
+		 * because they do not change the replayed responses.
+		 */
+		if (memcmp(buffer, data, tmp))
+			log_dbg(replay->ctx, "Replay: written data differs "
+				"from capture.");
+
+		buffer += tmp;
+		length -= tmp;
+	}
+
+	return JAYLINK_OK;
+}
+
+static int replay_read(void *user_data, uint8_t *buffer, size_t length)
+{
+	int ret;
+	struct replay *replay;
+	const uint8_t *data;
+	size_t tmp;
+
+	replay = user_data;
+
+	while (length > 0) {
+		tmp = length;
+		ret = consume_data(replay, RECORD_READ, &data, &tmp);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+
+		memcpy(buffer, data, tmp);
+		buffer += tmp;
+		length -= tmp;
+	}
+
+	return JAYLINK_OK;
+}
+
+static void replay_free(void *user_data)
+{
+	struct replay *replay;
+
+	replay = user_data;
+
+	free(replay->data);
+	free(replay);
+}
+
+static const struct jaylink_transport_ops replay_ops = {
+	.open = replay_open,
+	.close = NULL,
+	.start_write = replay_start_write,
+	.start_read = replay_start_read,
+	.start_write_read = replay_start_write_read,
+	.write = replay_write,
+	.read = replay_read,
+	.free = replay_free
+};
+
+static int read_file(struct jaylink_context *ctx, const char *filename,
+		uint8_t **data, size_t *size)
+{
+	FILE *file;
+	long length;
+	uint8_t *buffer;
+
+	file = fopen(filename, "rb");
+
+	if (!file) {
+		log_err(ctx, "Failed to open capture file: %s.", filename);
+		return JAYLINK_ERR_IO;
+	}
+
+	length = -1;
+
+	if (!fseek(file, 0, SEEK_END))
+		length = ftell(file);
+
+	if (length < 0 || fseek(file, 0, SEEK_SET)) {
+		log_err(ctx, "Failed to determine size of capture file.");
+		fclose(file);
+		return JAYLINK_ERR_IO;
+	}
+
+	buffer = malloc(length);
+
+	if (!buffer && length > 0) {
+		log_err(ctx, "Capture file buffer malloc failed.");
+		fclose(file);
+		return JAYLINK_ERR_MALLOC;
+	}
+
+	if (fread(buffer, 1, length, file) != (size_t)length) {
+		log_err(ctx, "Failed to read capture file.");
+		free(buffer);
+		fclose(file);
+		return JAYLINK_ERR_IO;
+	}
+
+	fclose(file);
+
+	*data = buffer;
+	*size = length;
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Create a device instance which replays a capture file.
+ *
+ * The device behaves like the captured device as long as the same transport
+ * operations are performed as during the capture. Operations are replayed
+ * without delay, the timestamps of the capture are not taken into account.
+ * Each time the device is opened, the replay starts at the beginning of the
+ * capture.
+ *
+ * An operation which does not match the capture fails with #JAYLINK_ERR_PROTO.
+ * Differences of the written data are tolerated.
+ *
+ * @param[in,out] ctx libjaylink context.
+ * @param[in] filename Name of the capture file.
+ * @param[out] dev Newly allocated device instance on success, and undefined
+ *                 on failure. The device instance must be freed by the caller
+ *                 with jaylink_unref_device().
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR_PROTO Invalid capture file.
+ *
+ * @see jaylink_capture_start()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_replay_device_new(struct jaylink_context *ctx,
+		const char *filename, struct jaylink_device **dev)
+{
+	int ret;
+	struct replay *replay;
+	uint8_t *data;
+	size_t size;
+
+	if (!ctx || !filename || !dev)
+		return JAYLINK_ERR_ARG;
+
+	ret = read_file(ctx, filename, &data, &size);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	if (size < CAPTURE_HEADER_SIZE ||
+			memcmp(data, CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE) ||
+			buffer_get_u32(data, CAPTURE_MAGIC_SIZE) !=
+			CAPTURE_VERSION) {
+		log_err(ctx, "Invalid capture file: %s.", filename);
+		free(data);
+		return JAYLINK_ERR_PROTO;
+	}
+
+	replay = malloc(sizeof(struct replay));
+
+	if (!replay) {
+		log_err(ctx, "Replay malloc failed.");
+		free(data);
+		return JAYLINK_ERR_MALLOC;
+	}
+
+	replay->ctx = ctx;
+	replay->data = data;
+	replay->size = size;
+	replay->pos = CAPTURE_HEADER_SIZE;
+	replay->length = 0;
+	replay->data_pos = 0;
+
+	ret = jaylink_transport_register(ctx, &replay_ops, replay, dev);
+
+	if (ret != JAYLINK_OK) {
+		free(data);
+		free(replay);
+	}
+
+	return ret;
+}
@@ -57,6 +57,22 @@
  * perspective and because there is only a single reason for failure which is
  * clearly distinguishable from the result.
  *
+ * @section sec_threads Thread safety
+ *
+ * libjaylink can be used by multiple threads at the same time. The device
+ * lists and the log settings of a context are protected by locks of the
+ * context, and the reference count of a device instance is maintained
+ * atomically.
+ *
+ * The operations on a device handle are serialized by a lock of the device
+ * handle. Different device handles can be used by different threads in
+ * parallel without blocking each other. A command queue must only be used by
+ * one thread at a time.
+ *
+ * The functions jaylink_init() and jaylink_exit() must not be called while
+ * the context is used by other threads. A device handle must not be used by
+ * other threads while it is closed.
+ *
  * @section sec_license Copyright and license
  *
  * libjaylink is licensed under the terms of the GNU General Public
@@ -134,6 +150,29 @@ JAYLINK_API int jaylink_init(struct jaylink_context **ctx)
 	context->devs = NULL;
 	context->discovered_devs = NULL;
 
+	if (!thread_mutex_init(&context->lock)) {
+#ifdef HAVE_LIBUSB
+		libusb_exit(context->usb_ctx);
+#endif
+#ifdef _WIN32
+		WSACleanup();
+#endif
+		free(context);
+		return JAYLINK_ERR;
+	}
+
+	if (!thread_mutex_init(&context->log_lock)) {
+		thread_mutex_destroy(&context->lock);
+#ifdef HAVE_LIBUSB
+		libusb_exit(context->usb_ctx);
+#endif
+#ifdef _WIN32
+		WSACleanup();
+#endif
+		free(context);
+		return JAYLINK_ERR;
+	}
+
 	/* Show error and warning messages by default. */
 	context->log_level = JAYLINK_LOG_LEVEL_WARNING;
 
@@ -143,6 +182,8 @@ JAYLINK_API int jaylink_init(struct jaylink_context **ctx)
 	ret = jaylink_log_set_domain(context, JAYLINK_LOG_DOMAIN_DEFAULT);
 
 	if (ret != JAYLINK_OK) {
+		thread_mutex_destroy(&context->log_lock);
+		thread_mutex_destroy(&context->lock);
 #ifdef HAVE_LIBUSB
 		libusb_exit(context->usb_ctx);
 #endif
@@ -185,6 +226,9 @@ JAYLINK_API int jaylink_exit(struct jaylink_context *ctx)
 	list_free(ctx->discovered_devs);
 	list_free(ctx->devs);
 
+	thread_mutex_destroy(&ctx->log_lock);
+	thread_mutex_destroy(&ctx->lock);
+
 #ifdef HAVE_LIBUSB
 	libusb_exit(ctx->usb_ctx);
 #endif
@@ -0,0 +1,1128 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "libjaylink.h"
+#include "libjaylink-internal.h"
+
+/**
+ * @file
+ *
+ * ARM Debug Access Port (DAP) transaction layer.
+ *
+ * The transaction layer encodes reads and writes of Debug Port (DP) and Access
+ * Port (AP) registers as ADIv5 Serial Wire Debug (SWD) packets. The packets of
+ * consecutive transactions are collected and transferred with a single SWD
+ * I/O operation when the transaction layer is flushed. Afterwards, the
+ * acknowledges and the parity of the read data are verified.
+ *
+ * With overrun detection of the DP enabled, the target performs the data phase
+ * of a transaction even if it is not acknowledged with OK and all subsequent
+ * transactions fail until the sticky overrun flag is cleared. This keeps the
+ * packets of a batch aligned such that the transactions starting with the
+ * first one acknowledged with WAIT are resubmitted after the flag is cleared.
+ * The number of idle cycles after each AP transaction is increased with every
+ * WAIT response and decreased again after a number of flushes without one to
+ * adapt to the access time of the target, see idle.c.
+ *
+ * Alternatively, the transactions are performed as scans of the DPACC and
+ * APACC scan chains of an ARM JTAG-DP, see dap_jtag.c.
+ */
+
+/** @cond PRIVATE */
+/** Number of bits of a packet request. */
+#define REQUEST_BITS		8
+
+/** Number of bits of a transaction with a single turnaround cycle. */
+#define TRANSACTION_BITS	46
+
+/** Offset of the acknowledge within a transaction in bits. */
+#define ACK_OFFSET		9
+
+/** Offset of the data of a read transaction in bits. */
+#define RDATA_OFFSET		12
+
+/** Number of host-driven high bits of a line reset. */
+#define LINE_RESET_BITS		56
+
+/** Number of idle cycles after a line reset. */
+#define LINE_RESET_IDLE_CYCLES	2
+
+/** Number of idle cycles at the end of the transferred transactions. */
+#define FLUSH_IDLE_CYCLES	8
+
+/** JTAG-to-SWD select sequence. */
+#define JTAG_TO_SWD		0xe79e
+#define JTAG_TO_SWD_BITS	16
+
+/** Maximum number of resubmissions per flush. */
+#define MAX_RETRIES		16
+
+/**
+ * Minimum number of bits per SWD I/O operation, rounded up to a multiple of 8
+ * bits. Operations are split between transactions only, so each of them must
+ * fit a transaction with the maximum number of idle cycles.
+ */
+#define MIN_CHUNK_LENGTH	((TRANSACTION_BITS + MAX_IDLE_CYCLES + 7) & ~7)
+
+/** Initial size of the SWD data buffers in bytes. */
+#define DAP_INITIAL_SIZE	64
+
+/** Initial number of transactions. */
+#define DAP_INITIAL_TRANSACTIONS	16
+
+#define ACK_OK			0x01
+#define ACK_WAIT		0x02
+#define ACK_FAULT		0x04
+
+#define REQUEST_START		(1 << 0)
+#define REQUEST_APNDP		(1 << 1)
+#define REQUEST_RNW		(1 << 2)
+#define REQUEST_PARITY		(1 << 5)
+#define REQUEST_PARK		(1 << 7)
+
+#define DP_ABORT		0x00
+#define DP_CTRL_STAT		0x04
+#define DP_SELECT		0x08
+#define DP_RDBUFF		0x0c
+
+#define ABORT_STKCMPCLR		(1 << 1)
+#define ABORT_STKERRCLR		(1 << 2)
+#define ABORT_WDERRCLR		(1 << 3)
+#define ABORT_ORUNERRCLR	(1 << 4)
+#define ABORT_ALL_CLR		(ABORT_STKCMPCLR | ABORT_STKERRCLR | \
+	ABORT_WDERRCLR | ABORT_ORUNERRCLR)
+
+#define CTRL_STAT_ORUNDETECT	(1 << 0)
+
+#define MEM_AP_CSW		0x00
+/** @endcond */
+
+/*
+ * Reserve space for the specified number of bits in the direction, output
+ * and input buffers.
+ */
+static int reserve_bits(struct jaylink_dap *dap, size_t length)
+{
+	uint8_t *direction;
+	uint8_t *out;
+	uint8_t *in;
+	size_t size;
+
+	size = (dap->length + length + 7) / 8;
+
+	if (size <= dap->size)
+		return JAYLINK_OK;
+
+	size = MAX(size, dap->size * 2);
+	direction = realloc(dap->direction, size);
+
+	if (!direction)
+		return JAYLINK_ERR_MALLOC;
+
+	dap->direction = direction;
+	out = realloc(dap->out, size);
+
+	if (!out)
+		return JAYLINK_ERR_MALLOC;
+
+	dap->out = out;
+	in = realloc(dap->in, size);
+
+	if (!in)
+		return JAYLINK_ERR_MALLOC;
+
+	dap->in = in;
+	dap->size = size;
+
+	return JAYLINK_OK;
+}
+
+/*
+ * Append bits without reserving space. Bits which are not driven by the host
+ * are sent as zero.
+ */
+static void append_bits(struct jaylink_dap *dap, bool host_drive,
+		uint64_t value, unsigned int length)
+{
+	jaylink_bitvec_fill(dap->direction, dap->length, host_drive, length);
+	jaylink_bitvec_set_field(dap->out, dap->length, value, length);
+	dap->length += length;
+}
+
+/*
+ * Add a transaction to the pending transactions. Returns the uninitialized
+ * transaction, or NULL on memory allocation error.
+ */
+JAYLINK_PRIV struct dap_transaction *dap_add_transaction(
+		struct jaylink_dap *dap)
+{
+	struct dap_transaction *transactions;
+	size_t size;
+
+	if (dap->num_transactions == dap->transactions_size) {
+		size = dap->transactions_size * 2;
+		transactions = realloc(dap->transactions,
+			size * sizeof(*transactions));
+
+		if (!transactions)
+			return NULL;
+
+		dap->transactions = transactions;
+		dap->transactions_size = size;
+	}
+
+	return &dap->transactions[dap->num_transactions++];
+}
+
+/*
+ * Save the state of the pending transactions. No transactions must be
+ * transferred until the state is restored or no longer needed.
+ */
+JAYLINK_PRIV void dap_save_queue(const struct jaylink_dap *dap,
+		struct dap_queue_state *state)
+{
+	state->length = dap->length;
+	state->num_transactions = dap->num_transactions;
+	state->read_pending = dap->read_pending;
+	state->pending_data = dap->pending_data;
+	state->select = dap->select;
+	state->select_valid = dap->select_valid;
+	state->csw_ap = dap->csw_ap;
+	state->csw = dap->csw;
+	state->csw_valid = dap->csw_valid;
+}
+
+/*
+ * Drop the transactions which were added after the state was saved, for
+ * example if a batch of transactions can not be completed. Their data
+ * buffers are no longer accessed afterwards.
+ */
+JAYLINK_PRIV void dap_restore_queue(struct jaylink_dap *dap,
+		const struct dap_queue_state *state)
+{
+	dap->length = state->length;
+	dap->num_transactions = state->num_transactions;
+	dap->read_pending = state->read_pending;
+	dap->pending_data = state->pending_data;
+	dap->select = state->select;
+	dap->select_valid = state->select_valid;
+	dap->csw_ap = state->csw_ap;
+	dap->csw = state->csw;
+	dap->csw_valid = state->csw_valid;
+}
+
+static int append_transaction(struct jaylink_dap *dap, bool ap, bool read,
+		uint8_t reg, uint32_t value, uint32_t *data)
+{
+	int ret;
+	struct dap_transaction *transaction;
+	size_t length;
+	uint8_t request;
+
+	if (dap->scan)
+		return dap_jtag_append(dap, ap, read, reg, value, data);
+
+	length = TRANSACTION_BITS;
+
+	/* Give the AP time to complete the access. */
+	if (ap)
+		length += dap->idle.cycles;
+
+	ret = reserve_bits(dap, length);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	transaction = dap_add_transaction(dap);
+
+	if (!transaction)
+		return JAYLINK_ERR_MALLOC;
+
+	request = REQUEST_START | REQUEST_PARK | ((reg & 0x0c) << 1);
+
+	if (ap)
+		request |= REQUEST_APNDP;
+
+	if (read)
+		request |= REQUEST_RNW;
+
+	if (jaylink_bitvec_parity(&request, 1, 4))
+		request |= REQUEST_PARITY;
+
+	transaction->request = request;
+	transaction->offset = dap->length;
+	transaction->length = length;
+	transaction->value = value;
+	transaction->data = data;
+
+	append_bits(dap, true, request, REQUEST_BITS);
+
+	if (read) {
+		/* Turnaround, acknowledge, data, parity and turnaround. */
+		append_bits(dap, false, 0, 38);
+	} else {
+		/* Turnaround, acknowledge and turnaround. */
+		append_bits(dap, false, 0, 5);
+		append_bits(dap, true, value, 32);
+		append_bits(dap, true, __builtin_parity(value), 1);
+	}
+
+	jaylink_bitvec_fill(dap->direction, dap->length, true,
+		length - TRANSACTION_BITS);
+	jaylink_bitvec_fill(dap->out, dap->length, false,
+		length - TRANSACTION_BITS);
+	dap->length += length - TRANSACTION_BITS;
+
+	return JAYLINK_OK;
+}
+
+/* Read DP RDBUFF to retrieve the result of the pending AP read, if any. */
+static int finish_posted_read(struct jaylink_dap *dap)
+{
+	int ret;
+
+	if (!dap->read_pending)
+		return JAYLINK_OK;
+
+	ret = append_transaction(dap, false, true, DP_RDBUFF, 0,
+		dap->pending_data);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	dap->read_pending = false;
+
+	return JAYLINK_OK;
+}
+
+static int select_register(struct jaylink_dap *dap, uint8_t ap, uint8_t reg)
+{
+	int ret;
+	uint32_t select;
+
+	select = ((uint32_t)ap << 24) | (reg & 0xf0);
+
+	if (dap->select_valid && dap->select == select)
+		return JAYLINK_OK;
+
+	ret = finish_posted_read(dap);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	ret = append_transaction(dap, false, false, DP_SELECT, select, NULL);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	dap->select = select;
+	dap->select_valid = true;
+
+	return JAYLINK_OK;
+}
+
+static void discard_transactions(struct jaylink_dap *dap)
+{
+	dap->length = 0;
+	dap->num_transactions = 0;
+	dap->read_pending = false;
+}
+
+/*
+ * Perform a SWD I/O operation with the bits of the pending transactions
+ * starting at the specified position. Bits which do not start at a byte
+ * boundary are copied into temporary buffers.
+ */
+static int transfer_bits(struct jaylink_dap *dap, size_t pos, size_t length)
+{
+	int ret;
+	uint8_t *buffer;
+	size_t num_bytes;
+
+	if (!(pos % 8))
+		return jaylink_swd_io(dap->devh, dap->direction + pos / 8,
+			dap->out + pos / 8, dap->in + pos / 8, length);
+
+	num_bytes = (length + 7) / 8;
+	buffer = malloc(3 * num_bytes);
+
+	if (!buffer)
+		return JAYLINK_ERR_MALLOC;
+
+	jaylink_bitvec_copy(buffer, 0, dap->direction, pos, length);
+	jaylink_bitvec_copy(buffer + num_bytes, 0, dap->out, pos, length);
+
+	ret = jaylink_swd_io(dap->devh, buffer, buffer + num_bytes,
+		buffer + 2 * num_bytes, length);
+
+	if (ret == JAYLINK_OK)
+		jaylink_bitvec_copy(dap->in, pos, buffer + 2 * num_bytes, 0,
+			length);
+
+	free(buffer);
+
+	return ret;
+}
+
+/*
+ * Transfer the bits of the pending transactions with as few SWD I/O
+ * operations as possible. Operations are split between transactions only.
+ */
+static int transfer_transactions(struct jaylink_dap *dap)
+{
+	int ret;
+	const struct dap_transaction *transaction;
+	size_t pos;
+	size_t end;
+	size_t i;
+
+	pos = 0;
+	i = 0;
+
+	while (pos < dap->length) {
+		end = MIN(dap->length, pos + dap->chunk_length);
+
+		while (i < dap->num_transactions) {
+			transaction = &dap->transactions[i];
+
+			if (transaction->offset + transaction->length > end)
+				break;
+
+			i++;
+		}
+
+		if (i < dap->num_transactions &&
+				dap->transactions[i].offset < end)
+			end = dap->transactions[i].offset;
+
+		ret = transfer_bits(dap, pos, end - pos);
+
+		if (ret == JAYLINK_ERR_DEV_NO_MEMORY &&
+				dap->chunk_length > MIN_CHUNK_LENGTH) {
+			/* Round down to a multiple of 8 bits. */
+			dap->chunk_length = MAX((dap->chunk_length / 2) & ~7,
+				MIN_CHUNK_LENGTH);
+			i = 0;
+			continue;
+		}
+
+		if (ret != JAYLINK_OK)
+			return ret;
+
+		pos = end;
+	}
+
+	return JAYLINK_OK;
+}
+
+/*
+ * Verify the acknowledges and the parity of the read data of the transferred
+ * transactions. On failure, the index of the failed transaction is stored.
+ */
+static int check_transactions(struct jaylink_dap *dap, size_t *index)
+{
+	struct jaylink_context *ctx;
+	const struct dap_transaction *transaction;
+	uint32_t value;
+	uint8_t ack;
+	bool parity;
+	size_t i;
+
+	ctx = dap->devh->dev->ctx;
+
+	for (i = 0; i < dap->num_transactions; i++) {
+		transaction = &dap->transactions[i];
+		ack = jaylink_bitvec_get_field(dap->in,
+			transaction->offset + ACK_OFFSET, 3);
+
+		*index = i;
+
+		if (ack != ACK_OK) {
+			log_dbg(ctx, "Transaction %zu (request 0x%02x) "
+				"failed with acknowledge 0x%x.", i,
+				transaction->request, ack);
+
+			if (ack == ACK_WAIT)
+				return JAYLINK_ERR_TARGET_WAIT;
+			else if (ack == ACK_FAULT)
+				return JAYLINK_ERR_TARGET_FAULT;
+
+			return JAYLINK_ERR_TARGET;
+		}
+
+		if (!(transaction->request & REQUEST_RNW))
+			continue;
+
+		value = jaylink_bitvec_get_field(dap->in,
+			transaction->offset + RDATA_OFFSET, 32);
+		parity = jaylink_bitvec_get_field(dap->in,
+			transaction->offset + RDATA_OFFSET + 32, 1);
+
+		if (jaylink_bitvec_parity(dap->in,
+				transaction->offset + RDATA_OFFSET, 32) != parity) {
+			log_dbg(ctx, "Transaction %zu (request 0x%02x) "
+				"failed with parity error.", i,
+				transaction->request);
+			return JAYLINK_ERR_TARGET_PARITY;
+		}
+
+		if (transaction->data)
+			*transaction->data = value;
+	}
+
+	return JAYLINK_OK;
+}
+
+/* Append bits copied from the specified direction and output buffers. */
+static int copy_bits(struct jaylink_dap *dap, const uint8_t *direction,
+		const uint8_t *out, size_t pos, size_t length)
+{
+	int ret;
+
+	ret = reserve_bits(dap, length);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	jaylink_bitvec_copy(dap->direction, dap->length, direction, pos,
+		length);
+	jaylink_bitvec_copy(dap->out, dap->length, out, pos, length);
+	dap->length += length;
+
+	return JAYLINK_OK;
+}
+
+/*
+ * Replace the pending transactions with a write of the DP ABORT register
+ * followed by the transactions starting at the specified index. The
+ * transactions are encoded again with the current number of idle cycles, the
+ * bits between them are copied.
+ */
+static int resubmit_transactions(struct jaylink_dap *dap, size_t index,
+		uint32_t abort)
+{
+	int ret;
+	struct dap_transaction *transactions;
+	const struct dap_transaction *transaction;
+	uint8_t *direction;
+	uint8_t *out;
+	uint8_t *in;
+	size_t length;
+	size_t num_transactions;
+	size_t pos;
+	size_t i;
+
+	direction = dap->direction;
+	out = dap->out;
+	in = dap->in;
+	transactions = dap->transactions;
+	length = dap->length;
+	num_transactions = dap->num_transactions;
+
+	dap->direction = malloc(dap->size);
+	dap->out = malloc(dap->size);
+	dap->in = malloc(dap->size);
+	dap->transactions = malloc(dap->transactions_size *
+		sizeof(struct dap_transaction));
+
+	if (!dap->direction || !dap->out || !dap->in || !dap->transactions) {
+		free(dap->direction);
+		free(dap->out);
+		free(dap->in);
+		free(dap->transactions);
+		dap->direction = direction;
+		dap->out = out;
+		dap->in = in;
+		dap->transactions = transactions;
+		return JAYLINK_ERR_MALLOC;
+	}
+
+	dap->length = 0;
+	dap->num_transactions = 0;
+
+	ret = append_transaction(dap, false, false, DP_ABORT, abort, NULL);
+	pos = length;
+
+	if (index < num_transactions)
+		pos = transactions[index].offset;
+
+	for (i = index; i < num_transactions; i++) {
+		if (ret != JAYLINK_OK)
+			break;
+
+		transaction = &transactions[i];
+		ret = copy_bits(dap, direction, out, pos,
+			transaction->offset - pos);
+
+		if (ret == JAYLINK_OK)
+			ret = append_transaction(dap,
+				transaction->request & REQUEST_APNDP,
+				transaction->request & REQUEST_RNW,
+				(transaction->request >> 1) & 0x0c,
+				transaction->value, transaction->data);
+
+		pos = transaction->offset + transaction->length;
+	}
+
+	if (ret == JAYLINK_OK)
+		ret = copy_bits(dap, direction, out, pos, length - pos);
+
+	free(direction);
+	free(out);
+	free(in);
+	free(transactions);
+
+	return ret;
+}
+
+/*
+ * Clear the sticky error flags such that the target accepts transactions
+ * again. The failed transactions are not resubmitted.
+ */
+static void clear_sticky_errors(struct jaylink_dap *dap)
+{
+	size_t index;
+
+	if (resubmit_transactions(dap, dap->num_transactions,
+			ABORT_ALL_CLR) != JAYLINK_OK)
+		return;
+
+	/* End the write of the ABORT register like any other flush. */
+	if (jaylink_dap_idle(dap, FLUSH_IDLE_CYCLES) != JAYLINK_OK)
+		return;
+
+	if (transfer_transactions(dap) == JAYLINK_OK)
+		check_transactions(dap, &index);
+}
+
+/*
+ * Transfer and verify the pending transactions. Transactions acknowledged
+ * with WAIT are resubmitted with an increased number of idle cycles if
+ * overrun detection is enabled.
+ */
+static int perform_transactions(struct jaylink_dap *dap)
+{
+	int ret;
+	struct jaylink_context *ctx;
+	size_t index;
+	size_t retries;
+
+	ctx = dap->devh->dev->ctx;
+	retries = 0;
+
+	while (true) {
+		ret = transfer_transactions(dap);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+
+		ret = check_transactions(dap, &index);
+
+		if (ret != JAYLINK_ERR_TARGET_WAIT || !dap->overrun_detect ||
+				retries == MAX_RETRIES)
+			break;
+
+		idle_busy(&dap->idle);
+		log_dbg(ctx, "Resubmitting %zu transaction(s) with %zu idle "
+			"cycle(s).", dap->num_transactions - index,
+			dap->idle.cycles);
+
+		ret = resubmit_transactions(dap, index, ABORT_ORUNERRCLR);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+
+		retries++;
+	}
+
+	if (ret == JAYLINK_OK)
+		idle_success(&dap->idle);
+
+	if (ret == JAYLINK_ERR_TARGET_FAULT && dap->overrun_detect)
+		clear_sticky_errors(dap);
+
+	return ret;
+}
+
+/**
+ * Create a DAP transaction layer.
+ *
+ * The transaction layer uses the SWD interface of the device.
+ *
+ * @param[in,out] devh Device handle. It must remain valid until the
+ *                     transaction layer is freed.
+ * @param[out] dap Newly allocated transaction layer on success. Its content
+ *                 is undefined on failure.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @see jaylink_dap_new_jtag()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_dap_new(struct jaylink_device_handle *devh,
+		struct jaylink_dap **dap)
+{
+	struct jaylink_dap *tmp;
+
+	if (!devh || !dap)
+		return JAYLINK_ERR_ARG;
+
+	tmp = malloc(sizeof(struct jaylink_dap));
+
+	if (!tmp)
+		return JAYLINK_ERR_MALLOC;
+
+	tmp->direction = malloc(DAP_INITIAL_SIZE);
+	tmp->out = malloc(DAP_INITIAL_SIZE);
+	tmp->in = malloc(DAP_INITIAL_SIZE);
+	tmp->transactions = malloc(DAP_INITIAL_TRANSACTIONS *
+		sizeof(struct dap_transaction));
+
+	if (!tmp->direction || !tmp->out || !tmp->in || !tmp->transactions) {
+		free(tmp->direction);
+		free(tmp->out);
+		free(tmp->in);
+		free(tmp->transactions);
+		free(tmp);
+		return JAYLINK_ERR_MALLOC;
+	}
+
+	tmp->devh = devh;
+	tmp->scan = NULL;
+	tmp->tap = 0;
+	tmp->ir = 0;
+	tmp->length = 0;
+	tmp->size = DAP_INITIAL_SIZE;
+	tmp->num_transactions = 0;
+	tmp->transactions_size = DAP_INITIAL_TRANSACTIONS;
+	tmp->read_pending = false;
+	tmp->pending_data = NULL;
+	tmp->select = 0;
+	tmp->select_valid = false;
+	tmp->chunk_length = UINT16_MAX & ~7;
+	tmp->csw_ap = 0;
+	tmp->csw = 0;
+	tmp->csw_valid = false;
+	idle_init(&tmp->idle, 0);
+	tmp->overrun_detect = false;
+	tmp->ctrl_stat = 0;
+
+	*dap = tmp;
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Free a DAP transaction layer.
+ *
+ * Pending transactions are discarded.
+ *
+ * @param[in,out] dap Transaction layer. If NULL, the function does nothing.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API void jaylink_dap_free(struct jaylink_dap *dap)
+{
+	if (!dap)
+		return;
+
+	free(dap->transactions);
+	free(dap->direction);
+	free(dap->out);
+	free(dap->in);
+	free(dap);
+}
+
+/**
+ * Perform a line reset.
+ *
+ * The line reset is preceded by the JTAG-to-SWD select sequence such that
+ * SWJ-DPs switch to SWD. After a line reset, the target expects a read of the
+ * DP IDCODE register.
+ *
+ * For a JTAG-DP, no bits are transferred. Only the cached value of the DP
+ * SELECT register is invalidated.
+ *
+ * @param[in,out] dap Transaction layer.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_dap_line_reset(struct jaylink_dap *dap)
+{
+	int ret;
+
+	if (!dap)
+		return JAYLINK_ERR_ARG;
+
+	if (dap->scan) {
+		dap->select_valid = false;
+		return JAYLINK_OK;
+	}
+
+	ret = finish_posted_read(dap);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	ret = reserve_bits(dap, 2 * LINE_RESET_BITS + JTAG_TO_SWD_BITS +
+		LINE_RESET_IDLE_CYCLES);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	append_bits(dap, true, UINT64_MAX, LINE_RESET_BITS);
+	append_bits(dap, true, JTAG_TO_SWD, JTAG_TO_SWD_BITS);
+	append_bits(dap, true, UINT64_MAX, LINE_RESET_BITS);
+	append_bits(dap, true, 0, LINE_RESET_IDLE_CYCLES);
+
+	/* The SELECT register is not affected but its value may be unknown. */
+	dap->select_valid = false;
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Insert idle cycles.
+ *
+ * For a JTAG-DP, the TAP controllers stay in the Run-Test/Idle state.
+ *
+ * @param[in,out] dap Transaction layer.
+ * @param[in] num_cycles Number of idle cycles.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_dap_idle(struct jaylink_dap *dap, size_t num_cycles)
+{
+	int ret;
+
+	if (!dap)
+		return JAYLINK_ERR_ARG;
+
+	if (dap->scan)
+		return dap_jtag_idle(dap, num_cycles);
+
+	ret = reserve_bits(dap, num_cycles);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	jaylink_bitvec_fill(dap->direction, dap->length, true, num_cycles);
+	jaylink_bitvec_fill(dap->out, dap->length, false, num_cycles);
+	dap->length += num_cycles;
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Read a DP register.
+ *
+ * The buffer must remain valid until the transaction layer is flushed.
+ *
+ * @param[in,out] dap Transaction layer.
+ * @param[in] reg Address of the register: 0x0, 0x4, 0x8 or 0xc.
+ * @param[out] value Buffer to store the value of the register when the
+ *                   transaction layer is flushed successfully, or NULL.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_dap_dp_read(struct jaylink_dap *dap, uint8_t reg,
+		uint32_t *value)
+{
+	int ret;
+
+	if (!dap || (reg & ~0x0c))
+		return JAYLINK_ERR_ARG;
+
+	ret = finish_posted_read(dap);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	return append_transaction(dap, false, true, reg, 0, value);
+}
+
+/**
+ * Write a DP register.
+ *
+ * Overrun detection is enabled with every write of the CTRL/STAT register such
+ * that transactions acknowledged with WAIT can be resubmitted.
+ *
+ * @param[in,out] dap Transaction layer.
+ * @param[in] reg Address of the register: 0x0, 0x4, 0x8 or 0xc.
+ * @param[in] value Value to write.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_dap_dp_write(struct jaylink_dap *dap, uint8_t reg,
+		uint32_t value)
+{
+	int ret;
+
+	if (!dap || (reg & ~0x0c))
+		return JAYLINK_ERR_ARG;
+
+	ret = finish_posted_read(dap);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	if (reg == DP_CTRL_STAT)
+		value |= CTRL_STAT_ORUNDETECT;
+
+	ret = append_transaction(dap, false, false, reg, value, NULL);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	if (reg == DP_CTRL_STAT) {
+		dap->ctrl_stat = value;
+		dap->overrun_detect = true;
+	}
+
+	if (reg == DP_SELECT) {
+		dap->select = value;
+		dap->select_valid = true;
+	}
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Read an AP register.
+ *
+ * The DP SELECT register is written if necessary. AP reads are posted, the
+ * result is retrieved with the next AP read or with an additional read of
+ * the DP RDBUFF register. The buffer must remain valid until the transaction
+ * layer is flushed.
+ *
+ * @param[in,out] dap Transaction layer.
+ * @param[in] ap Number of the AP.
+ * @param[in] reg Address of the register, a multiple of 4.
+ * @param[out] value Buffer to store the value of the register when the
+ *                   transaction layer is flushed successfully, or NULL.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_dap_ap_read(struct jaylink_dap *dap, uint8_t ap,
+		uint8_t reg, uint32_t *value)
+{
+	int ret;
+	uint32_t *data;
+
+	if (!dap || (reg & 0x03))
+		return JAYLINK_ERR_ARG;
+
+	ret = select_register(dap, ap, reg);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	/* The JTAG-DP layer takes care of posted reads itself. */
+	if (dap->scan)
+		return append_transaction(dap, true, true, reg, 0, value);
+
+	data = NULL;
+
+	/* The read returns the result of the previous AP read. */
+	if (dap->read_pending)
+		data = dap->pending_data;
+
+	ret = append_transaction(dap, true, true, reg, 0, data);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	dap->read_pending = true;
+	dap->pending_data = value;
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Write an AP register.
+ *
+ * The DP SELECT register is written if necessary.
+ *
+ * @param[in,out] dap Transaction layer.
+ * @param[in] ap Number of the AP.
+ * @param[in] reg Address of the register, a multiple of 4.
+ * @param[in] value Value to write.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_dap_ap_write(struct jaylink_dap *dap, uint8_t ap,
+		uint8_t reg, uint32_t value)
+{
+	int ret;
+
+	if (!dap || (reg & 0x03))
+		return JAYLINK_ERR_ARG;
+
+	ret = finish_posted_read(dap);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	ret = select_register(dap, ap, reg);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	/* The register may be the CSW register of a MEM-AP. */
+	if (reg == MEM_AP_CSW && ap == dap->csw_ap)
+		dap->csw_valid = false;
+
+	return append_transaction(dap, true, false, reg, value, NULL);
+}
+
+/**
+ * Transfer the pending transactions of a DAP transaction layer to the device.
+ *
+ * The transactions are transferred with a single SWD I/O operation, unless
+ * they exceed the size of a SWD I/O operation. Afterwards, the acknowledges
+ * and the parity of the read data of all transactions are verified in order.
+ * The results of the transactions before the first failed transaction are
+ * stored. Transactions after a failed transaction are performed but their
+ * result is undefined.
+ *
+ * If overrun detection is enabled, the transactions starting with the first
+ * one acknowledged with WAIT are resubmitted after the sticky overrun flag is
+ * cleared. After a FAULT response, all sticky error flags are cleared.
+ *
+ * For a JTAG-DP, the transactions are transferred with a single JTAG I/O
+ * operation of the scan engine instead. Failed AP accesses are detected with
+ * a read of the DP CTRL/STAT register at the end and reported as FAULT.
+ *
+ * @param[in,out] dap Transaction layer.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR_DEV_NO_MEMORY Not enough memory on the device to perform
+ *                                   the operation.
+ * @retval JAYLINK_ERR_DEV Unspecified device error.
+ * @retval JAYLINK_ERR_TARGET_WAIT A transaction was acknowledged with WAIT.
+ * @retval JAYLINK_ERR_TARGET_FAULT A transaction was acknowledged with FAULT.
+ * @retval JAYLINK_ERR_TARGET_PARITY Parity error in the read data.
+ * @retval JAYLINK_ERR_TARGET No or invalid acknowledge.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @see jaylink_swd_io()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_dap_flush(struct jaylink_dap *dap)
+{
+	int ret;
+
+	if (!dap)
+		return JAYLINK_ERR_ARG;
+
+	ret = finish_posted_read(dap);
+
+	if (ret != JAYLINK_OK) {
+		discard_transactions(dap);
+		return ret;
+	}
+
+	if (dap->scan) {
+		ret = dap_jtag_flush(dap);
+	} else {
+		if (!dap->length)
+			return JAYLINK_OK;
+
+		ret = jaylink_dap_idle(dap, FLUSH_IDLE_CYCLES);
+
+		if (ret == JAYLINK_OK)
+			ret = perform_transactions(dap);
+	}
+
+	/*
+	 * The writes of the SELECT and CSW registers may have failed without
+	 * being detected otherwise.
+	 */
+	if (ret != JAYLINK_OK) {
+		dap->select_valid = false;
+		dap->csw_valid = false;
+	}
+
+	discard_transactions(dap);
+
+	return ret;
+}
+
+/**
+ * Retrieve the statistics of the adaptive idle cycles of a DAP access layer.
+ *
+ * The number of idle cycles after each AP transaction is doubled whenever the
+ * target responds with WAIT and decreased again after a number of flushes
+ * without such a response.
+ *
+ * @param[in] dap Access layer.
+ * @param[out] stats Statistics on success, and undefined on failure.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_dap_get_idle_stats(const struct jaylink_dap *dap,
+		struct jaylink_idle_stats *stats)
+{
+	if (!dap || !stats)
+		return JAYLINK_ERR_ARG;
+
+	idle_get_stats(&dap->idle, stats);
+
+	return JAYLINK_OK;
+}
@@ -0,0 +1,390 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "libjaylink.h"
+#include "libjaylink-internal.h"
+
+/**
+ * @file
+ *
+ * DAP transaction layer for ARM JTAG-DPs.
+ *
+ * Each transaction is performed as a 35-bit scan of the DPACC or APACC scan
+ * chain. The instruction register is scanned only if the scan chain changes.
+ * All scans of a flush are transferred with a single JTAG I/O operation.
+ *
+ * A scan captures the acknowledge of the previous access together with its
+ * read result. WAIT indicates that the previous access is still in progress
+ * and that the request of the scan is ignored. Errors of AP accesses are not
+ * indicated by the acknowledge but by the sticky error flag of the CTRL/STAT
+ * register, which is read at the end of every flush.
+ *
+ * With overrun detection enabled, all accesses after a WAIT response are
+ * ignored until the sticky overrun flag is cleared. The scans starting with
+ * the first one acknowledged with WAIT are resubmitted after the flag is
+ * cleared, with an increased number of idle cycles after each AP access.
+ */
+
+/** @cond PRIVATE */
+/** Instruction register length of a JTAG-DP in bits. */
+#define IR_LENGTH		4
+
+#define IR_DPACC		0x0a
+#define IR_APACC		0x0b
+
+/** Number of bits of a DPACC or APACC scan. */
+#define SCAN_BITS		35
+
+/** Number of bytes reserved for a scan in the TDI and TDO buffers. */
+#define SCAN_BYTES		5
+
+#define ACK_WAIT		0x01
+#define ACK_OK_FAULT		0x02
+
+#define REQUEST_RNW		(1 << 0)
+#define REQUEST_APNDP		(1 << 3)
+
+#define DP_CTRL_STAT		0x04
+#define DP_RDBUFF		0x0c
+
+#define CTRL_STAT_STICKYORUN	(1 << 1)
+#define CTRL_STAT_STICKYCMP	(1 << 4)
+#define CTRL_STAT_STICKYERR	(1 << 5)
+
+/** Maximum number of resubmissions per flush. */
+#define MAX_RETRIES		16
+/** @endcond */
+
+/*
+ * Transfer the pending scans with a single JTAG I/O operation and verify
+ * their acknowledges. The read result captured by the first scan is stored
+ * in the specified buffer, or discarded if NULL. On a WAIT response, the
+ * index of the failed scan is stored.
+ */
+static int perform_scans(struct jaylink_dap *dap, uint32_t *first_data,
+		size_t leading_idle, size_t *index)
+{
+	int ret;
+	struct jaylink_context *ctx;
+	const struct dap_transaction *transaction;
+	uint8_t *tdi;
+	uint8_t *tdo;
+	uint32_t *data;
+	size_t idle;
+	uint8_t ir;
+	uint8_t ack;
+	size_t i;
+
+	ctx = dap->devh->dev->ctx;
+	tdi = malloc(dap->num_transactions * SCAN_BYTES);
+	tdo = malloc(dap->num_transactions * SCAN_BYTES);
+
+	if (!tdi || !tdo) {
+		free(tdi);
+		free(tdo);
+		return JAYLINK_ERR_MALLOC;
+	}
+
+	ret = jaylink_jtag_scan_select_tap(dap->scan, dap->tap);
+
+	if (ret == JAYLINK_OK && leading_idle > 0)
+		ret = jaylink_jtag_scan_idle(dap->scan, leading_idle);
+
+	for (i = 0; i < dap->num_transactions; i++) {
+		if (ret != JAYLINK_OK)
+			break;
+
+		transaction = &dap->transactions[i];
+		ir = IR_DPACC;
+
+		if (transaction->request & REQUEST_APNDP)
+			ir = IR_APACC;
+
+		if (dap->ir != ir) {
+			ret = jaylink_jtag_scan_ir(dap->scan, &ir, NULL,
+				JAYLINK_TAP_STATE_IDLE);
+
+			if (ret != JAYLINK_OK)
+				break;
+
+			dap->ir = ir;
+		}
+
+		jaylink_bitvec_set_field(tdi + i * SCAN_BYTES, 0,
+			(transaction->request & 0x07) |
+			((uint64_t)transaction->value << 3), SCAN_BITS);
+		ret = jaylink_jtag_scan_dr(dap->scan, tdi + i * SCAN_BYTES,
+			tdo + i * SCAN_BYTES, SCAN_BITS,
+			JAYLINK_TAP_STATE_IDLE);
+
+		if (ret != JAYLINK_OK)
+			break;
+
+		/* Give the AP time to complete the access. */
+		idle = transaction->length - SCAN_BITS;
+
+		if (transaction->request & REQUEST_APNDP)
+			idle += dap->idle.cycles;
+
+		if (idle > 0)
+			ret = jaylink_jtag_scan_idle(dap->scan, idle);
+	}
+
+	if (ret == JAYLINK_OK)
+		ret = jaylink_jtag_scan_flush(dap->scan);
+
+	if (ret != JAYLINK_OK) {
+		dap->ir = 0;
+		free(tdi);
+		free(tdo);
+		return ret;
+	}
+
+	data = first_data;
+
+	for (i = 0; i < dap->num_transactions; i++) {
+		transaction = &dap->transactions[i];
+		ack = jaylink_bitvec_get_field(tdo + i * SCAN_BYTES, 0, 3);
+
+		if (ack != ACK_OK_FAULT) {
+			log_dbg(ctx, "Scan %zu (request 0x%02x) failed with "
+				"acknowledge 0x%x.", i, transaction->request,
+				ack);
+			*index = i;
+			free(tdi);
+			free(tdo);
+
+			if (ack == ACK_WAIT)
+				return JAYLINK_ERR_TARGET_WAIT;
+
+			return JAYLINK_ERR_TARGET;
+		}
+
+		/* The scan captures the read result of the previous access. */
+		if (data)
+			*data = jaylink_bitvec_get_field(tdo + i * SCAN_BYTES,
+				3, 32);
+
+		data = transaction->data;
+	}
+
+	free(tdi);
+	free(tdo);
+
+	return JAYLINK_OK;
+}
+
+/*
+ * Replace the pending scans with a write of the DP CTRL/STAT register,
+ * which clears the specified sticky flags, followed by the scans starting at
+ * the specified index.
+ */
+static int resubmit_scans(struct jaylink_dap *dap, size_t index,
+		uint32_t flags)
+{
+	struct dap_transaction *transaction;
+	size_t num_transactions;
+
+	num_transactions = dap->num_transactions;
+
+	if (!index && !dap_add_transaction(dap))
+		return JAYLINK_ERR_MALLOC;
+
+	memmove(dap->transactions + 1, dap->transactions + index,
+		(num_transactions - index) * sizeof(struct dap_transaction));
+	dap->num_transactions = num_transactions - index + 1;
+
+	transaction = &dap->transactions[0];
+	transaction->request = (DP_CTRL_STAT >> 1);
+	transaction->offset = 0;
+	transaction->length = SCAN_BITS;
+	transaction->value = dap->ctrl_stat | flags;
+	transaction->data = NULL;
+
+	return JAYLINK_OK;
+}
+
+JAYLINK_PRIV int dap_jtag_append(struct jaylink_dap *dap, bool ap, bool read,
+		uint8_t reg, uint32_t value, uint32_t *data)
+{
+	struct dap_transaction *transaction;
+
+	transaction = dap_add_transaction(dap);
+
+	if (!transaction)
+		return JAYLINK_ERR_MALLOC;
+
+	transaction->request = (reg & 0x0c) >> 1;
+
+	if (ap)
+		transaction->request |= REQUEST_APNDP;
+
+	if (read)
+		transaction->request |= REQUEST_RNW;
+
+	transaction->offset = 0;
+	transaction->length = SCAN_BITS;
+	transaction->value = value;
+	transaction->data = data;
+
+	return JAYLINK_OK;
+}
+
+JAYLINK_PRIV int dap_jtag_idle(struct jaylink_dap *dap, size_t num_cycles)
+{
+	/* Idle cycles before the first scan are queued directly. */
+	if (!dap->num_transactions)
+		return jaylink_jtag_scan_idle(dap->scan, num_cycles);
+
+	dap->transactions[dap->num_transactions - 1].length += num_cycles;
+
+	return JAYLINK_OK;
+}
+
+JAYLINK_PRIV int dap_jtag_flush(struct jaylink_dap *dap)
+{
+	int ret;
+	struct jaylink_context *ctx;
+	uint32_t *first_data;
+	uint32_t ctrl_stat;
+	size_t leading_idle;
+	size_t index;
+	size_t retries;
+
+	ctx = dap->devh->dev->ctx;
+
+	if (!dap->num_transactions)
+		return jaylink_jtag_scan_flush(dap->scan);
+
+	/* Check for errors of the AP accesses. */
+	ret = dap_jtag_append(dap, false, true, DP_CTRL_STAT, 0, &ctrl_stat);
+
+	if (ret == JAYLINK_OK)
+		ret = dap_jtag_append(dap, false, true, DP_RDBUFF, 0, NULL);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	first_data = NULL;
+	leading_idle = 0;
+	retries = 0;
+
+	while (true) {
+		ret = perform_scans(dap, first_data, leading_idle, &index);
+
+		if (ret != JAYLINK_ERR_TARGET_WAIT || !dap->overrun_detect ||
+				retries == MAX_RETRIES)
+			break;
+
+		idle_busy(&dap->idle);
+		log_dbg(ctx, "Resubmitting %zu scan(s) with %zu idle cycle(s).",
+			dap->num_transactions - index, dap->idle.cycles);
+
+		/*
+		 * The read result of the scan before the failed one is
+		 * captured by the write of the CTRL/STAT register.
+		 */
+		if (index > 0)
+			first_data = dap->transactions[index - 1].data;
+
+		/* The failed scan already is a write of CTRL/STAT. */
+		if (!index && retries > 0)
+			ret = JAYLINK_OK;
+		else
+			ret = resubmit_scans(dap, index,
+				CTRL_STAT_STICKYORUN);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+
+		leading_idle = dap->idle.cycles;
+		retries++;
+	}
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	idle_success(&dap->idle);
+
+	if (!(ctrl_stat & CTRL_STAT_STICKYERR))
+		return JAYLINK_OK;
+
+	log_dbg(ctx, "AP access failed, CTRL/STAT 0x%08x.", ctrl_stat);
+
+	/* Clear the sticky error flags such that APs are accessible again. */
+	ret = resubmit_scans(dap, dap->num_transactions,
+		CTRL_STAT_STICKYORUN | CTRL_STAT_STICKYCMP |
+		CTRL_STAT_STICKYERR);
+
+	if (ret == JAYLINK_OK)
+		perform_scans(dap, NULL, 0, &index);
+
+	return JAYLINK_ERR_TARGET_FAULT;
+}
+
+/**
+ * Create a DAP transaction layer for a JTAG-DP.
+ *
+ * The selected TAP of the scan engine is used as ARM JTAG-DP. The
+ * transactions are transferred with the scan engine when the transaction
+ * layer is flushed, together with the pending operations of the scan engine.
+ * Unlike with SWD, the read results of all transactions are posted. They are
+ * retrieved with the next scan, which is either the next transaction or an
+ * additional read of the DP RDBUFF register.
+ *
+ * @param[in,out] scan Scan engine. It must remain valid until the transaction
+ *                     layer is freed.
+ * @param[out] dap Newly allocated transaction layer on success. Its content
+ *                 is undefined on failure.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @see jaylink_jtag_scan_set_chain()
+ * @see jaylink_jtag_scan_select_tap()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_dap_new_jtag(struct jaylink_jtag_scan *scan,
+		struct jaylink_dap **dap)
+{
+	int ret;
+
+	if (!scan || !dap)
+		return JAYLINK_ERR_ARG;
+
+	if (!scan->num_taps || scan->ir_lengths[scan->tap] != IR_LENGTH)
+		return JAYLINK_ERR_ARG;
+
+	ret = jaylink_dap_new(scan->devh, dap);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	(*dap)->scan = scan;
+	(*dap)->tap = scan->tap;
+
+	return JAYLINK_OK;
+}
@@ -0,0 +1,391 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "libjaylink.h"
+#include "libjaylink-internal.h"
+
+/**
+ * @file
+ *
+ * Memory access via an ADIv5 MEM-AP.
+ *
+ * Memory is accessed through the DRW register with automatic increment of the
+ * TAR register. Word accesses are used for the aligned part of the memory
+ * range, byte and halfword accesses for the unaligned edges. The transfers
+ * are collected in batches which fit into a single SWD I/O operation each. AP
+ * reads are posted, such that each read retrieves the data of the previous
+ * one.
+ */
+
+/** @cond PRIVATE */
+#define MEM_AP_CSW		0x00
+#define MEM_AP_TAR		0x04
+#define MEM_AP_DRW		0x0c
+
+#define CSW_SIZE_MASK		0x07
+#define CSW_SIZE_8		0x00
+#define CSW_SIZE_16		0x01
+#define CSW_SIZE_32		0x02
+#define CSW_ADDRINC_MASK	0x30
+#define CSW_ADDRINC_SINGLE	0x10
+
+/**
+ * Size of the address range within which the TAR register is incremented
+ * automatically.
+ */
+#define TAR_WRAP_SIZE		0x400
+
+/** Maximum number of transfers per flush of the transaction layer. */
+#define MEM_BATCH_SIZE		1024
+/** @endcond */
+
+/*
+ * Determine the largest access size for the address and the remaining number
+ * of bytes.
+ */
+static uint32_t access_size(uint32_t address, size_t remaining)
+{
+	if (!(address & 3) && remaining >= 4)
+		return 4;
+	else if (!(address & 1) && remaining >= 2)
+		return 2;
+
+	return 1;
+}
+
+/*
+ * Read the CSW register once to preserve the implementation defined bits. The
+ * transaction layer is flushed if the register value is not known yet.
+ */
+static int read_csw(struct jaylink_dap *dap, uint8_t ap)
+{
+	int ret;
+	uint32_t csw;
+
+	if (dap->csw_valid && dap->csw_ap == ap)
+		return JAYLINK_OK;
+
+	ret = jaylink_dap_ap_read(dap, ap, MEM_AP_CSW, &csw);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	ret = jaylink_dap_flush(dap);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	dap->csw_ap = ap;
+	dap->csw = csw;
+	dap->csw_valid = true;
+
+	return JAYLINK_OK;
+}
+
+static int set_access_size(struct jaylink_dap *dap, uint8_t ap,
+		uint32_t size)
+{
+	int ret;
+	uint32_t csw;
+
+	ret = read_csw(dap, ap);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	csw = dap->csw & ~(CSW_SIZE_MASK | CSW_ADDRINC_MASK);
+	csw |= CSW_ADDRINC_SINGLE;
+
+	if (size == 4)
+		csw |= CSW_SIZE_32;
+	else if (size == 2)
+		csw |= CSW_SIZE_16;
+	else
+		csw |= CSW_SIZE_8;
+
+	if (csw == dap->csw)
+		return JAYLINK_OK;
+
+	ret = jaylink_dap_ap_write(dap, ap, MEM_AP_CSW, csw);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	dap->csw_ap = ap;
+	dap->csw = csw;
+	dap->csw_valid = true;
+
+	return JAYLINK_OK;
+}
+
+/*
+ * Prepare a transfer. The TAR register is written unless it is incremented
+ * to the address automatically.
+ */
+static int prepare_transfer(struct jaylink_dap *dap, uint8_t ap,
+		uint32_t address, uint32_t size, uint32_t *tar, bool *tar_valid)
+{
+	int ret;
+
+	ret = set_access_size(dap, ap, size);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	if (!*tar_valid || *tar != address) {
+		ret = jaylink_dap_ap_write(dap, ap, MEM_AP_TAR, address);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+	}
+
+	*tar = address + size;
+	*tar_valid = true;
+
+	/* The TAR register wraps around at the boundary. */
+	if (!(*tar % TAR_WRAP_SIZE))
+		*tar_valid = false;
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Read memory via a MEM-AP.
+ *
+ * Pending transactions of the transaction layer are transferred together with
+ * the first part of the memory read.
+ *
+ * @param[in,out] dap Transaction layer.
+ * @param[in] ap Number of the MEM-AP.
+ * @param[in] address Address of the first byte to read.
+ * @param[out] buffer Buffer to store the read data on success. Its content is
+ *                    undefined on failure.
+ * @param[in] length Number of bytes to read.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR_DEV Unspecified device error.
+ * @retval JAYLINK_ERR_TARGET_WAIT A transaction was acknowledged with WAIT.
+ * @retval JAYLINK_ERR_TARGET_FAULT A transaction was acknowledged with FAULT.
+ * @retval JAYLINK_ERR_TARGET_PARITY Parity error in the read data.
+ * @retval JAYLINK_ERR_TARGET No or invalid acknowledge.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @see jaylink_dap_flush()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_dap_mem_read(struct jaylink_dap *dap, uint8_t ap,
+		uint32_t address, uint8_t *buffer, size_t length)
+{
+	int ret;
+	uint32_t *values;
+	struct dap_queue_state state;
+	uint32_t tar;
+	bool tar_valid;
+	uint32_t size;
+	size_t pos;
+	size_t start;
+	size_t num_values;
+	size_t i;
+
+	if (!dap || !buffer || !length)
+		return JAYLINK_ERR_ARG;
+
+	values = malloc(MEM_BATCH_SIZE * sizeof(uint32_t));
+
+	if (!values)
+		return JAYLINK_ERR_MALLOC;
+
+	tar = 0;
+	tar_valid = false;
+	pos = 0;
+
+	while (pos < length) {
+		start = pos;
+		num_values = 0;
+
+		/*
+		 * Read the CSW register before the batch such that the batch is
+		 * not flushed partially.
+		 */
+		ret = read_csw(dap, ap);
+
+		if (ret != JAYLINK_OK) {
+			free(values);
+			return ret;
+		}
+
+		dap_save_queue(dap, &state);
+
+		while (pos < length && num_values < MEM_BATCH_SIZE) {
+			size = access_size(address + pos, length - pos);
+			ret = prepare_transfer(dap, ap, address + pos, size,
+				&tar, &tar_valid);
+
+			if (ret == JAYLINK_OK)
+				ret = jaylink_dap_ap_read(dap, ap, MEM_AP_DRW,
+					&values[num_values]);
+
+			/*
+			 * Drop the reads of the batch because they refer to
+			 * the buffer which is freed.
+			 */
+			if (ret != JAYLINK_OK) {
+				dap_restore_queue(dap, &state);
+				free(values);
+				return ret;
+			}
+
+			num_values++;
+			pos += size;
+		}
+
+		ret = jaylink_dap_flush(dap);
+
+		if (ret != JAYLINK_OK) {
+			free(values);
+			return ret;
+		}
+
+		/* Take the data from the byte lanes of the addresses. */
+		for (i = 0; i < num_values; i++) {
+			size = access_size(address + start, length - start);
+
+			if (size == 4)
+				buffer_set_u32(buffer, values[i], start);
+			else if (size == 2)
+				buffer_set_u16(buffer, values[i] >>
+					((address + start) & 2) * 8, start);
+			else
+				buffer[start] = values[i] >>
+					((address + start) & 3) * 8;
+
+			start += size;
+		}
+	}
+
+	free(values);
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Write memory via a MEM-AP.
+ *
+ * Pending transactions of the transaction layer are transferred together with
+ * the first part of the memory write.
+ *
+ * @param[in,out] dap Transaction layer.
+ * @param[in] ap Number of the MEM-AP.
+ * @param[in] address Address of the first byte to write.
+ * @param[in] buffer Buffer to read the data from.
+ * @param[in] length Number of bytes to write.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR_DEV Unspecified device error.
+ * @retval JAYLINK_ERR_TARGET_WAIT A transaction was acknowledged with WAIT.
+ * @retval JAYLINK_ERR_TARGET_FAULT A transaction was acknowledged with FAULT.
+ * @retval JAYLINK_ERR_TARGET_PARITY Parity error in the read data.
+ * @retval JAYLINK_ERR_TARGET No or invalid acknowledge.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @see jaylink_dap_flush()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_dap_mem_write(struct jaylink_dap *dap, uint8_t ap,
+		uint32_t address, const uint8_t *buffer, size_t length)
+{
+	int ret;
+	struct dap_queue_state state;
+	uint32_t tar;
+	bool tar_valid;
+	uint32_t size;
+	uint32_t value;
+	size_t pos;
+	size_t num_values;
+
+	if (!dap || !buffer || !length)
+		return JAYLINK_ERR_ARG;
+
+	tar = 0;
+	tar_valid = false;
+	pos = 0;
+
+	while (pos < length) {
+		num_values = 0;
+		ret = read_csw(dap, ap);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+
+		dap_save_queue(dap, &state);
+
+		while (pos < length && num_values < MEM_BATCH_SIZE) {
+			size = access_size(address + pos, length - pos);
+			ret = prepare_transfer(dap, ap, address + pos, size,
+				&tar, &tar_valid);
+
+			/* Do not leave a partial batch of writes behind. */
+			if (ret != JAYLINK_OK) {
+				dap_restore_queue(dap, &state);
+				return ret;
+			}
+
+			/* Put the data on the byte lanes of the address. */
+			if (size == 4)
+				value = buffer_get_u32(buffer, pos);
+			else if (size == 2)
+				value = (uint32_t)buffer_get_u16(buffer, pos) <<
+					((address + pos) & 2) * 8;
+			else
+				value = (uint32_t)buffer[pos] <<
+					((address + pos) & 3) * 8;
+
+			ret = jaylink_dap_ap_write(dap, ap, MEM_AP_DRW, value);
+
+			if (ret != JAYLINK_OK) {
+				dap_restore_queue(dap, &state);
+				return ret;
+			}
+
+			num_values++;
+			pos += size;
+		}
+
+		ret = jaylink_dap_flush(dap);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+	}
+
+	return JAYLINK_OK;
+}
@@ -78,26 +78,47 @@ JAYLINK_PRIV struct jaylink_device *device_allocate(
 		struct jaylink_context *ctx)
 {
 	struct jaylink_device *dev;
-	struct list *list;
 
 	dev = malloc(sizeof(struct jaylink_device));
 
 	if (!dev)
 		return NULL;
 
+	dev->ctx = ctx;
+	dev->ref_count = 1;
+
+	return dev;
+}
+
+/**
+ * Add a device instance to the device list of its context.
+ *
+ * The device instance must be fully initialized because it becomes visible to
+ * other threads as soon as it is in the list.
+ *
+ * @param[in,out] dev Device instance.
+ *
+ * @return Whether the device instance was successfully added.
+ */
+JAYLINK_PRIV bool device_add(struct jaylink_device *dev)
+{
+	struct jaylink_context *ctx;
+	struct list *list;
+
+	ctx = dev->ctx;
+
+	thread_mutex_lock(&ctx->lock);
 	list = list_prepend(ctx->devs, dev);
 
 	if (!list) {
-		free(dev);
-		return NULL;
+		thread_mutex_unlock(&ctx->lock);
+		return false;
 	}
 
 	ctx->devs = list;
+	thread_mutex_unlock(&ctx->lock);
 
-	dev->ctx = ctx;
-	dev->ref_count = 1;
-
-	return dev;
+	return true;
 }
 
 static struct jaylink_device **allocate_device_list(size_t length)
@@ -146,10 +167,12 @@ JAYLINK_API int jaylink_get_devices(struct jaylink_context *ctx,
 	if (!ctx || !devs)
 		return JAYLINK_ERR_ARG;
 
+	thread_mutex_lock(&ctx->lock);
 	num = list_length(ctx->discovered_devs);
 	tmp = allocate_device_list(num);
 
 	if (!tmp) {
+		thread_mutex_unlock(&ctx->lock);
 		log_err(ctx, "Failed to allocate device list.");
 		return JAYLINK_ERR_MALLOC;
 	}
@@ -162,6 +185,8 @@ JAYLINK_API int jaylink_get_devices(struct jaylink_context *ctx,
 		item = item->next;
 	}
 
+	thread_mutex_unlock(&ctx->lock);
+
 	if (count)
 		*count = num;
 
@@ -524,7 +549,7 @@ JAYLINK_API struct jaylink_device *jaylink_ref_device(
 	if (!dev)
 		return NULL;
 
-	dev->ref_count++;
+	thread_atomic_inc(&dev->ref_count);
 
 	return dev;
 }
@@ -543,11 +568,20 @@ JAYLINK_API void jaylink_unref_device(struct jaylink_device *dev)
 	if (!dev)
 		return;
 
-	dev->ref_count--;
+	if (thread_atomic_dec_unless_one(&dev->ref_count))
+		return;
+
+	/*
+	 * Release the last reference with the lock held because the device
+	 * discovery may acquire a new reference of a device instance from the
+	 * device list in the meantime.
+	 */
+	ctx = dev->ctx;
+	thread_mutex_lock(&ctx->lock);
 
-	if (!dev->ref_count) {
-		ctx = dev->ctx;
-		ctx->devs = list_remove(dev->ctx->devs, dev);
+	if (!thread_atomic_dec(&dev->ref_count)) {
+		ctx->devs = list_remove(ctx->devs, dev);
+		thread_mutex_unlock(&ctx->lock);
 
 		if (dev->iface == JAYLINK_HIF_USB) {
 #ifdef HAVE_LIBUSB
@@ -561,12 +595,19 @@ JAYLINK_API void jaylink_unref_device(struct jaylink_device *dev)
 		} else if (dev->iface == JAYLINK_HIF_TCP) {
 			log_dbg(ctx, "Device destroyed (IPv4 address = %s).",
 				dev->ipv4_address);
+		} else if (dev->iface == JAYLINK_HIF_CUSTOM) {
+			log_dbg(ctx, "Device destroyed (custom transport).");
+
+			if (dev->custom_ops->free)
+				dev->custom_ops->free(dev->custom_data);
 		} else {
 			log_err(ctx, "BUG: Invalid host interface: %u.",
 				dev->iface);
 		}
 
 		free(dev);
+	} else {
+		thread_mutex_unlock(&ctx->lock);
 	}
 }
 
@@ -580,13 +621,20 @@ static struct jaylink_device_handle *allocate_device_handle(
 	if (!devh)
 		return NULL;
 
+	if (!thread_mutex_init(&devh->lock)) {
+		free(devh);
+		return NULL;
+	}
+
 	devh->dev = jaylink_ref_device(dev);
+	devh->jtag_chunk_size = 0;
 
 	return devh;
 }
 
 static void free_device_handle(struct jaylink_device_handle *devh)
 {
+	thread_mutex_destroy(&devh->lock);
 	jaylink_unref_device(devh->dev);
 	free(devh);
 }
@@ -653,7 +701,11 @@ JAYLINK_API int jaylink_close(struct jaylink_device_handle *devh)
 	if (!devh)
 		return JAYLINK_ERR_ARG;
 
+	/* Wait for an operation of another thread to be completed. */
+	thread_mutex_lock(&devh->lock);
 	ret = transport_close(devh);
+	thread_mutex_unlock(&devh->lock);
+
 	free_device_handle(devh);
 
 	return ret;
@@ -679,28 +731,7 @@ JAYLINK_API struct jaylink_device *jaylink_get_device(
 	return devh->dev;
 }
 
-/**
- * Retrieve the firmware version of a device.
- *
- * @param[in,out] devh Device handle.
- * @param[out] version Newly allocated string which contains the firmware
- *                     version  on success, and undefined if @p length is zero
- *                     or on failure. The string is null-terminated and must be
- *                     free'd by the caller.
- * @param[out] length Length of the firmware version string including trailing
- *                    null-terminator on success, and undefined on failure.
- *                    Zero if no firmware version string is available.
- *
- * @retval JAYLINK_OK Success.
- * @retval JAYLINK_ERR_ARG Invalid arguments.
- * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
- * @retval JAYLINK_ERR_MALLOC Memory allocation error.
- * @retval JAYLINK_ERR_IO Input/output error.
- * @retval JAYLINK_ERR Other error conditions.
- *
- * @since 0.1.0
- */
-JAYLINK_API int jaylink_get_firmware_version(
+static int _get_firmware_version(
 		struct jaylink_device_handle *devh, char **version,
 		size_t *length)
 {
@@ -778,30 +809,43 @@ JAYLINK_API int jaylink_get_firmware_version(
 }
 
 /**
- * Retrieve the hardware information of a device.
- *
- * @note This function must only be used if the device has the
- *       #JAYLINK_DEV_CAP_GET_HW_INFO capability.
+ * Retrieve the firmware version of a device.
  *
  * @param[in,out] devh Device handle.
- * @param[in] mask A bit field where each set bit represents hardware
- *                 information to request. See #jaylink_hardware_info for a
- *                 description of the hardware information and their bit
- *                 positions.
- * @param[out] info Array to store the hardware information on success. Its
- *                  content is undefined on failure. The array must be large
- *                  enough to contain at least as many elements as bits set in
- *                  @a mask.
+ * @param[out] version Newly allocated string which contains the firmware
+ *                     version  on success, and undefined if @p length is zero
+ *                     or on failure. The string is null-terminated and must be
+ *                     free'd by the caller.
+ * @param[out] length Length of the firmware version string including trailing
+ *                    null-terminator on success, and undefined on failure.
+ *                    Zero if no firmware version string is available.
  *
  * @retval JAYLINK_OK Success.
  * @retval JAYLINK_ERR_ARG Invalid arguments.
  * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
  * @retval JAYLINK_ERR_IO Input/output error.
  * @retval JAYLINK_ERR Other error conditions.
  *
  * @since 0.1.0
  */
-JAYLINK_API int jaylink_get_hardware_info(struct jaylink_device_handle *devh,
+JAYLINK_API int jaylink_get_firmware_version(
+		struct jaylink_device_handle *devh, char **version,
+		size_t *length)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _get_firmware_version(devh, version, length);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+static int _get_hardware_info(struct jaylink_device_handle *devh,
 		uint32_t mask, uint32_t *info)
 {
 	int ret;
@@ -859,19 +903,20 @@ JAYLINK_API int jaylink_get_hardware_info(struct jaylink_device_handle *devh,
 }
 
 /**
- * Retrieve the counter values of a device.
+ * Retrieve the hardware information of a device.
  *
  * @note This function must only be used if the device has the
- *       #JAYLINK_DEV_CAP_GET_COUNTERS capability.
+ *       #JAYLINK_DEV_CAP_GET_HW_INFO capability.
  *
  * @param[in,out] devh Device handle.
- * @param[in] mask A bit field where each set bit represents a counter value to
- *                 request. See #jaylink_counter for a description of the
- *                 counters and their bit positions.
- * @param[out] values Array to store the counter values on success. Its content
- *                    is undefined on failure. The array must be large enough
- *                    to contain at least as many elements as bits set in @p
- *                    mask.
+ * @param[in] mask A bit field where each set bit represents hardware
+ *                 information to request. See #jaylink_hardware_info for a
+ *                 description of the hardware information and their bit
+ *                 positions.
+ * @param[out] info Array to store the hardware information on success. Its
+ *                  content is undefined on failure. The array must be large
+ *                  enough to contain at least as many elements as bits set in
+ *                  @a mask.
  *
  * @retval JAYLINK_OK Success.
  * @retval JAYLINK_ERR_ARG Invalid arguments.
@@ -879,9 +924,24 @@ JAYLINK_API int jaylink_get_hardware_info(struct jaylink_device_handle *devh,
  * @retval JAYLINK_ERR_IO Input/output error.
  * @retval JAYLINK_ERR Other error conditions.
  *
- * @since 0.2.0
+ * @since 0.1.0
  */
-JAYLINK_API int jaylink_get_counters(struct jaylink_device_handle *devh,
+JAYLINK_API int jaylink_get_hardware_info(struct jaylink_device_handle *devh,
+		uint32_t mask, uint32_t *info)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _get_hardware_info(devh, mask, info);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+static int _get_counters(struct jaylink_device_handle *devh,
 		uint32_t mask, uint32_t *values)
 {
 	int ret;
@@ -938,17 +998,19 @@ JAYLINK_API int jaylink_get_counters(struct jaylink_device_handle *devh,
 }
 
 /**
- * Retrieve the hardware version of a device.
+ * Retrieve the counter values of a device.
  *
  * @note This function must only be used if the device has the
- *       #JAYLINK_DEV_CAP_GET_HW_VERSION capability.
- *
- * @warning This function may return a value for @p version where
- *          #jaylink_hardware_version::type is not covered by
- *          #jaylink_hardware_type.
+ *       #JAYLINK_DEV_CAP_GET_COUNTERS capability.
  *
  * @param[in,out] devh Device handle.
- * @param[out] version Hardware version on success, and undefined on failure.
+ * @param[in] mask A bit field where each set bit represents a counter value to
+ *                 request. See #jaylink_counter for a description of the
+ *                 counters and their bit positions.
+ * @param[out] values Array to store the counter values on success. Its content
+ *                    is undefined on failure. The array must be large enough
+ *                    to contain at least as many elements as bits set in @p
+ *                    mask.
  *
  * @retval JAYLINK_OK Success.
  * @retval JAYLINK_ERR_ARG Invalid arguments.
@@ -956,9 +1018,24 @@ JAYLINK_API int jaylink_get_counters(struct jaylink_device_handle *devh,
  * @retval JAYLINK_ERR_IO Input/output error.
  * @retval JAYLINK_ERR Other error conditions.
  *
- * @since 0.1.0
+ * @since 0.2.0
  */
-JAYLINK_API int jaylink_get_hardware_version(
+JAYLINK_API int jaylink_get_counters(struct jaylink_device_handle *devh,
+		uint32_t mask, uint32_t *values)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _get_counters(devh, mask, values);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+static int _get_hardware_version(
 		struct jaylink_device_handle *devh,
 		struct jaylink_hardware_version *version)
 {
@@ -1008,10 +1085,17 @@ JAYLINK_API int jaylink_get_hardware_version(
 }
 
 /**
- * Retrieve the hardware status of a device.
+ * Retrieve the hardware version of a device.
+ *
+ * @note This function must only be used if the device has the
+ *       #JAYLINK_DEV_CAP_GET_HW_VERSION capability.
+ *
+ * @warning This function may return a value for @p version where
+ *          #jaylink_hardware_version::type is not covered by
+ *          #jaylink_hardware_type.
  *
  * @param[in,out] devh Device handle.
- * @param[out] status Hardware status on success, and undefined on failure.
+ * @param[out] version Hardware version on success, and undefined on failure.
  *
  * @retval JAYLINK_OK Success.
  * @retval JAYLINK_ERR_ARG Invalid arguments.
@@ -1021,7 +1105,23 @@ JAYLINK_API int jaylink_get_hardware_version(
  *
  * @since 0.1.0
  */
-JAYLINK_API int jaylink_get_hardware_status(struct jaylink_device_handle *devh,
+JAYLINK_API int jaylink_get_hardware_version(
+		struct jaylink_device_handle *devh,
+		struct jaylink_hardware_version *version)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _get_hardware_version(devh, version);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+static int _get_hardware_status(struct jaylink_device_handle *devh,
 		struct jaylink_hardware_status *status)
 {
 	int ret;
@@ -1070,20 +1170,10 @@ JAYLINK_API int jaylink_get_hardware_status(struct jaylink_device_handle *devh,
 }
 
 /**
- * Retrieve the capabilities of a device.
- *
- * The capabilities are stored in a 32-bit bit array consisting of
- * #JAYLINK_DEV_CAPS_SIZE bytes where each individual bit represents a
- * capability. The first bit of this array is the least significant bit of the
- * first byte and the following bits are sequentially numbered in order of
- * increasing bit significance and byte index. A set bit indicates a supported
- * capability. See #jaylink_device_capability for a description of the
- * capabilities and their bit positions.
+ * Retrieve the hardware status of a device.
  *
  * @param[in,out] devh Device handle.
- * @param[out] caps Buffer to store capabilities on success. Its content is
- *                  undefined on failure. The buffer must be large enough to
- *                  contain at least #JAYLINK_DEV_CAPS_SIZE bytes.
+ * @param[out] status Hardware status on success, and undefined on failure.
  *
  * @retval JAYLINK_OK Success.
  * @retval JAYLINK_ERR_ARG Invalid arguments.
@@ -1091,12 +1181,24 @@ JAYLINK_API int jaylink_get_hardware_status(struct jaylink_device_handle *devh,
  * @retval JAYLINK_ERR_IO Input/output error.
  * @retval JAYLINK_ERR Other error conditions.
  *
- * @see jaylink_get_extended_caps()
- * @see jaylink_has_cap()
- *
  * @since 0.1.0
  */
-JAYLINK_API int jaylink_get_caps(struct jaylink_device_handle *devh,
+JAYLINK_API int jaylink_get_hardware_status(struct jaylink_device_handle *devh,
+		struct jaylink_hardware_status *status)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _get_hardware_status(devh, status);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+static int _get_caps(struct jaylink_device_handle *devh,
 		uint8_t *caps)
 {
 	int ret;
@@ -1137,21 +1239,20 @@ JAYLINK_API int jaylink_get_caps(struct jaylink_device_handle *devh,
 }
 
 /**
- * Retrieve the extended capabilities of a device.
- *
- * The extended capabilities are stored in a 256-bit bit array consisting of
- * #JAYLINK_DEV_EXT_CAPS_SIZE bytes. See jaylink_get_caps() for a further
- * description of how the capabilities are represented in this bit array. For a
- * description of the capabilities and their bit positions, see
- * #jaylink_device_capability.
+ * Retrieve the capabilities of a device.
  *
- * @note This function must only be used if the device has the
- *       #JAYLINK_DEV_CAP_GET_EXT_CAPS capability.
+ * The capabilities are stored in a 32-bit bit array consisting of
+ * #JAYLINK_DEV_CAPS_SIZE bytes where each individual bit represents a
+ * capability. The first bit of this array is the least significant bit of the
+ * first byte and the following bits are sequentially numbered in order of
+ * increasing bit significance and byte index. A set bit indicates a supported
+ * capability. See #jaylink_device_capability for a description of the
+ * capabilities and their bit positions.
  *
  * @param[in,out] devh Device handle.
  * @param[out] caps Buffer to store capabilities on success. Its content is
  *                  undefined on failure. The buffer must be large enough to
- *                  contain at least #JAYLINK_DEV_EXT_CAPS_SIZE bytes.
+ *                  contain at least #JAYLINK_DEV_CAPS_SIZE bytes.
  *
  * @retval JAYLINK_OK Success.
  * @retval JAYLINK_ERR_ARG Invalid arguments.
@@ -1159,11 +1260,27 @@ JAYLINK_API int jaylink_get_caps(struct jaylink_device_handle *devh,
  * @retval JAYLINK_ERR_IO Input/output error.
  * @retval JAYLINK_ERR Other error conditions.
  *
- * @see jaylink_get_caps()
+ * @see jaylink_get_extended_caps()
+ * @see jaylink_has_cap()
  *
  * @since 0.1.0
  */
-JAYLINK_API int jaylink_get_extended_caps(struct jaylink_device_handle *devh,
+JAYLINK_API int jaylink_get_caps(struct jaylink_device_handle *devh,
+		uint8_t *caps)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _get_caps(devh, caps);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+static int _get_extended_caps(struct jaylink_device_handle *devh,
 		uint8_t *caps)
 {
 	int ret;
@@ -1205,14 +1322,21 @@ JAYLINK_API int jaylink_get_extended_caps(struct jaylink_device_handle *devh,
 }
 
 /**
- * Retrieve the size of free memory of a device.
+ * Retrieve the extended capabilities of a device.
+ *
+ * The extended capabilities are stored in a 256-bit bit array consisting of
+ * #JAYLINK_DEV_EXT_CAPS_SIZE bytes. See jaylink_get_caps() for a further
+ * description of how the capabilities are represented in this bit array. For a
+ * description of the capabilities and their bit positions, see
+ * #jaylink_device_capability.
  *
  * @note This function must only be used if the device has the
- *       #JAYLINK_DEV_CAP_GET_FREE_MEMORY capability.
+ *       #JAYLINK_DEV_CAP_GET_EXT_CAPS capability.
  *
  * @param[in,out] devh Device handle.
- * @param[out] size Size of free memory in bytes on success, and undefined on
- *                  failure.
+ * @param[out] caps Buffer to store capabilities on success. Its content is
+ *                  undefined on failure. The buffer must be large enough to
+ *                  contain at least #JAYLINK_DEV_EXT_CAPS_SIZE bytes.
  *
  * @retval JAYLINK_OK Success.
  * @retval JAYLINK_ERR_ARG Invalid arguments.
@@ -1220,9 +1344,26 @@ JAYLINK_API int jaylink_get_extended_caps(struct jaylink_device_handle *devh,
  * @retval JAYLINK_ERR_IO Input/output error.
  * @retval JAYLINK_ERR Other error conditions.
  *
+ * @see jaylink_get_caps()
+ *
  * @since 0.1.0
  */
-JAYLINK_API int jaylink_get_free_memory(struct jaylink_device_handle *devh,
+JAYLINK_API int jaylink_get_extended_caps(struct jaylink_device_handle *devh,
+		uint8_t *caps)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _get_extended_caps(devh, caps);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+static int _get_free_memory(struct jaylink_device_handle *devh,
 		uint32_t *size)
 {
 	int ret;
@@ -1265,16 +1406,14 @@ JAYLINK_API int jaylink_get_free_memory(struct jaylink_device_handle *devh,
 }
 
 /**
- * Read the raw configuration data of a device.
+ * Retrieve the size of free memory of a device.
  *
  * @note This function must only be used if the device has the
- *       #JAYLINK_DEV_CAP_READ_CONFIG capability.
+ *       #JAYLINK_DEV_CAP_GET_FREE_MEMORY capability.
  *
  * @param[in,out] devh Device handle.
- * @param[out] config Buffer to store configuration data on success. Its
- *                    content is undefined on failure. The buffer must be large
- *                    enough to contain at least
- *                    #JAYLINK_DEV_CONFIG_SIZE bytes.
+ * @param[out] size Size of free memory in bytes on success, and undefined on
+ *                  failure.
  *
  * @retval JAYLINK_OK Success.
  * @retval JAYLINK_ERR_ARG Invalid arguments.
@@ -1284,7 +1423,22 @@ JAYLINK_API int jaylink_get_free_memory(struct jaylink_device_handle *devh,
  *
  * @since 0.1.0
  */
-JAYLINK_API int jaylink_read_raw_config(struct jaylink_device_handle *devh,
+JAYLINK_API int jaylink_get_free_memory(struct jaylink_device_handle *devh,
+		uint32_t *size)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _get_free_memory(devh, size);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+static int _read_raw_config(struct jaylink_device_handle *devh,
 		uint8_t *config)
 {
 	int ret;
@@ -1326,15 +1480,16 @@ JAYLINK_API int jaylink_read_raw_config(struct jaylink_device_handle *devh,
 }
 
 /**
- * Write the raw configuration data of a device.
+ * Read the raw configuration data of a device.
  *
  * @note This function must only be used if the device has the
- *       #JAYLINK_DEV_CAP_WRITE_CONFIG capability.
+ *       #JAYLINK_DEV_CAP_READ_CONFIG capability.
  *
  * @param[in,out] devh Device handle.
- * @param[in] config Buffer to write configuration data from. The size of the
- *                   configuration data is expected to be
- *                   #JAYLINK_DEV_CONFIG_SIZE bytes.
+ * @param[out] config Buffer to store configuration data on success. Its
+ *                    content is undefined on failure. The buffer must be large
+ *                    enough to contain at least
+ *                    #JAYLINK_DEV_CONFIG_SIZE bytes.
  *
  * @retval JAYLINK_OK Success.
  * @retval JAYLINK_ERR_ARG Invalid arguments.
@@ -1344,7 +1499,22 @@ JAYLINK_API int jaylink_read_raw_config(struct jaylink_device_handle *devh,
  *
  * @since 0.1.0
  */
-JAYLINK_API int jaylink_write_raw_config(struct jaylink_device_handle *devh,
+JAYLINK_API int jaylink_read_raw_config(struct jaylink_device_handle *devh,
+		uint8_t *config)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _read_raw_config(devh, config);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+static int _write_raw_config(struct jaylink_device_handle *devh,
 		const uint8_t *config)
 {
 	int ret;
@@ -1384,6 +1554,40 @@ JAYLINK_API int jaylink_write_raw_config(struct jaylink_device_handle *devh,
 	return JAYLINK_OK;
 }
 
+/**
+ * Write the raw configuration data of a device.
+ *
+ * @note This function must only be used if the device has the
+ *       #JAYLINK_DEV_CAP_WRITE_CONFIG capability.
+ *
+ * @param[in,out] devh Device handle.
+ * @param[in] config Buffer to write configuration data from. The size of the
+ *                   configuration data is expected to be
+ *                   #JAYLINK_DEV_CONFIG_SIZE bytes.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @since 0.1.0
+ */
+JAYLINK_API int jaylink_write_raw_config(struct jaylink_device_handle *devh,
+		const uint8_t *config)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _write_raw_config(devh, config);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
 static void parse_conn_table(struct jaylink_connection *conns,
 		const uint8_t *buffer, uint16_t num, uint16_t entry_size)
 {
@@ -1439,87 +1643,7 @@ static bool _inet_pton(const char *str, struct in_addr *in)
 	return true;
 }
 
-/**
- * Register a connection on a device.
- *
- * A connection can be registered by using 0 as handle. Additional information
- * about the connection can be attached whereby the timestamp is a read-only
- * value and therefore ignored for registration. On success, a new handle
- * greater than 0 is obtained from the device.
- *
- * However, if an obtained handle does not appear in the list of device
- * connections, the connection was not registered because the maximum number of
- * connections on the device is reached.
- *
- * @note This function must only be used if the device has the
- *       #JAYLINK_DEV_CAP_REGISTER capability.
- *
- * Example code:
- * @code{.c}
- * static bool register_connection(struct jaylink_device_handle *devh,
- *                 struct jaylink_connection *conn)
- * {
- *         int ret;
- *         struct jaylink_connection conns[JAYLINK_MAX_CONNECTIONS];
- *         bool found_handle;
- *         size_t count;
- *         size_t i;
- *
- *         conn->handle = 0;
- *         conn->pid = 0;
- *         strcpy(conn->hid, "0.0.0.0");
- *         conn->iid = 0;
- *         conn->cid = 0;
- *
- *         ret = jaylink_register(devh, conn, conns, &count);
- *
- *         if (ret != JAYLINK_OK) {
- *                 printf("jaylink_register() failed: %s.\n",
- *                         jaylink_strerror(ret));
- *                 return false;
- *         }
- *
- *         found_handle = false;
- *
- *         for (i = 0; i < count; i++) {
- *                 if (conns[i].handle == conn->handle) {
- *                         found_handle = true;
- *                         break;
- *                 }
- *         }
- *
- *         if (!found_handle) {
- *                 printf("Maximum number of connections reached.\n");
- *                 return false;
- *         }
- *
- *         printf("Connection successfully registered.\n");
- *
- *         return true;
- * }
- * @endcode
- *
- * @param[in,out] devh Device handle.
- * @param[in,out] connection Connection to register on the device.
- * @param[out] connections Array to store device connections on success.
- *                         Its content is undefined on failure. The array must
- *                         be large enough to contain at least
- *                         #JAYLINK_MAX_CONNECTIONS elements.
- * @param[out] count Number of device connections on success, and undefined on
- *                   failure.
- *
- * @retval JAYLINK_OK Success.
- * @retval JAYLINK_ERR_ARG Invalid arguments.
- * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
- * @retval JAYLINK_ERR_PROTO Protocol violation.
- * @retval JAYLINK_ERR_IO Input/output error.
- * @retval JAYLINK_ERR Other error conditions.
- *
- * @see jaylink_unregister()
- *
- * @since 0.1.0
- */
-JAYLINK_API int jaylink_register(struct jaylink_device_handle *devh,
+static int _register(struct jaylink_device_handle *devh,
 		struct jaylink_connection *connection,
 		struct jaylink_connection *connections, size_t *count)
 {
@@ -1635,13 +1759,67 @@ JAYLINK_API int jaylink_register(struct jaylink_device_handle *devh,
 }
 
 /**
- * Unregister a connection from a device.
+ * Register a connection on a device.
+ *
+ * A connection can be registered by using 0 as handle. Additional information
+ * about the connection can be attached whereby the timestamp is a read-only
+ * value and therefore ignored for registration. On success, a new handle
+ * greater than 0 is obtained from the device.
+ *
+ * However, if an obtained handle does not appear in the list of device
+ * connections, the connection was not registered because the maximum number of
+ * connections on the device is reached.
  *
  * @note This function must only be used if the device has the
  *       #JAYLINK_DEV_CAP_REGISTER capability.
  *
+ * Example code:
+ * @code{.c}
+ * static bool register_connection(struct jaylink_device_handle *devh,
+ *                 struct jaylink_connection *conn)
+ * {
+ *         int ret;
+ *         struct jaylink_connection conns[JAYLINK_MAX_CONNECTIONS];
+ *         bool found_handle;
+ *         size_t count;
+ *         size_t i;
+ *
+ *         conn->handle = 0;
+ *         conn->pid = 0;
+ *         strcpy(conn->hid, "0.0.0.0");
+ *         conn->iid = 0;
+ *         conn->cid = 0;
+ *
+ *         ret = jaylink_register(devh, conn, conns, &count);
+ *
+ *         if (ret != JAYLINK_OK) {
+ *                 printf("jaylink_register() failed: %s.\n",
+ *                         jaylink_strerror(ret));
+ *                 return false;
+ *         }
+ *
+ *         found_handle = false;
+ *
+ *         for (i = 0; i < count; i++) {
+ *                 if (conns[i].handle == conn->handle) {
+ *                         found_handle = true;
+ *                         break;
+ *                 }
+ *         }
+ *
+ *         if (!found_handle) {
+ *                 printf("Maximum number of connections reached.\n");
+ *                 return false;
+ *         }
+ *
+ *         printf("Connection successfully registered.\n");
+ *
+ *         return true;
+ * }
+ * @endcode
+ *
  * @param[in,out] devh Device handle.
- * @param[in,out] connection Connection to unregister from the device.
+ * @param[in,out] connection Connection to register on the device.
  * @param[out] connections Array to store device connections on success.
  *                         Its content is undefined on failure. The array must
  *                         be large enough to contain at least
@@ -1656,11 +1834,27 @@ JAYLINK_API int jaylink_register(struct jaylink_device_handle *devh,
  * @retval JAYLINK_ERR_IO Input/output error.
  * @retval JAYLINK_ERR Other error conditions.
  *
- * @see jaylink_register()
+ * @see jaylink_unregister()
  *
  * @since 0.1.0
  */
-JAYLINK_API int jaylink_unregister(struct jaylink_device_handle *devh,
+JAYLINK_API int jaylink_register(struct jaylink_device_handle *devh,
+		struct jaylink_connection *connection,
+		struct jaylink_connection *connections, size_t *count)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _register(devh, connection, connections, count);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+static int _unregister(struct jaylink_device_handle *devh,
 		const struct jaylink_connection *connection,
 		struct jaylink_connection *connections, size_t *count)
 {
@@ -1766,3 +1960,45 @@ JAYLINK_API int jaylink_unregister(struct jaylink_device_handle *devh,
 
 	return JAYLINK_OK;
 }
+
+/**
+ * Unregister a connection from a device.
+ *
+ * @note This function must only be used if the device has the
+ *       #JAYLINK_DEV_CAP_REGISTER capability.
+ *
+ * @param[in,out] devh Device handle.
+ * @param[in,out] connection Connection to unregister from the device.
+ * @param[out] connections Array to store device connections on success.
+ *                         Its content is undefined on failure. The array must
+ *                         be large enough to contain at least
+ *                         #JAYLINK_MAX_CONNECTIONS elements.
+ * @param[out] count Number of device connections on success, and undefined on
+ *                   failure.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_PROTO Protocol violation.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @see jaylink_register()
+ *
+ * @since 0.1.0
+ */
+JAYLINK_API int jaylink_unregister(struct jaylink_device_handle *devh,
+		const struct jaylink_connection *connection,
+		struct jaylink_connection *connections, size_t *count)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _unregister(devh, connection, connections, count);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
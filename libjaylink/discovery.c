@@ -31,13 +31,13 @@
  * Device discovery.
  */
 
-static void clear_discovery_list(struct jaylink_context *ctx)
+static void free_device_list(struct list *devs)
 {
 	struct list *item;
 	struct list *tmp;
 	struct jaylink_device *dev;
 
-	item = ctx->discovered_devs;
+	item = devs;
 
 	while (item) {
 		dev = (struct jaylink_device *)item->data;
@@ -47,13 +47,15 @@ static void clear_discovery_list(struct jaylink_context *ctx)
 		item = item->next;
 		free(tmp);
 	}
-
-	ctx->discovered_devs = NULL;
 }
 
 /**
  * Scan for devices.
  *
+ * The list of discovered devices of the context is replaced once the scan is
+ * complete. Other threads which access the device lists of the context, for
+ * example with jaylink_get_devices(), are not blocked during the scan.
+ *
  * @param[in,out] ctx libjaylink context.
  * @param[in] ifaces Host interfaces to scan for devices. Use bitwise OR to
  *                   specify multiple interfaces, or 0 to use all available
@@ -73,6 +75,8 @@ JAYLINK_API int jaylink_discovery_scan(struct jaylink_context *ctx,
 		uint32_t ifaces)
 {
 	int ret;
+	struct list *devs;
+	struct list *tmp;
 
 	if (!ctx)
 		return JAYLINK_ERR_ARG;
@@ -80,13 +84,18 @@ JAYLINK_API int jaylink_discovery_scan(struct jaylink_context *ctx,
 	if (!ifaces)
 		ifaces = JAYLINK_HIF_USB | JAYLINK_HIF_TCP;
 
-	clear_discovery_list(ctx);
+	/*
+	 * Scan into a separate list without holding the lock of the device
+	 * lists because the scan performs I/O operations.
+	 */
+	devs = NULL;
 
 #ifdef HAVE_LIBUSB
 	if (ifaces & JAYLINK_HIF_USB) {
-		ret = discovery_usb_scan(ctx);
+		ret = discovery_usb_scan(ctx, &devs);
 
 		if (ret != JAYLINK_OK) {
+			free_device_list(devs);
 			log_err(ctx, "USB device discovery failed.");
 			return ret;
 		}
@@ -94,13 +103,22 @@ JAYLINK_API int jaylink_discovery_scan(struct jaylink_context *ctx,
 #endif
 
 	if (ifaces & JAYLINK_HIF_TCP) {
-		ret = discovery_tcp_scan(ctx);
+		ret = discovery_tcp_scan(ctx, &devs);
 
 		if (ret != JAYLINK_OK) {
+			free_device_list(devs);
 			log_err(ctx, "TCP/IP device discovery failed.");
 			return ret;
 		}
 	}
 
+	/* Update the list of discovered devices at once. */
+	thread_mutex_lock(&ctx->lock);
+	tmp = ctx->discovered_devs;
+	ctx->discovered_devs = devs;
+	thread_mutex_unlock(&ctx->lock);
+
+	free_device_list(tmp);
+
 	return JAYLINK_OK;
 }
@@ -150,7 +150,8 @@ static bool parse_adv_message(struct jaylink_device *dev,
 }
 
 static struct jaylink_device *probe_device(struct jaylink_context *ctx,
-		struct sockaddr_in *addr, const uint8_t *buffer)
+		struct list *devs, struct sockaddr_in *addr,
+		const uint8_t *buffer)
 {
 	struct jaylink_device tmp;
 	struct jaylink_device *dev;
@@ -179,18 +180,21 @@ static struct jaylink_device *probe_device(struct jaylink_context *ctx,
 	if (tmp.has_nickname)
 		log_dbg(ctx, "Device: Nickname = %s.", tmp.nickname);
 
-	dev = find_device(ctx->discovered_devs, &tmp);
+	dev = find_device(devs, &tmp);
 
 	if (dev) {
 		log_dbg(ctx, "Ignoring already discovered device.");
 		return NULL;
 	}
 
+	thread_mutex_lock(&ctx->lock);
 	dev = find_device(ctx->devs, &tmp);
 
 	if (dev) {
+		dev = jaylink_ref_device(dev);
+		thread_mutex_unlock(&ctx->lock);
 		log_dbg(ctx, "Using existing device instance.");
-		return jaylink_ref_device(dev);
+		return dev;
 	}
 
 	log_dbg(ctx, "Allocating new device instance.");
@@ -198,6 +202,7 @@ static struct jaylink_device *probe_device(struct jaylink_context *ctx,
 	dev = device_allocate(ctx);
 
 	if (!dev) {
+		thread_mutex_unlock(&ctx->lock);
 		log_warn(ctx, "Device instance malloc failed.");
 		return NULL;
 	}
@@ -208,6 +213,7 @@ static struct jaylink_device *probe_device(struct jaylink_context *ctx,
 	dev->valid_serial_number = tmp.valid_serial_number;
 
 	memcpy(dev->ipv4_address, tmp.ipv4_address, sizeof(dev->ipv4_address));
+	dev->tcp_port = TRANSPORT_TCP_PORT;
 
 	memcpy(dev->mac_address, tmp.mac_address, sizeof(dev->mac_address));
 	dev->has_mac_address = tmp.has_mac_address;
@@ -221,11 +227,21 @@ static struct jaylink_device *probe_device(struct jaylink_context *ctx,
 	dev->hw_version = tmp.hw_version;
 	dev->has_hw_version = tmp.has_hw_version;
 
+	if (!device_add(dev)) {
+		thread_mutex_unlock(&ctx->lock);
+		log_warn(ctx, "Failed to add device instance.");
+		free(dev);
+		return NULL;
+	}
+
+	thread_mutex_unlock(&ctx->lock);
+
 	return dev;
 }
 
 /** @private */
-JAYLINK_PRIV int discovery_tcp_scan(struct jaylink_context *ctx)
+JAYLINK_PRIV int discovery_tcp_scan(struct jaylink_context *ctx,
+		struct list **devs)
 {
 	int ret;
 	int sock;
@@ -327,11 +343,10 @@ JAYLINK_PRIV int discovery_tcp_scan(struct jaylink_context *ctx)
 		if (length != ADV_MESSAGE_SIZE)
 			continue;
 
-		dev = probe_device(ctx, &addr, buf);
+		dev = probe_device(ctx, *devs, &addr, buf);
 
 		if (dev) {
-			ctx->discovered_devs = list_prepend(
-				ctx->discovered_devs, dev);
+			*devs = list_prepend(*devs, dev);
 			num_devs++;
 		}
 	}
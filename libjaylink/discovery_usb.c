@@ -173,8 +173,14 @@ static struct jaylink_device *probe_device(struct jaylink_context *ctx,
 	 * Search for an already allocated device instance for this device and
 	 * if found return a reference to it.
 	 */
+	thread_mutex_lock(&ctx->lock);
 	dev = find_device(ctx, usb_dev);
 
+	if (dev)
+		dev = jaylink_ref_device(dev);
+
+	thread_mutex_unlock(&ctx->lock);
+
 	if (dev) {
 		log_dbg(ctx, "Device: USB address = %u.", dev->usb_address);
 
@@ -185,7 +191,7 @@ static struct jaylink_device *probe_device(struct jaylink_context *ctx,
 			log_dbg(ctx, "Device: Serial number = N/A.");
 
 		log_dbg(ctx, "Using existing device instance.");
-		return jaylink_ref_device(dev);
+		return dev;
 	}
 
 	/* Open the device to be able to retrieve its serial number. */
@@ -225,11 +231,26 @@ static struct jaylink_device *probe_device(struct jaylink_context *ctx,
 	else
 		log_dbg(ctx, "Device: Serial number = N/A.");
 
+	/*
+	 * A device instance for this device may have been allocated by another
+	 * thread while the device was opened.
+	 */
+	thread_mutex_lock(&ctx->lock);
+	dev = find_device(ctx, usb_dev);
+
+	if (dev) {
+		dev = jaylink_ref_device(dev);
+		thread_mutex_unlock(&ctx->lock);
+		log_dbg(ctx, "Using existing device instance.");
+		return dev;
+	}
+
 	log_dbg(ctx, "Allocating new device instance.");
 
 	dev = device_allocate(ctx);
 
 	if (!dev) {
+		thread_mutex_unlock(&ctx->lock);
 		log_warn(ctx, "Device instance malloc failed.");
 		return NULL;
 	}
@@ -240,18 +261,29 @@ static struct jaylink_device *probe_device(struct jaylink_context *ctx,
 	dev->serial_number = serial_number;
 	dev->valid_serial_number = valid_serial_number;
 
+	if (!device_add(dev)) {
+		thread_mutex_unlock(&ctx->lock);
+		log_warn(ctx, "Failed to add device instance.");
+		libusb_unref_device(dev->usb_dev);
+		free(dev);
+		return NULL;
+	}
+
+	thread_mutex_unlock(&ctx->lock);
+
 	return dev;
 }
 
-JAYLINK_PRIV int discovery_usb_scan(struct jaylink_context *ctx)
+JAYLINK_PRIV int discovery_usb_scan(struct jaylink_context *ctx,
+		struct list **devs)
 {
 	ssize_t ret;
-	struct libusb_device **devs;
+	struct libusb_device **usb_devs;
 	struct jaylink_device *dev;
 	size_t num;
 	size_t i;
 
-	ret = libusb_get_device_list(ctx->usb_ctx, &devs);
+	ret = libusb_get_device_list(ctx->usb_ctx, &usb_devs);
 
 	if (ret == LIBUSB_ERROR_IO) {
 		log_err(ctx, "Failed to retrieve device list: input/output "
@@ -265,17 +297,17 @@ JAYLINK_PRIV int discovery_usb_scan(struct jaylink_context *ctx)
 
 	num = 0;
 
-	for (i = 0; devs[i]; i++) {
-		dev = probe_device(ctx, devs[i]);
+	for (i = 0; usb_devs[i]; i++) {
+		dev = probe_device(ctx, usb_devs[i]);
 
 		if (!dev)
 			continue;
 
-		ctx->discovered_devs = list_prepend(ctx->discovered_devs, dev);
+		*devs = list_prepend(*devs, dev);
 		num++;
 	}
 
-	libusb_free_device_list(devs, true);
+	libusb_free_device_list(usb_devs, true);
 	log_dbg(ctx, "Found %zu USB device(s).", num);
 
 	return JAYLINK_OK;
@@ -0,0 +1,596 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "libjaylink.h"
+#include "libjaylink-internal.h"
+
+/**
+ * @file
+ *
+ * RISC-V Debug Module Interface (DMI) access layer.
+ *
+ * DMI accesses are performed as scans of the dmi register of a RISC-V Debug
+ * Transport Module (DTM) according to the RISC-V debug specification 0.13.
+ * The accesses are collected and transferred with the JTAG scan engine as a
+ * single JTAG I/O operation when the access layer is flushed. Each scan is
+ * followed by a configurable number of Run-Test/Idle cycles.
+ *
+ * A scan captures the status and the read data of the previous access. The
+ * busy status indicates that an access was attempted while the previous one
+ * was still in progress. It is sticky and all further accesses are ignored
+ * until it is cleared with the dmireset bit of the dtmcs register. The scans
+ * starting with the first one which returned busy are resubmitted afterwards,
+ * with an increased number of idle cycles.
+ */
+
+/** @cond PRIVATE */
+#define IR_DTMCS		0x10
+#define IR_DMI			0x11
+
+/** Minimum instruction register length of a DTM in bits. */
+#define MIN_IR_LENGTH		5
+
+/** Number of bits of the dtmcs register. */
+#define DTMCS_BITS		32
+
+#define DTMCS_VERSION_MASK	0x0f
+#define DTMCS_VERSION_013	0x01
+#define DTMCS_ABITS_SHIFT	4
+#define DTMCS_ABITS_MASK	0x3f
+#define DTMCS_IDLE_SHIFT	12
+#define DTMCS_IDLE_MASK		0x07
+#define DTMCS_DMIRESET		(1 << 16)
+
+/** Number of data and op bits of the dmi register. */
+#define DMI_DATA_OP_BITS	34
+
+#define DMI_OP_NOP		0x00
+#define DMI_OP_READ		0x01
+#define DMI_OP_WRITE		0x02
+
+#define DMI_STATUS_SUCCESS	0x00
+#define DMI_STATUS_FAILED	0x02
+#define DMI_STATUS_BUSY		0x03
+
+/** Maximum number of resubmissions per flush. */
+#define MAX_RETRIES		16
+
+/** Initial number of accesses. */
+#define DMI_INITIAL_TRANSACTIONS	16
+/** @endcond */
+
+static int select_instruction(struct jaylink_dmi *dmi, uint8_t ir)
+{
+	int ret;
+	uint8_t buffer[4];
+
+	if (dmi->ir == ir)
+		return JAYLINK_OK;
+
+	memset(buffer, 0, sizeof(buffer));
+	buffer[0] = ir;
+
+	ret = jaylink_jtag_scan_ir(dmi->scan, buffer, NULL,
+		JAYLINK_TAP_STATE_IDLE);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	dmi->ir = ir;
+
+	return JAYLINK_OK;
+}
+
+/* Read the dtmcs register to determine the number of address bits. */
+static int read_dtmcs(struct jaylink_dmi *dmi)
+{
+	int ret;
+	struct jaylink_context *ctx;
+	uint8_t out[4];
+	uint8_t in[4];
+	uint32_t dtmcs;
+	size_t idle;
+
+	ctx = dmi->scan->devh->dev->ctx;
+	memset(out, 0, sizeof(out));
+
+	ret = jaylink_jtag_scan_select_tap(dmi->scan, dmi->tap);
+
+	if (ret == JAYLINK_OK)
+		ret = select_instruction(dmi, IR_DTMCS);
+
+	if (ret == JAYLINK_OK)
+		ret = jaylink_jtag_scan_dr(dmi->scan, out, in, DTMCS_BITS,
+			JAYLINK_TAP_STATE_IDLE);
+
+	if (ret == JAYLINK_OK)
+		ret = jaylink_jtag_scan_flush(dmi->scan);
+
+	if (ret != JAYLINK_OK) {
+		dmi->ir = 0;
+		return ret;
+	}
+
+	dtmcs = buffer_get_u32(in, 0);
+
+	if ((dtmcs & DTMCS_VERSION_MASK) != DTMCS_VERSION_013) {
+		log_err(ctx, "Unsupported DTM (dtmcs 0x%08x).", dtmcs);
+		return JAYLINK_ERR_TARGET;
+	}
+
+	dmi->abits = (dtmcs >> DTMCS_ABITS_SHIFT) & DTMCS_ABITS_MASK;
+
+	if (!dmi->abits || dmi->abits > 32) {
+		log_err(ctx, "Invalid number of DMI address bits: %zu.",
+			dmi->abits);
+		dmi->abits = 0;
+		return JAYLINK_ERR_TARGET;
+	}
+
+	/* The DTM hints at the number of required idle cycles. */
+	idle = (dtmcs >> DTMCS_IDLE_SHIFT) & DTMCS_IDLE_MASK;
+	idle_raise_min(&dmi->idle, idle);
+
+	log_dbg(ctx, "DTM with %zu DMI address bits and %zu idle cycle(s).",
+		dmi->abits, idle);
+
+	return JAYLINK_OK;
+}
+
+/*
+ * Transfer the pending accesses with a single JTAG I/O operation and verify
+ * their status. If requested, the sticky status is cleared first. The read
+ * data captured by the first scan is stored in the specified buffer, or
+ * discarded if NULL. On failure, the index of the failed scan is stored.
+ */
+static int perform_scans(struct jaylink_dmi *dmi, uint32_t *first_data,
+		bool reset, size_t *index)
+{
+	int ret;
+	struct jaylink_context *ctx;
+	const struct dmi_transaction *transaction;
+	uint8_t *tdi;
+	uint8_t *tdo;
+	uint8_t dtmcs[4];
+	uint32_t *data;
+	size_t length;
+	size_t num_bytes;
+	uint8_t status;
+	size_t i;
+
+	ctx = dmi->scan->devh->dev->ctx;
+	length = DMI_DATA_OP_BITS + dmi->abits;
+	num_bytes = (length + 7) / 8;
+	tdi = malloc(dmi->num_transactions * num_bytes + 1);
+	tdo = malloc(dmi->num_transactions * num_bytes + 1);
+
+	if (!tdi || !tdo) {
+		free(tdi);
+		free(tdo);
+		return JAYLINK_ERR_MALLOC;
+	}
+
+	ret = jaylink_jtag_scan_select_tap(dmi->scan, dmi->tap);
+
+	if (ret == JAYLINK_OK && reset) {
+		buffer_set_u32(dtmcs, DTMCS_DMIRESET, 0);
+		ret = select_instruction(dmi, IR_DTMCS);
+
+		if (ret == JAYLINK_OK)
+			ret = jaylink_jtag_scan_dr(dmi->scan, dtmcs, NULL,
+				DTMCS_BITS, JAYLINK_TAP_STATE_IDLE);
+
+		if (ret == JAYLINK_OK && dmi->idle.cycles > 0)
+			ret = jaylink_jtag_scan_idle(dmi->scan,
+				dmi->idle.cycles);
+	}
+
+	for (i = 0; i < dmi->num_transactions; i++) {
+		if (ret != JAYLINK_OK)
+			break;
+
+		transaction = &dmi->transactions[i];
+		ret = select_instruction(dmi, IR_DMI);
+
+		if (ret != JAYLINK_OK)
+			break;
+
+		jaylink_bitvec_set_field(tdi + i * num_bytes, 0,
+			transaction->op | ((uint64_t)transaction->value << 2),
+			DMI_DATA_OP_BITS);
+		jaylink_bitvec_set_field(tdi + i * num_bytes,
+			DMI_DATA_OP_BITS, transaction->address, dmi->abits);
+
+		ret = jaylink_jtag_scan_dr(dmi->scan, tdi + i * num_bytes,
+			tdo + i * num_bytes, length, JAYLINK_TAP_STATE_IDLE);
+
+		if (ret == JAYLINK_OK && dmi->idle.cycles > 0)
+			ret = jaylink_jtag_scan_idle(dmi->scan,
+				dmi->idle.cycles);
+	}
+
+	if (ret == JAYLINK_OK)
+		ret = jaylink_jtag_scan_flush(dmi->scan);
+
+	if (ret != JAYLINK_OK) {
+		dmi->ir = 0;
+		free(tdi);
+		free(tdo);
+		return ret;
+	}
+
+	data = first_data;
+
+	for (i = 0; i < dmi->num_transactions; i++) {
+		transaction = &dmi->transactions[i];
+		status = jaylink_bitvec_get_field(tdo + i * num_bytes, 0, 2);
+
+		if (status != DMI_STATUS_SUCCESS) {
+			log_dbg(ctx, "Scan %zu (op %u, address 0x%x) returned "
+				"status %u.", i, transaction->op,
+				transaction->address, status);
+			*index = i;
+			free(tdi);
+			free(tdo);
+
+			if (status == DMI_STATUS_BUSY)
+				return JAYLINK_ERR_TARGET_WAIT;
+			else if (status == DMI_STATUS_FAILED)
+				return JAYLINK_ERR_TARGET_FAULT;
+
+			return JAYLINK_ERR_TARGET;
+		}
+
+		/* The scan captures the read data of the previous access. */
+		if (data)
+			*data = jaylink_bitvec_get_field(tdo + i * num_bytes,
+				2, 32);
+
+		data = transaction->data;
+	}
+
+	free(tdi);
+	free(tdo);
+
+	return JAYLINK_OK;
+}
+
+static int append_transaction(struct jaylink_dmi *dmi, uint8_t op,
+		uint32_t address, uint32_t value, uint32_t *data)
+{
+	struct dmi_transaction *transactions;
+	size_t size;
+
+	if (dmi->num_transactions == dmi->transactions_size) {
+		size = dmi->transactions_size * 2;
+		transactions = realloc(dmi->transactions,
+			size * sizeof(*transactions));
+
+		if (!transactions)
+			return JAYLINK_ERR_MALLOC;
+
+		dmi->transactions = transactions;
+		dmi->transactions_size = size;
+	}
+
+	dmi->transactions[dmi->num_transactions].op = op;
+	dmi->transactions[dmi->num_transactions].address = address;
+	dmi->transactions[dmi->num_transactions].value = value;
+	dmi->transactions[dmi->num_transactions].data = data;
+	dmi->num_transactions++;
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Create a RISC-V DMI access layer.
+ *
+ * The selected TAP of the scan engine is used as RISC-V DTM. The number of
+ * DMI address bits is read from the dtmcs register with the first flush.
+ *
+ * @param[in,out] scan Scan engine. It must remain valid until the access layer
+ *                     is freed.
+ * @param[out] dmi Newly allocated access layer on success. Its content is
+ *                 undefined on failure.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @see jaylink_jtag_scan_set_chain()
+ * @see jaylink_jtag_scan_select_tap()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_dmi_new(struct jaylink_jtag_scan *scan,
+		struct jaylink_dmi **dmi)
+{
+	struct jaylink_dmi *tmp;
+	size_t ir_length;
+
+	if (!scan || !dmi || !scan->num_taps)
+		return JAYLINK_ERR_ARG;
+
+	ir_length = scan->ir_lengths[scan->tap];
+
+	if (ir_length < MIN_IR_LENGTH || ir_length > 32)
+		return JAYLINK_ERR_ARG;
+
+	tmp = malloc(sizeof(struct jaylink_dmi));
+
+	if (!tmp)
+		return JAYLINK_ERR_MALLOC;
+
+	tmp->transactions = malloc(DMI_INITIAL_TRANSACTIONS *
+		sizeof(struct dmi_transaction));
+
+	if (!tmp->transactions) {
+		free(tmp);
+		return JAYLINK_ERR_MALLOC;
+	}
+
+	tmp->scan = scan;
+	tmp->tap = scan->tap;
+	tmp->ir = 0;
+	tmp->abits = 0;
+	idle_init(&tmp->idle, 0);
+	tmp->num_transactions = 0;
+	tmp->transactions_size = DMI_INITIAL_TRANSACTIONS;
+	tmp->sbcs_valid = false;
+
+	*dmi = tmp;
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Free a RISC-V DMI access layer.
+ *
+ * Pending accesses are discarded.
+ *
+ * @param[in,out] dmi Access layer. If NULL, the function does nothing.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API void jaylink_dmi_free(struct jaylink_dmi *dmi)
+{
+	if (!dmi)
+		return;
+
+	free(dmi->transactions);
+	free(dmi);
+}
+
+/**
+ * Set the number of Run-Test/Idle cycles after each DMI access.
+ *
+ * The number is increased automatically if the DTM reports that an access
+ * was attempted while the previous one was still in progress, and decreased
+ * again after a number of accesses without such a report. It is never
+ * decreased below the number set with this function.
+ *
+ * @param[in,out] dmi Access layer.
+ * @param[in] num_cycles Number of idle cycles.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_dmi_set_idle(struct jaylink_dmi *dmi,
+		size_t num_cycles)
+{
+	if (!dmi || num_cycles > MAX_IDLE_CYCLES)
+		return JAYLINK_ERR_ARG;
+
+	idle_init(&dmi->idle, num_cycles);
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Read a Debug Module register.
+ *
+ * The buffer must remain valid until the access layer is flushed.
+ *
+ * @param[in,out] dmi Access layer.
+ * @param[in] address DMI address of the register.
+ * @param[out] value Buffer to store the value of the register when the access
+ *                   layer is flushed successfully, or NULL.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_dmi_read(struct jaylink_dmi *dmi, uint32_t address,
+		uint32_t *value)
+{
+	if (!dmi)
+		return JAYLINK_ERR_ARG;
+
+	return append_transaction(dmi, DMI_OP_READ, address, 0, value);
+}
+
+/**
+ * Write a Debug Module register.
+ *
+ * @param[in,out] dmi Access layer.
+ * @param[in] address DMI address of the register.
+ * @param[in] value Value to write.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_dmi_write(struct jaylink_dmi *dmi, uint32_t address,
+		uint32_t value)
+{
+	if (!dmi)
+		return JAYLINK_ERR_ARG;
+
+	return append_transaction(dmi, DMI_OP_WRITE, address, value, NULL);
+}
+
+/**
+ * Transfer the pending accesses of a RISC-V DMI access layer to the device.
+ *
+ * The accesses are transferred with a single JTAG I/O operation of the scan
+ * engine, followed by a no-operation scan which captures the result of the
+ * last access. Afterwards, the status of all accesses is verified in order.
+ * The results of the accesses before the first failed access are stored.
+ *
+ * Accesses which are ignored by the DTM because the previous access was still
+ * in progress are resubmitted with an increased number of idle cycles. After
+ * a failed access, the sticky status is cleared.
+ *
+ * @param[in,out] dmi Access layer.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR_DEV Unspecified device error.
+ * @retval JAYLINK_ERR_TARGET_WAIT The DTM remained busy.
+ * @retval JAYLINK_ERR_TARGET_FAULT A DMI access failed.
+ * @retval JAYLINK_ERR_TARGET Unsupported DTM or invalid status.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @see jaylink_jtag_scan_flush()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_dmi_flush(struct jaylink_dmi *dmi)
+{
+	int ret;
+	struct jaylink_context *ctx;
+	uint32_t *first_data;
+	size_t index;
+	size_t retries;
+	size_t i;
+
+	if (!dmi)
+		return JAYLINK_ERR_ARG;
+
+	if (!dmi->num_transactions)
+		return JAYLINK_OK;
+
+	ctx = dmi->scan->devh->dev->ctx;
+	ret = JAYLINK_OK;
+
+	if (!dmi->abits)
+		ret = read_dtmcs(dmi);
+
+	for (i = 0; i < dmi->num_transactions; i++) {
+		if (ret != JAYLINK_OK)
+			break;
+
+		if (dmi->abits < 32 &&
+				dmi->transactions[i].address >> dmi->abits)
+			ret = JAYLINK_ERR_ARG;
+	}
+
+	/* Capture the result of the last access. */
+	if (ret == JAYLINK_OK)
+		ret = append_transaction(dmi, DMI_OP_NOP, 0, 0, NULL);
+
+	if (ret != JAYLINK_OK) {
+		dmi->num_transactions = 0;
+		return ret;
+	}
+
+	first_data = NULL;
+	retries = 0;
+
+	while (true) {
+		ret = perform_scans(dmi, first_data, retries > 0, &index);
+
+		if (ret != JAYLINK_ERR_TARGET_WAIT || retries == MAX_RETRIES)
+			break;
+
+		idle_busy(&dmi->idle);
+		log_dbg(ctx, "Resubmitting %zu scan(s) with %zu idle cycle(s).",
+			dmi->num_transactions - index, dmi->idle.cycles);
+
+		/*
+		 * The first scan after the sticky status is cleared captures
+		 * the read data of the access before the failed one.
+		 */
+		if (index > 0)
+			first_data = dmi->transactions[index - 1].data;
+
+		memmove(dmi->transactions, dmi->transactions + index,
+			(dmi->num_transactions - index) *
+			sizeof(struct dmi_transaction));
+		dmi->num_transactions -= index;
+		retries++;
+	}
+
+	if (ret == JAYLINK_OK)
+		idle_success(&dmi->idle);
+
+	if (ret == JAYLINK_ERR_TARGET_FAULT ||
+			ret == JAYLINK_ERR_TARGET_WAIT) {
+		/* Clear the sticky status such that the DTM is usable again. */
+		dmi->num_transactions = 0;
+		perform_scans(dmi, NULL, true, &index);
+	}
+
+	dmi->num_transactions = 0;
+
+	return ret;
+}
+
+/**
+ * Retrieve the statistics of the adaptive idle cycles of a RISC-V DMI access
+ * layer.
+ *
+ * The number of idle cycles after each DMI access is doubled whenever the DTM
+ * or the Debug Module reports a busy condition and decreased again after a
+ * number of flushes without such a report.
+ *
+ * @param[in] dmi Access layer.
+ * @param[out] stats Statistics on success, and undefined on failure.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ *
+ * @see jaylink_dmi_set_idle()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_dmi_get_idle_stats(const struct jaylink_dmi *dmi,
+		struct jaylink_idle_stats *stats)
+{
+	if (!dmi || !stats)
+		return JAYLINK_ERR_ARG;
+
+	idle_get_stats(&dmi->idle, stats);
+
+	return JAYLINK_OK;
+}
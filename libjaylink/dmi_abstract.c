@@ -0,0 +1,651 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "libjaylink.h"
+#include "libjaylink-internal.h"
+
+/**
+ * @file
+ *
+ * Register and memory access via RISC-V abstract commands.
+ *
+ * The Access Register abstract command is used to access the registers of a
+ * halted hart. The commands and data accesses of many registers are collected
+ * and transferred with a single JTAG I/O operation. The abstractcs register is
+ * read only once at the end, the idle cycles after each DMI access must cover
+ * the execution time of a command.
+ *
+ * Memory is accessed by a loop in the program buffer which is executed after
+ * each command. The abstractauto register executes the command again whenever
+ * the data0 register is accessed such that each word requires a single DMI
+ * scan.
+ *
+ * If a register was accessed while a command was still executing, the batch
+ * is repeated with more idle cycles.
+ */
+
+/** @cond PRIVATE */
+#define DM_DATA0		0x04
+#define DM_DMCONTROL		0x10
+#define DM_ABSTRACTCS		0x16
+#define DM_COMMAND		0x17
+#define DM_ABSTRACTAUTO		0x18
+#define DM_PROGBUF0		0x20
+
+#define DMCONTROL_DMACTIVE	(1 << 0)
+#define DMCONTROL_HARTSELLO_SHIFT	16
+#define DMCONTROL_HARTSELHI_SHIFT	6
+#define DMCONTROL_HARTSEL_MASK		0x3ff
+
+#define ABSTRACTCS_CMDERR_SHIFT	8
+#define ABSTRACTCS_CMDERR_MASK	(0x07 << ABSTRACTCS_CMDERR_SHIFT)
+#define ABSTRACTCS_BUSY		(1 << 12)
+
+#define CMDERR_BUSY		1
+
+#define COMMAND_AARSIZE_32	(2 << 20)
+#define COMMAND_POSTEXEC	(1 << 18)
+#define COMMAND_TRANSFER	(1 << 17)
+#define COMMAND_WRITE		(1 << 16)
+
+#define ABSTRACTAUTO_DATA0	(1 << 0)
+
+/** Register numbers of s0 and s1. */
+#define REGNO_S0		0x1008
+#define REGNO_S1		0x1009
+
+/* Program buffer instructions. */
+#define INSN_LW_S1_S0		0x00042483
+#define INSN_SW_S1_S0		0x00942023
+#define INSN_ADDI_S0_S0_4	0x00440413
+#define INSN_EBREAK		0x00100073
+
+/** Maximum number of registers per flush of the access layer. */
+#define REG_BATCH_SIZE		256
+
+/** Maximum number of words per flush of the access layer. */
+#define MEM_BATCH_SIZE		1024
+
+/** Maximum number of repetitions of a batch. */
+#define MAX_RETRIES		16
+
+/** Maximum number of abstractcs reads while waiting for a command. */
+#define MAX_POLLS		64
+/** @endcond */
+
+static int select_hart(struct jaylink_dmi *dmi, uint32_t hart)
+{
+	return jaylink_dmi_write(dmi, DM_DMCONTROL, DMCONTROL_DMACTIVE |
+		((hart & DMCONTROL_HARTSEL_MASK) << DMCONTROL_HARTSELLO_SHIFT) |
+		(((hart >> 10) & DMCONTROL_HARTSEL_MASK) <<
+		DMCONTROL_HARTSELHI_SHIFT));
+}
+
+/*
+ * Check the value of the abstractcs register read at the end of a batch and
+ * clear the command error. Returns JAYLINK_ERR_TARGET_WAIT if the batch must
+ * be repeated.
+ */
+static int finish_batch(struct jaylink_dmi *dmi, uint32_t abstractcs)
+{
+	int ret;
+	struct jaylink_context *ctx;
+	uint32_t cmderr;
+	size_t polls;
+
+	ctx = dmi->scan->devh->dev->ctx;
+
+	for (polls = 0; (abstractcs & ABSTRACTCS_BUSY) && polls < MAX_POLLS;
+			polls++) {
+		ret = jaylink_dmi_read(dmi, DM_ABSTRACTCS, &abstractcs);
+
+		if (ret == JAYLINK_OK)
+			ret = jaylink_dmi_flush(dmi);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+	}
+
+	if (abstractcs & ABSTRACTCS_BUSY) {
+		log_err(ctx, "Abstract command remained busy.");
+		return JAYLINK_ERR_TIMEOUT;
+	}
+
+	cmderr = (abstractcs & ABSTRACTCS_CMDERR_MASK) >>
+		ABSTRACTCS_CMDERR_SHIFT;
+
+	if (!cmderr)
+		return JAYLINK_OK;
+
+	/* Also disable the automatic execution of a memory loop. */
+	ret = jaylink_dmi_write(dmi, DM_ABSTRACTCS, ABSTRACTCS_CMDERR_MASK);
+
+	if (ret == JAYLINK_OK)
+		ret = jaylink_dmi_write(dmi, DM_ABSTRACTAUTO, 0);
+
+	if (ret == JAYLINK_OK)
+		ret = jaylink_dmi_flush(dmi);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	if (cmderr != CMDERR_BUSY) {
+		log_err(ctx, "Abstract command failed (cmderr %u).", cmderr);
+		return JAYLINK_ERR_TARGET_FAULT;
+	}
+
+	log_dbg(ctx, "Abstract command busy, repeating batch with %zu idle "
+		"cycle(s).", dmi->idle.cycles);
+
+	return JAYLINK_ERR_TARGET_WAIT;
+}
+
+/*
+ * Transfer the pending accesses together with a read of the abstractcs
+ * register and check for command errors. If the read cannot be queued, the
+ * accesses queued after the first num_queued ones are removed because their
+ * read data would otherwise be stored after the buffers are released.
+ */
+static int flush_batch(struct jaylink_dmi *dmi, size_t num_queued)
+{
+	int ret;
+	uint32_t abstractcs;
+
+	ret = jaylink_dmi_read(dmi, DM_ABSTRACTCS, &abstractcs);
+
+	if (ret != JAYLINK_OK) {
+		dmi->num_transactions = num_queued;
+		return ret;
+	}
+
+	ret = jaylink_dmi_flush(dmi);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	return finish_batch(dmi, abstractcs);
+}
+
+/*
+ * Queue the accesses of a batch of registers. The values are written if
+ * specified, and read otherwise.
+ */
+static int queue_reg_accesses(struct jaylink_dmi *dmi, uint32_t hart,
+		const uint16_t *regnos, uint32_t *in, const uint32_t *out,
+		size_t num)
+{
+	int ret;
+	size_t i;
+
+	ret = select_hart(dmi, hart);
+
+	for (i = 0; i < num; i++) {
+		if (ret != JAYLINK_OK)
+			break;
+
+		if (out) {
+			ret = jaylink_dmi_write(dmi, DM_DATA0, out[i]);
+
+			if (ret == JAYLINK_OK)
+				ret = jaylink_dmi_write(dmi, DM_COMMAND,
+					COMMAND_AARSIZE_32 | COMMAND_TRANSFER |
+					COMMAND_WRITE | regnos[i]);
+		} else {
+			ret = jaylink_dmi_write(dmi, DM_COMMAND,
+				COMMAND_AARSIZE_32 | COMMAND_TRANSFER |
+				regnos[i]);
+
+			if (ret == JAYLINK_OK)
+				ret = jaylink_dmi_read(dmi, DM_DATA0, &in[i]);
+		}
+	}
+
+	return ret;
+}
+
+static int access_registers(struct jaylink_dmi *dmi, uint32_t hart,
+		const uint16_t *regnos, uint32_t *in, const uint32_t *out,
+		size_t num)
+{
+	int ret;
+	size_t pos;
+	size_t batch;
+	size_t num_queued;
+	size_t retries;
+
+	pos = 0;
+	retries = 0;
+
+	while (pos < num) {
+		batch = MIN(num - pos, REG_BATCH_SIZE);
+		num_queued = dmi->num_transactions;
+		ret = queue_reg_accesses(dmi, hart, regnos + pos,
+			out ? NULL : in + pos, out ? out + pos : NULL, batch);
+
+		/* Do not leave a partial batch in the queue. */
+		if (ret == JAYLINK_OK)
+			ret = flush_batch(dmi, num_queued);
+		else
+			dmi->num_transactions = num_queued;
+
+		if (ret == JAYLINK_ERR_TARGET_WAIT && retries < MAX_RETRIES) {
+			idle_busy(&dmi->idle);
+			retries++;
+			continue;
+		}
+
+		if (ret != JAYLINK_OK)
+			return ret;
+
+		pos += batch;
+	}
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Read registers of a RISC-V hart via abstract commands.
+ *
+ * The hart must be halted. Only 32-bit register accesses are supported.
+ * Pending accesses of the access layer are transferred together with the
+ * first registers.
+ *
+ * @param[in,out] dmi Access layer.
+ * @param[in] hart Index of the hart.
+ * @param[in] regnos Numbers of the registers as used by the Access Register
+ *                   abstract command. 0x0000 to 0x0fff are CSRs, 0x1000 to
+ *                   0x101f are GPRs.
+ * @param[out] values Buffer to store the register values on success. Its
+ *                    content is undefined on failure.
+ * @param[in] num Number of registers.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR_DEV Unspecified device error.
+ * @retval JAYLINK_ERR_TARGET_WAIT The abstract commands remained busy.
+ * @retval JAYLINK_ERR_TARGET_FAULT An abstract command or DMI access failed.
+ * @retval JAYLINK_ERR_TARGET Unsupported DTM or invalid status.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @see jaylink_dmi_flush()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_dmi_reg_read(struct jaylink_dmi *dmi, uint32_t hart,
+		const uint16_t *regnos, uint32_t *values, size_t num)
+{
+	if (!dmi || !regnos || !values || !num)
+		return JAYLINK_ERR_ARG;
+
+	return access_registers(dmi, hart, regnos, values, NULL, num);
+}
+
+/**
+ * Write registers of a RISC-V hart via abstract commands.
+ *
+ * The hart must be halted. Only 32-bit register accesses are supported.
+ * Pending accesses of the access layer are transferred together with the
+ * first registers.
+ *
+ * @param[in,out] dmi Access layer.
+ * @param[in] hart Index of the hart.
+ * @param[in] regnos Numbers of the registers as used by the Access Register
+ *                   abstract command. 0x0000 to 0x0fff are CSRs, 0x1000 to
+ *                   0x101f are GPRs.
+ * @param[in] values Values to write.
+ * @param[in] num Number of registers.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR_DEV Unspecified device error.
+ * @retval JAYLINK_ERR_TARGET_WAIT The abstract commands remained busy.
+ * @retval JAYLINK_ERR_TARGET_FAULT An abstract command or DMI access failed.
+ * @retval JAYLINK_ERR_TARGET Unsupported DTM or invalid status.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @see jaylink_dmi_flush()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_dmi_reg_write(struct jaylink_dmi *dmi, uint32_t hart,
+		const uint16_t *regnos, const uint32_t *values, size_t num)
+{
+	if (!dmi || !regnos || !values || !num)
+		return JAYLINK_ERR_ARG;
+
+	return access_registers(dmi, hart, regnos, NULL, values, num);
+}
+
+static int write_progbuf(struct jaylink_dmi *dmi, uint32_t insn)
+{
+	int ret;
+
+	ret = jaylink_dmi_write(dmi, DM_PROGBUF0, insn);
+
+	if (ret == JAYLINK_OK)
+		ret = jaylink_dmi_write(dmi, DM_PROGBUF0 + 1,
+			INSN_ADDI_S0_S0_4);
+
+	if (ret == JAYLINK_OK)
+		ret = jaylink_dmi_write(dmi, DM_PROGBUF0 + 2, INSN_EBREAK);
+
+	return ret;
+}
+
+/*
+ * Queue the reads of a batch of words. Writing s0 loads the first word into
+ * s1. Each command reads s1 into data0 and loads the next word. The last
+ * command does not execute the program buffer to not read beyond the end.
+ */
+static int queue_word_reads(struct jaylink_dmi *dmi, uint32_t address,
+		uint32_t *values, size_t num)
+{
+	int ret;
+	size_t i;
+
+	ret = jaylink_dmi_write(dmi, DM_DATA0, address);
+
+	if (ret == JAYLINK_OK)
+		ret = jaylink_dmi_write(dmi, DM_COMMAND, COMMAND_AARSIZE_32 |
+			COMMAND_POSTEXEC | COMMAND_TRANSFER | COMMAND_WRITE |
+			REGNO_S0);
+
+	if (ret == JAYLINK_OK && num > 1)
+		ret = jaylink_dmi_write(dmi, DM_COMMAND, COMMAND_AARSIZE_32 |
+			COMMAND_POSTEXEC | COMMAND_TRANSFER | REGNO_S1);
+
+	if (ret == JAYLINK_OK && num > 2)
+		ret = jaylink_dmi_write(dmi, DM_ABSTRACTAUTO,
+			ABSTRACTAUTO_DATA0);
+
+	for (i = 0; i + 2 < num; i++) {
+		if (ret != JAYLINK_OK)
+			break;
+
+		ret = jaylink_dmi_read(dmi, DM_DATA0, &values[i]);
+	}
+
+	if (ret == JAYLINK_OK && num > 2)
+		ret = jaylink_dmi_write(dmi, DM_ABSTRACTAUTO, 0);
+
+	if (ret == JAYLINK_OK && num > 1)
+		ret = jaylink_dmi_read(dmi, DM_DATA0, &values[num - 2]);
+
+	if (ret == JAYLINK_OK)
+		ret = jaylink_dmi_write(dmi, DM_COMMAND, COMMAND_AARSIZE_32 |
+			COMMAND_TRANSFER | REGNO_S1);
+
+	if (ret == JAYLINK_OK)
+		ret = jaylink_dmi_read(dmi, DM_DATA0, &values[num - 1]);
+
+	return ret;
+}
+
+/*
+ * Queue the writes of a batch of words. Each command writes data0 into s1
+ * and stores it.
+ */
+static int queue_word_writes(struct jaylink_dmi *dmi, uint32_t address,
+		const uint8_t *buffer, size_t num)
+{
+	int ret;
+	size_t i;
+
+	ret = jaylink_dmi_write(dmi, DM_DATA0, address);
+
+	if (ret == JAYLINK_OK)
+		ret = jaylink_dmi_write(dmi, DM_COMMAND, COMMAND_AARSIZE_32 |
+			COMMAND_TRANSFER | COMMAND_WRITE | REGNO_S0);
+
+	if (ret == JAYLINK_OK)
+		ret = jaylink_dmi_write(dmi, DM_DATA0,
+			buffer_get_u32(buffer, 0));
+
+	if (ret == JAYLINK_OK)
+		ret = jaylink_dmi_write(dmi, DM_COMMAND, COMMAND_AARSIZE_32 |
+			COMMAND_POSTEXEC | COMMAND_TRANSFER | COMMAND_WRITE |
+			REGNO_S1);
+
+	if (ret == JAYLINK_OK && num > 1)
+		ret = jaylink_dmi_write(dmi, DM_ABSTRACTAUTO,
+			ABSTRACTAUTO_DATA0);
+
+	for (i = 1; i < num; i++) {
+		if (ret != JAYLINK_OK)
+			break;
+
+		ret = jaylink_dmi_write(dmi, DM_DATA0,
+			buffer_get_u32(buffer, i * 4));
+	}
+
+	if (ret == JAYLINK_OK && num > 1)
+		ret = jaylink_dmi_write(dmi, DM_ABSTRACTAUTO, 0);
+
+	return ret;
+}
+
+/*
+ * Access memory with a loop in the program buffer. The data is written if
+ * specified, and read otherwise. The program buffer is written with each
+ * batch such that a repeated batch does not depend on a previous one.
+ */
+static int access_memory(struct jaylink_dmi *dmi, uint32_t hart,
+		uint32_t address, uint8_t *in, const uint8_t *out,
+		size_t length)
+{
+	int ret;
+	uint32_t *values;
+	size_t pos;
+	size_t num;
+	size_t num_queued;
+	size_t retries;
+	size_t i;
+
+	values = malloc(MEM_BATCH_SIZE * sizeof(uint32_t));
+
+	if (!values)
+		return JAYLINK_ERR_MALLOC;
+
+	ret = JAYLINK_OK;
+	pos = 0;
+	retries = 0;
+
+	while (pos < length) {
+		num = MIN((length - pos) / 4, MEM_BATCH_SIZE);
+		num_queued = dmi->num_transactions;
+		ret = select_hart(dmi, hart);
+
+		if (ret == JAYLINK_OK)
+			ret = write_progbuf(dmi, out ? INSN_SW_S1_S0 :
+				INSN_LW_S1_S0);
+
+		if (ret == JAYLINK_OK && out)
+			ret = queue_word_writes(dmi, address + pos,
+				out + pos, num);
+		else if (ret == JAYLINK_OK)
+			ret = queue_word_reads(dmi, address + pos, values,
+				num);
+
+		/*
+		 * Do not leave a partial batch in the queue because the read
+		 * data is stored in the buffer released on return.
+		 */
+		if (ret == JAYLINK_OK)
+			ret = flush_batch(dmi, num_queued);
+		else
+			dmi->num_transactions = num_queued;
+
+		if (ret == JAYLINK_ERR_TARGET_WAIT && retries < MAX_RETRIES) {
+			idle_busy(&dmi->idle);
+			retries++;
+			continue;
+		}
+
+		if (ret != JAYLINK_OK)
+			break;
+
+		for (i = 0; !out && i < num; i++)
+			buffer_set_u32(in, values[i], pos + i * 4);
+
+		pos += num * 4;
+	}
+
+	free(values);
+
+	return ret;
+}
+
+static int save_registers(struct jaylink_dmi *dmi, uint32_t hart,
+		uint32_t *values)
+{
+	static const uint16_t regnos[2] = {REGNO_S0, REGNO_S1};
+
+	return access_registers(dmi, hart, regnos, values, NULL, 2);
+}
+
+static int restore_registers(struct jaylink_dmi *dmi, uint32_t hart,
+		const uint32_t *values)
+{
+	static const uint16_t regnos[2] = {REGNO_S0, REGNO_S1};
+
+	return access_registers(dmi, hart, regnos, NULL, values, 2);
+}
+
+/**
+ * Read memory via the program buffer of a RISC-V hart.
+ *
+ * The hart must be halted and the program buffer must hold at least three
+ * instructions. The registers s0 and s1 of the hart are used and restored
+ * afterwards. Pending accesses of the access layer are transferred together
+ * with the first part of the memory read.
+ *
+ * @param[in,out] dmi Access layer.
+ * @param[in] hart Index of the hart.
+ * @param[in] address Address of the first byte to read. Must be 32-bit
+ *                    aligned.
+ * @param[out] buffer Buffer to store the read data on success. Its content is
+ *                    undefined on failure.
+ * @param[in] length Number of bytes to read. Must be a multiple of 4.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR_DEV Unspecified device error.
+ * @retval JAYLINK_ERR_TARGET_WAIT The abstract commands remained busy.
+ * @retval JAYLINK_ERR_TARGET_FAULT An abstract command, for example due to an
+ *                                  invalid address, or a DMI access failed.
+ * @retval JAYLINK_ERR_TARGET Unsupported DTM or invalid status.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @see jaylink_dmi_flush()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_dmi_prog_mem_read(struct jaylink_dmi *dmi,
+		uint32_t hart, uint32_t address, uint8_t *buffer,
+		size_t length)
+{
+	int ret;
+	int tmp;
+	uint32_t saved[2];
+
+	if (!dmi || !buffer || !length || (address & 3) || (length & 3))
+		return JAYLINK_ERR_ARG;
+
+	ret = save_registers(dmi, hart, saved);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	ret = access_memory(dmi, hart, address, buffer, NULL, length);
+	tmp = restore_registers(dmi, hart, saved);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	return tmp;
+}
+
+/**
+ * Write memory via the program buffer of a RISC-V hart.
+ *
+ * The hart must be halted and the program buffer must hold at least three
+ * instructions. The registers s0 and s1 of the hart are used and restored
+ * afterwards. Pending accesses of the access layer are transferred together
+ * with the first part of the memory write.
+ *
+ * @param[in,out] dmi Access layer.
+ * @param[in] hart Index of the hart.
+ * @param[in] address Address of the first byte to write. Must be 32-bit
+ *                    aligned.
+ * @param[in] buffer Buffer to read the data from.
+ * @param[in] length Number of bytes to write. Must be a multiple of 4.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR_DEV Unspecified device error.
+ * @retval JAYLINK_ERR_TARGET_WAIT The abstract commands remained busy.
+ * @retval JAYLINK_ERR_TARGET_FAULT An abstract command, for example due to an
+ *                                  invalid address, or a DMI access failed.
+ * @retval JAYLINK_ERR_TARGET Unsupported DTM or invalid status.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @see jaylink_dmi_flush()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_dmi_prog_mem_write(struct jaylink_dmi *dmi,
+		uint32_t hart, uint32_t address, const uint8_t *buffer,
+		size_t length)
+{
+	int ret;
+	int tmp;
+	uint32_t saved[2];
+
+	if (!dmi || !buffer || !length || (address & 3) || (length & 3))
+		return JAYLINK_ERR_ARG;
+
+	ret = save_registers(dmi, hart, saved);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	ret = access_memory(dmi, hart, address, NULL, buffer, length);
+	tmp = restore_registers(dmi, hart, saved);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	return tmp;
+}
@@ -0,0 +1,536 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "libjaylink.h"
+#include "libjaylink-internal.h"
+
+/**
+ * @file
+ *
+ * Memory access via RISC-V System Bus Access (SBA).
+ *
+ * Memory is accessed through the sbdata0 register of the Debug Module with
+ * automatic increment of the sbaddress0 register. For reads, writing the
+ * address and reading the data trigger the next system bus read such that
+ * each access requires a single DMI scan. The accesses are collected in
+ * batches which are transferred with a single JTAG I/O operation each.
+ *
+ * Each batch consists of accesses with the same size only such that the sbcs
+ * register is written at the beginning of the batch while the system bus is
+ * idle. The sbcs register is read at the end of each batch. If an access was
+ * attempted while the system bus was still busy, the batch is repeated with
+ * more idle cycles after each DMI access.
+ */
+
+/** @cond PRIVATE */
+#define DM_SBCS			0x38
+#define DM_SBADDRESS0		0x39
+#define DM_SBADDRESS1		0x3a
+#define DM_SBDATA0		0x3c
+
+#define SBCS_SBVERSION_SHIFT	29
+#define SBCS_SBVERSION_MASK	0x07
+#define SBCS_SBVERSION_013	0x01
+#define SBCS_SBBUSYERROR	(1 << 22)
+#define SBCS_SBBUSY		(1 << 21)
+#define SBCS_SBREADONADDR	(1 << 20)
+#define SBCS_SBACCESS_SHIFT	17
+#define SBCS_SBAUTOINCREMENT	(1 << 16)
+#define SBCS_SBREADONDATA	(1 << 15)
+#define SBCS_SBERROR_SHIFT	12
+#define SBCS_SBERROR_MASK	(0x07 << SBCS_SBERROR_SHIFT)
+#define SBCS_SBASIZE_SHIFT	5
+#define SBCS_SBASIZE_MASK	0x7f
+#define SBCS_SBACCESS8		(1 << 0)
+#define SBCS_SBACCESS16		(1 << 1)
+#define SBCS_SBACCESS32		(1 << 2)
+
+/** Maximum number of accesses per flush of the access layer. */
+#define MEM_BATCH_SIZE		1024
+
+/** Maximum number of repetitions of a batch. */
+#define MAX_RETRIES		16
+
+/** Maximum number of sbcs reads while waiting for the system bus. */
+#define MAX_POLLS		64
+/** @endcond */
+
+/* Read the sbcs register once to determine the SBA capabilities. */
+static int prepare_sba(struct jaylink_dmi *dmi)
+{
+	int ret;
+	struct jaylink_context *ctx;
+	uint32_t sbcs;
+
+	if (dmi->sbcs_valid)
+		return JAYLINK_OK;
+
+	ctx = dmi->scan->devh->dev->ctx;
+	ret = jaylink_dmi_read(dmi, DM_SBCS, &sbcs);
+
+	if (ret == JAYLINK_OK)
+		ret = jaylink_dmi_flush(dmi);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	if (((sbcs >> SBCS_SBVERSION_SHIFT) & SBCS_SBVERSION_MASK) !=
+			SBCS_SBVERSION_013 ||
+			!((sbcs >> SBCS_SBASIZE_SHIFT) & SBCS_SBASIZE_MASK)) {
+		log_err(ctx, "System bus access not supported (sbcs 0x%08x).",
+			sbcs);
+		return JAYLINK_ERR_TARGET;
+	}
+
+	/* Clear errors of previous accesses. */
+	if (sbcs & (SBCS_SBBUSYERROR | SBCS_SBERROR_MASK)) {
+		ret = jaylink_dmi_write(dmi, DM_SBCS,
+			SBCS_SBBUSYERROR | SBCS_SBERROR_MASK);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+	}
+
+	/* Only 32-bit addresses are used. */
+	if (((sbcs >> SBCS_SBASIZE_SHIFT) & SBCS_SBASIZE_MASK) > 32) {
+		ret = jaylink_dmi_write(dmi, DM_SBADDRESS1, 0);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+	}
+
+	dmi->sbcs = sbcs;
+	dmi->sbcs_valid = true;
+
+	return JAYLINK_OK;
+}
+
+/*
+ * Determine the largest supported access size for the address and the
+ * remaining number of bytes, or 0 if there is none.
+ */
+static uint32_t access_size(const struct jaylink_dmi *dmi, uint32_t address,
+		size_t remaining)
+{
+	if ((dmi->sbcs & SBCS_SBACCESS32) && !(address & 3) && remaining >= 4)
+		return 4;
+	else if ((dmi->sbcs & SBCS_SBACCESS16) && !(address & 1) &&
+			remaining >= 2)
+		return 2;
+	else if (dmi->sbcs & SBCS_SBACCESS8)
+		return 1;
+
+	return 0;
+}
+
+static uint32_t sbaccess(uint32_t size)
+{
+	if (size == 4)
+		return 2 << SBCS_SBACCESS_SHIFT;
+	else if (size == 2)
+		return 1 << SBCS_SBACCESS_SHIFT;
+
+	return 0;
+}
+
+/*
+ * Determine the number of consecutive accesses with the same size, limited to
+ * the specified maximum.
+ */
+static size_t run_length(const struct jaylink_dmi *dmi, uint32_t address,
+		size_t remaining, uint32_t size, size_t max)
+{
+	size_t num;
+
+	num = 0;
+
+	while (num < max && remaining >= size &&
+			access_size(dmi, address, remaining) == size) {
+		address += size;
+		remaining -= size;
+		num++;
+	}
+
+	return num;
+}
+
+/*
+ * Check the value of the sbcs register read at the end of a batch and clear
+ * the errors. Returns JAYLINK_ERR_TARGET_WAIT if the batch must be repeated.
+ */
+static int finish_batch(struct jaylink_dmi *dmi, uint32_t sbcs)
+{
+	int ret;
+	struct jaylink_context *ctx;
+	size_t polls;
+
+	ctx = dmi->scan->devh->dev->ctx;
+
+	/* Wait for the last write of the batch. */
+	for (polls = 0; (sbcs & SBCS_SBBUSY) && polls < MAX_POLLS; polls++) {
+		ret = jaylink_dmi_read(dmi, DM_SBCS, &sbcs);
+
+		if (ret == JAYLINK_OK)
+			ret = jaylink_dmi_flush(dmi);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+	}
+
+	if (sbcs & SBCS_SBBUSY) {
+		log_err(ctx, "System bus remained busy.");
+		return JAYLINK_ERR_TIMEOUT;
+	}
+
+	if (!(sbcs & (SBCS_SBBUSYERROR | SBCS_SBERROR_MASK)))
+		return JAYLINK_OK;
+
+	ret = jaylink_dmi_write(dmi, DM_SBCS,
+		SBCS_SBBUSYERROR | SBCS_SBERROR_MASK);
+
+	if (ret == JAYLINK_OK)
+		ret = jaylink_dmi_flush(dmi);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	if (sbcs & SBCS_SBERROR_MASK) {
+		log_err(ctx, "System bus access failed (sberror %u).",
+			(sbcs & SBCS_SBERROR_MASK) >> SBCS_SBERROR_SHIFT);
+		return JAYLINK_ERR_TARGET_FAULT;
+	}
+
+	log_dbg(ctx, "System bus busy, repeating batch with %zu idle "
+		"cycle(s).", dmi->idle.cycles);
+
+	return JAYLINK_ERR_TARGET_WAIT;
+}
+
+/*
+ * Queue the reads of a batch. The batch starts with the address write, which
+ * triggers the first read. All reads of sbdata0 except the last one trigger
+ * the next read.
+ *
+ * The sbcs register is read after the last triggered read. The automatic read
+ * on sbdata0 reads is disabled afterwards in order to not read beyond the end
+ * of the batch. This write of the sbcs register is only valid if the status
+ * indicates that the system bus was not busy anymore.
+ */
+static int queue_reads(struct jaylink_dmi *dmi, uint32_t address,
+		size_t length, uint32_t *values, uint32_t *status,
+		size_t *num_bytes)
+{
+	int ret;
+	uint32_t sbcs;
+	uint32_t size;
+	size_t num_queued;
+	size_t num;
+	size_t i;
+
+	size = access_size(dmi, address, length);
+
+	if (!size)
+		return JAYLINK_ERR_TARGET;
+
+	num_queued = dmi->num_transactions;
+	num = run_length(dmi, address, length, size, MEM_BATCH_SIZE);
+	sbcs = SBCS_SBREADONADDR | sbaccess(size) | SBCS_SBAUTOINCREMENT;
+
+	if (num > 1)
+		sbcs |= SBCS_SBREADONDATA;
+
+	ret = jaylink_dmi_write(dmi, DM_SBCS, sbcs);
+
+	if (ret == JAYLINK_OK)
+		ret = jaylink_dmi_write(dmi, DM_SBADDRESS0, address);
+
+	for (i = 0; i < num - 1; i++) {
+		if (ret != JAYLINK_OK)
+			break;
+
+		ret = jaylink_dmi_read(dmi, DM_SBDATA0, &values[i]);
+	}
+
+	/* The status is read with the same JTAG I/O operation. */
+	if (ret == JAYLINK_OK)
+		ret = jaylink_dmi_read(dmi, DM_SBCS, status);
+
+	if (ret == JAYLINK_OK && num > 1)
+		ret = jaylink_dmi_write(dmi, DM_SBCS,
+			sbcs & ~SBCS_SBREADONDATA);
+
+	if (ret == JAYLINK_OK)
+		ret = jaylink_dmi_read(dmi, DM_SBDATA0, &values[num - 1]);
+
+	/*
+	 * Remove the accesses of this batch from the queue because their read
+	 * data would otherwise be stored after the buffers are released.
+	 */
+	if (ret != JAYLINK_OK) {
+		dmi->num_transactions = num_queued;
+		return ret;
+	}
+
+	*num_bytes = num * size;
+
+	return JAYLINK_OK;
+}
+
+/* Queue the writes of a batch, followed by a read of the sbcs register. */
+static int queue_writes(struct jaylink_dmi *dmi, uint32_t address,
+		const uint8_t *buffer, size_t length, uint32_t *status,
+		size_t *num_bytes)
+{
+	int ret;
+	uint32_t size;
+	uint32_t value;
+	size_t num_queued;
+	size_t num;
+	size_t pos;
+	size_t i;
+
+	size = access_size(dmi, address, length);
+
+	if (!size)
+		return JAYLINK_ERR_TARGET;
+
+	num_queued = dmi->num_transactions;
+	num = run_length(dmi, address, length, size, MEM_BATCH_SIZE);
+	pos = 0;
+
+	ret = jaylink_dmi_write(dmi, DM_SBCS, sbaccess(size) |
+		SBCS_SBAUTOINCREMENT);
+
+	if (ret == JAYLINK_OK)
+		ret = jaylink_dmi_write(dmi, DM_SBADDRESS0, address);
+
+	for (i = 0; i < num; i++) {
+		if (ret != JAYLINK_OK)
+			break;
+
+		if (size == 4)
+			value = buffer_get_u32(buffer, pos);
+		else if (size == 2)
+			value = buffer_get_u16(buffer, pos);
+		else
+			value = buffer[pos];
+
+		ret = jaylink_dmi_write(dmi, DM_SBDATA0, value);
+		pos += size;
+	}
+
+	/* The status is read with the same JTAG I/O operation. */
+	if (ret == JAYLINK_OK)
+		ret = jaylink_dmi_read(dmi, DM_SBCS, status);
+
+	/* Do not leave a partial batch in the queue. */
+	if (ret != JAYLINK_OK) {
+		dmi->num_transactions = num_queued;
+		return ret;
+	}
+
+	*num_bytes = pos;
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Read memory via RISC-V System Bus Access.
+ *
+ * The largest access size supported by the system bus is used for each part
+ * of the memory range. Pending accesses of the access layer are transferred
+ * together with the first part of the memory read.
+ *
+ * @param[in,out] dmi Access layer.
+ * @param[in] address Address of the first byte to read.
+ * @param[out] buffer Buffer to store the read data on success. Its content is
+ *                    undefined on failure.
+ * @param[in] length Number of bytes to read.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR_DEV Unspecified device error.
+ * @retval JAYLINK_ERR_TARGET_WAIT The system bus remained busy.
+ * @retval JAYLINK_ERR_TARGET_FAULT A system bus or DMI access failed.
+ * @retval JAYLINK_ERR_TARGET System bus access or the required access size is
+ *                            not supported. Other access methods, for example
+ *                            abstract commands, must be used instead.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @see jaylink_dmi_flush()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_dmi_mem_read(struct jaylink_dmi *dmi,
+		uint32_t address, uint8_t *buffer, size_t length)
+{
+	int ret;
+	uint32_t *values;
+	uint32_t size;
+	uint32_t sbcs;
+	size_t pos;
+	size_t num_bytes;
+	size_t retries;
+	size_t i;
+
+	if (!dmi || !buffer || !length)
+		return JAYLINK_ERR_ARG;
+
+	ret = prepare_sba(dmi);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	values = malloc(MEM_BATCH_SIZE * sizeof(uint32_t));
+
+	if (!values)
+		return JAYLINK_ERR_MALLOC;
+
+	pos = 0;
+	retries = 0;
+
+	while (pos < length) {
+		ret = queue_reads(dmi, address + pos, length - pos, values,
+			&sbcs, &num_bytes);
+
+		if (ret == JAYLINK_OK)
+			ret = jaylink_dmi_flush(dmi);
+
+		if (ret == JAYLINK_OK)
+			ret = finish_batch(dmi, sbcs);
+
+		/*
+		 * Repeat the batch if the sbcs register was written while the
+		 * last read was still in progress.
+		 */
+		if (ret == JAYLINK_OK && (sbcs & SBCS_SBBUSY))
+			ret = JAYLINK_ERR_TARGET_WAIT;
+
+		if (ret == JAYLINK_ERR_TARGET_WAIT && retries < MAX_RETRIES) {
+			idle_busy(&dmi->idle);
+			retries++;
+			continue;
+		}
+
+		if (ret != JAYLINK_OK) {
+			free(values);
+			return ret;
+		}
+
+		/* The read data is in the low-order bits. */
+		for (i = 0; num_bytes > 0; i++) {
+			size = access_size(dmi, address + pos, length - pos);
+
+			if (size == 4)
+				buffer_set_u32(buffer, values[i], pos);
+			else if (size == 2)
+				buffer_set_u16(buffer, values[i], pos);
+			else
+				buffer[pos] = values[i];
+
+			pos += size;
+			num_bytes -= size;
+		}
+	}
+
+	free(values);
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Write memory via RISC-V System Bus Access.
+ *
+ * The largest access size supported by the system bus is used for each part
+ * of the memory range. Pending accesses of the access layer are transferred
+ * together with the first part of the memory write.
+ *
+ * @param[in,out] dmi Access layer.
+ * @param[in] address Address of the first byte to write.
+ * @param[in] buffer Buffer to read the data from.
+ * @param[in] length Number of bytes to write.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR_DEV Unspecified device error.
+ * @retval JAYLINK_ERR_TARGET_WAIT The system bus remained busy.
+ * @retval JAYLINK_ERR_TARGET_FAULT A system bus or DMI access failed.
+ * @retval JAYLINK_ERR_TARGET System bus access or the required access size is
+ *                            not supported. Other access methods, for example
+ *                            abstract commands, must be used instead.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @see jaylink_dmi_flush()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_dmi_mem_write(struct jaylink_dmi *dmi,
+		uint32_t address, const uint8_t *buffer, size_t length)
+{
+	int ret;
+	uint32_t sbcs;
+	size_t pos;
+	size_t num_bytes;
+	size_t retries;
+
+	if (!dmi || !buffer || !length)
+		return JAYLINK_ERR_ARG;
+
+	ret = prepare_sba(dmi);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	pos = 0;
+	retries = 0;
+
+	while (pos < length) {
+		ret = queue_writes(dmi, address + pos, buffer + pos,
+			length - pos, &sbcs, &num_bytes);
+
+		if (ret == JAYLINK_OK)
+			ret = jaylink_dmi_flush(dmi);
+
+		if (ret == JAYLINK_OK)
+			ret = finish_batch(dmi, sbcs);
+
+		if (ret == JAYLINK_ERR_TARGET_WAIT && retries < MAX_RETRIES) {
+			idle_busy(&dmi->idle);
+			retries++;
+			continue;
+		}
+
+		if (ret != JAYLINK_OK)
+			return ret;
+
+		pos += num_bytes;
+	}
+
+	return JAYLINK_OK;
+}
@@ -59,38 +59,7 @@
 #define EMUCOM_AVAILABLE_BYTES_MASK	0x00ffffff
 /** @endcond */
 
-/**
- * Read from an EMUCOM channel.
- *
- * @note This function must only be used if the device has the
- *       #JAYLINK_DEV_CAP_EMUCOM capability.
- *
- * @param[in,out] devh Device handle.
- * @param[in] channel Channel to read data from.
- * @param[out] buffer Buffer to store read data on success. Its content is
- *                    undefined on failure.
- * @param[in,out] length Number of bytes to read. On success, the value gets
- *                       updated with the actual number of bytes read. Unless
- *                       otherwise specified, the value is undefined on
- *                       failure.
- *
- * @retval JAYLINK_OK Success.
- * @retval JAYLINK_ERR_ARG Invalid arguments.
- * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
- * @retval JAYLINK_ERR_PROTO Protocol violation.
- * @retval JAYLINK_ERR_IO Input/output error.
- * @retval JAYLINK_ERR_DEV_NOT_SUPPORTED Channel is not supported by the
- *                                       device.
- * @retval JAYLINK_ERR_DEV_NOT_AVAILABLE Channel is not available for the
- *                                       requested amount of data. @p length is
- *                                       updated with the number of bytes
- *                                       available on this channel.
- * @retval JAYLINK_ERR_DEV Unspecified device error.
- * @retval JAYLINK_ERR Other error conditions.
- *
- * @since 0.1.0
- */
-JAYLINK_API int jaylink_emucom_read(struct jaylink_device_handle *devh,
+static int _emucom_read(struct jaylink_device_handle *devh,
 		uint32_t channel, uint8_t *buffer, uint32_t *length)
 {
 	int ret;
@@ -179,17 +148,19 @@ JAYLINK_API int jaylink_emucom_read(struct jaylink_device_handle *devh,
 }
 
 /**
- * Write to an EMUCOM channel.
+ * Read from an EMUCOM channel.
  *
  * @note This function must only be used if the device has the
  *       #JAYLINK_DEV_CAP_EMUCOM capability.
  *
  * @param[in,out] devh Device handle.
- * @param[in] channel Channel to write data to.
- * @param[in] buffer Buffer to write data from.
- * @param[in,out] length Number of bytes to write. On success, the value gets
- *                       updated with the actual number of bytes written. The
- *                       value is undefined on failure.
+ * @param[in] channel Channel to read data from.
+ * @param[out] buffer Buffer to store read data on success. Its content is
+ *                    undefined on failure.
+ * @param[in,out] length Number of bytes to read. On success, the value gets
+ *                       updated with the actual number of bytes read. Unless
+ *                       otherwise specified, the value is undefined on
+ *                       failure.
  *
  * @retval JAYLINK_OK Success.
  * @retval JAYLINK_ERR_ARG Invalid arguments.
@@ -198,12 +169,31 @@ JAYLINK_API int jaylink_emucom_read(struct jaylink_device_handle *devh,
  * @retval JAYLINK_ERR_IO Input/output error.
  * @retval JAYLINK_ERR_DEV_NOT_SUPPORTED Channel is not supported by the
  *                                       device.
+ * @retval JAYLINK_ERR_DEV_NOT_AVAILABLE Channel is not available for the
+ *                                       requested amount of data. @p length is
+ *                                       updated with the number of bytes
+ *                                       available on this channel.
  * @retval JAYLINK_ERR_DEV Unspecified device error.
  * @retval JAYLINK_ERR Other error conditions.
  *
  * @since 0.1.0
  */
-JAYLINK_API int jaylink_emucom_write(struct jaylink_device_handle *devh,
+JAYLINK_API int jaylink_emucom_read(struct jaylink_device_handle *devh,
+		uint32_t channel, uint8_t *buffer, uint32_t *length)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _emucom_read(devh, channel, buffer, length);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+static int _emucom_write(struct jaylink_device_handle *devh,
 		uint32_t channel, const uint8_t *buffer, uint32_t *length)
 {
 	int ret;
@@ -285,3 +275,43 @@ JAYLINK_API int jaylink_emucom_write(struct jaylink_device_handle *devh,
 
 	return JAYLINK_OK;
 }
+
+/**
+ * Write to an EMUCOM channel.
+ *
+ * @note This function must only be used if the device has the
+ *       #JAYLINK_DEV_CAP_EMUCOM capability.
+ *
+ * @param[in,out] devh Device handle.
+ * @param[in] channel Channel to write data to.
+ * @param[in] buffer Buffer to write data from.
+ * @param[in,out] length Number of bytes to write. On success, the value gets
+ *                       updated with the actual number of bytes written. The
+ *                       value is undefined on failure.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_PROTO Protocol violation.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR_DEV_NOT_SUPPORTED Channel is not supported by the
+ *                                       device.
+ * @retval JAYLINK_ERR_DEV Unspecified device error.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @since 0.1.0
+ */
+JAYLINK_API int jaylink_emucom_write(struct jaylink_device_handle *devh,
+		uint32_t channel, const uint8_t *buffer, uint32_t *length)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _emucom_write(devh, channel, buffer, length);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
@@ -66,6 +66,14 @@ JAYLINK_API const char *jaylink_strerror(int error_code)
 		return "device: entity not available";
 	case JAYLINK_ERR_DEV_NO_MEMORY:
 		return "device: not enough memory to perform operation";
+	case JAYLINK_ERR_TARGET:
+		return "target: unspecified error";
+	case JAYLINK_ERR_TARGET_WAIT:
+		return "target: busy";
+	case JAYLINK_ERR_TARGET_FAULT:
+		return "target: fault";
+	case JAYLINK_ERR_TARGET_PARITY:
+		return "target: parity error";
 	default:
 		return "unknown error";
 	}
@@ -112,6 +120,14 @@ JAYLINK_API const char *jaylink_strerror_name(int error_code)
 		return "JAYLINK_ERR_DEV_NOT_AVAILABLE";
 	case JAYLINK_ERR_DEV_NO_MEMORY:
 		return "JAYLINK_ERR_DEV_NO_MEMORY";
+	case JAYLINK_ERR_TARGET:
+		return "JAYLINK_ERR_TARGET";
+	case JAYLINK_ERR_TARGET_WAIT:
+		return "JAYLINK_ERR_TARGET_WAIT";
+	case JAYLINK_ERR_TARGET_FAULT:
+		return "JAYLINK_ERR_TARGET_FAULT";
+	case JAYLINK_ERR_TARGET_PARITY:
+		return "JAYLINK_ERR_TARGET_PARITY";
 	default:
 		return "unknown error code";
 	}
@@ -45,36 +45,7 @@
 #define FILE_IO_ERR		0x80000000
 /** @endcond */
 
-/**
- * Read from a file.
- *
- * The maximum amount of data that can be read from a file at once is
- * #JAYLINK_FILE_MAX_TRANSFER_SIZE bytes. Multiple reads in conjunction with
- * the @p offset parameter are needed for larger files.
- *
- * @note This function must only be used if the device has the
- *       #JAYLINK_DEV_CAP_FILE_IO capability.
- *
- * @param[in,out] devh Device handle.
- * @param[in] filename Name of the file to read from. The length of the name
- *                     must not exceed #JAYLINK_FILE_NAME_MAX_LENGTH bytes.
- * @param[out] buffer Buffer to store read data on success. Its content is
- *                    undefined on failure
- * @param[in] offset Offset in bytes relative to the beginning of the file from
- *                   where to start reading.
- * @param[in,out] length Number of bytes to read. On success, the value gets
- *                       updated with the actual number of bytes read. The
- *                       value is undefined on failure.
- * @retval JAYLINK_OK Success.
- * @retval JAYLINK_ERR_ARG Invalid arguments.
- * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
- * @retval JAYLINK_ERR_IO Input/output error.
- * @retval JAYLINK_ERR_DEV Unspecified device error, or the file was not found.
- * @retval JAYLINK_ERR Other error conditions.
- *
- * @since 0.1.0
- */
-JAYLINK_API int jaylink_file_read(struct jaylink_device_handle *devh,
+static int _file_read(struct jaylink_device_handle *devh,
 		const char *filename, uint8_t *buffer, uint32_t offset,
 		uint32_t *length)
 {
@@ -179,27 +150,25 @@ JAYLINK_API int jaylink_file_read(struct jaylink_device_handle *devh,
 }
 
 /**
- * Write to a file.
- *
- * If a file does not exist, a new file is created.
+ * Read from a file.
  *
- * The maximum amount of data that can be written to a file at once is
- * #JAYLINK_FILE_MAX_TRANSFER_SIZE bytes. Multiple writes in conjunction with
+ * The maximum amount of data that can be read from a file at once is
+ * #JAYLINK_FILE_MAX_TRANSFER_SIZE bytes. Multiple reads in conjunction with
  * the @p offset parameter are needed for larger files.
  *
  * @note This function must only be used if the device has the
  *       #JAYLINK_DEV_CAP_FILE_IO capability.
  *
  * @param[in,out] devh Device handle.
- * @param[in] filename Name of the file to write to. The length of the name
+ * @param[in] filename Name of the file to read from. The length of the name
  *                     must not exceed #JAYLINK_FILE_NAME_MAX_LENGTH bytes.
- * @param[in] buffer Buffer to write data from.
+ * @param[out] buffer Buffer to store read data on success. Its content is
+ *                    undefined on failure
  * @param[in] offset Offset in bytes relative to the beginning of the file from
- *                   where to start writing.
- * @param[in,out] length Number of bytes to write. On success, the value gets
- *                       updated with the actual number of bytes written. The
+ *                   where to start reading.
+ * @param[in,out] length Number of bytes to read. On success, the value gets
+ *                       updated with the actual number of bytes read. The
  *                       value is undefined on failure.
- *
  * @retval JAYLINK_OK Success.
  * @retval JAYLINK_ERR_ARG Invalid arguments.
  * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
@@ -209,7 +178,23 @@ JAYLINK_API int jaylink_file_read(struct jaylink_device_handle *devh,
  *
  * @since 0.1.0
  */
-JAYLINK_API int jaylink_file_write(struct jaylink_device_handle *devh,
+JAYLINK_API int jaylink_file_read(struct jaylink_device_handle *devh,
+		const char *filename, uint8_t *buffer, uint32_t offset,
+		uint32_t *length)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _file_read(devh, filename, buffer, offset, length);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+static int _file_write(struct jaylink_device_handle *devh,
 		const char *filename, const uint8_t *buffer, uint32_t offset,
 		uint32_t *length)
 {
@@ -314,17 +299,26 @@ JAYLINK_API int jaylink_file_write(struct jaylink_device_handle *devh,
 }
 
 /**
- * Retrieve the size of a file.
+ * Write to a file.
+ *
+ * If a file does not exist, a new file is created.
+ *
+ * The maximum amount of data that can be written to a file at once is
+ * #JAYLINK_FILE_MAX_TRANSFER_SIZE bytes. Multiple writes in conjunction with
+ * the @p offset parameter are needed for larger files.
  *
  * @note This function must only be used if the device has the
  *       #JAYLINK_DEV_CAP_FILE_IO capability.
  *
  * @param[in,out] devh Device handle.
- * @param[in] filename Name of the file to retrieve the size of. The length
- *                     of the name must not exceed
- *                     #JAYLINK_FILE_NAME_MAX_LENGTH bytes.
- * @param[out] size Size of the file in bytes on success, and undefined on
- *                  failure.
+ * @param[in] filename Name of the file to write to. The length of the name
+ *                     must not exceed #JAYLINK_FILE_NAME_MAX_LENGTH bytes.
+ * @param[in] buffer Buffer to write data from.
+ * @param[in] offset Offset in bytes relative to the beginning of the file from
+ *                   where to start writing.
+ * @param[in,out] length Number of bytes to write. On success, the value gets
+ *                       updated with the actual number of bytes written. The
+ *                       value is undefined on failure.
  *
  * @retval JAYLINK_OK Success.
  * @retval JAYLINK_ERR_ARG Invalid arguments.
@@ -335,7 +329,23 @@ JAYLINK_API int jaylink_file_write(struct jaylink_device_handle *devh,
  *
  * @since 0.1.0
  */
-JAYLINK_API int jaylink_file_get_size(struct jaylink_device_handle *devh,
+JAYLINK_API int jaylink_file_write(struct jaylink_device_handle *devh,
+		const char *filename, const uint8_t *buffer, uint32_t offset,
+		uint32_t *length)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _file_write(devh, filename, buffer, offset, length);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+static int _file_get_size(struct jaylink_device_handle *devh,
 		const char *filename, uint32_t *size)
 {
 	int ret;
@@ -409,14 +419,17 @@ JAYLINK_API int jaylink_file_get_size(struct jaylink_device_handle *devh,
 }
 
 /**
- * Delete a file.
+ * Retrieve the size of a file.
  *
  * @note This function must only be used if the device has the
  *       #JAYLINK_DEV_CAP_FILE_IO capability.
  *
  * @param[in,out] devh Device handle.
- * @param[in] filename Name of the file to delete. The length of the name
- *                     must not exceed #JAYLINK_FILE_NAME_MAX_LENGTH bytes.
+ * @param[in] filename Name of the file to retrieve the size of. The length
+ *                     of the name must not exceed
+ *                     #JAYLINK_FILE_NAME_MAX_LENGTH bytes.
+ * @param[out] size Size of the file in bytes on success, and undefined on
+ *                  failure.
  *
  * @retval JAYLINK_OK Success.
  * @retval JAYLINK_ERR_ARG Invalid arguments.
@@ -427,7 +440,22 @@ JAYLINK_API int jaylink_file_get_size(struct jaylink_device_handle *devh,
  *
  * @since 0.1.0
  */
-JAYLINK_API int jaylink_file_delete(struct jaylink_device_handle *devh,
+JAYLINK_API int jaylink_file_get_size(struct jaylink_device_handle *devh,
+		const char *filename, uint32_t *size)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _file_get_size(devh, filename, size);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+static int _file_delete(struct jaylink_device_handle *devh,
 		const char *filename)
 {
 	int ret;
@@ -497,3 +525,37 @@ JAYLINK_API int jaylink_file_delete(struct jaylink_device_handle *devh,
 
 	return JAYLINK_OK;
 }
+
+/**
+ * Delete a file.
+ *
+ * @note This function must only be used if the device has the
+ *       #JAYLINK_DEV_CAP_FILE_IO capability.
+ *
+ * @param[in,out] devh Device handle.
+ * @param[in] filename Name of the file to delete. The length of the name
+ *                     must not exceed #JAYLINK_FILE_NAME_MAX_LENGTH bytes.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR_DEV Unspecified device error, or the file was not found.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @since 0.1.0
+ */
+JAYLINK_API int jaylink_file_delete(struct jaylink_device_handle *devh,
+		const char *filename)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _file_delete(devh, filename);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
@@ -0,0 +1,96 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "libjaylink.h"
+#include "libjaylink-internal.h"
+
+/**
+ * @file
+ *
+ * Adaptive number of idle cycles.
+ *
+ * The DAP and DMI access layers insert idle cycles after each access to give
+ * the target time to complete it. If the target is still busy, the number of
+ * idle cycles is doubled. After a number of consecutive transfers without a
+ * busy response, the number is decreased again by an eighth such that it
+ * converges to the lowest number the target can cope with.
+ */
+
+/** @cond PRIVATE */
+/** Number of consecutive successful transfers before a decrease. */
+#define DECREASE_INTERVAL	32
+/** @endcond */
+
+JAYLINK_PRIV void idle_init(struct idle_control *idle, size_t min_cycles)
+{
+	idle->cycles = MIN(min_cycles, MAX_IDLE_CYCLES);
+	idle->min_cycles = idle->cycles;
+	idle->successes = 0;
+	idle->retries = 0;
+}
+
+/*
+ * Raise the minimum number of idle cycles, for example to a number required
+ * by the target.
+ */
+JAYLINK_PRIV void idle_raise_min(struct idle_control *idle,
+		size_t min_cycles)
+{
+	idle->min_cycles = MAX(idle->min_cycles,
+		MIN(min_cycles, MAX_IDLE_CYCLES));
+	idle->cycles = MAX(idle->cycles, idle->min_cycles);
+}
+
+/* Account a transfer which is retried because the target was busy. */
+JAYLINK_PRIV void idle_busy(struct idle_control *idle)
+{
+	if (!idle->cycles)
+		idle->cycles = 1;
+	else
+		idle->cycles = MIN(2 * idle->cycles, MAX_IDLE_CYCLES);
+
+	idle->successes = 0;
+	idle->retries++;
+}
+
+/* Account a transfer which completed without a busy response. */
+JAYLINK_PRIV void idle_success(struct idle_control *idle)
+{
+	idle->successes++;
+
+	if (idle->successes < DECREASE_INTERVAL)
+		return;
+
+	idle->successes = 0;
+
+	if (idle->cycles > idle->min_cycles)
+		idle->cycles -= MIN(MAX(idle->cycles / 8, 1),
+			idle->cycles - idle->min_cycles);
+}
+
+JAYLINK_PRIV void idle_get_stats(const struct idle_control *idle,
+		struct jaylink_idle_stats *stats)
+{
+	stats->idle_cycles = idle->cycles;
+	stats->min_idle_cycles = idle->min_cycles;
+	stats->retries = idle->retries;
+}
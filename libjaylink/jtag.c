@@ -40,8 +40,111 @@
  * perform the JTAG I/O operation.
  */
 #define JTAG_IO_ERR_NO_MEMORY	0x06
+
+/** Maximum number of bytes of TMS data of a single JTAG I/O operation. */
+#define JTAG_IO_MAX_CHUNK_SIZE	(UINT16_MAX / 8)
+
+/**
+ * Packet size in bytes which the number of response bytes of a JTAG I/O
+ * operation of a long scan must not be a multiple of.
+ *
+ * A response with a multiple of the USB packet size is not terminated by a
+ * short packet. While the next operation is pending, it could be received
+ * together with the response of that operation.
+ */
+#define JTAG_IO_PACKET_SIZE	64
 /** @endcond */
 
+static int _jtag_io(struct jaylink_device_handle *devh,
+		const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
+		uint16_t length, enum jaylink_jtag_version version)
+{
+	int ret;
+	struct jaylink_context *ctx;
+	uint8_t buf[4];
+	struct transport_iovec iov[3];
+	uint16_t num_bytes;
+	uint16_t read_length;
+	uint8_t status;
+	uint8_t cmd;
+
+	if (!devh || !tms || !tdi || !tdo || !length)
+		return JAYLINK_ERR_ARG;
+
+	num_bytes = (length + 7) / 8;
+	read_length = num_bytes;
+
+	switch (version) {
+	case JAYLINK_JTAG_VERSION_2:
+		cmd = CMD_JTAG_IO_V2;
+		break;
+	case JAYLINK_JTAG_VERSION_3:
+		cmd = CMD_JTAG_IO_V3;
+		/* In this version, the response includes a status byte. */
+		read_length++;
+		break;
+	default:
+		return JAYLINK_ERR_ARG;
+	}
+
+	ctx = devh->dev->ctx;
+	ret = transport_start_write_read(devh, 4 + 2 * num_bytes,
+		read_length, true);
+
+	if (ret != JAYLINK_OK) {
+		log_err(ctx, "transport_start_write_read() failed: %s.",
+			jaylink_strerror(ret));
+		return ret;
+	}
+
+	buf[0] = cmd;
+	buf[1] = 0x00;
+	buffer_set_u16(buf, length, 2);
+
+	iov[0].buffer = buf;
+	iov[0].length = 4;
+	iov[1].buffer = tms;
+	iov[1].length = num_bytes;
+	iov[2].buffer = tdi;
+	iov[2].length = num_bytes;
+
+	ret = transport_writev(devh, iov, 3);
+
+	if (ret != JAYLINK_OK) {
+		log_err(ctx, "transport_writev() failed: %s.",
+			jaylink_strerror(ret));
+		return ret;
+	}
+
+	ret = transport_read(devh, tdo, num_bytes);
+
+	if (ret != JAYLINK_OK) {
+		log_err(ctx, "transport_read() failed: %s.",
+			jaylink_strerror(ret));
+		return ret;
+	}
+
+	if (version == JAYLINK_JTAG_VERSION_2)
+		return JAYLINK_OK;
+
+	ret = transport_read(devh, &status, 1);
+
+	if (ret != JAYLINK_OK) {
+		log_err(ctx, "transport_read() failed: %s.",
+			jaylink_strerror(ret));
+		return ret;
+	}
+
+	if (status == JTAG_IO_ERR_NO_MEMORY) {
+		return JAYLINK_ERR_DEV_NO_MEMORY;
+	} else if (status > 0) {
+		log_err(ctx, "JTAG I/O operation failed: 0x%x.", status);
+		return JAYLINK_ERR_DEV;
+	}
+
+	return JAYLINK_OK;
+}
+
 /**
  * Perform a JTAG I/O operation.
  *
@@ -77,38 +180,75 @@ JAYLINK_API int jaylink_jtag_io(struct jaylink_device_handle *devh,
 		uint16_t length, enum jaylink_jtag_version version)
 {
 	int ret;
-	struct jaylink_context *ctx;
-	uint8_t buf[4];
-	uint16_t num_bytes;
-	uint16_t read_length;
-	uint8_t status;
-	uint8_t cmd;
 
-	if (!devh || !tms || !tdi || !tdo || !length)
+	if (!devh)
 		return JAYLINK_ERR_ARG;
 
-	num_bytes = (length + 7) / 8;
-	read_length = num_bytes;
+	thread_mutex_lock(&devh->lock);
+	ret = _jtag_io(devh, tms, tdi, tdo, length, version);
+	thread_mutex_unlock(&devh->lock);
 
-	switch (version) {
-	case JAYLINK_JTAG_VERSION_2:
-		cmd = CMD_JTAG_IO_V2;
-		break;
-	case JAYLINK_JTAG_VERSION_3:
-		cmd = CMD_JTAG_IO_V3;
-		/* In this version, the response includes a status byte. */
-		read_length++;
-		break;
-	default:
-		return JAYLINK_ERR_ARG;
+	return ret;
+}
+
+static int get_chunk_size(struct jaylink_device_handle *devh, size_t *size)
+{
+	int ret;
+	uint8_t caps[JAYLINK_DEV_EXT_CAPS_SIZE];
+	uint32_t free_memory;
+
+	if (devh->jtag_chunk_size > 0) {
+		*size = devh->jtag_chunk_size;
+		return JAYLINK_OK;
+	}
+
+	ret = jaylink_get_caps(devh, caps);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	*size = JTAG_IO_MAX_CHUNK_SIZE;
+
+	/*
+	 * Without the capability, start with the maximum size and rely on the
+	 * device to report if it runs out of memory.
+	 */
+	if (jaylink_has_cap(caps, JAYLINK_DEV_CAP_GET_FREE_MEMORY)) {
+		ret = jaylink_get_free_memory(devh, &free_memory);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+
+		/*
+		 * Each of the two pending operations needs memory for its TMS,
+		 * TDI and TDO data.
+		 */
+		*size = MIN(free_memory / 6, *size);
 	}
 
+	if (!*size)
+		return JAYLINK_ERR_DEV_NO_MEMORY;
+
+	devh->jtag_chunk_size = *size;
+
+	return JAYLINK_OK;
+}
+
+static int send_chunk(struct jaylink_device_handle *devh, uint8_t cmd,
+		const uint8_t *tms, const uint8_t *tdi, uint16_t length)
+{
+	int ret;
+	struct jaylink_context *ctx;
+	uint8_t buf[4];
+	struct transport_iovec iov[3];
+	uint16_t num_bytes;
+
 	ctx = devh->dev->ctx;
-	ret = transport_start_write_read(devh, 4 + 2 * num_bytes,
-		read_length, true);
+	num_bytes = (length + 7) / 8;
+	ret = transport_start_write(devh, 4 + 2 * num_bytes, true);
 
 	if (ret != JAYLINK_OK) {
-		log_err(ctx, "transport_start_write_read() failed: %s.",
+		log_err(ctx, "transport_start_write() failed: %s.",
 			jaylink_strerror(ret));
 		return ret;
 	}
@@ -117,26 +257,44 @@ JAYLINK_API int jaylink_jtag_io(struct jaylink_device_handle *devh,
 	buf[1] = 0x00;
 	buffer_set_u16(buf, length, 2);
 
-	ret = transport_write(devh, buf, 4);
+	iov[0].buffer = buf;
+	iov[0].length = 4;
+	iov[1].buffer = tms;
+	iov[1].length = num_bytes;
+	iov[2].buffer = tdi;
+	iov[2].length = num_bytes;
+
+	ret = transport_writev(devh, iov, 3);
 
 	if (ret != JAYLINK_OK) {
-		log_err(ctx, "transport_write() failed: %s.",
+		log_err(ctx, "transport_writev() failed: %s.",
 			jaylink_strerror(ret));
 		return ret;
 	}
 
-	ret = transport_write(devh, tms, num_bytes);
+	return JAYLINK_OK;
+}
 
-	if (ret != JAYLINK_OK) {
-		log_err(ctx, "transport_write() failed: %s.",
-			jaylink_strerror(ret));
-		return ret;
-	}
+/*
+ * Receive the response of a JTAG I/O operation.
+ *
+ * Returns a libjaylink error code and stores the result of the operation
+ * reported by the device in @p result.
+ */
+static int receive_chunk(struct jaylink_device_handle *devh, uint8_t *tdo,
+		uint16_t length, bool has_status, int *result)
+{
+	int ret;
+	struct jaylink_context *ctx;
+	uint16_t num_bytes;
+	uint8_t status;
 
-	ret = transport_write(devh, tdi, num_bytes);
+	ctx = devh->dev->ctx;
+	num_bytes = (length + 7) / 8;
+	ret = transport_start_read(devh, num_bytes + (has_status ? 1 : 0));
 
 	if (ret != JAYLINK_OK) {
-		log_err(ctx, "transport_write() failed: %s.",
+		log_err(ctx, "transport_start_read() failed: %s.",
 			jaylink_strerror(ret));
 		return ret;
 	}
@@ -149,7 +307,9 @@ JAYLINK_API int jaylink_jtag_io(struct jaylink_device_handle *devh,
 		return ret;
 	}
 
-	if (version == JAYLINK_JTAG_VERSION_2)
+	*result = JAYLINK_OK;
+
+	if (!has_status)
 		return JAYLINK_OK;
 
 	ret = transport_read(devh, &status, 1);
@@ -161,29 +321,306 @@ JAYLINK_API int jaylink_jtag_io(struct jaylink_device_handle *devh,
 	}
 
 	if (status == JTAG_IO_ERR_NO_MEMORY) {
-		return JAYLINK_ERR_DEV_NO_MEMORY;
+		*result = JAYLINK_ERR_DEV_NO_MEMORY;
 	} else if (status > 0) {
 		log_err(ctx, "JTAG I/O operation failed: 0x%x.", status);
-		return JAYLINK_ERR_DEV;
+		*result = JAYLINK_ERR_DEV;
+	}
+
+	return JAYLINK_OK;
+}
+
+/*
+ * Adjust the chunk size such that the size of the response is not a multiple
+ * of the packet size.
+ */
+static size_t adjust_chunk_size(size_t size, bool has_status)
+{
+	if (size > 1 && !((size + (has_status ? 1 : 0)) % JTAG_IO_PACKET_SIZE))
+		size--;
+
+	return size;
+}
+
+static void verify_chunk(const uint8_t *tdo, const uint8_t *expected,
+		const uint8_t *mask, size_t pos, size_t length,
+		size_t *mismatch)
+{
+	size_t index;
+
+	/* Only the first mismatch is of interest. */
+	if (!expected || *mismatch < pos)
+		return;
+
+	index = jaylink_bitvec_compare(tdo, expected, mask, pos, length);
+
+	if (index < length)
+		*mismatch = pos + index;
+}
+
+static int _jtag_io_long(struct jaylink_device_handle *devh,
+		const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
+		const uint8_t *expected, const uint8_t *mask, size_t length,
+		enum jaylink_jtag_version version, size_t *mismatch)
+{
+	int ret;
+	struct jaylink_context *ctx;
+	uint8_t cmd;
+	bool has_status;
+	size_t chunk_size;
+	size_t pos;
+	size_t pending_pos;
+	uint16_t pending_length;
+	uint16_t next_length;
+	bool pending;
+	bool pipeline;
+	int result;
+	int next_result;
+
+	if (!devh || !tms || !tdi || !tdo || !length)
+		return JAYLINK_ERR_ARG;
+
+	switch (version) {
+	case JAYLINK_JTAG_VERSION_2:
+		cmd = CMD_JTAG_IO_V2;
+		has_status = false;
+		break;
+	case JAYLINK_JTAG_VERSION_3:
+		cmd = CMD_JTAG_IO_V3;
+		has_status = true;
+		break;
+	default:
+		return JAYLINK_ERR_ARG;
+	}
+
+	ctx = devh->dev->ctx;
+	ret = get_chunk_size(devh, &chunk_size);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	chunk_size = adjust_chunk_size(chunk_size, has_status);
+
+	log_dbg(ctx, "Performing JTAG I/O operation with %zu bits in chunks "
+		"of %zu bytes.", length, chunk_size);
+
+	/* Position of the next chunk to be sent in bits. */
+	pos = 0;
+	*mismatch = length;
+	pending = false;
+	pending_pos = 0;
+	pending_length = 0;
+	pipeline = true;
+
+	/*
+	 * The next chunk is sent before the response of the pending chunk is
+	 * received such that the device does not idle in between.
+	 */
+	while (pos < length || pending) {
+		next_length = 0;
+
+		if (pos < length && (pipeline || !pending)) {
+			next_length = MIN(length - pos, chunk_size * 8);
+			ret = send_chunk(devh, cmd, tms + pos / 8,
+				tdi + pos / 8, next_length);
+
+			if (ret != JAYLINK_OK)
+				return ret;
+		}
+
+		if (!pending) {
+			pending = true;
+			pending_pos = pos;
+			pending_length = next_length;
+			pos += next_length;
+			continue;
+		}
+
+		ret = receive_chunk(devh, tdo + pending_pos / 8,
+			pending_length, has_status, &result);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+
+		if (result == JAYLINK_OK) {
+			/*
+			 * The TDO data is verified while the device performs
+			 * the next chunk.
+			 */
+			verify_chunk(tdo, expected, mask, pending_pos,
+				pending_length, mismatch);
+
+			pipeline = true;
+			pending = next_length > 0;
+			pending_pos = pos;
+			pending_length = next_length;
+			pos += next_length;
+			continue;
+		}
+
+		if (result != JAYLINK_ERR_DEV_NO_MEMORY)
+			return result;
+
+		/*
+		 * The chunk was not performed. The following chunk must not
+		 * be performed either, otherwise the scan can not be continued
+		 * consistently.
+		 */
+		if (next_length > 0) {
+			ret = receive_chunk(devh, tdo + pos / 8, next_length,
+				has_status, &next_result);
+
+			if (ret != JAYLINK_OK)
+				return ret;
+
+			if (next_result != JAYLINK_ERR_DEV_NO_MEMORY) {
+				log_err(ctx, "JTAG I/O operation continued "
+					"after a chunk failed.");
+				return JAYLINK_ERR_DEV_NO_MEMORY;
+			}
+		}
+
+		if (chunk_size == 1)
+			return JAYLINK_ERR_DEV_NO_MEMORY;
+
+		chunk_size = adjust_chunk_size(chunk_size / 2, has_status);
+		devh->jtag_chunk_size = chunk_size;
+
+		log_dbg(ctx, "Device out of memory, retrying with chunks of "
+			"%zu bytes.", chunk_size);
+
+		/*
+		 * Do not send the next chunk before the pending one succeeded.
+		 * Otherwise, the next chunk may be performed while the pending
+		 * one fails again, which can not be recovered.
+		 */
+		pipeline = false;
+		pos = pending_pos;
+		pending = false;
 	}
 
 	return JAYLINK_OK;
 }
 
 /**
- * Clear the JTAG test reset (TRST) signal.
+ * Perform a JTAG I/O operation of arbitrary length.
+ *
+ * Unlike jaylink_jtag_io(), the number of bits to transfer is not limited.
+ * The operation is split into multiple JTAG I/O operations which fit into the
+ * memory of the device. The size of the operations is determined from the free
+ * memory of the device if it has the #JAYLINK_DEV_CAP_GET_FREE_MEMORY
+ * capability. It is halved if the device runs out of memory and the
+ * operation is retried. The resulting size is retained for subsequent calls.
+ *
+ * While the device performs an operation, the next one is already sent to the
+ * device.
+ *
+ * @note This function must only be used if the #JAYLINK_TIF_JTAG interface is
+ *       available and selected. Nevertheless, this function can be used if the
+ *       device doesn't have the #JAYLINK_DEV_CAP_SELECT_TIF capability.
  *
  * @param[in,out] devh Device handle.
+ * @param[in] tms Buffer to read TMS data from.
+ * @param[in] tdi Buffer to read TDI data from.
+ * @param[out] tdo Buffer to store TDO data on success. Its content is
+ *                 undefined on failure. The buffer must be large enough to
+ *                 contain at least the specified number of bits to transfer.
+ * @param[in] length Number of bits to transfer.
+ * @param[in] version Version of the JTAG command to use. Only
+ *                    #JAYLINK_JTAG_VERSION_3 allows to detect that the device
+ *                    runs out of memory.
  *
  * @retval JAYLINK_OK Success.
  * @retval JAYLINK_ERR_ARG Invalid arguments.
  * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
  * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR_DEV_NO_MEMORY Not enough memory on the device to perform
+ *                                   the operation.
+ * @retval JAYLINK_ERR_DEV Unspecified device error.
  * @retval JAYLINK_ERR Other error conditions.
  *
- * @since 0.1.0
+ * @see jaylink_jtag_io()
+ *
+ * @since 0.2.0
  */
-JAYLINK_API int jaylink_jtag_clear_trst(struct jaylink_device_handle *devh)
+JAYLINK_API int jaylink_jtag_io_long(struct jaylink_device_handle *devh,
+		const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
+		size_t length, enum jaylink_jtag_version version)
+{
+	int ret;
+	size_t mismatch;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _jtag_io_long(devh, tms, tdi, tdo, NULL, NULL, length, version,
+		&mismatch);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+/**
+ * Perform a JTAG I/O operation and verify the TDO data.
+ *
+ * The operation is performed like with jaylink_jtag_io_long(). The received
+ * TDO data is compared with the expected values under the mask on the host
+ * while the device performs the next part of the operation. The operation is
+ * always performed completely, even if a mismatch is detected, such that the
+ * state of the TAP controllers remains consistent.
+ *
+ * @note This function must only be used if the #JAYLINK_TIF_JTAG interface is
+ *       available and selected. Nevertheless, this function can be used if the
+ *       device doesn't have the #JAYLINK_DEV_CAP_SELECT_TIF capability.
+ *
+ * @param[in,out] devh Device handle.
+ * @param[in] tms Buffer to read TMS data from.
+ * @param[in] tdi Buffer to read TDI data from.
+ * @param[out] tdo Buffer to store TDO data on success. Its content is
+ *                 undefined on failure. The buffer must be large enough to
+ *                 contain at least the specified number of bits to transfer.
+ * @param[in] expected Buffer to read the expected TDO data from.
+ * @param[in] mask Buffer to read the mask from. Only TDO bits with a set mask
+ *                 bit are compared. Can be NULL to compare all TDO bits.
+ * @param[in] length Number of bits to transfer.
+ * @param[in] version Version of the JTAG command to use.
+ * @param[out] mismatch Index of the first TDO bit which does not match the
+ *                      expected value on success, or the number of bits to
+ *                      transfer if all bits match.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR_DEV_NO_MEMORY Not enough memory on the device to perform
+ *                                   the operation.
+ * @retval JAYLINK_ERR_DEV Unspecified device error.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @see jaylink_bitvec_compare()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_jtag_io_verify(struct jaylink_device_handle *devh,
+		const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
+		const uint8_t *expected, const uint8_t *mask, size_t length,
+		enum jaylink_jtag_version version, size_t *mismatch)
+{
+	int ret;
+
+	if (!devh || !expected || !mismatch)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _jtag_io_long(devh, tms, tdi, tdo, expected, mask, length,
+		version, mismatch);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+static int _jtag_clear_trst(struct jaylink_device_handle *devh)
 {
 	int ret;
 	struct jaylink_context *ctx;
@@ -215,7 +652,7 @@ JAYLINK_API int jaylink_jtag_clear_trst(struct jaylink_device_handle *devh)
 }
 
 /**
- * Set the JTAG test reset (TRST) signal.
+ * Clear the JTAG test reset (TRST) signal.
  *
  * @param[in,out] devh Device handle.
  *
@@ -227,7 +664,21 @@ JAYLINK_API int jaylink_jtag_clear_trst(struct jaylink_device_handle *devh)
  *
  * @since 0.1.0
  */
-JAYLINK_API int jaylink_jtag_set_trst(struct jaylink_device_handle *devh)
+JAYLINK_API int jaylink_jtag_clear_trst(struct jaylink_device_handle *devh)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _jtag_clear_trst(devh);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+static int _jtag_set_trst(struct jaylink_device_handle *devh)
 {
 	int ret;
 	struct jaylink_context *ctx;
@@ -257,3 +708,139 @@ JAYLINK_API int jaylink_jtag_set_trst(struct jaylink_device_handle *devh)
 
 	return JAYLINK_OK;
 }
+
+/**
+ * Set the JTAG test reset (TRST) signal.
+ *
+ * @param[in,out] devh Device handle.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @since 0.1.0
+ */
+JAYLINK_API int jaylink_jtag_set_trst(struct jaylink_device_handle *devh)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _jtag_set_trst(devh);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+/**
+ * Add a JTAG I/O operation to a command queue.
+ *
+ * See jaylink_jtag_io() for a description of the operation. The buffers must
+ * remain valid until the queue is executed.
+ *
+ * @param[in,out] queue Queue.
+ * @param[in] tms Buffer to read TMS data from.
+ * @param[in] tdi Buffer to read TDI data from.
+ * @param[out] tdo Buffer to store TDO data when the queue is executed
+ *                 successfully. Its content is undefined on failure. The buffer
+ *                 must be large enough to contain at least the specified number
+ *                 of bits to transfer.
+ * @param[in] length Number of bits to transfer.
+ * @param[in] version Version of the JTAG command to use.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @see jaylink_queue_execute()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_queue_jtag_io(struct jaylink_queue *queue,
+		const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
+		uint16_t length, enum jaylink_jtag_version version)
+{
+	struct queue_entry *entry;
+	uint8_t cmd;
+	bool has_status;
+
+	if (!queue || !tms || !tdi || !tdo || !length)
+		return JAYLINK_ERR_ARG;
+
+	switch (version) {
+	case JAYLINK_JTAG_VERSION_2:
+		cmd = CMD_JTAG_IO_V2;
+		has_status = false;
+		break;
+	case JAYLINK_JTAG_VERSION_3:
+		cmd = CMD_JTAG_IO_V3;
+		has_status = true;
+		break;
+	default:
+		return JAYLINK_ERR_ARG;
+	}
+
+	entry = queue_add(queue);
+
+	if (!entry)
+		return JAYLINK_ERR_MALLOC;
+
+	entry->header[0] = cmd;
+	entry->header[1] = 0x00;
+	buffer_set_u16(entry->header, length, 2);
+	entry->header_length = 4;
+	entry->data[0] = tms;
+	entry->data[1] = tdi;
+	entry->data_length = (length + 7) / 8;
+	entry->response = tdo;
+	entry->response_length = entry->data_length;
+	entry->has_status = has_status;
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Add the clearing of the JTAG test reset (TRST) signal to a command queue.
+ *
+ * @param[in,out] queue Queue.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @see jaylink_queue_execute()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_queue_jtag_clear_trst(struct jaylink_queue *queue)
+{
+	if (!queue)
+		return JAYLINK_ERR_ARG;
+
+	return queue_add_command(queue, CMD_JTAG_CLEAR_TRST);
+}
+
+/**
+ * Add the setting of the JTAG test reset (TRST) signal to a command queue.
+ *
+ * @param[in,out] queue Queue.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @see jaylink_queue_execute()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_queue_jtag_set_trst(struct jaylink_queue *queue)
+{
+	if (!queue)
+		return JAYLINK_ERR_ARG;
+
+	return queue_add_command(queue, CMD_JTAG_SET_TRST);
+}
@@ -0,0 +1,385 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libjaylink.h"
+#include "libjaylink-internal.h"
+
+/**
+ * @file
+ *
+ * JTAG scan chain detection.
+ *
+ * The scan chain is examined with three scans which are transferred with a
+ * single JTAG I/O operation:
+ *
+ *  - After a reset, each TAP has either its IDCODE or its bypass register
+ *    selected. A data register scan with TDI high captures all of them. An
+ *    IDCODE always starts with a one bit, whereas the bypass register is
+ *    captured as zero.
+ *  - An instruction register scan with zeros followed by ones captures the
+ *    instruction registers and determines their total length from the delay
+ *    of the first one. It leaves all TAPs with the BYPASS instruction.
+ *  - A data register scan with zeros followed by ones determines the number
+ *    of TAPs from the delay through their bypass registers.
+ *
+ * The instruction register length of each TAP is derived from the captured
+ * instruction registers whose two least significant bits are always 01b.
+ */
+
+/** @cond PRIVATE */
+/** Maximum number of TAPs of a scan chain. */
+#define MAX_TAPS		32
+
+/** Maximum total instruction register length of a scan chain in bits. */
+#define MAX_IR_LENGTH		1024
+
+#define IDCODE_LENGTH		32
+
+/*
+ * Length of the IDCODE scan in bits. The IDCODEs are followed by at least one
+ * IDCODE length of TDI data which marks the end of the scan chain.
+ */
+#define ID_SCAN_LENGTH		((MAX_TAPS + 1) * IDCODE_LENGTH)
+
+#define IR_SCAN_LENGTH		(2 * MAX_IR_LENGTH)
+
+#define COUNT_SCAN_LENGTH	(2 * MAX_TAPS)
+/** @endcond */
+
+/*
+ * Find the first bit with the specified value. Returns the length if there is
+ * no such bit.
+ */
+static size_t find_bit(const uint8_t *buffer, size_t offset, size_t length,
+		bool value)
+{
+	size_t i;
+
+	for (i = offset; i < length; i++) {
+		if ((bool)(buffer[i / 8] & (1 << (i % 8))) == value)
+			break;
+	}
+
+	return i;
+}
+
+/*
+ * Split the captured instruction registers into the instruction registers of
+ * the TAPs. Each of them starts with 01b, starting with the least significant
+ * bit. Further 01b pairs within an instruction register are possible, so all
+ * splits into the known number of TAPs are counted.
+ */
+static int split_ir(struct jaylink_context *ctx, const uint8_t *ir,
+		size_t ir_length, size_t *ir_lengths, size_t num_taps)
+{
+	uint8_t *splits;
+	size_t width;
+	size_t sum;
+	size_t tap;
+	size_t pos;
+	size_t i;
+
+	if (ir_length < 2 * num_taps ||
+			jaylink_bitvec_get_field(ir, 0, 2) != 0x01) {
+		log_err(ctx, "Invalid instruction register capture.");
+		return JAYLINK_ERR_TARGET;
+	}
+
+	if (num_taps == 1) {
+		ir_lengths[0] = ir_length;
+		return JAYLINK_OK;
+	}
+
+	width = ir_length + 1;
+	splits = calloc(num_taps + 1, width);
+
+	if (!splits)
+		return JAYLINK_ERR_MALLOC;
+
+	/*
+	 * The entry of n TAPs at a bit position is the number of splits of the
+	 * capture from this position to the end into n instruction registers,
+	 * limited to two.
+	 */
+	splits[ir_length] = 1;
+
+	for (tap = 1; tap <= num_taps; tap++) {
+		sum = 0;
+
+		for (i = ir_length - 1; i > 0; i--) {
+			pos = i - 1;
+			sum = MIN(sum + splits[(tap - 1) * width + pos + 2], 2);
+
+			if (jaylink_bitvec_get_field(ir, pos, 2) == 0x01)
+				splits[tap * width + pos] = sum;
+		}
+	}
+
+	if (!splits[num_taps * width]) {
+		free(splits);
+		log_err(ctx, "Instruction register capture does not match %zu "
+			"TAPs.", num_taps);
+		return JAYLINK_ERR_TARGET;
+	}
+
+	if (splits[num_taps * width] > 1) {
+		free(splits);
+		log_err(ctx, "Instruction register lengths of the %zu TAPs "
+			"are ambiguous.", num_taps);
+		return JAYLINK_ERR;
+	}
+
+	/* Follow the only split from the least significant bit. */
+	pos = 0;
+
+	for (tap = 0; tap < num_taps; tap++) {
+		i = pos + 2;
+
+		while (!splits[(num_taps - tap - 1) * width + i])
+			i++;
+
+		ir_lengths[tap] = i - pos;
+		pos = i;
+	}
+
+	free(splits);
+
+	return JAYLINK_OK;
+}
+
+static int parse_idcodes(struct jaylink_context *ctx, const uint8_t *id,
+		uint32_t *idcodes, size_t num_taps)
+{
+	size_t i;
+	size_t pos;
+
+	pos = 0;
+
+	for (i = 0; i < num_taps; i++) {
+		if (!(id[pos / 8] & (1 << (pos % 8)))) {
+			idcodes[i] = 0;
+			pos++;
+			continue;
+		}
+
+		idcodes[i] = jaylink_bitvec_get_field(id, pos, IDCODE_LENGTH);
+		pos += IDCODE_LENGTH;
+
+		if (idcodes[i] == 0xffffffff)
+			break;
+	}
+
+	/* The TDI data must follow the last TAP. */
+	if (i < num_taps || jaylink_bitvec_get_field(id, pos,
+			IDCODE_LENGTH) != 0xffffffff) {
+		log_err(ctx, "IDCODEs do not match %zu TAPs.", num_taps);
+		return JAYLINK_ERR_TARGET;
+	}
+
+	return JAYLINK_OK;
+}
+
+static int append_scans(struct jaylink_jtag_scan *scan, uint8_t *id,
+		uint8_t *ir, uint8_t *count)
+{
+	int ret;
+	uint8_t id_out[ID_SCAN_LENGTH / 8];
+	uint8_t ir_out[IR_SCAN_LENGTH / 8];
+	uint8_t count_out[COUNT_SCAN_LENGTH / 8];
+
+	memset(id_out, 0xff, sizeof(id_out));
+	memset(ir_out, 0x00, MAX_IR_LENGTH / 8);
+	memset(ir_out + MAX_IR_LENGTH / 8, 0xff, MAX_IR_LENGTH / 8);
+	memset(count_out, 0x00, MAX_TAPS / 8);
+	memset(count_out + MAX_TAPS / 8, 0xff, MAX_TAPS / 8);
+
+	ret = jaylink_jtag_scan_reset(scan);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	ret = jtag_scan_shift(scan, false, id_out, id, ID_SCAN_LENGTH,
+		JAYLINK_TAP_STATE_IDLE);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	ret = jtag_scan_shift(scan, true, ir_out, ir, IR_SCAN_LENGTH,
+		JAYLINK_TAP_STATE_IDLE);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	ret = jtag_scan_shift(scan, false, count_out, count,
+		COUNT_SCAN_LENGTH, JAYLINK_TAP_STATE_IDLE);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	return jaylink_jtag_scan_flush(scan);
+}
+
+/**
+ * Detect the TAPs of the JTAG scan chain.
+ *
+ * The number of TAPs, their IDCODEs and their instruction register lengths
+ * are determined with a single JTAG I/O operation and the scan chain is set
+ * accordingly, see jaylink_jtag_scan_set_chain(). The result is kept by the
+ * scan engine and can be retrieved with jaylink_jtag_scan_get_tap() without
+ * further communication with the device.
+ *
+ * Pending operations are transferred as well. Afterwards, all TAPs have the
+ * BYPASS instruction selected and are in the Run-Test/Idle state.
+ *
+ * The instruction register length of each TAP is derived from the captured
+ * instruction registers. If this is ambiguous, the scan chain must be set
+ * with jaylink_jtag_scan_set_chain() instead.
+ *
+ * @param[in,out] scan Scan engine.
+ * @param[out] num_taps Number of detected TAPs on success, and undefined on
+ *                      failure. Can be NULL.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR_DEV_NO_MEMORY Not enough memory on the device to perform
+ *                                   the operation.
+ * @retval JAYLINK_ERR_DEV Unspecified device error.
+ * @retval JAYLINK_ERR_TARGET No TAPs or a malfunctioning scan chain detected.
+ * @retval JAYLINK_ERR The instruction register lengths are ambiguous, or
+ *                     other error conditions.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_jtag_scan_detect(struct jaylink_jtag_scan *scan,
+		size_t *num_taps)
+{
+	int ret;
+	struct jaylink_context *ctx;
+	uint8_t id[ID_SCAN_LENGTH / 8];
+	uint8_t ir[IR_SCAN_LENGTH / 8];
+	uint8_t count[COUNT_SCAN_LENGTH / 8];
+	size_t ir_lengths[MAX_TAPS];
+	uint32_t idcodes[MAX_TAPS];
+	size_t taps;
+	size_t ir_length;
+	size_t i;
+
+	if (!scan)
+		return JAYLINK_ERR_ARG;
+
+	ctx = scan->devh->dev->ctx;
+	ret = append_scans(scan, id, ir, count);
+
+	if (ret != JAYLINK_OK) {
+		/* Do not leave captures into the buffers on the stack. */
+		jtag_scan_discard(scan);
+		log_err(ctx, "Failed to detect the scan chain: %s.",
+			jaylink_strerror(ret));
+		return ret;
+	}
+
+	/* The bypass registers are captured as zero. */
+	taps = find_bit(count, 0, COUNT_SCAN_LENGTH, true);
+
+	if (taps < MAX_TAPS || taps == COUNT_SCAN_LENGTH) {
+		log_err(ctx, "Scan chain is broken or has more than %u TAPs.",
+			MAX_TAPS);
+		return JAYLINK_ERR_TARGET;
+	}
+
+	taps -= MAX_TAPS;
+
+	if (!taps) {
+		log_err(ctx, "No TAPs found.");
+		return JAYLINK_ERR_TARGET;
+	}
+
+	ir_length = find_bit(ir, MAX_IR_LENGTH, IR_SCAN_LENGTH, true);
+
+	if (ir_length == IR_SCAN_LENGTH) {
+		log_err(ctx, "Instruction registers are longer than %u bits.",
+			MAX_IR_LENGTH);
+		return JAYLINK_ERR_TARGET;
+	}
+
+	ir_length -= MAX_IR_LENGTH;
+	ret = parse_idcodes(ctx, id, idcodes, taps);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	ret = split_ir(ctx, ir, ir_length, ir_lengths, taps);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	ret = jaylink_jtag_scan_set_chain(scan, ir_lengths, taps);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	memcpy(scan->idcodes, idcodes, taps * sizeof(uint32_t));
+
+	for (i = 0; i < taps; i++)
+		log_dbg(ctx, "TAP %zu: IDCODE 0x%08x, instruction register "
+			"length %zu.", i, idcodes[i], ir_lengths[i]);
+
+	if (num_taps)
+		*num_taps = taps;
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Retrieve information about a TAP of the JTAG scan chain.
+ *
+ * The information is kept by the scan engine and does not require any
+ * communication with the device.
+ *
+ * @param[in] scan Scan engine.
+ * @param[in] tap Index of the TAP.
+ * @param[out] info Information about the TAP on success, and undefined on
+ *                  failure.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ *
+ * @see jaylink_jtag_scan_detect()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_jtag_scan_get_tap(const struct jaylink_jtag_scan *scan,
+		size_t tap, struct jaylink_jtag_tap *info)
+{
+	if (!scan || !info || tap >= scan->num_taps)
+		return JAYLINK_ERR_ARG;
+
+	info->idcode = scan->idcodes[tap];
+	info->ir_length = scan->ir_lengths[tap];
+
+	return JAYLINK_OK;
+}
@@ -0,0 +1,809 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "libjaylink.h"
+#include "libjaylink-internal.h"
+
+/**
+ * @file
+ *
+ * JTAG scan engine.
+ *
+ * The scan engine tracks the state of the TAP controllers and generates the
+ * TMS and TDI data for instruction and data register scans. The data of
+ * consecutive operations is collected and transferred with a single JTAG I/O
+ * operation when the scan engine is flushed.
+ */
+
+/** @cond PRIVATE */
+/** Number of TAP controller states. */
+#define NUM_TAP_STATES		16
+
+/** Number of TMS cycles with TMS high to reach Test-Logic-Reset. */
+#define TAP_RESET_CYCLES	5
+
+/** Initial size of the TMS, TDI and TDO buffers in bytes. */
+#define SCAN_INITIAL_SIZE	64
+
+/** Initial number of captures. */
+#define SCAN_INITIAL_CAPTURES	8
+
+/** Shortest TMS sequence between two TAP controller states. */
+struct tap_path {
+	/** TMS bits, starting with the least significant bit. */
+	uint8_t tms;
+	/** Number of TMS bits. */
+	uint8_t length;
+};
+/** @endcond */
+
+/*
+ * Shortest TMS sequences between all TAP controller states, indexed by the
+ * start state and the end state.
+ *
+ * The table was generated with a breadth-first search on the state diagram of
+ * IEEE 1149.1.
+ */
+static const struct tap_path tap_paths[NUM_TAP_STATES][NUM_TAP_STATES] = {
+	/* RESET */
+	{{0x00, 0}, {0x00, 1}, {0x02, 2}, {0x02, 3}, {0x02, 4}, {0x0a, 4},
+		{0x0a, 5}, {0x2a, 6}, {0x1a, 5}, {0x06, 3}, {0x06, 4},
+		{0x06, 5}, {0x16, 5}, {0x16, 6}, {0x56, 7}, {0x36, 6}},
+	/* IDLE */
+	{{0x07, 3}, {0x00, 0}, {0x01, 1}, {0x01, 2}, {0x01, 3}, {0x05, 3},
+		{0x05, 4}, {0x15, 5}, {0x0d, 4}, {0x03, 2}, {0x03, 3},
+		{0x03, 4}, {0x0b, 4}, {0x0b, 5}, {0x2b, 6}, {0x1b, 5}},
+	/* DR_SELECT */
+	{{0x03, 2}, {0x03, 3}, {0x00, 0}, {0x00, 1}, {0x00, 2}, {0x02, 2},
+		{0x02, 3}, {0x0a, 4}, {0x06, 3}, {0x01, 1}, {0x01, 2},
+		{0x01, 3}, {0x05, 3}, {0x05, 4}, {0x15, 5}, {0x0d, 4}},
+	/* DR_CAPTURE */
+	{{0x1f, 5}, {0x03, 3}, {0x07, 3}, {0x00, 0}, {0x00, 1}, {0x01, 1},
+		{0x01, 2}, {0x05, 3}, {0x03, 2}, {0x0f, 4}, {0x0f, 5},
+		{0x0f, 6}, {0x2f, 6}, {0x2f, 7}, {0xaf, 8}, {0x6f, 7}},
+	/* DR_SHIFT */
+	{{0x1f, 5}, {0x03, 3}, {0x07, 3}, {0x07, 4}, {0x00, 0}, {0x01, 1},
+		{0x01, 2}, {0x05, 3}, {0x03, 2}, {0x0f, 4}, {0x0f, 5},
+		{0x0f, 6}, {0x2f, 6}, {0x2f, 7}, {0xaf, 8}, {0x6f, 7}},
+	/* DR_EXIT1 */
+	{{0x0f, 4}, {0x01, 2}, {0x03, 2}, {0x03, 3}, {0x02, 3}, {0x00, 0},
+		{0x00, 1}, {0x02, 2}, {0x01, 1}, {0x07, 3}, {0x07, 4},
+		{0x07, 5}, {0x17, 5}, {0x17, 6}, {0x57, 7}, {0x37, 6}},
+	/* DR_PAUSE */
+	{{0x1f, 5}, {0x03, 3}, {0x07, 3}, {0x07, 4}, {0x01, 2}, {0x05, 3},
+		{0x00, 0}, {0x01, 1}, {0x03, 2}, {0x0f, 4}, {0x0f, 5},
+		{0x0f, 6}, {0x2f, 6}, {0x2f, 7}, {0xaf, 8}, {0x6f, 7}},
+	/* DR_EXIT2 */
+	{{0x0f, 4}, {0x01, 2}, {0x03, 2}, {0x03, 3}, {0x00, 1}, {0x02, 2},
+		{0x02, 3}, {0x00, 0}, {0x01, 1}, {0x07, 3}, {0x07, 4},
+		{0x07, 5}, {0x17, 5}, {0x17, 6}, {0x57, 7}, {0x37, 6}},
+	/* DR_UPDATE */
+	{{0x07, 3}, {0x00, 1}, {0x01, 1}, {0x01, 2}, {0x01, 3}, {0x05, 3},
+		{0x05, 4}, {0x15, 5}, {0x00, 0}, {0x03, 2}, {0x03, 3},
+		{0x03, 4}, {0x0b, 4}, {0x0b, 5}, {0x2b, 6}, {0x1b, 5}},
+	/* IR_SELECT */
+	{{0x01, 1}, {0x01, 2}, {0x05, 3}, {0x05, 4}, {0x05, 5}, {0x15, 5},
+		{0x15, 6}, {0x55, 7}, {0x35, 6}, {0x00, 0}, {0x00, 1},
+		{0x00, 2}, {0x02, 2}, {0x02, 3}, {0x0a, 4}, {0x06, 3}},
+	/* IR_CAPTURE */
+	{{0x1f, 5}, {0x03, 3}, {0x07, 3}, {0x07, 4}, {0x07, 5}, {0x17, 5},
+		{0x17, 6}, {0x57, 7}, {0x37, 6}, {0x0f, 4}, {0x00, 0},
+		{0x00, 1}, {0x01, 1}, {0x01, 2}, {0x05, 3}, {0x03, 2}},
+	/* IR_SHIFT */
+	{{0x1f, 5}, {0x03, 3}, {0x07, 3}, {0x07, 4}, {0x07, 5}, {0x17, 5},
+		{0x17, 6}, {0x57, 7}, {0x37, 6}, {0x0f, 4}, {0x0f, 5},
+		{0x00, 0}, {0x01, 1}, {0x01, 2}, {0x05, 3}, {0x03, 2}},
+	/* IR_EXIT1 */
+	{{0x0f, 4}, {0x01, 2}, {0x03, 2}, {0x03, 3}, {0x03, 4}, {0x0b, 4},
+		{0x0b, 5}, {0x2b, 6}, {0x1b, 5}, {0x07, 3}, {0x07, 4},
+		{0x02, 3}, {0x00, 0}, {0x00, 1}, {0x02, 2}, {0x01, 1}},
+	/* IR_PAUSE */
+	{{0x1f, 5}, {0x03, 3}, {0x07, 3}, {0x07, 4}, {0x07, 5}, {0x17, 5},
+		{0x17, 6}, {0x57, 7}, {0x37, 6}, {0x0f, 4}, {0x0f, 5},
+		{0x01, 2}, {0x05, 3}, {0x00, 0}, {0x01, 1}, {0x03, 2}},
+	/* IR_EXIT2 */
+	{{0x0f, 4}, {0x01, 2}, {0x03, 2}, {0x03, 3}, {0x03, 4}, {0x0b, 4},
+		{0x0b, 5}, {0x2b, 6}, {0x1b, 5}, {0x07, 3}, {0x07, 4},
+		{0x00, 1}, {0x02, 2}, {0x02, 3}, {0x00, 0}, {0x01, 1}},
+	/* IR_UPDATE */
+	{{0x07, 3}, {0x00, 1}, {0x01, 1}, {0x01, 2}, {0x01, 3}, {0x05, 3},
+		{0x05, 4}, {0x15, 5}, {0x0d, 4}, {0x03, 2}, {0x03, 3},
+		{0x03, 4}, {0x0b, 4}, {0x0b, 5}, {0x2b, 6}, {0x00, 0}}
+};
+
+static bool is_stable_state(enum jaylink_tap_state state)
+{
+	switch (state) {
+	case JAYLINK_TAP_STATE_RESET:
+	case JAYLINK_TAP_STATE_IDLE:
+	case JAYLINK_TAP_STATE_DR_SHIFT:
+	case JAYLINK_TAP_STATE_DR_PAUSE:
+	case JAYLINK_TAP_STATE_IR_SHIFT:
+	case JAYLINK_TAP_STATE_IR_PAUSE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Reserve space for the specified number of bits in the TMS, TDI and TDO
+ * buffers.
+ */
+static int reserve_bits(struct jaylink_jtag_scan *scan, size_t length)
+{
+	uint8_t *tms;
+	uint8_t *tdi;
+	uint8_t *tdo;
+	size_t size;
+
+	size = (scan->length + length + 7) / 8;
+
+	if (size <= scan->size)
+		return JAYLINK_OK;
+
+	size = MAX(size, scan->size * 2);
+	tms = realloc(scan->tms, size);
+
+	if (!tms)
+		return JAYLINK_ERR_MALLOC;
+
+	scan->tms = tms;
+	tdi = realloc(scan->tdi, size);
+
+	if (!tdi)
+		return JAYLINK_ERR_MALLOC;
+
+	scan->tdi = tdi;
+	tdo = realloc(scan->tdo, size);
+
+	if (!tdo)
+		return JAYLINK_ERR_MALLOC;
+
+	scan->tdo = tdo;
+	scan->size = size;
+
+	return JAYLINK_OK;
+}
+
+static int add_capture(struct jaylink_jtag_scan *scan, uint8_t *buffer,
+		size_t offset, size_t length)
+{
+	struct jtag_scan_capture *captures;
+	size_t size;
+
+	if (scan->num_captures == scan->captures_size) {
+		size = scan->captures_size * 2;
+		captures = realloc(scan->captures, size * sizeof(*captures));
+
+		if (!captures)
+			return JAYLINK_ERR_MALLOC;
+
+		scan->captures = captures;
+		scan->captures_size = size;
+	}
+
+	scan->captures[scan->num_captures].buffer = buffer;
+	scan->captures[scan->num_captures].offset = offset;
+	scan->captures[scan->num_captures].length = length;
+	scan->num_captures++;
+
+	return JAYLINK_OK;
+}
+
+/* Append TMS bits with TDI low. */
+static int append_tms(struct jaylink_jtag_scan *scan, uint32_t tms,
+		size_t length)
+{
+	int ret;
+
+	ret = reserve_bits(scan, length);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	jaylink_bitvec_set_field(scan->tms, scan->length, tms, length);
+	jaylink_bitvec_fill(scan->tdi, scan->length, false, length);
+	scan->length += length;
+
+	return JAYLINK_OK;
+}
+
+static int move_to_state(struct jaylink_jtag_scan *scan,
+		enum jaylink_tap_state state)
+{
+	int ret;
+	const struct tap_path *path;
+
+	if (!scan->state_known) {
+		ret = append_tms(scan, 0x1f, TAP_RESET_CYCLES);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+
+		scan->state = JAYLINK_TAP_STATE_RESET;
+		scan->state_known = true;
+	}
+
+	path = &tap_paths[scan->state][state];
+	ret = append_tms(scan, path->tms, path->length);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	scan->state = state;
+
+	return JAYLINK_OK;
+}
+
+/*
+ * Append a shift operation. The bits of the other TAPs are shifted before
+ * and after the data of the selected TAP.
+ */
+static int append_shift(struct jaylink_jtag_scan *scan,
+		enum jaylink_tap_state shift_state, const uint8_t *out,
+		uint8_t *in, size_t length, size_t pre, size_t post,
+		bool bypass_value, enum jaylink_tap_state end_state)
+{
+	int ret;
+	size_t total;
+
+	ret = move_to_state(scan, shift_state);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	total = pre + length + post;
+	ret = reserve_bits(scan, total);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	if (in) {
+		ret = add_capture(scan, in, scan->length + pre, length);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+	}
+
+	jaylink_bitvec_fill(scan->tms, scan->length, false, total);
+	jaylink_bitvec_fill(scan->tdi, scan->length, bypass_value, pre);
+	jaylink_bitvec_copy(scan->tdi, scan->length + pre, out, 0, length);
+	jaylink_bitvec_fill(scan->tdi, scan->length + pre + length,
+		bypass_value, post);
+
+	/* Leave the shift state with the last bit. */
+	if (end_state != shift_state) {
+		jaylink_bitvec_fill(scan->tms, scan->length + total - 1, true, 1);
+		if (shift_state == JAYLINK_TAP_STATE_DR_SHIFT)
+			scan->state = JAYLINK_TAP_STATE_DR_EXIT1;
+		else
+			scan->state = JAYLINK_TAP_STATE_IR_EXIT1;
+	}
+
+	scan->length += total;
+
+	return move_to_state(scan, end_state);
+}
+
+/*
+ * Append a shift operation of the whole scan chain without taking the TAPs of
+ * the chain into account.
+ */
+JAYLINK_PRIV int jtag_scan_shift(struct jaylink_jtag_scan *scan, bool ir,
+		const uint8_t *out, uint8_t *in, size_t length,
+		enum jaylink_tap_state end_state)
+{
+	enum jaylink_tap_state shift_state;
+
+	if (ir)
+		shift_state = JAYLINK_TAP_STATE_IR_SHIFT;
+	else
+		shift_state = JAYLINK_TAP_STATE_DR_SHIFT;
+
+	return append_shift(scan, shift_state, out, in, length, 0, 0, false,
+		end_state);
+}
+
+/* Move the TAP controllers into any state, including unstable ones. */
+JAYLINK_PRIV int jtag_scan_move(struct jaylink_jtag_scan *scan,
+		enum jaylink_tap_state state)
+{
+	return move_to_state(scan, state);
+}
+
+/*
+ * Append TCK cycles which keep the TAP controllers in the current stable
+ * state. TMS is held high in the Test-Logic-Reset state and low otherwise.
+ */
+JAYLINK_PRIV int jtag_scan_clock(struct jaylink_jtag_scan *scan,
+		size_t num_clocks)
+{
+	int ret;
+
+	if (!scan->state_known || !is_stable_state(scan->state))
+		return JAYLINK_ERR;
+
+	ret = reserve_bits(scan, num_clocks);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	jaylink_bitvec_fill(scan->tms, scan->length,
+		scan->state == JAYLINK_TAP_STATE_RESET, num_clocks);
+	jaylink_bitvec_fill(scan->tdi, scan->length, false, num_clocks);
+	scan->length += num_clocks;
+
+	return JAYLINK_OK;
+}
+
+/*
+ * Discard the pending operations. The state of the TAP controllers is unknown
+ * afterwards.
+ */
+JAYLINK_PRIV void jtag_scan_discard(struct jaylink_jtag_scan *scan)
+{
+	scan->length = 0;
+	scan->num_captures = 0;
+	scan->state_known = false;
+}
+
+/**
+ * Create a JTAG scan engine.
+ *
+ * The state of the TAP controllers is unknown initially. Therefore, the first
+ * operation is preceded by five TCK cycles with TMS high which move the TAP
+ * controllers into the Test-Logic-Reset state.
+ *
+ * @param[in,out] devh Device handle. It must remain valid until the scan
+ *                     engine is freed.
+ * @param[in] version Version of the JTAG command to use.
+ * @param[out] scan Newly allocated scan engine on success. Its content is
+ *                  undefined on failure.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_jtag_scan_new(struct jaylink_device_handle *devh,
+		enum jaylink_jtag_version version,
+		struct jaylink_jtag_scan **scan)
+{
+	struct jaylink_jtag_scan *tmp;
+
+	if (!devh || !scan)
+		return JAYLINK_ERR_ARG;
+
+	if (version != JAYLINK_JTAG_VERSION_2 &&
+			version != JAYLINK_JTAG_VERSION_3)
+		return JAYLINK_ERR_ARG;
+
+	tmp = malloc(sizeof(struct jaylink_jtag_scan));
+
+	if (!tmp)
+		return JAYLINK_ERR_MALLOC;
+
+	tmp->tms = malloc(SCAN_INITIAL_SIZE);
+	tmp->tdi = malloc(SCAN_INITIAL_SIZE);
+	tmp->tdo = malloc(SCAN_INITIAL_SIZE);
+	tmp->captures = malloc(SCAN_INITIAL_CAPTURES *
+		sizeof(struct jtag_scan_capture));
+
+	if (!tmp->tms || !tmp->tdi || !tmp->tdo || !tmp->captures) {
+		free(tmp->tms);
+		free(tmp->tdi);
+		free(tmp->tdo);
+		free(tmp->captures);
+		free(tmp);
+		return JAYLINK_ERR_MALLOC;
+	}
+
+	tmp->devh = devh;
+	tmp->version = version;
+	tmp->state = JAYLINK_TAP_STATE_RESET;
+	tmp->state_known = false;
+	tmp->ir_lengths = NULL;
+	tmp->idcodes = NULL;
+	tmp->num_taps = 0;
+	tmp->tap = 0;
+	tmp->ir_pre = 0;
+	tmp->ir_post = 0;
+	tmp->length = 0;
+	tmp->size = SCAN_INITIAL_SIZE;
+	tmp->num_captures = 0;
+	tmp->captures_size = SCAN_INITIAL_CAPTURES;
+
+	*scan = tmp;
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Free a JTAG scan engine.
+ *
+ * Pending operations are discarded.
+ *
+ * @param[in,out] scan Scan engine. If NULL, the function does nothing.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API void jaylink_jtag_scan_free(struct jaylink_jtag_scan *scan)
+{
+	if (!scan)
+		return;
+
+	free(scan->ir_lengths);
+	free(scan->idcodes);
+	free(scan->captures);
+	free(scan->tms);
+	free(scan->tdi);
+	free(scan->tdo);
+	free(scan);
+}
+
+/**
+ * Set the TAPs of the JTAG scan chain.
+ *
+ * The first TAP is the one closest to TDO of the device, which means its data
+ * is shifted out first. The first TAP is selected.
+ *
+ * The IDCODEs of the TAPs are unknown afterwards, use
+ * jaylink_jtag_scan_detect() to determine the scan chain including the
+ * IDCODEs instead.
+ *
+ * @param[in,out] scan Scan engine.
+ * @param[in] ir_lengths Instruction register length in bits of each TAP.
+ * @param[in] num_taps Number of TAPs.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @see jaylink_jtag_scan_select_tap()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_jtag_scan_set_chain(struct jaylink_jtag_scan *scan,
+		const size_t *ir_lengths, size_t num_taps)
+{
+	size_t *tmp;
+	uint32_t *idcodes;
+	size_t i;
+
+	if (!scan || !ir_lengths || !num_taps)
+		return JAYLINK_ERR_ARG;
+
+	for (i = 0; i < num_taps; i++) {
+		if (!ir_lengths[i])
+			return JAYLINK_ERR_ARG;
+	}
+
+	tmp = malloc(num_taps * sizeof(size_t));
+
+	if (!tmp)
+		return JAYLINK_ERR_MALLOC;
+
+	/* The IDCODEs are unknown unless the chain was detected. */
+	idcodes = calloc(num_taps, sizeof(uint32_t));
+
+	if (!idcodes) {
+		free(tmp);
+		return JAYLINK_ERR_MALLOC;
+	}
+
+	memcpy(tmp, ir_lengths, num_taps * sizeof(size_t));
+
+	free(scan->ir_lengths);
+	free(scan->idcodes);
+	scan->ir_lengths = tmp;
+	scan->idcodes = idcodes;
+	scan->num_taps = num_taps;
+
+	return jaylink_jtag_scan_select_tap(scan, 0);
+}
+
+/**
+ * Select the TAP for instruction and data register scans.
+ *
+ * All other TAPs of the chain are expected to be in bypass mode during data
+ * register scans. During instruction register scans, the BYPASS instruction
+ * (all ones) is shifted into all other TAPs.
+ *
+ * @param[in,out] scan Scan engine.
+ * @param[in] tap Index of the TAP.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_jtag_scan_select_tap(struct jaylink_jtag_scan *scan,
+		size_t tap)
+{
+	size_t i;
+
+	if (!scan || tap >= scan->num_taps)
+		return JAYLINK_ERR_ARG;
+
+	scan->tap = tap;
+	scan->ir_pre = 0;
+	scan->ir_post = 0;
+
+	for (i = 0; i < tap; i++)
+		scan->ir_pre += scan->ir_lengths[i];
+
+	for (i = tap + 1; i < scan->num_taps; i++)
+		scan->ir_post += scan->ir_lengths[i];
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Retrieve the TAP controller state after the pending operations.
+ *
+ * @param[in] scan Scan engine.
+ * @param[out] state TAP controller state on success, and undefined on
+ *                   failure.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR The TAP controller state is unknown.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_jtag_scan_get_state(
+		const struct jaylink_jtag_scan *scan,
+		enum jaylink_tap_state *state)
+{
+	if (!scan || !state)
+		return JAYLINK_ERR_ARG;
+
+	if (!scan->state_known)
+		return JAYLINK_ERR;
+
+	*state = scan->state;
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Move the TAP controllers into the Test-Logic-Reset state.
+ *
+ * Unlike jaylink_jtag_scan_goto(), TMS is held high for five cycles
+ * regardless of the current state.
+ *
+ * @param[in,out] scan Scan engine.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_jtag_scan_reset(struct jaylink_jtag_scan *scan)
+{
+	int ret;
+
+	if (!scan)
+		return JAYLINK_ERR_ARG;
+
+	ret = append_tms(scan, 0x1f, TAP_RESET_CYCLES);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	scan->state = JAYLINK_TAP_STATE_RESET;
+	scan->state_known = true;
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Move the TAP controllers into a stable state.
+ *
+ * The shortest path from the current state is used.
+ *
+ * @param[in,out] scan Scan engine.
+ * @param[in] state Stable TAP controller state: Test-Logic-Reset,
+ *                  Run-Test/Idle, Shift-DR, Pause-DR, Shift-IR or Pause-IR.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_jtag_scan_goto(struct jaylink_jtag_scan *scan,
+		enum jaylink_tap_state state)
+{
+	if (!scan || !is_stable_state(state))
+		return JAYLINK_ERR_ARG;
+
+	return move_to_state(scan, state);
+}
+
+/**
+ * Move the TAP controllers into the Run-Test/Idle state and stay there.
+ *
+ * @param[in,out] scan Scan engine.
+ * @param[in] num_clocks Number of TCK cycles to stay in the Run-Test/Idle
+ *                       state.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_jtag_scan_idle(struct jaylink_jtag_scan *scan,
+		size_t num_clocks)
+{
+	int ret;
+
+	if (!scan)
+		return JAYLINK_ERR_ARG;
+
+	ret = move_to_state(scan, JAYLINK_TAP_STATE_IDLE);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	return jtag_scan_clock(scan, num_clocks);
+}
+
+/**
+ * Perform an instruction register scan on the selected TAP.
+ *
+ * The BYPASS instruction is shifted into all other TAPs of the chain. The
+ * buffers must remain valid until the scan engine is flushed.
+ *
+ * @param[in,out] scan Scan engine.
+ * @param[in] out Buffer to read the instruction from. The number of bits is
+ *                the instruction register length of the selected TAP.
+ * @param[out] in Buffer to store the captured instruction register bits of
+ *                the selected TAP when the scan engine is flushed
+ *                successfully, or NULL.
+ * @param[in] end_state Stable TAP controller state after the scan.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @see jaylink_jtag_scan_set_chain()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_jtag_scan_ir(struct jaylink_jtag_scan *scan,
+		const uint8_t *out, uint8_t *in, enum jaylink_tap_state end_state)
+{
+	if (!scan || !out || !scan->num_taps)
+		return JAYLINK_ERR_ARG;
+
+	if (!is_stable_state(end_state))
+		return JAYLINK_ERR_ARG;
+
+	return append_shift(scan, JAYLINK_TAP_STATE_IR_SHIFT, out, in,
+		scan->ir_lengths[scan->tap], scan->ir_pre, scan->ir_post, true,
+		end_state);
+}
+
+/**
+ * Perform a data register scan on the selected TAP.
+ *
+ * All other TAPs of the chain are expected to be in bypass mode, a single
+ * bit is shifted for each of them. The buffers must remain valid until the
+ * scan engine is flushed.
+ *
+ * @param[in,out] scan Scan engine.
+ * @param[in] out Buffer to read the data from.
+ * @param[out] in Buffer to store the captured data register bits of the
+ *                selected TAP when the scan engine is flushed successfully,
+ *                or NULL.
+ * @param[in] length Number of bits to shift.
+ * @param[in] end_state Stable TAP controller state after the scan.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_jtag_scan_dr(struct jaylink_jtag_scan *scan,
+		const uint8_t *out, uint8_t *in, size_t length,
+		enum jaylink_tap_state end_state)
+{
+	size_t post;
+
+	if (!scan || !out || !length)
+		return JAYLINK_ERR_ARG;
+
+	if (!is_stable_state(end_state))
+		return JAYLINK_ERR_ARG;
+
+	post = 0;
+
+	if (scan->num_taps > 0)
+		post = scan->num_taps - scan->tap - 1;
+
+	return append_shift(scan, JAYLINK_TAP_STATE_DR_SHIFT, out, in, length,
+		scan->tap, post, false, end_state);
+}
+
+/**
+ * Transfer the pending operations of a JTAG scan engine to the device.
+ *
+ * All pending operations are transferred with a single JTAG I/O operation.
+ * On failure, the state of the TAP controllers is unknown afterwards.
+ *
+ * @param[in,out] scan Scan engine.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR_DEV_NO_MEMORY Not enough memory on the device to perform
+ *                                   the operation.
+ * @retval JAYLINK_ERR_DEV Unspecified device error.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @see jaylink_jtag_io_long()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_jtag_scan_flush(struct jaylink_jtag_scan *scan)
+{
+	int ret;
+	size_t i;
+	const struct jtag_scan_capture *capture;
+
+	if (!scan)
+		return JAYLINK_ERR_ARG;
+
+	if (!scan->length)
+		return JAYLINK_OK;
+
+	if (scan->length <= UINT16_MAX)
+		ret = jaylink_jtag_io(scan->devh, scan->tms, scan->tdi,
+			scan->tdo, scan->length, scan->version);
+	else
+		ret = jaylink_jtag_io_long(scan->devh, scan->tms, scan->tdi,
+			scan->tdo, scan->length, scan->version);
+
+	if (ret == JAYLINK_OK) {
+		for (i = 0; i < scan->num_captures; i++) {
+			capture = &scan->captures[i];
+			jaylink_bitvec_copy(capture->buffer, 0, scan->tdo,
+				capture->offset, capture->length);
+		}
+	} else {
+		scan->state_known = false;
+	}
+
+	scan->length = 0;
+	scan->num_captures = 0;
+
+	return ret;
+}
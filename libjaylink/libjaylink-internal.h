@@ -30,6 +30,7 @@
 #else
 #include <sys/socket.h>
 #include <arpa/inet.h>
+#include <pthread.h>
 #endif
 
 #ifdef HAVE_CONFIG_H
@@ -58,6 +59,94 @@
 /** Calculate the minimum of two numeric values. */
 #define MIN(a, b) (((a) < (b)) ? (a) : (b))
 
+/** Calculate the maximum of two numeric values. */
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+
+/** Port number of the J-Link TCP/IP protocol. */
+#define TRANSPORT_TCP_PORT	19020
+
+/** Maximum number of buffers of a scatter-gather write. */
+#define TRANSPORT_MAX_IOVEC	4
+
+/** Buffer of a scatter-gather write. */
+struct transport_iovec {
+	/** Buffer to write data from. */
+	const uint8_t *buffer;
+	/** Number of bytes to write. */
+	size_t length;
+};
+
+struct jaylink_device_handle;
+
+/** Recursive mutex. */
+struct thread_mutex {
+#ifdef _WIN32
+	/** Critical section. */
+	CRITICAL_SECTION cs;
+#else
+	/** POSIX mutex. */
+	pthread_mutex_t mutex;
+#endif
+};
+
+/** Function executed by a thread. */
+typedef void (*thread_function)(void *arg);
+
+/** Thread. */
+struct thread {
+	/** Function executed by the thread. */
+	thread_function function;
+	/** Argument passed to the function. */
+	void *arg;
+#ifdef _WIN32
+	/** Windows thread handle. */
+	HANDLE handle;
+#else
+	/** POSIX thread. */
+	pthread_t thread;
+#endif
+};
+
+/**
+ * Transport operations.
+ *
+ * Each host interface provides an instance of this structure. See the
+ * corresponding functions of the transport abstraction layer in transport.c
+ * for a description of the operations.
+ */
+struct transport_ops {
+	/** Open a device. */
+	int (*open)(struct jaylink_device_handle *devh);
+	/** Close a device. */
+	int (*close)(struct jaylink_device_handle *devh);
+	/** Start a write operation. */
+	int (*start_write)(struct jaylink_device_handle *devh, size_t length,
+		bool has_command);
+	/** Start a read operation. */
+	int (*start_read)(struct jaylink_device_handle *devh, size_t length);
+	/** Start a write and read operation. */
+	int (*start_write_read)(struct jaylink_device_handle *devh,
+		size_t write_length, size_t read_length, bool has_command);
+	/** Write data. */
+	int (*write)(struct jaylink_device_handle *devh, const uint8_t *buffer,
+		size_t length);
+	/** Write data from multiple buffers. */
+	int (*writev)(struct jaylink_device_handle *devh,
+		const struct transport_iovec *iov, size_t iovcnt);
+	/** Read data. */
+	int (*read)(struct jaylink_device_handle *devh, uint8_t *buffer,
+		size_t length);
+	/** End a batch of write operations. */
+	int (*end_batch)(struct jaylink_device_handle *devh, bool discard);
+	/** Send the data of an ended batch without blocking. */
+	int (*progress_batch)(struct jaylink_device_handle *devh, bool *done);
+	/** Receive the data of a read operation without blocking. */
+	int (*progress_read)(struct jaylink_device_handle *devh, bool *done);
+	/** Get the file descriptors to be monitored. */
+	int (*get_pollfds)(struct jaylink_device_handle *devh,
+		struct jaylink_pollfd *fds, size_t *num_fds);
+};
+
 struct jaylink_context {
 #ifdef HAVE_LIBUSB
 	/** libusb context. */
@@ -71,6 +160,15 @@ struct jaylink_context {
 	struct list *devs;
 	/** List of recently discovered devices. */
 	struct list *discovered_devs;
+	/**
+	 * Lock of the device lists.
+	 *
+	 * The lock must be held to access the lists and to release the last
+	 * reference of a device instance.
+	 */
+	struct thread_mutex lock;
+	/** Lock of the log settings, held while a message is logged. */
+	struct thread_mutex log_lock;
 	/** Current log level. */
 	enum jaylink_log_level log_level;
 	/** Log callback function. */
@@ -84,7 +182,11 @@ struct jaylink_context {
 struct jaylink_device {
 	/** libjaylink context. */
 	struct jaylink_context *ctx;
-	/** Number of references held on this device instance. */
+	/**
+	 * Number of references held on this device instance.
+	 *
+	 * The value is accessed atomically.
+	 */
 	size_t ref_count;
 	/** Host interface. */
 	enum jaylink_host_interface iface;
@@ -112,6 +214,13 @@ struct jaylink_device {
 	 * only.
 	 */
 	char ipv4_address[INET_ADDRSTRLEN];
+	/**
+	 * TCP port of the device.
+	 *
+	 * This field is used for devices with host interface #JAYLINK_HIF_TCP
+	 * only.
+	 */
+	uint16_t tcp_port;
 	/**
 	 * Media Access Control (MAC) address.
 	 *
@@ -148,11 +257,50 @@ struct jaylink_device {
 	struct jaylink_hardware_version hw_version;
 	/** Indicates whether the hardware version is available. */
 	bool has_hw_version;
+	/**
+	 * Operations of the custom transport.
+	 *
+	 * This field is used for devices with host interface
+	 * #JAYLINK_HIF_CUSTOM only.
+	 */
+	const struct jaylink_transport_ops *custom_ops;
+	/**
+	 * User data to be passed to the operations of the custom transport.
+	 *
+	 * This field is used for devices with host interface
+	 * #JAYLINK_HIF_CUSTOM only.
+	 */
+	void *custom_data;
+};
+
+/** Command measured for the statistics. */
+struct stats_command {
+	/** Indicates whether a command is measured. */
+	bool active;
+	/** Indicates whether the opcode of the command is known. */
+	bool has_opcode;
+	/** Indicates whether the latency of the command is measured. */
+	bool timed;
+	/** Opcode of the command. */
+	uint8_t opcode;
+	/** Start time of the command in microseconds. */
+	uint64_t start;
+	/** Time of the last data transfer of the command in microseconds. */
+	uint64_t end;
 };
 
 struct jaylink_device_handle {
 	/** Device instance. */
 	struct jaylink_device *dev;
+	/** Lock to serialize the operations on the device handle. */
+	struct thread_mutex lock;
+	/**
+	 * Transport operations.
+	 *
+	 * The operations are selected according to the host interface of the
+	 * device when the device is opened.
+	 */
+	const struct transport_ops *transport;
 	/**
 	 * Buffer for write and read operations.
 	 *
@@ -180,6 +328,24 @@ struct jaylink_device_handle {
 	 * write operations only.
 	 */
 	size_t write_pos;
+	/**
+	 * Indicates whether batch mode is enabled.
+	 *
+	 * In batch mode, the data of consecutive write operations is collected
+	 * in the buffer and sent to the device at once when the batch is ended.
+	 */
+	bool batch;
+	/** Performance statistics. */
+	struct jaylink_stats stats;
+	/** Command currently measured for the statistics. */
+	struct stats_command stats_cmd;
+	/** Capture of the transport operations, or NULL if not captured. */
+	struct capture *capture;
+	/**
+	 * Number of bytes of TMS and TDI data of each JTAG I/O operation of
+	 * jaylink_jtag_io_long(), or 0 if not determined yet.
+	 */
+	size_t jtag_chunk_size;
 #ifdef HAVE_LIBUSB
 	/** libusb device handle. */
 	struct libusb_device_handle *usb_devh;
@@ -189,6 +355,8 @@ struct jaylink_device_handle {
 	uint8_t endpoint_in;
 	/** USB interface OUT endpoint of the device. */
 	uint8_t endpoint_out;
+	/** Asynchronous transfer state. */
+	struct usb_async *usb_async;
 #endif
 	/**
 	 * Socket descriptor.
@@ -197,6 +365,407 @@ struct jaylink_device_handle {
 	 * only.
 	 */
 	int sock;
+	/**
+	 * Indicates whether the socket is in non-blocking mode.
+	 *
+	 * This field is used for devices with host interface #JAYLINK_HIF_TCP
+	 * only.
+	 */
+	bool sock_nonblocking;
+	/**
+	 * Number of bytes of an ended batch which are sent without blocking.
+	 *
+	 * This field is used for devices with host interface #JAYLINK_HIF_TCP
+	 * only.
+	 */
+	size_t batch_pos;
+	/**
+	 * Time of the last data transfer without blocking in microseconds.
+	 *
+	 * This field is used for devices with host interface #JAYLINK_HIF_TCP
+	 * only.
+	 */
+	uint64_t progress_time;
+};
+
+/** Maximum number of header bytes of a queue entry. */
+#define QUEUE_ENTRY_HEADER_SIZE	4
+
+/** Queued command. */
+struct queue_entry {
+	/** Command header. */
+	uint8_t header[QUEUE_ENTRY_HEADER_SIZE];
+	/** Number of bytes of the command header. */
+	size_t header_length;
+	/**
+	 * Buffers with the command data to be sent after the header.
+	 *
+	 * Unused buffers are NULL.
+	 */
+	const uint8_t *data[2];
+	/** Number of bytes of each buffer with command data. */
+	size_t data_length;
+	/**
+	 * Buffer to store the response data.
+	 *
+	 * NULL if the command has no response data.
+	 */
+	uint8_t *response;
+	/** Number of bytes of the response data. */
+	size_t response_length;
+	/**
+	 * Indicates whether the response data is followed by a status byte.
+	 */
+	bool has_status;
+};
+
+struct jaylink_queue {
+	/** Device handle. */
+	struct jaylink_device_handle *devh;
+	/** Queued commands. */
+	struct queue_entry *entries;
+	/** Number of queued commands. */
+	size_t num_entries;
+	/** Number of allocated entries. */
+	size_t size;
+	/** Indicates whether the queue is executed without blocking. */
+	bool submitted;
+	/** Indicates whether the commands of the current segment are sent. */
+	bool reading;
+	/** Index of the first command of the current segment. */
+	size_t start;
+	/** Index after the last command of the current segment. */
+	size_t end;
+	/** Number of response bytes of the current segment. */
+	size_t read_length;
+	/** Error of the first failed command. */
+	int result;
+};
+
+/** Type of an operation of a broadcast. */
+enum broadcast_step_type {
+	BROADCAST_STEP_JTAG_IO,
+	BROADCAST_STEP_JTAG_CLEAR_TRST,
+	BROADCAST_STEP_JTAG_SET_TRST,
+	BROADCAST_STEP_SWD_IO,
+	BROADCAST_STEP_CLEAR_RESET,
+	BROADCAST_STEP_SET_RESET,
+	BROADCAST_STEP_FILE_WRITE
+};
+
+/** Operation of a broadcast. */
+struct broadcast_step {
+	/** Type of the operation. */
+	enum broadcast_step_type type;
+	/**
+	 * Buffers with the data of the operation.
+	 *
+	 * Unused buffers are NULL.
+	 */
+	const uint8_t *data[2];
+	/**
+	 * Buffer to store the response data of all devices.
+	 *
+	 * NULL if the response data is discarded or if the operation has no
+	 * response data.
+	 */
+	uint8_t *response;
+	/** Number of bits or bytes to transfer. */
+	uint32_t length;
+	/** Version of the JTAG command. */
+	enum jaylink_jtag_version version;
+	/** Name of the file to write to. */
+	char filename[JAYLINK_FILE_NAME_MAX_LENGTH + 1];
+	/** Offset in the file. */
+	uint32_t offset;
+};
+
+/** Device of a broadcast. */
+struct broadcast_probe {
+	/** Device handle. */
+	struct jaylink_device_handle *devh;
+	/** Index of the device. */
+	size_t index;
+	/** Queue to execute the operations. */
+	struct jaylink_queue *queue;
+	/** Buffer to store discarded response data. */
+	uint8_t *scratch;
+	/** Result of the last execution. */
+	int result;
+};
+
+struct jaylink_broadcast {
+	/** libjaylink context of the first device. */
+	struct jaylink_context *ctx;
+	/** Devices. */
+	struct broadcast_probe *probes;
+	/** Number of devices. */
+	size_t num_probes;
+	/** Operations. */
+	struct broadcast_step *steps;
+	/** Number of operations. */
+	size_t num_steps;
+	/** Number of allocated operations. */
+	size_t size;
+	/** Maximum number of workers, or 0 for a worker for each device. */
+	size_t num_workers;
+	/** Number of bytes of discarded response data per device. */
+	size_t scratch_length;
+	/**
+	 * Index of the next device to be served by a worker.
+	 *
+	 * Accessed atomically.
+	 */
+	size_t next_probe;
+};
+
+/** Maximum number of idle cycles after each access of an access layer. */
+#define MAX_IDLE_CYCLES		1024
+
+/** Adaptive number of idle cycles of an access layer. */
+struct idle_control {
+	/** Current number of idle cycles. */
+	size_t cycles;
+	/** Minimum number of idle cycles. */
+	size_t min_cycles;
+	/** Number of consecutive transfers without a busy response. */
+	size_t successes;
+	/** Total number of transfers retried due to a busy response. */
+	uint64_t retries;
+};
+
+/** Transaction of a DAP transaction layer. */
+struct dap_transaction {
+	/** Packet request, or the request bits of a JTAG-DP scan. */
+	uint8_t request;
+	/** Offset of the packet request within the SWD data in bits. */
+	size_t offset;
+	/** Number of bits of the transaction including the idle cycles. */
+	size_t length;
+	/** Value of a write transaction. */
+	uint32_t value;
+	/**
+	 * Buffer to store the data of a read transaction.
+	 *
+	 * NULL if the data is discarded or for write transactions.
+	 */
+	uint32_t *data;
+};
+
+struct jaylink_dap {
+	/** Device handle. */
+	struct jaylink_device_handle *devh;
+	/** JTAG scan engine of a JTAG-DP, or NULL for a SW-DP. */
+	struct jaylink_jtag_scan *scan;
+	/** Index of the JTAG-DP within the scan chain. */
+	size_t tap;
+	/** Current instruction of the JTAG-DP, or 0 if unknown. */
+	uint8_t ir;
+	/** Direction data of the pending transactions. */
+	uint8_t *direction;
+	/** Host-to-target data of the pending transactions. */
+	uint8_t *out;
+	/** Buffer for the target-to-host data of the pending transactions. */
+	uint8_t *in;
+	/** Number of bits of the pending transactions. */
+	size_t length;
+	/** Size of the direction, output and input buffers in bytes. */
+	size_t size;
+	/** Pending transactions. */
+	struct dap_transaction *transactions;
+	/** Number of pending transactions. */
+	size_t num_transactions;
+	/** Number of allocated transactions. */
+	size_t transactions_size;
+	/**
+	 * Indicates whether the result of an AP read is pending.
+	 *
+	 * AP reads are posted, their result is returned by the next AP read or
+	 * DP RDBUFF read.
+	 */
+	bool read_pending;
+	/** Buffer to store the result of the pending AP read, or NULL. */
+	uint32_t *pending_data;
+	/** Value of the DP SELECT register after the pending transactions. */
+	uint32_t select;
+	/** Indicates whether the value of the DP SELECT register is known. */
+	bool select_valid;
+	/** Maximum number of bits per SWD I/O operation. */
+	size_t chunk_length;
+	/** Number of the MEM-AP whose CSW register value is known. */
+	uint8_t csw_ap;
+	/** Value of the CSW register of the MEM-AP. */
+	uint32_t csw;
+	/** Indicates whether the value of the CSW register is known. */
+	bool csw_valid;
+	/**
+	 * Number of idle cycles after each AP transaction.
+	 *
+	 * The number is adapted to the WAIT responses of the target.
+	 */
+	struct idle_control idle;
+	/** Indicates whether overrun detection of the DP is enabled. */
+	bool overrun_detect;
+	/** Last written value of the DP CTRL/STAT register. */
+	uint32_t ctrl_stat;
+};
+
+/**
+ * State of the pending transactions of a DAP transaction layer.
+ *
+ * Used to drop the transactions which were added after the state was saved.
+ */
+struct dap_queue_state {
+	/** Number of bits of the pending transactions. */
+	size_t length;
+	/** Number of pending transactions. */
+	size_t num_transactions;
+	/** Indicates whether the result of an AP read is pending. */
+	bool read_pending;
+	/** Buffer to store the result of the pending AP read, or NULL. */
+	uint32_t *pending_data;
+	/** Value of the DP SELECT register after the pending transactions. */
+	uint32_t select;
+	/** Indicates whether the value of the DP SELECT register is known. */
+	bool select_valid;
+	/** Number of the MEM-AP whose CSW register value is known. */
+	uint8_t csw_ap;
+	/** Value of the CSW register of the MEM-AP. */
+	uint32_t csw;
+	/** Indicates whether the value of the CSW register is known. */
+	bool csw_valid;
+};
+
+/** RISC-V DMI access. */
+struct dmi_transaction {
+	/** Operation of the access. */
+	uint8_t op;
+	/** DMI address of the access. */
+	uint32_t address;
+	/** Value of a write access. */
+	uint32_t value;
+	/**
+	 * Buffer to store the data of a read access.
+	 *
+	 * NULL if the data is discarded or for other accesses.
+	 */
+	uint32_t *data;
+};
+
+struct jaylink_dmi {
+	/** JTAG scan engine. */
+	struct jaylink_jtag_scan *scan;
+	/** Index of the DTM within the scan chain. */
+	size_t tap;
+	/** Current instruction of the DTM, or 0 if unknown. */
+	uint8_t ir;
+	/** Number of DMI address bits, or 0 if unknown. */
+	size_t abits;
+	/**
+	 * Number of idle cycles after each DMI access.
+	 *
+	 * The number is adapted to the busy responses of the target.
+	 */
+	struct idle_control idle;
+	/** Pending accesses. */
+	struct dmi_transaction *transactions;
+	/** Number of pending accesses. */
+	size_t num_transactions;
+	/** Number of allocated accesses. */
+	size_t transactions_size;
+	/** Value of the sbcs register read before the first memory access. */
+	uint32_t sbcs;
+	/** Indicates whether the value of the sbcs register is known. */
+	bool sbcs_valid;
+};
+
+/** Bits captured by a JTAG scan. */
+struct jtag_scan_capture {
+	/** Buffer to store the captured bits. */
+	uint8_t *buffer;
+	/** Offset of the captured bits within the TDO data in bits. */
+	size_t offset;
+	/** Number of captured bits. */
+	size_t length;
+};
+
+struct jaylink_jtag_scan {
+	/** Device handle. */
+	struct jaylink_device_handle *devh;
+	/** Version of the JTAG command to use. */
+	enum jaylink_jtag_version version;
+	/** TAP state after the pending operations. */
+	enum jaylink_tap_state state;
+	/** Indicates whether the TAP state is known. */
+	bool state_known;
+	/** Instruction register length of each TAP of the chain. */
+	size_t *ir_lengths;
+	/**
+	 * IDCODE of each TAP of the chain, or 0 if unknown or if the TAP has
+	 * no IDCODE register.
+	 */
+	uint32_t *idcodes;
+	/** Number of TAPs of the chain. */
+	size_t num_taps;
+	/** Index of the selected TAP. */
+	size_t tap;
+	/** Number of instruction register bits before the selected TAP. */
+	size_t ir_pre;
+	/** Number of instruction register bits after the selected TAP. */
+	size_t ir_post;
+	/** TMS data of the pending operations. */
+	uint8_t *tms;
+	/** TDI data of the pending operations. */
+	uint8_t *tdi;
+	/** Buffer for the TDO data of the pending operations. */
+	uint8_t *tdo;
+	/** Number of bits of the pending operations. */
+	size_t length;
+	/** Size of the TMS, TDI and TDO buffers in bytes. */
+	size_t size;
+	/** Bits to be captured from the TDO data. */
+	struct jtag_scan_capture *captures;
+	/** Number of bits to be captured. */
+	size_t num_captures;
+	/** Number of allocated captures. */
+	size_t captures_size;
+};
+
+/** Deferred verification of the TDO data of a scan. */
+struct svf_check {
+	/**
+	 * Offset of the check within the check buffer in bytes.
+	 *
+	 * The captured TDO data is followed by the expected TDO data and the
+	 * mask, each of them with the same size.
+	 */
+	size_t offset;
+	/** Number of bits to verify. */
+	size_t length;
+	/** Position of the statement within the file. */
+	size_t position;
+};
+
+/** Player for SVF and XSVF files. */
+struct svf_player {
+	/** Scan engine. */
+	struct jaylink_jtag_scan *scan;
+	/** TCK frequency in Hz, or 0 if unknown. */
+	uint32_t frequency;
+	/** Position of the current statement within the file. */
+	size_t position;
+	/** Captured and expected TDO data of the pending checks. */
+	uint8_t *data;
+	/** Number of used bytes of the check buffer. */
+	size_t data_used;
+	/** Size of the check buffer in bytes. */
+	size_t data_size;
+	/** Pending checks. */
+	struct svf_check *checks;
+	/** Number of pending checks. */
+	size_t num_checks;
+	/** Number of allocated checks. */
+	size_t checks_size;
 };
 
 struct list {
@@ -215,18 +784,72 @@ JAYLINK_PRIV void buffer_set_u32(uint8_t *buffer, uint32_t value,
 		size_t offset);
 JAYLINK_PRIV uint32_t buffer_get_u32(const uint8_t *buffer, size_t offset);
 
+/*--- capture.c -------------------------------------------------------------*/
+
+JAYLINK_PRIV void capture_start_write(struct jaylink_device_handle *devh,
+		size_t length, bool has_command);
+JAYLINK_PRIV void capture_start_read(struct jaylink_device_handle *devh,
+		size_t length);
+JAYLINK_PRIV void capture_start_write_read(struct jaylink_device_handle *devh,
+		size_t write_length, size_t read_length, bool has_command);
+JAYLINK_PRIV void capture_write(struct jaylink_device_handle *devh,
+		const uint8_t *buffer, size_t length);
+JAYLINK_PRIV void capture_read(struct jaylink_device_handle *devh,
+		const uint8_t *buffer, size_t length);
+JAYLINK_PRIV void capture_close(struct jaylink_device_handle *devh);
+
+/*--- dap.c -----------------------------------------------------------------*/
+
+JAYLINK_PRIV struct dap_transaction *dap_add_transaction(
+		struct jaylink_dap *dap);
+JAYLINK_PRIV void dap_save_queue(const struct jaylink_dap *dap,
+		struct dap_queue_state *state);
+JAYLINK_PRIV void dap_restore_queue(struct jaylink_dap *dap,
+		const struct dap_queue_state *state);
+
+/*--- dap_jtag.c ------------------------------------------------------------*/
+
+JAYLINK_PRIV int dap_jtag_append(struct jaylink_dap *dap, bool ap, bool read,
+		uint8_t reg, uint32_t value, uint32_t *data);
+JAYLINK_PRIV int dap_jtag_idle(struct jaylink_dap *dap, size_t num_cycles);
+JAYLINK_PRIV int dap_jtag_flush(struct jaylink_dap *dap);
+
 /*--- device.c --------------------------------------------------------------*/
 
 JAYLINK_PRIV struct jaylink_device *device_allocate(
 		struct jaylink_context *ctx);
+JAYLINK_PRIV bool device_add(struct jaylink_device *dev);
 
 /*--- discovery_tcp.c -------------------------------------------------------*/
 
-JAYLINK_PRIV int discovery_tcp_scan(struct jaylink_context *ctx);
+JAYLINK_PRIV int discovery_tcp_scan(struct jaylink_context *ctx,
+		struct list **devs);
 
 /*--- discovery_usb.c -------------------------------------------------------*/
 
-JAYLINK_PRIV int discovery_usb_scan(struct jaylink_context *ctx);
+JAYLINK_PRIV int discovery_usb_scan(struct jaylink_context *ctx,
+		struct list **devs);
+
+/*--- idle.c ----------------------------------------------------------------*/
+
+JAYLINK_PRIV void idle_init(struct idle_control *idle, size_t min_cycles);
+JAYLINK_PRIV void idle_raise_min(struct idle_control *idle,
+		size_t min_cycles);
+JAYLINK_PRIV void idle_busy(struct idle_control *idle);
+JAYLINK_PRIV void idle_success(struct idle_control *idle);
+JAYLINK_PRIV void idle_get_stats(const struct idle_control *idle,
+		struct jaylink_idle_stats *stats);
+
+/*--- jtag_scan.c -----------------------------------------------------------*/
+
+JAYLINK_PRIV int jtag_scan_shift(struct jaylink_jtag_scan *scan, bool ir,
+		const uint8_t *out, uint8_t *in, size_t length,
+		enum jaylink_tap_state end_state);
+JAYLINK_PRIV int jtag_scan_move(struct jaylink_jtag_scan *scan,
+		enum jaylink_tap_state state);
+JAYLINK_PRIV int jtag_scan_clock(struct jaylink_jtag_scan *scan,
+		size_t num_clocks);
+JAYLINK_PRIV void jtag_scan_discard(struct jaylink_jtag_scan *scan);
 
 /*--- list.c ----------------------------------------------------------------*/
 
@@ -253,6 +876,12 @@ JAYLINK_PRIV void log_dbg(const struct jaylink_context *ctx,
 JAYLINK_PRIV void log_dbgio(const struct jaylink_context *ctx,
 		const char *format, ...);
 
+/*--- queue.c ---------------------------------------------------------------*/
+
+JAYLINK_PRIV struct queue_entry *queue_add(struct jaylink_queue *queue);
+JAYLINK_PRIV int queue_add_command(struct jaylink_queue *queue, uint8_t cmd);
+JAYLINK_PRIV void queue_reset(struct jaylink_queue *queue);
+
 /*--- socket.c --------------------------------------------------------------*/
 
 JAYLINK_PRIV bool socket_close(int sock);
@@ -260,6 +889,8 @@ JAYLINK_PRIV bool socket_bind(int sock, const struct sockaddr *address,
 		size_t length);
 JAYLINK_PRIV bool socket_send(int sock, const void *buffer, size_t *length,
 		int flags);
+JAYLINK_PRIV bool socket_sendv(int sock, const struct transport_iovec *iov,
+		size_t iovcnt, size_t *length, int flags);
 JAYLINK_PRIV bool socket_recv(int sock, void *buffer, size_t *length,
 		int flags);
 JAYLINK_PRIV bool socket_sendto(int sock, const void *buffer, size_t *length,
@@ -269,6 +900,45 @@ JAYLINK_PRIV bool socket_recvfrom(int sock, void *buffer, size_t *length,
 		int flags, struct sockaddr *address, size_t *address_length);
 JAYLINK_PRIV bool socket_set_option(int sock, int level, int option,
 		const void *value, size_t length);
+JAYLINK_PRIV bool socket_set_blocking(int sock, bool blocking);
+JAYLINK_PRIV bool socket_would_block(void);
+
+/*--- stats.c ---------------------------------------------------------------*/
+
+JAYLINK_PRIV void stats_init(struct jaylink_device_handle *devh);
+JAYLINK_PRIV void stats_start_command(struct jaylink_device_handle *devh);
+JAYLINK_PRIV void stats_write(struct jaylink_device_handle *devh,
+		const uint8_t *buffer, size_t length);
+JAYLINK_PRIV void stats_read(struct jaylink_device_handle *devh,
+		size_t length);
+
+/*--- svf.c -----------------------------------------------------------------*/
+
+JAYLINK_PRIV void svf_player_init(struct svf_player *player,
+		struct jaylink_jtag_scan *scan, uint32_t frequency);
+JAYLINK_PRIV void svf_player_free(struct svf_player *player);
+JAYLINK_PRIV int svf_player_shift(struct svf_player *player, bool ir,
+		const uint8_t *tdi, const uint8_t *tdo, const uint8_t *mask,
+		size_t length, enum jaylink_tap_state end_state);
+JAYLINK_PRIV int svf_player_run(struct svf_player *player,
+		size_t num_clocks, uint64_t usecs);
+JAYLINK_PRIV int svf_player_flush(struct svf_player *player);
+JAYLINK_PRIV int svf_map_file(struct jaylink_context *ctx,
+		const char *filename, const uint8_t **data, size_t *length);
+JAYLINK_PRIV void svf_unmap_file(const uint8_t *data, size_t length);
+
+/*--- thread.c --------------------------------------------------------------*/
+
+JAYLINK_PRIV bool thread_mutex_init(struct thread_mutex *mutex);
+JAYLINK_PRIV void thread_mutex_destroy(struct thread_mutex *mutex);
+JAYLINK_PRIV void thread_mutex_lock(struct thread_mutex *mutex);
+JAYLINK_PRIV void thread_mutex_unlock(struct thread_mutex *mutex);
+JAYLINK_PRIV size_t thread_atomic_inc(size_t *value);
+JAYLINK_PRIV size_t thread_atomic_dec(size_t *value);
+JAYLINK_PRIV bool thread_atomic_dec_unless_one(size_t *value);
+JAYLINK_PRIV bool thread_create(struct thread *thread,
+		thread_function function, void *arg);
+JAYLINK_PRIV void thread_join(struct thread *thread);
 
 /*--- transport.c -----------------------------------------------------------*/
 
@@ -282,39 +952,33 @@ JAYLINK_PRIV int transport_start_read(struct jaylink_device_handle *devh,
 		size_t length);
 JAYLINK_PRIV int transport_write(struct jaylink_device_handle *devh,
 		const uint8_t *buffer, size_t length);
+JAYLINK_PRIV int transport_writev(struct jaylink_device_handle *devh,
+		const struct transport_iovec *iov, size_t iovcnt);
 JAYLINK_PRIV int transport_read(struct jaylink_device_handle *devh,
 		uint8_t *buffer, size_t length);
+JAYLINK_PRIV void transport_start_batch(struct jaylink_device_handle *devh);
+JAYLINK_PRIV int transport_end_batch(struct jaylink_device_handle *devh,
+		bool discard);
+JAYLINK_PRIV int transport_progress_batch(struct jaylink_device_handle *devh,
+		bool *done);
+JAYLINK_PRIV int transport_progress_read(struct jaylink_device_handle *devh,
+		bool *done);
+
+/*--- transport_custom.c ----------------------------------------------------*/
+
+JAYLINK_PRIV extern const struct transport_ops transport_custom_ops;
 
 /*--- transport_usb.c -------------------------------------------------------*/
 
-JAYLINK_PRIV int transport_usb_open(struct jaylink_device_handle *devh);
-JAYLINK_PRIV int transport_usb_close(struct jaylink_device_handle *devh);
-JAYLINK_PRIV int transport_usb_start_write_read(
-		struct jaylink_device_handle *devh, size_t write_length,
-		size_t read_length, bool has_command);
-JAYLINK_PRIV int transport_usb_start_write(struct jaylink_device_handle *devh,
-		size_t length, bool has_command);
-JAYLINK_PRIV int transport_usb_start_read(struct jaylink_device_handle *devh,
-		size_t length);
-JAYLINK_PRIV int transport_usb_write(struct jaylink_device_handle *devh,
-		const uint8_t *buffer, size_t length);
-JAYLINK_PRIV int transport_usb_read(struct jaylink_device_handle *devh,
-		uint8_t *buffer, size_t length);
+JAYLINK_PRIV extern const struct transport_ops transport_usb_ops;
 
 /*--- transport_tcp.c -------------------------------------------------------*/
 
-JAYLINK_PRIV int transport_tcp_open(struct jaylink_device_handle *devh);
-JAYLINK_PRIV int transport_tcp_close(struct jaylink_device_handle *devh);
-JAYLINK_PRIV int transport_tcp_start_write_read(
-		struct jaylink_device_handle *devh, size_t write_length,
-		size_t read_length, bool has_command);
-JAYLINK_PRIV int transport_tcp_start_write(struct jaylink_device_handle *devh,
-		size_t length, bool has_command);
-JAYLINK_PRIV int transport_tcp_start_read(struct jaylink_device_handle *devh,
-		size_t length);
-JAYLINK_PRIV int transport_tcp_write(struct jaylink_device_handle *devh,
-		const uint8_t *buffer, size_t length);
-JAYLINK_PRIV int transport_tcp_read(struct jaylink_device_handle *devh,
-		uint8_t *buffer, size_t length);
+JAYLINK_PRIV extern const struct transport_ops transport_tcp_ops;
+
+/*--- util.c ----------------------------------------------------------------*/
+
+JAYLINK_PRIV uint64_t util_get_time(void);
+JAYLINK_PRIV void util_sleep(uint64_t usecs);
 
 #endif /* LIBJAYLINK_LIBJAYLINK_INTERNAL_H */
@@ -63,7 +63,15 @@ enum jaylink_error {
 	/** Device: entity not available. */
 	JAYLINK_ERR_DEV_NOT_AVAILABLE = -1002,
 	/** Device: not enough memory to perform operation. */
-	JAYLINK_ERR_DEV_NO_MEMORY = -1003
+	JAYLINK_ERR_DEV_NO_MEMORY = -1003,
+	/** Target: unspecified error. */
+	JAYLINK_ERR_TARGET = -2000,
+	/** Target: WAIT response, the target is busy. */
+	JAYLINK_ERR_TARGET_WAIT = -2001,
+	/** Target: FAULT response. */
+	JAYLINK_ERR_TARGET_FAULT = -2002,
+	/** Target: parity error in the data sent by the target. */
+	JAYLINK_ERR_TARGET_PARITY = -2003
 };
 
 /** libjaylink log levels. */
@@ -99,7 +107,13 @@ enum jaylink_host_interface {
 	/** Universal Serial Bus (USB). */
 	JAYLINK_HIF_USB = (1 << 0),
 	/** Transmission Control Protocol (TCP). */
-	JAYLINK_HIF_TCP = (1 << 1)
+	JAYLINK_HIF_TCP = (1 << 1),
+	/**
+	 * Custom transport.
+	 *
+	 * @see jaylink_transport_register()
+	 */
+	JAYLINK_HIF_CUSTOM = (1 << 2)
 };
 
 /**
@@ -256,6 +270,42 @@ enum jaylink_jtag_version {
 	JAYLINK_JTAG_VERSION_3 = 2
 };
 
+/** JTAG TAP controller states. */
+enum jaylink_tap_state {
+	/** Test-Logic-Reset. */
+	JAYLINK_TAP_STATE_RESET = 0,
+	/** Run-Test/Idle. */
+	JAYLINK_TAP_STATE_IDLE = 1,
+	/** Select-DR-Scan. */
+	JAYLINK_TAP_STATE_DR_SELECT = 2,
+	/** Capture-DR. */
+	JAYLINK_TAP_STATE_DR_CAPTURE = 3,
+	/** Shift-DR. */
+	JAYLINK_TAP_STATE_DR_SHIFT = 4,
+	/** Exit1-DR. */
+	JAYLINK_TAP_STATE_DR_EXIT1 = 5,
+	/** Pause-DR. */
+	JAYLINK_TAP_STATE_DR_PAUSE = 6,
+	/** Exit2-DR. */
+	JAYLINK_TAP_STATE_DR_EXIT2 = 7,
+	/** Update-DR. */
+	JAYLINK_TAP_STATE_DR_UPDATE = 8,
+	/** Select-IR-Scan. */
+	JAYLINK_TAP_STATE_IR_SELECT = 9,
+	/** Capture-IR. */
+	JAYLINK_TAP_STATE_IR_CAPTURE = 10,
+	/** Shift-IR. */
+	JAYLINK_TAP_STATE_IR_SHIFT = 11,
+	/** Exit1-IR. */
+	JAYLINK_TAP_STATE_IR_EXIT1 = 12,
+	/** Pause-IR. */
+	JAYLINK_TAP_STATE_IR_PAUSE = 13,
+	/** Exit2-IR. */
+	JAYLINK_TAP_STATE_IR_EXIT2 = 14,
+	/** Update-IR. */
+	JAYLINK_TAP_STATE_IR_UPDATE = 15
+};
+
 /** Serial Wire Output (SWO) capture modes. */
 enum jaylink_swo_mode {
 	/** Universal Asynchronous Receiver Transmitter (UART). */
@@ -345,6 +395,144 @@ struct jaylink_connection {
 	uint32_t timestamp;
 };
 
+/**
+ * Operations of a custom transport.
+ *
+ * A custom transport allows to use the protocol stack of libjaylink with an
+ * application-provided backend, for example an in-process emulator or a
+ * loopback device.
+ *
+ * All operations get passed the user data given to
+ * jaylink_transport_register() and return #JAYLINK_OK on success, or an error
+ * code of #jaylink_error on failure. The semantics of the operations
+ * correspond to those of the built-in transports: each write or read
+ * operation is started with the number of bytes to transfer and the data is
+ * then transferred with one or more calls of @a write or @a read. A backend
+ * may transfer the data of a write operation as soon as it is written.
+ */
+struct jaylink_transport_ops {
+	/** Open the transport. Can be NULL. */
+	int (*open)(void *user_data);
+	/** Close the transport. Can be NULL. */
+	int (*close)(void *user_data);
+	/**
+	 * Start a write operation of @a length bytes.
+	 *
+	 * @a has_command indicates whether the data of the write operation
+	 * contains a protocol command.
+	 */
+	int (*start_write)(void *user_data, size_t length, bool has_command);
+	/** Start a read operation of @a length bytes. */
+	int (*start_read)(void *user_data, size_t length);
+	/**
+	 * Start a write operation of @a write_length bytes followed by a read
+	 * operation of @a read_length bytes.
+	 */
+	int (*start_write_read)(void *user_data, size_t write_length,
+		size_t read_length, bool has_command);
+	/** Write @a length bytes of the current write operation. */
+	int (*write)(void *user_data, const uint8_t *buffer, size_t length);
+	/** Read @a length bytes of the current read operation. */
+	int (*read)(void *user_data, uint8_t *buffer, size_t length);
+	/**
+	 * Free the user data.
+	 *
+	 * Called when the device instance of the transport is destroyed.
+	 * Can be NULL.
+	 */
+	void (*free)(void *user_data);
+};
+
+/** Number of buckets of a command latency histogram. */
+#define JAYLINK_STATS_LATENCY_BUCKETS	24
+
+/** Number of different protocol commands. */
+#define JAYLINK_STATS_NUM_COMMANDS	256
+
+/**
+ * Statistics of a protocol command.
+ *
+ * The latency of a command is the time between the start of the command and
+ * the end of its last data transfer.
+ */
+struct jaylink_command_stats {
+	/** Number of times the command was sent to the device. */
+	uint64_t count;
+	/**
+	 * Number of latency measurements.
+	 *
+	 * This number can be smaller than the number of commands because the
+	 * latency of commands sent with a command queue is not measured.
+	 */
+	uint64_t num_latencies;
+	/** Sum of all measured latencies in microseconds. */
+	uint64_t total_latency;
+	/** Maximum measured latency in microseconds. */
+	uint64_t max_latency;
+	/**
+	 * Latency histogram.
+	 *
+	 * Bucket 0 counts latencies below 1 microsecond. Bucket n counts
+	 * latencies of at least 2^(n - 1) and less than 2^n microseconds. The
+	 * last bucket counts all latencies above as well.
+	 */
+	uint64_t latency[JAYLINK_STATS_LATENCY_BUCKETS];
+};
+
+/** Performance statistics of a device handle. */
+struct jaylink_stats {
+	/** Number of bytes written to the device. */
+	uint64_t bytes_written;
+	/** Number of bytes read from the device. */
+	uint64_t bytes_read;
+	/** Number of submitted USB transfers. */
+	uint64_t usb_transfers;
+	/** Number of send system calls on the TCP socket. */
+	uint64_t tcp_send_calls;
+	/** Number of receive system calls on the TCP socket. */
+	uint64_t tcp_recv_calls;
+	/** Number of transfers retried due to a timeout. */
+	uint64_t timeout_retries;
+	/** Number of reallocations of the internal buffer. */
+	uint64_t buffer_reallocs;
+	/** Statistics of each protocol command indexed by its opcode. */
+	struct jaylink_command_stats commands[JAYLINK_STATS_NUM_COMMANDS];
+};
+
+/** Statistics of the adaptive idle cycles of an access layer. */
+struct jaylink_idle_stats {
+	/** Current number of idle cycles after each access. */
+	size_t idle_cycles;
+	/** Number of idle cycles below which the number is not decreased. */
+	size_t min_idle_cycles;
+	/** Number of transfers retried because the target was busy. */
+	uint64_t retries;
+};
+
+/** TAP of a JTAG scan chain. */
+struct jaylink_jtag_tap {
+	/** IDCODE, or 0 if unknown or if the TAP has no IDCODE register. */
+	uint32_t idcode;
+	/** Instruction register length in bits. */
+	size_t ir_length;
+};
+
+/** Events of a file descriptor. */
+enum jaylink_poll_event {
+	/** Data can be read from the file descriptor. */
+	JAYLINK_POLL_IN = (1 << 0),
+	/** Data can be written to the file descriptor. */
+	JAYLINK_POLL_OUT = (1 << 1)
+};
+
+/** File descriptor to be monitored by an event loop. */
+struct jaylink_pollfd {
+	/** File descriptor. */
+	int fd;
+	/** Events to monitor, see #jaylink_poll_event. */
+	uint32_t events;
+};
+
 /** Target interface speed value for adaptive clocking. */
 #define JAYLINK_SPEED_ADAPTIVE_CLOCKING		0xffff
 
@@ -418,6 +606,44 @@ struct jaylink_device;
  */
 struct jaylink_device_handle;
 
+/**
+ * @struct jaylink_broadcast
+ *
+ * Opaque structure representing a sequence of operations to be executed on
+ * multiple devices.
+ */
+struct jaylink_broadcast;
+
+/**
+ * @struct jaylink_dap
+ *
+ * Opaque structure representing an ARM Debug Access Port (DAP) transaction
+ * layer.
+ */
+struct jaylink_dap;
+
+/**
+ * @struct jaylink_dmi
+ *
+ * Opaque structure representing a RISC-V Debug Module Interface (DMI) access
+ * layer.
+ */
+struct jaylink_dmi;
+
+/**
+ * @struct jaylink_jtag_scan
+ *
+ * Opaque structure representing a JTAG scan engine.
+ */
+struct jaylink_jtag_scan;
+
+/**
+ * @struct jaylink_queue
+ *
+ * Opaque structure representing a command queue.
+ */
+struct jaylink_queue;
+
 /** Macro to mark public libjaylink API symbol. */
 #ifdef _WIN32
 #define JAYLINK_API
@@ -441,12 +667,95 @@ typedef int (*jaylink_log_callback)(const struct jaylink_context *ctx,
 		enum jaylink_log_level level, const char *format, va_list args,
 		void *user_data);
 
+/*--- bitvec.c --------------------------------------------------------------*/
+
+JAYLINK_API uint64_t jaylink_bitvec_get_field(const uint8_t *buffer,
+		size_t offset, unsigned int length);
+JAYLINK_API void jaylink_bitvec_set_field(uint8_t *buffer, size_t offset,
+		uint64_t value, unsigned int length);
+JAYLINK_API void jaylink_bitvec_copy(uint8_t *dst, size_t dst_offset,
+		const uint8_t *src, size_t src_offset, size_t length);
+JAYLINK_API void jaylink_bitvec_fill(uint8_t *buffer, size_t offset,
+		bool value, size_t length);
+JAYLINK_API size_t jaylink_bitvec_popcount(const uint8_t *buffer,
+		size_t offset, size_t length);
+JAYLINK_API bool jaylink_bitvec_parity(const uint8_t *buffer, size_t offset,
+		size_t length);
+JAYLINK_API size_t jaylink_bitvec_compare(const uint8_t *buffer,
+		const uint8_t *expected, const uint8_t *mask, size_t offset,
+		size_t length);
+
+/*--- broadcast.c -----------------------------------------------------------*/
+
+JAYLINK_API int jaylink_broadcast_new(struct jaylink_device_handle **devhs,
+		size_t num_devhs, struct jaylink_broadcast **bc);
+JAYLINK_API void jaylink_broadcast_free(struct jaylink_broadcast *bc);
+JAYLINK_API int jaylink_broadcast_set_workers(struct jaylink_broadcast *bc,
+		size_t num_workers);
+JAYLINK_API int jaylink_broadcast_clear(struct jaylink_broadcast *bc);
+JAYLINK_API int jaylink_broadcast_jtag_io(struct jaylink_broadcast *bc,
+		const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
+		uint16_t length, enum jaylink_jtag_version version);
+JAYLINK_API int jaylink_broadcast_jtag_clear_trst(
+		struct jaylink_broadcast *bc);
+JAYLINK_API int jaylink_broadcast_jtag_set_trst(struct jaylink_broadcast *bc);
+JAYLINK_API int jaylink_broadcast_swd_io(struct jaylink_broadcast *bc,
+		const uint8_t *direction, const uint8_t *out, uint8_t *in,
+		uint16_t length);
+JAYLINK_API int jaylink_broadcast_clear_reset(struct jaylink_broadcast *bc);
+JAYLINK_API int jaylink_broadcast_set_reset(struct jaylink_broadcast *bc);
+JAYLINK_API int jaylink_broadcast_file_write(struct jaylink_broadcast *bc,
+		const char *filename, const uint8_t *buffer, uint32_t offset,
+		uint32_t length);
+JAYLINK_API int jaylink_broadcast_execute(struct jaylink_broadcast *bc);
+JAYLINK_API int jaylink_broadcast_get_result(
+		const struct jaylink_broadcast *bc, size_t index, int *result);
+
+/*--- capture.c -------------------------------------------------------------*/
+
+JAYLINK_API int jaylink_capture_start(struct jaylink_device_handle *devh,
+		const char *filename);
+JAYLINK_API int jaylink_capture_stop(struct jaylink_device_handle *devh);
+JAYLINK_API int jaylink_replay_device_new(struct jaylink_context *ctx,
+		const char *filename, struct jaylink_device **dev);
+
 /*--- core.c ----------------------------------------------------------------*/
 
 JAYLINK_API int jaylink_init(struct jaylink_context **ctx);
 JAYLINK_API int jaylink_exit(struct jaylink_context *ctx);
 JAYLINK_API bool jaylink_library_has_cap(enum jaylink_capability cap);
 
+/*--- dap.c -----------------------------------------------------------------*/
+
+JAYLINK_API int jaylink_dap_new(struct jaylink_device_handle *devh,
+		struct jaylink_dap **dap);
+JAYLINK_API void jaylink_dap_free(struct jaylink_dap *dap);
+JAYLINK_API int jaylink_dap_line_reset(struct jaylink_dap *dap);
+JAYLINK_API int jaylink_dap_idle(struct jaylink_dap *dap, size_t num_cycles);
+JAYLINK_API int jaylink_dap_dp_read(struct jaylink_dap *dap, uint8_t reg,
+		uint32_t *value);
+JAYLINK_API int jaylink_dap_dp_write(struct jaylink_dap *dap, uint8_t reg,
+		uint32_t value);
+JAYLINK_API int jaylink_dap_ap_read(struct jaylink_dap *dap, uint8_t ap,
+		uint8_t reg, uint32_t *value);
+JAYLINK_API int jaylink_dap_ap_write(struct jaylink_dap *dap, uint8_t ap,
+		uint8_t reg, uint32_t value);
+JAYLINK_API int jaylink_dap_flush(struct jaylink_dap *dap);
+JAYLINK_API int jaylink_dap_get_idle_stats(const struct jaylink_dap *dap,
+		struct jaylink_idle_stats *stats);
+
+/*--- dap_jtag.c ------------------------------------------------------------*/
+
+JAYLINK_API int jaylink_dap_new_jtag(struct jaylink_jtag_scan *scan,
+		struct jaylink_dap **dap);
+
+/*--- dap_mem.c -------------------------------------------------------------*/
+
+JAYLINK_API int jaylink_dap_mem_read(struct jaylink_dap *dap, uint8_t ap,
+		uint32_t address, uint8_t *buffer, size_t length);
+JAYLINK_API int jaylink_dap_mem_write(struct jaylink_dap *dap, uint8_t ap,
+		uint32_t address, const uint8_t *buffer, size_t length);
+
 /*--- device.c --------------------------------------------------------------*/
 
 JAYLINK_API int jaylink_get_devices(struct jaylink_context *ctx,
@@ -517,6 +826,41 @@ JAYLINK_API int jaylink_unregister(struct jaylink_device_handle *devh,
 JAYLINK_API int jaylink_discovery_scan(struct jaylink_context *ctx,
 		uint32_t ifaces);
 
+/*--- dmi.c -----------------------------------------------------------------*/
+
+JAYLINK_API int jaylink_dmi_new(struct jaylink_jtag_scan *scan,
+		struct jaylink_dmi **dmi);
+JAYLINK_API void jaylink_dmi_free(struct jaylink_dmi *dmi);
+JAYLINK_API int jaylink_dmi_set_idle(struct jaylink_dmi *dmi,
+		size_t num_cycles);
+JAYLINK_API int jaylink_dmi_read(struct jaylink_dmi *dmi, uint32_t address,
+		uint32_t *value);
+JAYLINK_API int jaylink_dmi_write(struct jaylink_dmi *dmi, uint32_t address,
+		uint32_t value);
+JAYLINK_API int jaylink_dmi_flush(struct jaylink_dmi *dmi);
+JAYLINK_API int jaylink_dmi_get_idle_stats(const struct jaylink_dmi *dmi,
+		struct jaylink_idle_stats *stats);
+
+/*--- dmi_abstract.c --------------------------------------------------------*/
+
+JAYLINK_API int jaylink_dmi_reg_read(struct jaylink_dmi *dmi, uint32_t hart,
+		const uint16_t *regnos, uint32_t *values, size_t num);
+JAYLINK_API int jaylink_dmi_reg_write(struct jaylink_dmi *dmi, uint32_t hart,
+		const uint16_t *regnos, const uint32_t *values, size_t num);
+JAYLINK_API int jaylink_dmi_prog_mem_read(struct jaylink_dmi *dmi,
+		uint32_t hart, uint32_t address, uint8_t *buffer,
+		size_t length);
+JAYLINK_API int jaylink_dmi_prog_mem_write(struct jaylink_dmi *dmi,
+		uint32_t hart, uint32_t address, const uint8_t *buffer,
+		size_t length);
+
+/*--- dmi_mem.c -------------------------------------------------------------*/
+
+JAYLINK_API int jaylink_dmi_mem_read(struct jaylink_dmi *dmi,
+		uint32_t address, uint8_t *buffer, size_t length);
+JAYLINK_API int jaylink_dmi_mem_write(struct jaylink_dmi *dmi,
+		uint32_t address, const uint8_t *buffer, size_t length);
+
 /*--- emucom.c --------------------------------------------------------------*/
 
 JAYLINK_API int jaylink_emucom_read(struct jaylink_device_handle *devh,
@@ -547,8 +891,52 @@ JAYLINK_API int jaylink_file_delete(struct jaylink_device_handle *devh,
 JAYLINK_API int jaylink_jtag_io(struct jaylink_device_handle *devh,
 		const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
 		uint16_t length, enum jaylink_jtag_version version);
+JAYLINK_API int jaylink_jtag_io_long(struct jaylink_device_handle *devh,
+		const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
+		size_t length, enum jaylink_jtag_version version);
+JAYLINK_API int jaylink_jtag_io_verify(struct jaylink_device_handle *devh,
+		const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
+		const uint8_t *expected, const uint8_t *mask, size_t length,
+		enum jaylink_jtag_version version, size_t *mismatch);
 JAYLINK_API int jaylink_jtag_clear_trst(struct jaylink_device_handle *devh);
 JAYLINK_API int jaylink_jtag_set_trst(struct jaylink_device_handle *devh);
+JAYLINK_API int jaylink_queue_jtag_io(struct jaylink_queue *queue,
+		const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
+		uint16_t length, enum jaylink_jtag_version version);
+JAYLINK_API int jaylink_queue_jtag_clear_trst(struct jaylink_queue *queue);
+JAYLINK_API int jaylink_queue_jtag_set_trst(struct jaylink_queue *queue);
+
+/*--- jtag_detect.c ---------------------------------------------------------*/
+
+JAYLINK_API int jaylink_jtag_scan_detect(struct jaylink_jtag_scan *scan,
+		size_t *num_taps);
+JAYLINK_API int jaylink_jtag_scan_get_tap(const struct jaylink_jtag_scan *scan,
+		size_t tap, struct jaylink_jtag_tap *info);
+
+/*--- jtag_scan.c -----------------------------------------------------------*/
+
+JAYLINK_API int jaylink_jtag_scan_new(struct jaylink_device_handle *devh,
+		enum jaylink_jtag_version version,
+		struct jaylink_jtag_scan **scan);
+JAYLINK_API void jaylink_jtag_scan_free(struct jaylink_jtag_scan *scan);
+JAYLINK_API int jaylink_jtag_scan_set_chain(struct jaylink_jtag_scan *scan,
+		const size_t *ir_lengths, size_t num_taps);
+JAYLINK_API int jaylink_jtag_scan_select_tap(struct jaylink_jtag_scan *scan,
+		size_t tap);
+JAYLINK_API int jaylink_jtag_scan_get_state(
+		const struct jaylink_jtag_scan *scan,
+		enum jaylink_tap_state *state);
+JAYLINK_API int jaylink_jtag_scan_reset(struct jaylink_jtag_scan *scan);
+JAYLINK_API int jaylink_jtag_scan_goto(struct jaylink_jtag_scan *scan,
+		enum jaylink_tap_state state);
+JAYLINK_API int jaylink_jtag_scan_idle(struct jaylink_jtag_scan *scan,
+		size_t num_clocks);
+JAYLINK_API int jaylink_jtag_scan_ir(struct jaylink_jtag_scan *scan,
+		const uint8_t *out, uint8_t *in, enum jaylink_tap_state end_state);
+JAYLINK_API int jaylink_jtag_scan_dr(struct jaylink_jtag_scan *scan,
+		const uint8_t *out, uint8_t *in, size_t length,
+		enum jaylink_tap_state end_state);
+JAYLINK_API int jaylink_jtag_scan_flush(struct jaylink_jtag_scan *scan);
 
 /*--- log.c -----------------------------------------------------------------*/
 
@@ -563,16 +951,45 @@ JAYLINK_API int jaylink_log_set_domain(struct jaylink_context *ctx,
 JAYLINK_API const char *jaylink_log_get_domain(
 		const struct jaylink_context *ctx);
 
+/*--- queue.c ---------------------------------------------------------------*/
+
+JAYLINK_API int jaylink_queue_new(struct jaylink_device_handle *devh,
+		struct jaylink_queue **queue);
+JAYLINK_API void jaylink_queue_free(struct jaylink_queue *queue);
+JAYLINK_API int jaylink_queue_get_length(const struct jaylink_queue *queue,
+		size_t *length);
+JAYLINK_API int jaylink_queue_execute(struct jaylink_queue *queue);
+JAYLINK_API int jaylink_queue_submit(struct jaylink_queue *queue);
+JAYLINK_API int jaylink_queue_progress(struct jaylink_queue *queue,
+		bool *done);
+
+/*--- stats.c ---------------------------------------------------------------*/
+
+JAYLINK_API int jaylink_get_stats(struct jaylink_device_handle *devh,
+		struct jaylink_stats *stats);
+JAYLINK_API int jaylink_reset_stats(struct jaylink_device_handle *devh);
+
 /*--- strutil.c -------------------------------------------------------------*/
 
 JAYLINK_API int jaylink_parse_serial_number(const char *str,
 		uint32_t *serial_number);
 
+/*--- svf.c -----------------------------------------------------------------*/
+
+JAYLINK_API int jaylink_svf_play(struct jaylink_jtag_scan *scan,
+		const char *data, size_t length, uint32_t frequency,
+		size_t *line);
+JAYLINK_API int jaylink_svf_play_file(struct jaylink_jtag_scan *scan,
+		const char *filename, uint32_t frequency, size_t *line);
+
 /*--- swd.c -----------------------------------------------------------------*/
 
 JAYLINK_API int jaylink_swd_io(struct jaylink_device_handle *devh,
 		const uint8_t *direction, const uint8_t *out, uint8_t *in,
 		uint16_t length);
+JAYLINK_API int jaylink_queue_swd_io(struct jaylink_queue *queue,
+		const uint8_t *direction, const uint8_t *out, uint8_t *in,
+		uint16_t length);
 
 /*--- swo.c -----------------------------------------------------------------*/
 
@@ -602,6 +1019,24 @@ JAYLINK_API int jaylink_clear_reset(struct jaylink_device_handle *devh);
 JAYLINK_API int jaylink_set_reset(struct jaylink_device_handle *devh);
 JAYLINK_API int jaylink_set_target_power(struct jaylink_device_handle *devh,
 		bool enable);
+JAYLINK_API int jaylink_queue_clear_reset(struct jaylink_queue *queue);
+JAYLINK_API int jaylink_queue_set_reset(struct jaylink_queue *queue);
+
+/*--- transport.c -----------------------------------------------------------*/
+
+JAYLINK_API int jaylink_get_pollfds(struct jaylink_device_handle *devh,
+		struct jaylink_pollfd *fds, size_t *num_fds);
+
+/*--- transport_custom.c ----------------------------------------------------*/
+
+JAYLINK_API int jaylink_transport_register(struct jaylink_context *ctx,
+		const struct jaylink_transport_ops *ops, void *user_data,
+		struct jaylink_device **dev);
+
+/*--- transport_tcp.c -------------------------------------------------------*/
+
+JAYLINK_API int jaylink_tcp_device_new(struct jaylink_context *ctx,
+		const char *address, uint16_t port, struct jaylink_device **dev);
 
 /*--- util.c ----------------------------------------------------------------*/
 
@@ -618,6 +1053,14 @@ JAYLINK_API int jaylink_version_library_get_revision(void);
 JAYLINK_API int jaylink_version_library_get_age(void);
 JAYLINK_API const char *jaylink_version_library_get_string(void);
 
+/*--- xsvf.c ----------------------------------------------------------------*/
+
+JAYLINK_API int jaylink_xsvf_play(struct jaylink_jtag_scan *scan,
+		const uint8_t *data, size_t length, uint32_t frequency,
+		size_t *offset);
+JAYLINK_API int jaylink_xsvf_play_file(struct jaylink_jtag_scan *scan,
+		const char *filename, uint32_t frequency, size_t *offset);
+
 #include "version.h"
 
 #endif /* LIBJAYLINK_LIBJAYLINK_H */
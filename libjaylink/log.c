@@ -53,7 +53,9 @@ JAYLINK_API int jaylink_log_set_level(struct jaylink_context *ctx,
 	if (level > JAYLINK_LOG_LEVEL_DEBUG_IO)
 		return JAYLINK_ERR_ARG;
 
+	thread_mutex_lock(&ctx->log_lock);
 	ctx->log_level = level;
+	thread_mutex_unlock(&ctx->log_lock);
 
 	return JAYLINK_OK;
 }
@@ -83,6 +85,9 @@ JAYLINK_API int jaylink_log_get_level(const struct jaylink_context *ctx,
 /**
  * Set the libjaylink log callback function.
  *
+ * The callback function is never invoked by multiple threads at the same
+ * time. It must not change the log settings of the context.
+ *
  * @param[in,out] ctx libjaylink context.
  * @param[in] callback Callback function to use, or NULL to use the default log
  *                     function.
@@ -99,6 +104,8 @@ JAYLINK_API int jaylink_log_set_callback(struct jaylink_context *ctx,
 	if (!ctx)
 		return JAYLINK_ERR_ARG;
 
+	thread_mutex_lock(&ctx->log_lock);
+
 	if (callback) {
 		ctx->log_callback = callback;
 		ctx->log_callback_data = user_data;
@@ -107,6 +114,8 @@ JAYLINK_API int jaylink_log_set_callback(struct jaylink_context *ctx,
 		ctx->log_callback_data = NULL;
 	}
 
+	thread_mutex_unlock(&ctx->log_lock);
+
 	return JAYLINK_OK;
 }
 
@@ -138,8 +147,10 @@ JAYLINK_API int jaylink_log_set_domain(struct jaylink_context *ctx,
 	if (!ctx || !domain)
 		return JAYLINK_ERR_ARG;
 
+	thread_mutex_lock(&ctx->log_lock);
 	ret = snprintf(ctx->log_domain, JAYLINK_LOG_DOMAIN_MAX_LENGTH + 1,
 		"%s", domain);
+	thread_mutex_unlock(&ctx->log_lock);
 
 	if (ret < 0)
 		return JAYLINK_ERR;
@@ -150,6 +161,9 @@ JAYLINK_API int jaylink_log_set_domain(struct jaylink_context *ctx,
 /**
  * Get the libjaylink log domain.
  *
+ * @note The returned string must not be used while the log domain is changed
+ *       by another thread.
+ *
  * @param[in] ctx libjaylink context.
  *
  * @return A string which contains the current log domain on success, or NULL
@@ -190,6 +204,23 @@ JAYLINK_PRIV int log_vprintf(const struct jaylink_context *ctx,
 	return 0;
 }
 
+static void log_message(const struct jaylink_context *ctx,
+		enum jaylink_log_level level, const char *format, va_list args)
+{
+	struct jaylink_context *tmp;
+
+	/* The log lock is not part of the logical state of the context. */
+	tmp = (struct jaylink_context *)ctx;
+
+	/*
+	 * Hold the lock while the callback is invoked such that the messages
+	 * of different threads do not interleave.
+	 */
+	thread_mutex_lock(&tmp->log_lock);
+	ctx->log_callback(ctx, level, format, args, ctx->log_callback_data);
+	thread_mutex_unlock(&tmp->log_lock);
+}
+
 /** @private */
 JAYLINK_PRIV void log_err(const struct jaylink_context *ctx,
 		const char *format, ...)
@@ -200,8 +231,7 @@ JAYLINK_PRIV void log_err(const struct jaylink_context *ctx,
 		return;
 
 	va_start(args, format);
-	ctx->log_callback(ctx, JAYLINK_LOG_LEVEL_ERROR, format, args,
-		ctx->log_callback_data);
+	log_message(ctx, JAYLINK_LOG_LEVEL_ERROR, format, args);
 	va_end(args);
 }
 
@@ -215,8 +245,7 @@ JAYLINK_PRIV void log_warn(const struct jaylink_context *ctx,
 		return;
 
 	va_start(args, format);
-	ctx->log_callback(ctx, JAYLINK_LOG_LEVEL_WARNING, format, args,
-		ctx->log_callback_data);
+	log_message(ctx, JAYLINK_LOG_LEVEL_WARNING, format, args);
 	va_end(args);
 }
 
@@ -230,8 +259,7 @@ JAYLINK_PRIV void log_info(const struct jaylink_context *ctx,
 		return;
 
 	va_start(args, format);
-	ctx->log_callback(ctx, JAYLINK_LOG_LEVEL_INFO, format, args,
-		ctx->log_callback_data);
+	log_message(ctx, JAYLINK_LOG_LEVEL_INFO, format, args);
 	va_end(args);
 }
 
@@ -245,8 +273,7 @@ JAYLINK_PRIV void log_dbg(const struct jaylink_context *ctx,
 		return;
 
 	va_start(args, format);
-	ctx->log_callback(ctx, JAYLINK_LOG_LEVEL_DEBUG, format, args,
-		ctx->log_callback_data);
+	log_message(ctx, JAYLINK_LOG_LEVEL_DEBUG, format, args);
 	va_end(args);
 }
 
@@ -260,7 +287,6 @@ JAYLINK_PRIV void log_dbgio(const struct jaylink_context *ctx,
 		return;
 
 	va_start(args, format);
-	ctx->log_callback(ctx, JAYLINK_LOG_LEVEL_DEBUG_IO, format, args,
-		ctx->log_callback_data);
+	log_message(ctx, JAYLINK_LOG_LEVEL_DEBUG_IO, format, args);
 	va_end(args);
 }
@@ -0,0 +1,746 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "libjaylink.h"
+#include "libjaylink-internal.h"
+
+/**
+ * @file
+ *
+ * Command queue.
+ */
+
+/** @cond PRIVATE */
+/** Initial number of entries of a queue. */
+#define QUEUE_INITIAL_SIZE	16
+
+/**
+ * Maximum number of response bytes of the commands sent to the device at once.
+ *
+ * The device processes the commands while they are being sent and it can not
+ * proceed if the responses are not read by the host. Limiting the number of
+ * response bytes of the commands sent at once prevents that the device and the
+ * host wait for each other.
+ */
+#define QUEUE_MAX_READ_LENGTH	4096
+
+/**
+ * Error code indicating that there is not enough free memory on the device to
+ * perform the operation of a queued command.
+ */
+#define QUEUE_ERR_NO_MEMORY	0x06
+/** @endcond */
+
+/**
+ * Add an entry to a queue.
+ *
+ * The fields of the returned entry are initialized such that the entry
+ * describes a command without header, data and response.
+ *
+ * @param[in,out] queue Queue.
+ *
+ * @return The added entry on success, or NULL on failure.
+ */
+JAYLINK_PRIV struct queue_entry *queue_add(struct jaylink_queue *queue)
+{
+	struct queue_entry *entries;
+	struct queue_entry *entry;
+	size_t size;
+
+	if (queue->num_entries == queue->size) {
+		size = queue->size * 2;
+		entries = realloc(queue->entries, size * sizeof(*entries));
+
+		if (!entries) {
+			log_err(queue->devh->dev->ctx, "Failed to adjust queue "
+				"size to %zu entries.", size);
+			return NULL;
+		}
+
+		queue->entries = entries;
+		queue->size = size;
+	}
+
+	entry = &queue->entries[queue->num_entries];
+	queue->num_entries++;
+
+	entry->header_length = 0;
+	entry->data[0] = NULL;
+	entry->data[1] = NULL;
+	entry->data_length = 0;
+	entry->response = NULL;
+	entry->response_length = 0;
+	entry->has_status = false;
+
+	return entry;
+}
+
+/**
+ * Add a command without data and response to a queue.
+ *
+ * @param[in,out] queue Queue.
+ * @param[in] cmd Command.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ */
+JAYLINK_PRIV int queue_add_command(struct jaylink_queue *queue, uint8_t cmd)
+{
+	struct queue_entry *entry;
+
+	entry = queue_add(queue);
+
+	if (!entry)
+		return JAYLINK_ERR_MALLOC;
+
+	entry->header[0] = cmd;
+	entry->header_length = 1;
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Remove all commands from a queue without executing them.
+ *
+ * The queue must not be executed without blocking at the same time.
+ *
+ * @param[in,out] queue Queue.
+ */
+JAYLINK_PRIV void queue_reset(struct jaylink_queue *queue)
+{
+	queue->num_entries = 0;
+}
+
+static size_t entry_write_length(const struct queue_entry *entry)
+{
+	size_t length;
+
+	length = entry->header_length;
+
+	if (entry->data[0])
+		length += entry->data_length;
+
+	if (entry->data[1])
+		length += entry->data_length;
+
+	return length;
+}
+
+static size_t entry_read_length(const struct queue_entry *entry)
+{
+	size_t length;
+
+	length = entry->response_length;
+
+	if (entry->has_status)
+		length++;
+
+	return length;
+}
+
+static int write_entries(struct jaylink_device_handle *devh,
+		const struct queue_entry *entries, size_t num_entries)
+{
+	int ret;
+	struct jaylink_context *ctx;
+	const struct queue_entry *entry;
+	struct transport_iovec iov[3];
+	size_t iovcnt;
+	size_t i;
+	size_t j;
+
+	ctx = devh->dev->ctx;
+
+	for (i = 0; i < num_entries; i++) {
+		entry = &entries[i];
+		ret = transport_start_write(devh, entry_write_length(entry),
+			true);
+
+		if (ret != JAYLINK_OK) {
+			log_err(ctx, "transport_start_write() failed: %s.",
+				jaylink_strerror(ret));
+			return ret;
+		}
+
+		iov[0].buffer = entry->header;
+		iov[0].length = entry->header_length;
+		iovcnt = 1;
+
+		for (j = 0; j < 2; j++) {
+			if (!entry->data[j])
+				continue;
+
+			iov[iovcnt].buffer = entry->data[j];
+			iov[iovcnt].length = entry->data_length;
+			iovcnt++;
+		}
+
+		ret = transport_writev(devh, iov, iovcnt);
+
+		if (ret != JAYLINK_OK) {
+			log_err(ctx, "transport_writev() failed: %s.",
+				jaylink_strerror(ret));
+			return ret;
+		}
+	}
+
+	return JAYLINK_OK;
+}
+
+static int read_entries(struct jaylink_device_handle *devh,
+		const struct queue_entry *entries, size_t num_entries)
+{
+	int ret;
+	int result;
+	struct jaylink_context *ctx;
+	const struct queue_entry *entry;
+	size_t i;
+	uint8_t status;
+
+	ctx = devh->dev->ctx;
+	result = JAYLINK_OK;
+
+	/*
+	 * Read the responses of all commands even if a command failed in order
+	 * to keep the host and the device in sync.
+	 */
+	for (i = 0; i < num_entries; i++) {
+		entry = &entries[i];
+
+		if (entry->response_length > 0) {
+			ret = transport_read(devh, entry->response,
+				entry->response_length);
+
+			if (ret != JAYLINK_OK) {
+				log_err(ctx, "transport_read() failed: %s.",
+					jaylink_strerror(ret));
+				return ret;
+			}
+		}
+
+		if (!entry->has_status)
+			continue;
+
+		ret = transport_read(devh, &status, 1);
+
+		if (ret != JAYLINK_OK) {
+			log_err(ctx, "transport_read() failed: %s.",
+				jaylink_strerror(ret));
+			return ret;
+		}
+
+		if (!status || result != JAYLINK_OK)
+			continue;
+
+		if (status == QUEUE_ERR_NO_MEMORY) {
+			result = JAYLINK_ERR_DEV_NO_MEMORY;
+		} else {
+			log_err(ctx, "Queued command 0x%x failed: 0x%x.",
+				entry->header[0], status);
+			result = JAYLINK_ERR_DEV;
+		}
+	}
+
+	return result;
+}
+
+static int execute_entries(struct jaylink_device_handle *devh,
+		const struct queue_entry *entries, size_t num_entries,
+		size_t read_length)
+{
+	int ret;
+	struct jaylink_context *ctx;
+
+	ctx = devh->dev->ctx;
+
+	transport_start_batch(devh);
+	ret = write_entries(devh, entries, num_entries);
+
+	if (ret != JAYLINK_OK) {
+		transport_end_batch(devh, true);
+		return ret;
+	}
+
+	ret = transport_end_batch(devh, false);
+
+	if (ret != JAYLINK_OK) {
+		log_err(ctx, "transport_end_batch() failed: %s.",
+			jaylink_strerror(ret));
+		return ret;
+	}
+
+	if (!read_length)
+		return JAYLINK_OK;
+
+	ret = transport_start_read(devh, read_length);
+
+	if (ret != JAYLINK_OK) {
+		log_err(ctx, "transport_start_read() failed: %s.",
+			jaylink_strerror(ret));
+		return ret;
+	}
+
+	return read_entries(devh, entries, num_entries);
+}
+
+/*
+ * Determine the commands of the current segment, which starts with the command
+ * at index start. The commands of a segment are sent at once. A single command
+ * with a response larger than the limit is sent on its own.
+ */
+static void next_segment(struct jaylink_queue *queue)
+{
+	const struct queue_entry *entries;
+	size_t read_length;
+	size_t end;
+
+	entries = queue->entries;
+	read_length = entry_read_length(&entries[queue->start]);
+	end = queue->start + 1;
+
+	while (end < queue->num_entries) {
+		if (read_length + entry_read_length(&entries[end]) >
+				QUEUE_MAX_READ_LENGTH)
+			break;
+
+		read_length += entry_read_length(&entries[end]);
+		end++;
+	}
+
+	queue->end = end;
+	queue->read_length = read_length;
+}
+
+/*
+ * Merge the result of a segment into the result of the queue. Device errors
+ * are remembered and the execution continues, other errors abort the
+ * execution.
+ *
+ * Returns whether the execution continues.
+ */
+static bool merge_result(struct jaylink_queue *queue, int ret)
+{
+	if (ret == JAYLINK_ERR_DEV || ret == JAYLINK_ERR_DEV_NO_MEMORY) {
+		if (queue->result == JAYLINK_OK)
+			queue->result = ret;
+	} else if (ret != JAYLINK_OK) {
+		queue->result = ret;
+		return false;
+	}
+
+	return true;
+}
+
+/* Collect the commands of the current segment to be sent without blocking. */
+static int start_segment(struct jaylink_queue *queue)
+{
+	int ret;
+	struct jaylink_device_handle *devh;
+
+	devh = queue->devh;
+
+	next_segment(queue);
+	queue->reading = false;
+
+	transport_start_batch(devh);
+	ret = write_entries(devh, queue->entries + queue->start,
+		queue->end - queue->start);
+
+	if (ret != JAYLINK_OK) {
+		transport_end_batch(devh, true);
+		return ret;
+	}
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Allocate a command queue.
+ *
+ * A command queue collects commands for a device and sends them to the device
+ * at once when it is executed. This reduces the number of round trips between
+ * the host and the device significantly compared to the corresponding
+ * functions which perform each command immediately.
+ *
+ * Commands are added to the queue with the jaylink_queue_*() functions, for
+ * example jaylink_queue_jtag_io().
+ *
+ * @param[in,out] devh Device handle.
+ * @param[out] queue Newly allocated queue on success, and undefined on
+ *                   failure. The queue must be freed by the caller with
+ *                   jaylink_queue_free().
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @see jaylink_queue_execute()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_queue_new(struct jaylink_device_handle *devh,
+		struct jaylink_queue **queue)
+{
+	struct jaylink_queue *tmp;
+
+	if (!devh || !queue)
+		return JAYLINK_ERR_ARG;
+
+	tmp = malloc(sizeof(struct jaylink_queue));
+
+	if (!tmp) {
+		log_err(devh->dev->ctx, "Queue malloc failed.");
+		return JAYLINK_ERR_MALLOC;
+	}
+
+	tmp->entries = malloc(QUEUE_INITIAL_SIZE * sizeof(struct queue_entry));
+
+	if (!tmp->entries) {
+		log_err(devh->dev->ctx, "Queue entries malloc failed.");
+		free(tmp);
+		return JAYLINK_ERR_MALLOC;
+	}
+
+	tmp->devh = devh;
+	tmp->num_entries = 0;
+	tmp->size = QUEUE_INITIAL_SIZE;
+	tmp->submitted = false;
+
+	*queue = tmp;
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Free a command queue.
+ *
+ * Commands which are still in the queue are discarded.
+ *
+ * @param[in,out] queue Queue.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API void jaylink_queue_free(struct jaylink_queue *queue)
+{
+	if (!queue)
+		return;
+
+	free(queue->entries);
+	free(queue);
+}
+
+/**
+ * Get the number of commands in a command queue.
+ *
+ * @param[in] queue Queue.
+ * @param[out] length Number of commands in the queue on success, and undefined
+ *                    on failure.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_queue_get_length(const struct jaylink_queue *queue,
+		size_t *length)
+{
+	if (!queue || !length)
+		return JAYLINK_ERR_ARG;
+
+	*length = queue->num_entries;
+
+	return JAYLINK_OK;
+}
+
+static int _queue_execute(struct jaylink_queue *queue)
+{
+	int ret;
+
+	if (!queue || queue->submitted)
+		return JAYLINK_ERR_ARG;
+
+	queue->result = JAYLINK_OK;
+	queue->start = 0;
+
+	log_dbgio(queue->devh->dev->ctx, "Executing %zu queued commands.",
+		queue->num_entries);
+
+	while (queue->start < queue->num_entries) {
+		next_segment(queue);
+
+		ret = execute_entries(queue->devh,
+			queue->entries + queue->start,
+			queue->end - queue->start, queue->read_length);
+
+		if (!merge_result(queue, ret))
+			break;
+
+		queue->start = queue->end;
+	}
+
+	queue->num_entries = 0;
+
+	return queue->result;
+}
+
+/**
+ * Execute a command queue.
+ *
+ * All commands of the queue are sent to the device and their responses are
+ * stored in the buffers passed when the commands were added. The commands are
+ * sent to the device with as few transfers as possible. After this function
+ * has returned, the queue is empty and can be reused.
+ *
+ * If a command fails, the following commands are still performed by the
+ * device, and the error of the first failed command is returned.
+ *
+ * @param[in,out] queue Queue.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments or the queue is submitted.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR_DEV_NO_MEMORY Not enough memory on the device to perform
+ *                                   the operation of a command.
+ * @retval JAYLINK_ERR_DEV Unspecified device error.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_queue_execute(struct jaylink_queue *queue)
+{
+	int ret;
+
+	if (!queue)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&queue->devh->lock);
+	ret = _queue_execute(queue);
+	thread_mutex_unlock(&queue->devh->lock);
+
+	return ret;
+}
+
+static int _queue_submit(struct jaylink_queue *queue)
+{
+	int ret;
+
+	if (!queue || queue->submitted)
+		return JAYLINK_ERR_ARG;
+
+	queue->result = JAYLINK_OK;
+	queue->start = 0;
+
+	log_dbgio(queue->devh->dev->ctx, "Submitting %zu queued commands.",
+		queue->num_entries);
+
+	if (!queue->num_entries) {
+		queue->submitted = true;
+		return JAYLINK_OK;
+	}
+
+	ret = start_segment(queue);
+
+	if (ret != JAYLINK_OK) {
+		queue->num_entries = 0;
+		return ret;
+	}
+
+	queue->submitted = true;
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Submit a command queue for execution without blocking.
+ *
+ * The commands of the queue are executed like with jaylink_queue_execute(),
+ * but the execution proceeds only when jaylink_queue_progress() is called.
+ * This allows to drive many devices concurrently from a single thread, for
+ * example with an event loop which monitors the file descriptors of the
+ * devices, see jaylink_get_pollfds().
+ *
+ * The queue must not be modified or freed, and no other operation must be
+ * performed on the device, until the execution of the queue is done.
+ *
+ * @note Devices with a custom transport are supported but their operations
+ *       are performed blocking within jaylink_queue_progress().
+ *
+ * @param[in,out] queue Queue.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments or the queue is already
+ *                         submitted.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @see jaylink_queue_progress()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_queue_submit(struct jaylink_queue *queue)
+{
+	int ret;
+
+	if (!queue)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&queue->devh->lock);
+	ret = _queue_submit(queue);
+	thread_mutex_unlock(&queue->devh->lock);
+
+	return ret;
+}
+
+static int _queue_progress(struct jaylink_queue *queue,
+		bool *done)
+{
+	int ret;
+	struct jaylink_device_handle *devh;
+	struct jaylink_context *ctx;
+	bool complete;
+
+	if (!queue || !done || !queue->submitted)
+		return JAYLINK_ERR_ARG;
+
+	devh = queue->devh;
+	ctx = devh->dev->ctx;
+
+	while (queue->start < queue->num_entries) {
+		if (!queue->reading) {
+			ret = transport_progress_batch(devh, &complete);
+
+			if (ret != JAYLINK_OK) {
+				log_err(ctx, "transport_progress_batch() "
+					"failed: %s.", jaylink_strerror(ret));
+				merge_result(queue, ret);
+				break;
+			}
+
+			if (!complete) {
+				*done = false;
+				return JAYLINK_OK;
+			}
+
+			if (queue->read_length > 0) {
+				ret = transport_start_read(devh,
+					queue->read_length);
+
+				if (ret != JAYLINK_OK) {
+					log_err(ctx, "transport_start_read() "
+						"failed: %s.",
+						jaylink_strerror(ret));
+					merge_result(queue, ret);
+					break;
+				}
+
+				queue->reading = true;
+			}
+		}
+
+		if (queue->reading) {
+			ret = transport_progress_read(devh, &complete);
+
+			if (ret != JAYLINK_OK) {
+				log_err(ctx, "transport_progress_read() "
+					"failed: %s.", jaylink_strerror(ret));
+				merge_result(queue, ret);
+				break;
+			}
+
+			if (!complete) {
+				*done = false;
+				return JAYLINK_OK;
+			}
+
+			/* The responses are read from the internal buffer. */
+			ret = read_entries(devh, queue->entries + queue->start,
+				queue->end - queue->start);
+
+			if (!merge_result(queue, ret))
+				break;
+		}
+
+		queue->start = queue->end;
+
+		if (queue->start == queue->num_entries)
+			break;
+
+		ret = start_segment(queue);
+
+		if (!merge_result(queue, ret))
+			break;
+	}
+
+	queue->submitted = false;
+	queue->num_entries = 0;
+	*done = true;
+
+	return queue->result;
+}
+
+/**
+ * Make progress with the execution of a submitted command queue.
+ *
+ * The commands of the queue are sent to the device and their responses are
+ * received as far as possible without blocking. The function should be called
+ * whenever one of the file descriptors of the device is ready, see
+ * jaylink_get_pollfds(). It should also be called periodically, for example
+ * every 100 milliseconds, in order to detect timeouts.
+ *
+ * When the execution is done, the responses are stored in the buffers passed
+ * when the commands were added, and the queue is empty and can be reused.
+ *
+ * @param[in,out] queue Queue.
+ * @param[out] done Indicates whether the execution of the queue is done. If
+ *                  the function fails with #JAYLINK_ERR_ARG, the value is
+ *                  undefined.
+ *
+ * @retval JAYLINK_OK Success, or the execution is not done yet.
+ * @retval JAYLINK_ERR_ARG Invalid arguments or the queue is not submitted.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR_DEV_NO_MEMORY Not enough memory on the device to perform
+ *                                   the operation of a command.
+ * @retval JAYLINK_ERR_DEV Unspecified device error.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @see jaylink_queue_submit()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_queue_progress(struct jaylink_queue *queue,
+		bool *done)
+{
+	int ret;
+
+	if (!queue)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&queue->devh->lock);
+	ret = _queue_progress(queue, done);
+	thread_mutex_unlock(&queue->devh->lock);
+
+	return ret;
+}
@@ -17,12 +17,17 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+
 #ifdef _WIN32
 #include <winsock2.h>
 #else
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
 #endif
 
 #include "libjaylink.h"
@@ -115,6 +120,74 @@ JAYLINK_PRIV bool socket_send(int sock, const void *buffer, size_t *length,
 	return true;
 }
 
+/**
+ * Send a message from multiple buffers on a socket.
+ *
+ * The buffers are sent as a single message in the given order without copying
+ * them.
+ *
+ * @param[in] sock Socket descriptor.
+ * @param[in] iov Array of buffers of the message to be sent.
+ * @param[in] iovcnt Number of buffers, at most #TRANSPORT_MAX_IOVEC + 1.
+ * @param[out] length Number of bytes sent on success, and undefined on
+ *                    failure.
+ * @param[in] flags Flags to modify the function behaviour. Use bitwise OR to
+ *                  specify multiple flags.
+ *
+ * @return Whether the message was sent successfully.
+ */
+JAYLINK_PRIV bool socket_sendv(int sock, const struct transport_iovec *iov,
+		size_t iovcnt, size_t *length, int flags)
+{
+#ifdef _WIN32
+	WSABUF buffers[TRANSPORT_MAX_IOVEC + 1];
+	DWORD bytes_sent;
+	size_t i;
+	int ret;
+
+	if (iovcnt > TRANSPORT_MAX_IOVEC + 1)
+		return false;
+
+	for (i = 0; i < iovcnt; i++) {
+		buffers[i].buf = (char *)iov[i].buffer;
+		buffers[i].len = iov[i].length;
+	}
+
+	ret = WSASend(sock, buffers, iovcnt, &bytes_sent, flags, NULL, NULL);
+
+	if (ret == SOCKET_ERROR)
+		return false;
+
+	*length = bytes_sent;
+#else
+	struct iovec buffers[TRANSPORT_MAX_IOVEC + 1];
+	struct msghdr msg;
+	size_t i;
+	ssize_t ret;
+
+	if (iovcnt > TRANSPORT_MAX_IOVEC + 1)
+		return false;
+
+	for (i = 0; i < iovcnt; i++) {
+		buffers[i].iov_base = (void *)iov[i].buffer;
+		buffers[i].iov_len = iov[i].length;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = buffers;
+	msg.msg_iovlen = iovcnt;
+
+	ret = sendmsg(sock, &msg, flags);
+
+	if (ret < 0)
+		return false;
+
+	*length = ret;
+#endif
+
+	return true;
+}
+
 /**
  * Receive a message from a socket.
  *
@@ -255,3 +328,56 @@ JAYLINK_PRIV bool socket_set_option(int sock, int level, int option,
 
 	return false;
 }
+
+/**
+ * Set the blocking mode of a socket.
+ *
+ * @param[in] sock Socket descriptor.
+ * @param[in] blocking Determines whether the socket operations block.
+ *
+ * @return Whether the blocking mode was set successfully.
+ */
+JAYLINK_PRIV bool socket_set_blocking(int sock, bool blocking)
+{
+#ifdef _WIN32
+	u_long mode;
+
+	mode = !blocking;
+
+	if (ioctlsocket(sock, FIONBIO, &mode) == SOCKET_ERROR)
+		return false;
+#else
+	int flags;
+
+	flags = fcntl(sock, F_GETFL, 0);
+
+	if (flags < 0)
+		return false;
+
+	if (blocking)
+		flags &= ~O_NONBLOCK;
+	else
+		flags |= O_NONBLOCK;
+
+	if (fcntl(sock, F_SETFL, flags) < 0)
+		return false;
+#endif
+
+	return true;
+}
+
+/**
+ * Determine whether the last socket operation failed because it would block.
+ *
+ * This function must be called immediately after the failed operation.
+ *
+ * @return Whether the operation would have blocked a socket in blocking mode.
+ */
+JAYLINK_PRIV bool socket_would_block(void)
+{
+#ifdef _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
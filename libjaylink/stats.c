@@ -0,0 +1,211 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "libjaylink.h"
+#include "libjaylink-internal.h"
+
+/**
+ * @file
+ *
+ * Performance statistics.
+ */
+
+static size_t latency_bucket(uint64_t latency)
+{
+	size_t bucket;
+
+	bucket = 0;
+
+	while (latency > 0 && bucket < JAYLINK_STATS_LATENCY_BUCKETS - 1) {
+		latency >>= 1;
+		bucket++;
+	}
+
+	return bucket;
+}
+
+/*
+ * Account the measured command, if any. The latency of a command is only known
+ * when the next command is started because the data of a command can be
+ * transferred with several write and read operations.
+ */
+static void finish_command(struct jaylink_device_handle *devh)
+{
+	struct stats_command *cmd;
+	struct jaylink_command_stats *stats;
+	uint64_t latency;
+
+	cmd = &devh->stats_cmd;
+
+	if (!cmd->active || !cmd->has_opcode) {
+		cmd->active = false;
+		return;
+	}
+
+	cmd->active = false;
+	stats = &devh->stats.commands[cmd->opcode];
+
+	if (!cmd->timed)
+		return;
+
+	latency = cmd->end - cmd->start;
+
+	stats->num_latencies++;
+	stats->total_latency += latency;
+	stats->latency[latency_bucket(latency)]++;
+
+	if (latency > stats->max_latency)
+		stats->max_latency = latency;
+}
+
+/**
+ * Initialize the statistics of a device handle.
+ *
+ * @param[in,out] devh Device handle.
+ */
+JAYLINK_PRIV void stats_init(struct jaylink_device_handle *devh)
+{
+	memset(&devh->stats, 0, sizeof(devh->stats));
+	devh->stats_cmd.active = false;
+}
+
+/**
+ * Account the start of a command.
+ *
+ * The opcode of the command is taken from the first byte written afterwards.
+ *
+ * @param[in,out] devh Device handle.
+ */
+JAYLINK_PRIV void stats_start_command(struct jaylink_device_handle *devh)
+{
+	struct stats_command *cmd;
+
+	finish_command(devh);
+
+	cmd = &devh->stats_cmd;
+	cmd->active = true;
+	cmd->has_opcode = false;
+	/*
+	 * The commands of a batch are sent at once and therefore their
+	 * individual latencies are meaningless.
+	 */
+	cmd->timed = !devh->batch;
+	cmd->start = util_get_time();
+	cmd->end = cmd->start;
+}
+
+/**
+ * Account written data.
+ *
+ * @param[in,out] devh Device handle.
+ * @param[in] buffer Buffer with the written data.
+ * @param[in] length Number of written bytes.
+ */
+JAYLINK_PRIV void stats_write(struct jaylink_device_handle *devh,
+		const uint8_t *buffer, size_t length)
+{
+	struct stats_command *cmd;
+
+	devh->stats.bytes_written += length;
+	cmd = &devh->stats_cmd;
+
+	if (!cmd->active)
+		return;
+
+	if (!cmd->has_opcode && length > 0) {
+		cmd->opcode = buffer[0];
+		cmd->has_opcode = true;
+		devh->stats.commands[cmd->opcode].count++;
+	}
+
+	if (cmd->timed)
+		cmd->end = util_get_time();
+}
+
+/**
+ * Account read data.
+ *
+ * @param[in,out] devh Device handle.
+ * @param[in] length Number of read bytes.
+ */
+JAYLINK_PRIV void stats_read(struct jaylink_device_handle *devh,
+		size_t length)
+{
+	struct stats_command *cmd;
+
+	devh->stats.bytes_read += length;
+	cmd = &devh->stats_cmd;
+
+	if (cmd->active && cmd->timed)
+		cmd->end = util_get_time();
+}
+
+/**
+ * Retrieve the performance statistics of a device handle.
+ *
+ * The statistics are accumulated since the device was opened or since the last
+ * call of jaylink_reset_stats().
+ *
+ * @param[in,out] devh Device handle.
+ * @param[out] stats Statistics on success, and undefined on failure.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_get_stats(struct jaylink_device_handle *devh,
+		struct jaylink_stats *stats)
+{
+	if (!devh || !stats)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	finish_command(devh);
+	memcpy(stats, &devh->stats, sizeof(struct jaylink_stats));
+	thread_mutex_unlock(&devh->lock);
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Reset the performance statistics of a device handle.
+ *
+ * @param[in,out] devh Device handle.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_reset_stats(struct jaylink_device_handle *devh)
+{
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	stats_init(devh);
+	thread_mutex_unlock(&devh->lock);
+
+	return JAYLINK_OK;
+}
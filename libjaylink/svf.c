@@ -0,0 +1,1411 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "libjaylink.h"
+#include "libjaylink-internal.h"
+
+/**
+ * @file
+ *
+ * Serial Vector Format (SVF) player.
+ *
+ * The statements are parsed one after another directly from the memory mapped
+ * file and appended to a JTAG scan engine. The TMS and TDI data of consecutive
+ * statements is collected and transferred with a single JTAG I/O operation
+ * once a threshold is reached or a statement requires the pending scans to be
+ * completed, for example to change the TRST signal. Expected TDO values are
+ * verified on the host after each transfer.
+ *
+ * Wait times are converted into TCK cycles if the TCK frequency is known.
+ * Otherwise, the pending scans are transferred and the time is waited on the
+ * host.
+ *
+ * The player core is shared with the XSVF player, see xsvf.c.
+ */
+
+/** @cond PRIVATE */
+/** Number of pending bits after which the scan engine is flushed. */
+#define FLUSH_BITS		(1 << 20)
+
+/** Maximum number of characters of a number. */
+#define MAX_NUMBER_LENGTH	32
+
+/** Maximum wait time in microseconds. */
+#define MAX_WAIT_TIME		(3600ULL * 1000000)
+
+/** Type of an SVF token. */
+enum token_type {
+	/** Keyword or number. */
+	TOKEN_WORD,
+	/** Hexadecimal data within parentheses. */
+	TOKEN_DATA,
+	/** End of a statement. */
+	TOKEN_END,
+	/** End of the file. */
+	TOKEN_EOF
+};
+
+struct token {
+	/** Type of the token. */
+	enum token_type type;
+	/** Characters of the token, without parentheses for data. */
+	const char *start;
+	/** Number of characters. */
+	size_t length;
+};
+
+/** Header, trailer or body of instruction and data register scans. */
+struct scan_data {
+	/** Number of bits. */
+	size_t length;
+	/** TDI data. */
+	uint8_t *tdi;
+	/** Expected TDO data. */
+	uint8_t *tdo;
+	/** Mask of the TDO bits to compare. */
+	uint8_t *mask;
+	/** Mask of the TDI bits to care about, which is not used. */
+	uint8_t *smask;
+	/** Indicates whether the TDO data is compared. */
+	bool has_tdo;
+};
+
+struct svf {
+	/** Player core. */
+	struct svf_player player;
+	/** File content. */
+	const char *data;
+	/** Size of the file in bytes. */
+	size_t length;
+	/** Position of the next character to parse. */
+	size_t pos;
+	/** Line number of the next character to parse. */
+	size_t line;
+	struct scan_data hir;
+	struct scan_data sir;
+	struct scan_data tir;
+	struct scan_data hdr;
+	struct scan_data sdr;
+	struct scan_data tdr;
+	/** TAP controller state after instruction register scans. */
+	enum jaylink_tap_state endir;
+	/** TAP controller state after data register scans. */
+	enum jaylink_tap_state enddr;
+	/** TAP controller state in which RUNTEST statements wait. */
+	enum jaylink_tap_state run_state;
+	/** TAP controller state after RUNTEST statements. */
+	enum jaylink_tap_state run_end_state;
+	/** TDI data of a complete scan. */
+	uint8_t *tdi;
+	/** Expected TDO data of a complete scan. */
+	uint8_t *tdo;
+	/** Mask of a complete scan. */
+	uint8_t *mask;
+	/** Size of the buffers for complete scans in bytes. */
+	size_t size;
+};
+/** @endcond */
+
+/* Names of the TAP controller states, indexed by the state. */
+static const char *const state_names[] = {
+	"RESET", "IDLE", "DRSELECT", "DRCAPTURE", "DRSHIFT", "DREXIT1",
+	"DRPAUSE", "DREXIT2", "DRUPDATE", "IRSELECT", "IRCAPTURE", "IRSHIFT",
+	"IREXIT1", "IRPAUSE", "IREXIT2", "IRUPDATE"
+};
+
+static int add_check(struct svf_player *player, const uint8_t *tdo,
+		const uint8_t *mask, size_t length, uint8_t **in)
+{
+	int ret;
+	struct svf_check *checks;
+	uint8_t *data;
+	size_t num_bytes;
+	size_t size;
+
+	num_bytes = (length + 7) / 8;
+	size = 3 * num_bytes;
+
+	/*
+	 * The captured TDO data of the pending scans is stored in the check
+	 * buffer when the scan engine is flushed. Therefore, the buffer must
+	 * not be moved before.
+	 */
+	if (player->data_used + size > player->data_size) {
+		if (player->data_used > 0) {
+			ret = svf_player_flush(player);
+
+			if (ret != JAYLINK_OK)
+				return ret;
+		}
+
+		if (size > player->data_size) {
+			data = realloc(player->data,
+				MAX(size, 2 * player->data_size));
+
+			if (!data)
+				return JAYLINK_ERR_MALLOC;
+
+			player->data = data;
+			player->data_size = MAX(size, 2 * player->data_size);
+		}
+	}
+
+	if (player->num_checks == player->checks_size) {
+		size = MAX(2 * player->checks_size, 16);
+		checks = realloc(player->checks, size * sizeof(*checks));
+
+		if (!checks)
+			return JAYLINK_ERR_MALLOC;
+
+		player->checks = checks;
+		player->checks_size = size;
+	}
+
+	data = player->data + player->data_used;
+	memcpy(data + num_bytes, tdo, num_bytes);
+
+	if (mask)
+		memcpy(data + 2 * num_bytes, mask, num_bytes);
+	else
+		memset(data + 2 * num_bytes, 0xff, num_bytes);
+
+	player->checks[player->num_checks].offset = player->data_used;
+	player->checks[player->num_checks].length = length;
+	player->checks[player->num_checks].position = player->position;
+	player->num_checks++;
+	player->data_used += 3 * num_bytes;
+
+	*in = data;
+
+	return JAYLINK_OK;
+}
+
+JAYLINK_PRIV void svf_player_init(struct svf_player *player,
+		struct jaylink_jtag_scan *scan, uint32_t frequency)
+{
+	player->scan = scan;
+	player->frequency = frequency;
+	player->position = 0;
+	player->data = NULL;
+	player->data_used = 0;
+	player->data_size = 0;
+	player->checks = NULL;
+	player->num_checks = 0;
+	player->checks_size = 0;
+}
+
+JAYLINK_PRIV void svf_player_free(struct svf_player *player)
+{
+	/*
+	 * Scans are only pending after a failure. They must not be transferred
+	 * because they may refer to the check buffer.
+	 */
+	if (player->scan->length > 0)
+		jtag_scan_discard(player->scan);
+
+	free(player->data);
+	free(player->checks);
+}
+
+/*
+ * Append a scan of the whole chain. If the expected TDO data is given, it is
+ * verified under the mask when the scan engine is flushed.
+ */
+JAYLINK_PRIV int svf_player_shift(struct svf_player *player, bool ir,
+		const uint8_t *tdi, const uint8_t *tdo, const uint8_t *mask,
+		size_t length, enum jaylink_tap_state end_state)
+{
+	int ret;
+	uint8_t *in;
+
+	in = NULL;
+
+	if (tdo) {
+		ret = add_check(player, tdo, mask, length, &in);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+	}
+
+	ret = jtag_scan_shift(player->scan, ir, tdi, in, length, end_state);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	if (player->scan->length >= FLUSH_BITS)
+		return svf_player_flush(player);
+
+	return JAYLINK_OK;
+}
+
+/*
+ * Stay in the current stable state for at least the specified number of TCK
+ * cycles and the specified time.
+ */
+JAYLINK_PRIV int svf_player_run(struct svf_player *player,
+		size_t num_clocks, uint64_t usecs)
+{
+	int ret;
+	uint64_t tmp;
+	size_t length;
+
+	if (usecs > 0 && player->frequency > 0) {
+		tmp = (usecs / 1000000) * player->frequency;
+		tmp += ((usecs % 1000000) * player->frequency + 999999) /
+			1000000;
+
+		if (tmp > SIZE_MAX)
+			return JAYLINK_ERR_ARG;
+
+		num_clocks = MAX(num_clocks, tmp);
+		usecs = 0;
+	}
+
+	while (num_clocks > 0) {
+		length = MIN(num_clocks, FLUSH_BITS);
+		ret = jtag_scan_clock(player->scan, length);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+
+		num_clocks -= length;
+
+		if (player->scan->length < FLUSH_BITS)
+			continue;
+
+		ret = svf_player_flush(player);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+	}
+
+	if (!usecs)
+		return JAYLINK_OK;
+
+	ret = svf_player_flush(player);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	util_sleep(usecs);
+
+	return JAYLINK_OK;
+}
+
+/*
+ * Transfer the pending scans and verify their TDO data. On a mismatch, the
+ * position is set to the one of the failed statement.
+ */
+JAYLINK_PRIV int svf_player_flush(struct svf_player *player)
+{
+	int ret;
+	struct jaylink_context *ctx;
+	const struct svf_check *check;
+	const uint8_t *data;
+	size_t num_checks;
+	size_t num_bytes;
+	size_t index;
+	size_t i;
+
+	ret = jaylink_jtag_scan_flush(player->scan);
+	num_checks = player->num_checks;
+	player->num_checks = 0;
+	player->data_used = 0;
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	ctx = player->scan->devh->dev->ctx;
+
+	for (i = 0; i < num_checks; i++) {
+		check = &player->checks[i];
+		data = player->data + check->offset;
+		num_bytes = (check->length + 7) / 8;
+		index = jaylink_bitvec_compare(data, data + num_bytes,
+			data + 2 * num_bytes, 0, check->length);
+
+		if (index < check->length) {
+			log_dbg(ctx, "TDO mismatch at bit %zu.", index);
+			player->position = check->position;
+			return JAYLINK_ERR_TARGET;
+		}
+	}
+
+	return JAYLINK_OK;
+}
+
+JAYLINK_PRIV int svf_map_file(struct jaylink_context *ctx,
+		const char *filename, const uint8_t **data, size_t *length)
+{
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+	int fd;
+	struct stat st;
+	void *addr;
+
+	fd = open(filename, O_RDONLY);
+
+	if (fd < 0) {
+		log_err(ctx, "Failed to open file: %s.", filename);
+		return JAYLINK_ERR_IO;
+	}
+
+	if (fstat(fd, &st) < 0) {
+		log_err(ctx, "Failed to determine size of file.");
+		close(fd);
+		return JAYLINK_ERR_IO;
+	}
+
+	if (!st.st_size) {
+		close(fd);
+		*data = NULL;
+		*length = 0;
+		return JAYLINK_OK;
+	}
+
+	addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (addr == MAP_FAILED) {
+		log_err(ctx, "Failed to map file.");
+		return JAYLINK_ERR_IO;
+	}
+
+#ifdef MADV_SEQUENTIAL
+	madvise(addr, st.st_size, MADV_SEQUENTIAL);
+#endif
+
+	*data = addr;
+	*length = st.st_size;
+
+	return JAYLINK_OK;
+#else
+	FILE *file;
+	long size;
+	uint8_t *buffer;
+
+	file = fopen(filename, "rb");
+
+	if (!file) {
+		log_err(ctx, "Failed to open file: %s.", filename);
+		return JAYLINK_ERR_IO;
+	}
+
+	size = -1;
+
+	if (!fseek(file, 0, SEEK_END))
+		size = ftell(file);
+
+	if (size < 0 || fseek(file, 0, SEEK_SET)) {
+		log_err(ctx, "Failed to determine size of file.");
+		fclose(file);
+		return JAYLINK_ERR_IO;
+	}
+
+	buffer = malloc(size);
+
+	if (!buffer && size > 0) {
+		log_err(ctx, "File buffer malloc failed.");
+		fclose(file);
+		return JAYLINK_ERR_MALLOC;
+	}
+
+	if (fread(buffer, 1, size, file) != (size_t)size) {
+		log_err(ctx, "Failed to read file.");
+		free(buffer);
+		fclose(file);
+		return JAYLINK_ERR_IO;
+	}
+
+	fclose(file);
+
+	*data = buffer;
+	*length = size;
+
+	return JAYLINK_OK;
+#endif
+}
+
+JAYLINK_PRIV void svf_unmap_file(const uint8_t *data, size_t length)
+{
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+	if (length > 0)
+		munmap((void *)data, length);
+#else
+	(void)length;
+	free((void *)data);
+#endif
+}
+
+static int next_token(struct svf *svf, struct token *token)
+{
+	const char *data;
+	size_t pos;
+	char c;
+
+	data = svf->data;
+	pos = svf->pos;
+
+	while (pos < svf->length) {
+		c = data[pos];
+
+		if (c == '\n') {
+			svf->line++;
+			pos++;
+		} else if (isspace((unsigned char)c)) {
+			pos++;
+		} else if (c == '!' || (c == '/' && pos + 1 < svf->length &&
+				data[pos + 1] == '/')) {
+			while (pos < svf->length && data[pos] != '\n')
+				pos++;
+		} else {
+			break;
+		}
+	}
+
+	token->start = data + pos;
+	token->length = 0;
+
+	if (pos == svf->length) {
+		token->type = TOKEN_EOF;
+	} else if (data[pos] == ';') {
+		token->type = TOKEN_END;
+		pos++;
+	} else if (data[pos] == '(') {
+		token->type = TOKEN_DATA;
+		token->start++;
+		pos++;
+
+		while (pos < svf->length && data[pos] != ')') {
+			if (data[pos] == '\n')
+				svf->line++;
+
+			pos++;
+		}
+
+		if (pos == svf->length)
+			return JAYLINK_ERR_PROTO;
+
+		token->length = data + pos - token->start;
+		pos++;
+	} else {
+		token->type = TOKEN_WORD;
+
+		while (pos < svf->length) {
+			c = data[pos];
+
+			if (isspace((unsigned char)c) || c == '(' ||
+					c == ')' || c == ';' || c == '!')
+				break;
+
+			pos++;
+		}
+
+		token->length = data + pos - token->start;
+
+		if (!token->length)
+			return JAYLINK_ERR_PROTO;
+	}
+
+	svf->pos = pos;
+
+	return JAYLINK_OK;
+}
+
+static int next_token_type(struct svf *svf, struct token *token,
+		enum token_type type)
+{
+	int ret;
+
+	ret = next_token(svf, token);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	if (token->type != type)
+		return JAYLINK_ERR_PROTO;
+
+	return JAYLINK_OK;
+}
+
+/* Compare a word token with a keyword, ignoring the case. */
+static bool token_is(const struct token *token, const char *keyword)
+{
+	size_t i;
+
+	if (token->type != TOKEN_WORD || token->length != strlen(keyword))
+		return false;
+
+	for (i = 0; i < token->length; i++) {
+		if (toupper((unsigned char)token->start[i]) != keyword[i])
+			return false;
+	}
+
+	return true;
+}
+
+static int parse_state(const struct token *token,
+		enum jaylink_tap_state *state)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(state_names) / sizeof(state_names[0]); i++) {
+		if (token_is(token, state_names[i])) {
+			*state = i;
+			return JAYLINK_OK;
+		}
+	}
+
+	return JAYLINK_ERR_PROTO;
+}
+
+static int parse_number(const struct token *token, double *value)
+{
+	char buffer[MAX_NUMBER_LENGTH + 1];
+	char *end;
+
+	if (token->type != TOKEN_WORD || token->length > MAX_NUMBER_LENGTH)
+		return JAYLINK_ERR_PROTO;
+
+	memcpy(buffer, token->start, token->length);
+	buffer[token->length] = '\0';
+	*value = strtod(buffer, &end);
+
+	if (end != buffer + token->length || !(*value >= 0))
+		return JAYLINK_ERR_PROTO;
+
+	return JAYLINK_OK;
+}
+
+static int parse_length(const struct token *token, size_t *length)
+{
+	size_t value;
+	size_t i;
+	char c;
+
+	if (token->type != TOKEN_WORD)
+		return JAYLINK_ERR_PROTO;
+
+	value = 0;
+
+	for (i = 0; i < token->length; i++) {
+		c = token->start[i];
+
+		if (!isdigit((unsigned char)c) || value > (SIZE_MAX - 9) / 10)
+			return JAYLINK_ERR_PROTO;
+
+		value = 10 * value + (c - '0');
+	}
+
+	*length = value;
+
+	return JAYLINK_OK;
+}
+
+/*
+ * Convert hexadecimal data into a bit vector. The last digit contains the
+ * first bits. Set bits beyond the specified length are not allowed.
+ */
+static int parse_hex(const struct token *token, uint8_t *buffer,
+		size_t length)
+{
+	size_t bit;
+	size_t i;
+	unsigned int value;
+	char c;
+
+	memset(buffer, 0, (length + 7) / 8);
+	bit = 0;
+
+	for (i = token->length; i > 0; i--) {
+		c = token->start[i - 1];
+
+		if (isspace((unsigned char)c))
+			continue;
+
+		if (isdigit((unsigned char)c))
+			value = c - '0';
+		else if (isxdigit((unsigned char)c))
+			value = toupper((unsigned char)c) - 'A' + 10;
+		else
+			return JAYLINK_ERR_PROTO;
+
+		if (bit >= length) {
+			if (value)
+				return JAYLINK_ERR_PROTO;
+
+			continue;
+		}
+
+		if (length - bit < 4 && (value >> (length - bit)))
+			return JAYLINK_ERR_PROTO;
+
+		buffer[bit / 8] |= value << (bit % 8);
+		bit += 4;
+	}
+
+	return JAYLINK_OK;
+}
+
+static int resize_scan_data(struct scan_data *scan, size_t length)
+{
+	uint8_t **buffers[4];
+	uint8_t *tmp;
+	size_t num_bytes;
+	size_t i;
+
+	buffers[0] = &scan->tdi;
+	buffers[1] = &scan->tdo;
+	buffers[2] = &scan->mask;
+	buffers[3] = &scan->smask;
+	num_bytes = MAX((length + 7) / 8, 1);
+
+	for (i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++) {
+		tmp = realloc(*buffers[i], num_bytes);
+
+		if (!tmp)
+			return JAYLINK_ERR_MALLOC;
+
+		*buffers[i] = tmp;
+	}
+
+	/* The TDI data must be specified again, all TDO bits are compared. */
+	memset(scan->tdi, 0x00, num_bytes);
+	memset(scan->mask, 0xff, num_bytes);
+	memset(scan->smask, 0xff, num_bytes);
+	scan->length = length;
+
+	return JAYLINK_OK;
+}
+
+static void free_scan_data(struct scan_data *scan)
+{
+	free(scan->tdi);
+	free(scan->tdo);
+	free(scan->mask);
+	free(scan->smask);
+}
+
+/*
+ * Parse the parameters of an HIR, SIR, TIR, HDR, SDR or TDR statement. The
+ * TDI data, the mask and the select mask are kept as long as the length does
+ * not change.
+ */
+static int parse_scan_data(struct svf *svf, struct scan_data *scan)
+{
+	int ret;
+	struct token token;
+	struct token data;
+	size_t length;
+	uint8_t *buffer;
+	bool has_tdi;
+	bool resized;
+
+	ret = next_token(svf, &token);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	ret = parse_length(&token, &length);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	resized = false;
+
+	if (length != scan->length || !scan->tdi) {
+		ret = resize_scan_data(scan, length);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+
+		resized = true;
+	}
+
+	has_tdi = false;
+	scan->has_tdo = false;
+
+	while (true) {
+		ret = next_token(svf, &token);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+
+		if (token.type == TOKEN_END)
+			break;
+
+		if (token_is(&token, "TDI")) {
+			buffer = scan->tdi;
+			has_tdi = true;
+		} else if (token_is(&token, "TDO")) {
+			buffer = scan->tdo;
+			scan->has_tdo = true;
+		} else if (token_is(&token, "MASK")) {
+			buffer = scan->mask;
+		} else if (token_is(&token, "SMASK")) {
+			buffer = scan->smask;
+		} else {
+			return JAYLINK_ERR_PROTO;
+		}
+
+		ret = next_token_type(svf, &data, TOKEN_DATA);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+
+		ret = parse_hex(&data, buffer, scan->length);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+	}
+
+	if (resized && length > 0 && !has_tdi)
+		return JAYLINK_ERR_PROTO;
+
+	return JAYLINK_OK;
+}
+
+static int reserve_scan_buffers(struct svf *svf, size_t length)
+{
+	uint8_t *tdi;
+	uint8_t *tdo;
+	uint8_t *mask;
+	size_t size;
+
+	size = (length + 7) / 8;
+
+	if (size <= svf->size)
+		return JAYLINK_OK;
+
+	tdi = realloc(svf->tdi, size);
+
+	if (!tdi)
+		return JAYLINK_ERR_MALLOC;
+
+	svf->tdi = tdi;
+	tdo = realloc(svf->tdo, size);
+
+	if (!tdo)
+		return JAYLINK_ERR_MALLOC;
+
+	svf->tdo = tdo;
+	mask = realloc(svf->mask, size);
+
+	if (!mask)
+		return JAYLINK_ERR_MALLOC;
+
+	svf->mask = mask;
+	svf->size = size;
+
+	return JAYLINK_OK;
+}
+
+/* Perform a scan consisting of the header, the body and the trailer. */
+static int perform_scan(struct svf *svf, bool ir)
+{
+	int ret;
+	const struct scan_data *parts[3];
+	const struct scan_data *part;
+	enum jaylink_tap_state end_state;
+	size_t length;
+	size_t offset;
+	bool check;
+	size_t i;
+
+	if (ir) {
+		parts[0] = &svf->hir;
+		parts[1] = &svf->sir;
+		parts[2] = &svf->tir;
+		end_state = svf->endir;
+	} else {
+		parts[0] = &svf->hdr;
+		parts[1] = &svf->sdr;
+		parts[2] = &svf->tdr;
+		end_state = svf->enddr;
+	}
+
+	length = parts[0]->length + parts[1]->length + parts[2]->length;
+	check = parts[0]->has_tdo || parts[1]->has_tdo || parts[2]->has_tdo;
+
+	if (!length)
+		return JAYLINK_OK;
+
+	/* Avoid copying the data of large scans without header and trailer. */
+	if (!parts[0]->length && !parts[2]->length)
+		return svf_player_shift(&svf->player, ir, parts[1]->tdi,
+			check ? parts[1]->tdo : NULL, parts[1]->mask, length,
+			end_state);
+
+	ret = reserve_scan_buffers(svf, length);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	offset = 0;
+
+	for (i = 0; i < sizeof(parts) / sizeof(parts[0]); i++) {
+		part = parts[i];
+
+		if (!part->length)
+			continue;
+
+		jaylink_bitvec_copy(svf->tdi, offset, part->tdi, 0,
+			part->length);
+
+		if (part->has_tdo) {
+			jaylink_bitvec_copy(svf->tdo, offset, part->tdo, 0,
+				part->length);
+			jaylink_bitvec_copy(svf->mask, offset, part->mask, 0,
+				part->length);
+		} else {
+			jaylink_bitvec_fill(svf->tdo, offset, false,
+				part->length);
+			jaylink_bitvec_fill(svf->mask, offset, false,
+				part->length);
+		}
+
+		offset += part->length;
+	}
+
+	return svf_player_shift(&svf->player, ir, svf->tdi,
+		check ? svf->tdo : NULL, svf->mask, length, end_state);
+}
+
+static bool is_run_state(enum jaylink_tap_state state)
+{
+	switch (state) {
+	case JAYLINK_TAP_STATE_RESET:
+	case JAYLINK_TAP_STATE_IDLE:
+	case JAYLINK_TAP_STATE_DR_PAUSE:
+	case JAYLINK_TAP_STATE_IR_PAUSE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static int parse_end_state(struct svf *svf, enum jaylink_tap_state *state)
+{
+	int ret;
+	struct token token;
+
+	ret = next_token(svf, &token);
+
+	if (ret == JAYLINK_OK)
+		ret = parse_state(&token, state);
+
+	if (ret == JAYLINK_OK && !is_run_state(*state))
+		ret = JAYLINK_ERR_PROTO;
+
+	if (ret == JAYLINK_OK)
+		ret = next_token_type(svf, &token, TOKEN_END);
+
+	return ret;
+}
+
+static int handle_runtest(struct svf *svf)
+{
+	int ret;
+	struct token token;
+	struct token unit;
+	enum jaylink_tap_state state;
+	double value;
+	size_t num_clocks;
+	uint64_t usecs;
+	bool has_run_state;
+	bool has_end_state;
+	bool maximum;
+
+	num_clocks = 0;
+	usecs = 0;
+	has_run_state = false;
+	has_end_state = false;
+	maximum = false;
+
+	ret = next_token(svf, &token);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	if (parse_state(&token, &state) == JAYLINK_OK) {
+		if (!is_run_state(state))
+			return JAYLINK_ERR_PROTO;
+
+		svf->run_state = state;
+		has_run_state = true;
+		ret = next_token(svf, &token);
+	}
+
+	while (ret == JAYLINK_OK && token.type != TOKEN_END) {
+		if (token_is(&token, "ENDSTATE")) {
+			ret = next_token(svf, &token);
+
+			if (ret == JAYLINK_OK)
+				ret = parse_state(&token, &state);
+
+			if (ret != JAYLINK_OK)
+				return ret;
+
+			if (!is_run_state(state))
+				return JAYLINK_ERR_PROTO;
+
+			svf->run_end_state = state;
+			has_end_state = true;
+		} else if (token_is(&token, "MAXIMUM")) {
+			maximum = true;
+		} else {
+			ret = parse_number(&token, &value);
+
+			if (ret == JAYLINK_OK)
+				ret = next_token(svf, &unit);
+
+			if (ret != JAYLINK_OK)
+				return ret;
+
+			if (token_is(&unit, "SEC") && maximum) {
+				/* The maximum time is not taken into account. */
+				maximum = false;
+			} else if (token_is(&unit, "SEC")) {
+				if (value * 1000000 > MAX_WAIT_TIME)
+					return JAYLINK_ERR_PROTO;
+
+				usecs = value * 1000000;
+
+				if (usecs < value * 1000000)
+					usecs++;
+			} else if (token_is(&unit, "TCK") ||
+					token_is(&unit, "SCK")) {
+				if (value >= SIZE_MAX)
+					return JAYLINK_ERR_PROTO;
+
+				num_clocks = value;
+
+				if (num_clocks < value)
+					num_clocks++;
+			} else {
+				return JAYLINK_ERR_PROTO;
+			}
+		}
+
+		if (ret == JAYLINK_OK)
+			ret = next_token(svf, &token);
+	}
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	if (has_run_state && !has_end_state)
+		svf->run_end_state = svf->run_state;
+
+	ret = jaylink_jtag_scan_goto(svf->player.scan, svf->run_state);
+
+	if (ret == JAYLINK_OK)
+		ret = svf_player_run(&svf->player, num_clocks, usecs);
+
+	if (ret == JAYLINK_OK)
+		ret = jaylink_jtag_scan_goto(svf->player.scan,
+			svf->run_end_state);
+
+	return ret;
+}
+
+/*
+ * Move along a path of TAP controller states. Only the last state must be a
+ * stable state.
+ */
+static int handle_state(struct svf *svf)
+{
+	int ret;
+	struct token token;
+	enum jaylink_tap_state state;
+	bool pending;
+
+	state = JAYLINK_TAP_STATE_RESET;
+	pending = false;
+
+	while (true) {
+		ret = next_token(svf, &token);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+
+		if (token.type == TOKEN_END)
+			break;
+
+		if (pending) {
+			ret = jtag_scan_move(svf->player.scan, state);
+
+			if (ret != JAYLINK_OK)
+				return ret;
+		}
+
+		ret = parse_state(&token, &state);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+
+		pending = true;
+	}
+
+	if (!pending || !is_run_state(state))
+		return JAYLINK_ERR_PROTO;
+
+	return jtag_scan_move(svf->player.scan, state);
+}
+
+static int handle_frequency(struct svf *svf)
+{
+	int ret;
+	struct jaylink_context *ctx;
+	struct token token;
+	double value;
+	uint16_t speed;
+
+	ret = next_token(svf, &token);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	/* Without a frequency, the current speed is kept. */
+	if (token.type == TOKEN_END)
+		return JAYLINK_OK;
+
+	ret = parse_number(&token, &value);
+
+	if (ret == JAYLINK_OK)
+		ret = next_token(svf, &token);
+
+	if (ret == JAYLINK_OK && !token_is(&token, "HZ"))
+		ret = JAYLINK_ERR_PROTO;
+
+	if (ret == JAYLINK_OK)
+		ret = next_token_type(svf, &token, TOKEN_END);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	/*
+	 * Round down to the next speed in kHz, excluding the value for
+	 * adaptive clocking.
+	 */
+	if (value >= (JAYLINK_SPEED_ADAPTIVE_CLOCKING - 1) * 1000.0)
+		speed = JAYLINK_SPEED_ADAPTIVE_CLOCKING - 1;
+	else
+		speed = MAX(value / 1000, 1.0);
+
+	ret = svf_player_flush(&svf->player);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	ret = jaylink_set_speed(svf->player.scan->devh, speed);
+
+	if (ret != JAYLINK_OK) {
+		ctx = svf->player.scan->devh->dev->ctx;
+		log_err(ctx, "jaylink_set_speed() failed: %s.",
+			jaylink_strerror(ret));
+		return ret;
+	}
+
+	svf->player.frequency = speed * 1000;
+
+	return JAYLINK_OK;
+}
+
+static int handle_trst(struct svf *svf)
+{
+	int ret;
+	struct jaylink_device_handle *devh;
+	struct token token;
+	struct token end;
+
+	ret = next_token(svf, &token);
+
+	if (ret == JAYLINK_OK)
+		ret = next_token_type(svf, &end, TOKEN_END);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	if (token_is(&token, "Z") || token_is(&token, "ABSENT"))
+		return JAYLINK_OK;
+
+	if (!token_is(&token, "ON") && !token_is(&token, "OFF"))
+		return JAYLINK_ERR_PROTO;
+
+	ret = svf_player_flush(&svf->player);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	devh = svf->player.scan->devh;
+
+	if (token_is(&token, "OFF"))
+		return jaylink_jtag_set_trst(devh);
+
+	ret = jaylink_jtag_clear_trst(devh);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	/* The TAP controllers are held in the Test-Logic-Reset state. */
+	svf->player.scan->state = JAYLINK_TAP_STATE_RESET;
+	svf->player.scan->state_known = true;
+
+	return JAYLINK_OK;
+}
+
+static int handle_statement(struct svf *svf, const struct token *token)
+{
+	int ret;
+
+	if (token_is(token, "SIR")) {
+		ret = parse_scan_data(svf, &svf->sir);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+
+		return perform_scan(svf, true);
+	} else if (token_is(token, "SDR")) {
+		ret = parse_scan_data(svf, &svf->sdr);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+
+		return perform_scan(svf, false);
+	} else if (token_is(token, "RUNTEST")) {
+		return handle_runtest(svf);
+	} else if (token_is(token, "HIR")) {
+		return parse_scan_data(svf, &svf->hir);
+	} else if (token_is(token, "TIR")) {
+		return parse_scan_data(svf, &svf->tir);
+	} else if (token_is(token, "HDR")) {
+		return parse_scan_data(svf, &svf->hdr);
+	} else if (token_is(token, "TDR")) {
+		return parse_scan_data(svf, &svf->tdr);
+	} else if (token_is(token, "ENDIR")) {
+		return parse_end_state(svf, &svf->endir);
+	} else if (token_is(token, "ENDDR")) {
+		return parse_end_state(svf, &svf->enddr);
+	} else if (token_is(token, "STATE")) {
+		return handle_state(svf);
+	} else if (token_is(token, "FREQUENCY")) {
+		return handle_frequency(svf);
+	} else if (token_is(token, "TRST")) {
+		return handle_trst(svf);
+	} else if (token_is(token, "PIO") || token_is(token, "PIOMAP")) {
+		return JAYLINK_ERR_NOT_SUPPORTED;
+	}
+
+	return JAYLINK_ERR_PROTO;
+}
+
+static void init_scan_data(struct scan_data *scan)
+{
+	scan->length = 0;
+	scan->tdi = NULL;
+	scan->tdo = NULL;
+	scan->mask = NULL;
+	scan->smask = NULL;
+	scan->has_tdo = false;
+}
+
+/**
+ * Play SVF data.
+ *
+ * The SIR, SDR and RUNTEST statements and all other statements which do not
+ * require an immediate transfer are collected by the scan engine and
+ * transferred with a single JTAG I/O operation. The expected TDO data is
+ * verified on the host after each transfer. Pending operations of the scan
+ * engine are transferred as well.
+ *
+ * The FREQUENCY statement changes the target interface speed, rounded down to
+ * the next speed in kHz. The PIO and PIOMAP statements are not supported.
+ *
+ * @param[in,out] scan Scan engine.
+ * @param[in] data SVF data.
+ * @param[in] length Length of the SVF data in bytes.
+ * @param[in] frequency TCK frequency in Hz, or 0 if unknown. It is used to
+ *                      convert wait times into TCK cycles. If unknown, wait
+ *                      times are waited on the host after all pending scans
+ *                      are transferred.
+ * @param[out] line Line number of the failed statement on failure, and
+ *                  undefined on success. Can be NULL.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR_PROTO Invalid statement.
+ * @retval JAYLINK_ERR_NOT_SUPPORTED Unsupported statement.
+ * @retval JAYLINK_ERR_DEV_NO_MEMORY Not enough memory on the device to perform
+ *                                   the operation.
+ * @retval JAYLINK_ERR_DEV Unspecified device error.
+ * @retval JAYLINK_ERR_TARGET TDO data does not match the expected values.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @see jaylink_svf_play_file()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_svf_play(struct jaylink_jtag_scan *scan,
+		const char *data, size_t length, uint32_t frequency,
+		size_t *line)
+{
+	int ret;
+	struct jaylink_context *ctx;
+	struct svf svf;
+	struct token token;
+
+	if (!scan || (!data && length > 0))
+		return JAYLINK_ERR_ARG;
+
+	ctx = scan->devh->dev->ctx;
+
+	svf_player_init(&svf.player, scan, frequency);
+	svf.data = data;
+	svf.length = length;
+	svf.pos = 0;
+	svf.line = 1;
+	init_scan_data(&svf.hir);
+	init_scan_data(&svf.sir);
+	init_scan_data(&svf.tir);
+	init_scan_data(&svf.hdr);
+	init_scan_data(&svf.sdr);
+	init_scan_data(&svf.tdr);
+	svf.endir = JAYLINK_TAP_STATE_IDLE;
+	svf.enddr = JAYLINK_TAP_STATE_IDLE;
+	svf.run_state = JAYLINK_TAP_STATE_IDLE;
+	svf.run_end_state = JAYLINK_TAP_STATE_IDLE;
+	svf.tdi = NULL;
+	svf.tdo = NULL;
+	svf.mask = NULL;
+	svf.size = 0;
+
+	while (true) {
+		ret = next_token(&svf, &token);
+
+		if (ret != JAYLINK_OK || token.type == TOKEN_EOF)
+			break;
+
+		svf.player.position = svf.line;
+
+		if (token.type != TOKEN_WORD)
+			ret = JAYLINK_ERR_PROTO;
+		else
+			ret = handle_statement(&svf, &token);
+
+		if (ret != JAYLINK_OK)
+			break;
+	}
+
+	if (ret == JAYLINK_OK)
+		ret = svf_player_flush(&svf.player);
+	else if (ret != JAYLINK_ERR_TARGET)
+		svf.player.position = svf.line;
+
+	if (ret == JAYLINK_ERR_PROTO)
+		log_err(ctx, "Invalid SVF statement in line %zu.",
+			svf.player.position);
+	else if (ret != JAYLINK_OK)
+		log_err(ctx, "SVF statement in line %zu failed: %s.",
+			svf.player.position, jaylink_strerror(ret));
+
+	if (ret != JAYLINK_OK && line)
+		*line = svf.player.position;
+
+	svf_player_free(&svf.player);
+	free_scan_data(&svf.hir);
+	free_scan_data(&svf.sir);
+	free_scan_data(&svf.tir);
+	free_scan_data(&svf.hdr);
+	free_scan_data(&svf.sdr);
+	free_scan_data(&svf.tdr);
+	free(svf.tdi);
+	free(svf.tdo);
+	free(svf.mask);
+
+	return ret;
+}
+
+/**
+ * Play an SVF file.
+ *
+ * The file is mapped into memory if supported by the system and played like
+ * with jaylink_svf_play().
+ *
+ * @param[in,out] scan Scan engine.
+ * @param[in] filename Name of the SVF file.
+ * @param[in] frequency TCK frequency in Hz, or 0 if unknown.
+ * @param[out] line Line number of the failed statement on failure, and
+ *                  undefined on success. Can be NULL.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR_PROTO Invalid statement.
+ * @retval JAYLINK_ERR_NOT_SUPPORTED Unsupported statement.
+ * @retval JAYLINK_ERR_DEV_NO_MEMORY Not enough memory on the device to perform
+ *                                   the operation.
+ * @retval JAYLINK_ERR_DEV Unspecified device error.
+ * @retval JAYLINK_ERR_TARGET TDO data does not match the expected values.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_svf_play_file(struct jaylink_jtag_scan *scan,
+		const char *filename, uint32_t frequency, size_t *line)
+{
+	int ret;
+	const uint8_t *data;
+	size_t length;
+
+	if (!scan || !filename)
+		return JAYLINK_ERR_ARG;
+
+	ret = svf_map_file(scan->devh->dev->ctx, filename, &data, &length);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	ret = jaylink_svf_play(scan, (const char *)data, length, frequency,
+		line);
+	svf_unmap_file(data, length);
+
+	return ret;
+}
@@ -39,36 +39,7 @@
 #define SWD_IO_ERR_NO_MEMORY	0x06
 /** @endcond */
 
-/**
- * Perform a SWD I/O operation.
- *
- * @note This function must only be used if the #JAYLINK_TIF_SWD interface is
- *       available and selected.
- *
- * @param[in,out] devh Device handle.
- * @param[in] direction Buffer to read the transfer direction from.
- * @param[in] out Buffer to read host-to-target data from.
- * @param[out] in Buffer to store target-to-host data on success. Its content
- *                is undefined on failure. The buffer must be large enough to
- *                contain at least the specified number of bits to transfer.
- * @param[in] length Total number of bits to transfer from host to target and
- *                   vice versa.
- *
- * @retval JAYLINK_OK Success.
- * @retval JAYLINK_ERR_ARG Invalid arguments.
- * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
- * @retval JAYLINK_ERR_IO Input/output error.
- * @retval JAYLINK_ERR_DEV_NO_MEMORY Not enough memory on the device to perform
- *                                   the operation.
- * @retval JAYLINK_ERR_DEV Unspecified device error.
- * @retval JAYLINK_ERR Other error conditions.
- *
- * @see jaylink_select_interface()
- * @see jaylink_set_speed()
- *
- * @since 0.1.0
- */
-JAYLINK_API int jaylink_swd_io(struct jaylink_device_handle *devh,
+static int _swd_io(struct jaylink_device_handle *devh,
 		const uint8_t *direction, const uint8_t *out, uint8_t *in,
 		uint16_t length)
 {
@@ -76,6 +47,7 @@ JAYLINK_API int jaylink_swd_io(struct jaylink_device_handle *devh,
 	struct jaylink_context *ctx;
 	uint16_t num_bytes;
 	uint8_t buf[4];
+	struct transport_iovec iov[3];
 	uint8_t status;
 
 	if (!devh || !direction || !out || !in || !length)
@@ -97,26 +69,17 @@ JAYLINK_API int jaylink_swd_io(struct jaylink_device_handle *devh,
 	buf[1] = 0x00;
 	buffer_set_u16(buf, length, 2);
 
-	ret = transport_write(devh, buf, 4);
-
-	if (ret != JAYLINK_OK) {
-		log_err(ctx, "transport_write() failed: %s.",
-			jaylink_strerror(ret));
-		return ret;
-	}
-
-	ret = transport_write(devh, direction, num_bytes);
-
-	if (ret != JAYLINK_OK) {
-		log_err(ctx, "transport_write() failed: %s.",
-			jaylink_strerror(ret));
-		return ret;
-	}
+	iov[0].buffer = buf;
+	iov[0].length = 4;
+	iov[1].buffer = direction;
+	iov[1].length = num_bytes;
+	iov[2].buffer = out;
+	iov[2].length = num_bytes;
 
-	ret = transport_write(devh, out, num_bytes);
+	ret = transport_writev(devh, iov, 3);
 
 	if (ret != JAYLINK_OK) {
-		log_err(ctx, "transport_write() failed: %s.",
+		log_err(ctx, "transport_writev() failed: %s.",
 			jaylink_strerror(ret));
 		return ret;
 	}
@@ -146,3 +109,100 @@ JAYLINK_API int jaylink_swd_io(struct jaylink_device_handle *devh,
 
 	return JAYLINK_OK;
 }
+
+/**
+ * Perform a SWD I/O operation.
+ *
+ * @note This function must only be used if the #JAYLINK_TIF_SWD interface is
+ *       available and selected.
+ *
+ * @param[in,out] devh Device handle.
+ * @param[in] direction Buffer to read the transfer direction from.
+ * @param[in] out Buffer to read host-to-target data from.
+ * @param[out] in Buffer to store target-to-host data on success. Its content
+ *                is undefined on failure. The buffer must be large enough to
+ *                contain at least the specified number of bits to transfer.
+ * @param[in] length Total number of bits to transfer from host to target and
+ *                   vice versa.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR_DEV_NO_MEMORY Not enough memory on the device to perform
+ *                                   the operation.
+ * @retval JAYLINK_ERR_DEV Unspecified device error.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @see jaylink_select_interface()
+ * @see jaylink_set_speed()
+ *
+ * @since 0.1.0
+ */
+JAYLINK_API int jaylink_swd_io(struct jaylink_device_handle *devh,
+		const uint8_t *direction, const uint8_t *out, uint8_t *in,
+		uint16_t length)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _swd_io(devh, direction, out, in, length);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+/**
+ * Add a SWD I/O operation to a command queue.
+ *
+ * See jaylink_swd_io() for a description of the operation. The buffers must
+ * remain valid until the queue is executed.
+ *
+ * @param[in,out] queue Queue.
+ * @param[in] direction Buffer to read the transfer direction from.
+ * @param[in] out Buffer to read host-to-target data from.
+ * @param[out] in Buffer to store target-to-host data when the queue is
+ *                executed successfully. Its content is undefined on failure.
+ *                The buffer must be large enough to contain at least the
+ *                specified number of bits to transfer.
+ * @param[in] length Total number of bits to transfer from host to target and
+ *                   vice versa.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @see jaylink_queue_execute()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_queue_swd_io(struct jaylink_queue *queue,
+		const uint8_t *direction, const uint8_t *out, uint8_t *in,
+		uint16_t length)
+{
+	struct queue_entry *entry;
+
+	if (!queue || !direction || !out || !in || !length)
+		return JAYLINK_ERR_ARG;
+
+	entry = queue_add(queue);
+
+	if (!entry)
+		return JAYLINK_ERR_MALLOC;
+
+	entry->header[0] = CMD_SWD_IO;
+	entry->header[1] = 0x00;
+	buffer_set_u16(entry->header, length, 2);
+	entry->header_length = 4;
+	entry->data[0] = direction;
+	entry->data[1] = out;
+	entry->data_length = (length + 7) / 8;
+	entry->response = in;
+	entry->response_length = entry->data_length;
+	entry->has_status = true;
+
+	return JAYLINK_OK;
+}
@@ -45,30 +45,7 @@
 #define SWO_ERR			0x80000000
 /** @endcond */
 
-/**
- * Start SWO capture.
- *
- * @note This function must be used only if the device has the
- *       #JAYLINK_DEV_CAP_SWO capability.
- *
- * @param[in,out] devh Device handle.
- * @param[in] mode Mode to capture data with.
- * @param[in] baudrate Baudrate to capture data in bit per second.
- * @param[in] size Device internal buffer size in bytes to use for capturing.
- *
- * @retval JAYLINK_OK Success.
- * @retval JAYLINK_ERR_ARG Invalid arguments.
- * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
- * @retval JAYLINK_ERR_IO Input/output error.
- * @retval JAYLINK_ERR_DEV Unspecified device error.
- * @retval JAYLINK_ERR Other error conditions.
- *
- * @see jaylink_swo_get_speeds()
- * @see jaylink_get_free_memory()
- *
- * @since 0.1.0
- */
-JAYLINK_API int jaylink_swo_start(struct jaylink_device_handle *devh,
+static int _swo_start(struct jaylink_device_handle *devh,
 		enum jaylink_swo_mode mode, uint32_t baudrate, uint32_t size)
 {
 	int ret;
@@ -135,12 +112,15 @@ JAYLINK_API int jaylink_swo_start(struct jaylink_device_handle *devh,
 }
 
 /**
- * Stop SWO capture.
+ * Start SWO capture.
  *
  * @note This function must be used only if the device has the
  *       #JAYLINK_DEV_CAP_SWO capability.
  *
  * @param[in,out] devh Device handle.
+ * @param[in] mode Mode to capture data with.
+ * @param[in] baudrate Baudrate to capture data in bit per second.
+ * @param[in] size Device internal buffer size in bytes to use for capturing.
  *
  * @retval JAYLINK_OK Success.
  * @retval JAYLINK_ERR_ARG Invalid arguments.
@@ -149,11 +129,27 @@ JAYLINK_API int jaylink_swo_start(struct jaylink_device_handle *devh,
  * @retval JAYLINK_ERR_DEV Unspecified device error.
  * @retval JAYLINK_ERR Other error conditions.
  *
- * @see jaylink_swo_start()
+ * @see jaylink_swo_get_speeds()
+ * @see jaylink_get_free_memory()
  *
  * @since 0.1.0
  */
-JAYLINK_API int jaylink_swo_stop(struct jaylink_device_handle *devh)
+JAYLINK_API int jaylink_swo_start(struct jaylink_device_handle *devh,
+		enum jaylink_swo_mode mode, uint32_t baudrate, uint32_t size)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _swo_start(devh, mode, baudrate, size);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+static int _swo_stop(struct jaylink_device_handle *devh)
 {
 	int ret;
 	struct jaylink_context *ctx;
@@ -203,22 +199,16 @@ JAYLINK_API int jaylink_swo_stop(struct jaylink_device_handle *devh)
 }
 
 /**
- * Read SWO trace data.
+ * Stop SWO capture.
  *
  * @note This function must be used only if the device has the
  *       #JAYLINK_DEV_CAP_SWO capability.
  *
  * @param[in,out] devh Device handle.
- * @param[out] buffer Buffer to store trace data on success. Its content is
- *                    undefined on failure.
- * @param[in,out] length Maximum number of bytes to read. On success, the value
- *                       gets updated with the actual number of bytes read. The
- *                       value is undefined on failure.
  *
  * @retval JAYLINK_OK Success.
  * @retval JAYLINK_ERR_ARG Invalid arguments.
  * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
- * @retval JAYLINK_ERR_PROTO Protocol violation.
  * @retval JAYLINK_ERR_IO Input/output error.
  * @retval JAYLINK_ERR_DEV Unspecified device error.
  * @retval JAYLINK_ERR Other error conditions.
@@ -227,7 +217,21 @@ JAYLINK_API int jaylink_swo_stop(struct jaylink_device_handle *devh)
  *
  * @since 0.1.0
  */
-JAYLINK_API int jaylink_swo_read(struct jaylink_device_handle *devh,
+JAYLINK_API int jaylink_swo_stop(struct jaylink_device_handle *devh)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _swo_stop(devh);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+static int _swo_read(struct jaylink_device_handle *devh,
 		uint8_t *buffer, uint32_t *length)
 {
 	int ret;
@@ -311,26 +315,17 @@ JAYLINK_API int jaylink_swo_read(struct jaylink_device_handle *devh,
 }
 
 /**
- * Retrieve SWO speeds.
-
- * The speeds are calculated as follows:
- *
- * @par
- * <tt>speeds = @a freq / n</tt> with <tt>n >= @a min_div</tt> and
- * <tt>n <= @a max_div</tt>, where @p n is an integer
- *
- * Assuming, for example, a base frequency @a freq of 4500 kHz, a minimum
- * divider @a min_div of 1 and a maximum divider @a max_div of 8 then the
- * highest possible SWO speed is 4500 kHz / 1 = 4500 kHz. The next highest
- * speed is 2250 kHz for a divider of 2, and so on. Accordingly, the lowest
- * possible speed is 4500 kHz / 8 = 562.5 kHz.
+ * Read SWO trace data.
  *
  * @note This function must be used only if the device has the
  *       #JAYLINK_DEV_CAP_SWO capability.
  *
  * @param[in,out] devh Device handle.
- * @param[in] mode Capture mode to retrieve speeds for.
- * @param[out] speed Speed information on success, and undefined on failure.
+ * @param[out] buffer Buffer to store trace data on success. Its content is
+ *                    undefined on failure.
+ * @param[in,out] length Maximum number of bytes to read. On success, the value
+ *                       gets updated with the actual number of bytes read. The
+ *                       value is undefined on failure.
  *
  * @retval JAYLINK_OK Success.
  * @retval JAYLINK_ERR_ARG Invalid arguments.
@@ -340,9 +335,26 @@ JAYLINK_API int jaylink_swo_read(struct jaylink_device_handle *devh,
  * @retval JAYLINK_ERR_DEV Unspecified device error.
  * @retval JAYLINK_ERR Other error conditions.
  *
+ * @see jaylink_swo_start()
+ *
  * @since 0.1.0
  */
-JAYLINK_API int jaylink_swo_get_speeds(struct jaylink_device_handle *devh,
+JAYLINK_API int jaylink_swo_read(struct jaylink_device_handle *devh,
+		uint8_t *buffer, uint32_t *length)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _swo_read(devh, buffer, length);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+static int _swo_get_speeds(struct jaylink_device_handle *devh,
 		enum jaylink_swo_mode mode, struct jaylink_swo_speed *speed)
 {
 	int ret;
@@ -451,3 +463,50 @@ JAYLINK_API int jaylink_swo_get_speeds(struct jaylink_device_handle *devh,
 
 	return JAYLINK_OK;
 }
+
+/**
+ * Retrieve SWO speeds.
+
+ * The speeds are calculated as follows:
+ *
+ * @par
+ * <tt>speeds = @a freq / n</tt> with <tt>n >= @a min_div</tt> and
+ * <tt>n <= @a max_div</tt>, where @p n is an integer
+ *
+ * Assuming, for example, a base frequency @a freq of 4500 kHz, a minimum
+ * divider @a min_div of 1 and a maximum divider @a max_div of 8 then the
+ * highest possible SWO speed is 4500 kHz / 1 = 4500 kHz. The next highest
+ * speed is 2250 kHz for a divider of 2, and so on. Accordingly, the lowest
+ * possible speed is 4500 kHz / 8 = 562.5 kHz.
+ *
+ * @note This function must be used only if the device has the
+ *       #JAYLINK_DEV_CAP_SWO capability.
+ *
+ * @param[in,out] devh Device handle.
+ * @param[in] mode Capture mode to retrieve speeds for.
+ * @param[out] speed Speed information on success, and undefined on failure.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_PROTO Protocol violation.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR_DEV Unspecified device error.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @since 0.1.0
+ */
+JAYLINK_API int jaylink_swo_get_speeds(struct jaylink_device_handle *devh,
+		enum jaylink_swo_mode mode, struct jaylink_swo_speed *speed)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _swo_get_speeds(devh, mode, speed);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
@@ -41,26 +41,7 @@
 #define TIF_GET_AVAILABLE	0xff
 /** @endcond */
 
-/**
- * Set the target interface speed.
- *
- * @param[in,out] devh Device handle.
- * @param[in] speed Speed in kHz or #JAYLINK_SPEED_ADAPTIVE_CLOCKING for
- *                  adaptive clocking. Speed of 0 kHz is not allowed and
- *                  adaptive clocking must only be used if the device has the
- *                  #JAYLINK_DEV_CAP_ADAPTIVE_CLOCKING capability.
- *
- * @retval JAYLINK_OK Success.
- * @retval JAYLINK_ERR_ARG Invalid arguments.
- * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
- * @retval JAYLINK_ERR_IO Input/output error.
- * @retval JAYLINK_ERR Other error conditions.
- *
- * @see jaylink_get_speeds()
- *
- * @since 0.1.0
- */
-JAYLINK_API int jaylink_set_speed(struct jaylink_device_handle *devh,
+static int _set_speed(struct jaylink_device_handle *devh,
 		uint16_t speed)
 {
 	int ret;
@@ -94,38 +75,40 @@ JAYLINK_API int jaylink_set_speed(struct jaylink_device_handle *devh,
 }
 
 /**
- * Retrieve target interface speeds.
- *
- * The speeds are applicable for the currently selected target interface only
- * and calculated as follows:
- *
- * @par
- * <tt>speeds = @a freq / n</tt> with <tt>n >= @a div</tt>, where @p n is an
- * integer
- *
- * Assuming, for example, a base frequency @a freq of 4 MHz and a minimum
- * divider @a div of 4 then the highest possible target interface speed is
- * 4 MHz / 4 = 1 MHz. The next highest speed is 800 kHz for a divider of 5, and
- * so on.
- *
- * @note This function must only be used if the device has the
- *       #JAYLINK_DEV_CAP_GET_SPEEDS capability.
+ * Set the target interface speed.
  *
  * @param[in,out] devh Device handle.
- * @param[out] speed Speed information on success, and undefined on failure.
+ * @param[in] speed Speed in kHz or #JAYLINK_SPEED_ADAPTIVE_CLOCKING for
+ *                  adaptive clocking. Speed of 0 kHz is not allowed and
+ *                  adaptive clocking must only be used if the device has the
+ *                  #JAYLINK_DEV_CAP_ADAPTIVE_CLOCKING capability.
  *
  * @retval JAYLINK_OK Success.
  * @retval JAYLINK_ERR_ARG Invalid arguments.
  * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
- * @retval JAYLINK_ERR_PROTO Protocol violation.
  * @retval JAYLINK_ERR_IO Input/output error.
  * @retval JAYLINK_ERR Other error conditions.
  *
- * @see jaylink_select_interface()
+ * @see jaylink_get_speeds()
  *
  * @since 0.1.0
  */
-JAYLINK_API int jaylink_get_speeds(struct jaylink_device_handle *devh,
+JAYLINK_API int jaylink_set_speed(struct jaylink_device_handle *devh,
+		uint16_t speed)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _set_speed(devh, speed);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+static int _get_speeds(struct jaylink_device_handle *devh,
 		struct jaylink_speed *speed)
 {
 	int ret;
@@ -177,30 +160,53 @@ JAYLINK_API int jaylink_get_speeds(struct jaylink_device_handle *devh,
 }
 
 /**
- * Select the target interface.
+ * Retrieve target interface speeds.
  *
- * @note This function must only be used if the device has the
- *       #JAYLINK_DEV_CAP_SELECT_TIF capability.
+ * The speeds are applicable for the currently selected target interface only
+ * and calculated as follows:
  *
- * @warning This function may return a value for @p prev_iface which is not
- *          covered by #jaylink_target_interface.
+ * @par
+ * <tt>speeds = @a freq / n</tt> with <tt>n >= @a div</tt>, where @p n is an
+ * integer
+ *
+ * Assuming, for example, a base frequency @a freq of 4 MHz and a minimum
+ * divider @a div of 4 then the highest possible target interface speed is
+ * 4 MHz / 4 = 1 MHz. The next highest speed is 800 kHz for a divider of 5, and
+ * so on.
+ *
+ * @note This function must only be used if the device has the
+ *       #JAYLINK_DEV_CAP_GET_SPEEDS capability.
  *
  * @param[in,out] devh Device handle.
- * @param[in] iface Target interface to select.
- * @param[out] prev_iface Previously selected target interface on success, and
- *                        undefined on failure. Can be NULL.
+ * @param[out] speed Speed information on success, and undefined on failure.
  *
  * @retval JAYLINK_OK Success.
  * @retval JAYLINK_ERR_ARG Invalid arguments.
  * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_PROTO Protocol violation.
  * @retval JAYLINK_ERR_IO Input/output error.
  * @retval JAYLINK_ERR Other error conditions.
  *
- * @see jaylink_get_available_interfaces()
+ * @see jaylink_select_interface()
  *
  * @since 0.1.0
  */
-JAYLINK_API int jaylink_select_interface(struct jaylink_device_handle *devh,
+JAYLINK_API int jaylink_get_speeds(struct jaylink_device_handle *devh,
+		struct jaylink_speed *speed)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _get_speeds(devh, speed);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+static int _select_interface(struct jaylink_device_handle *devh,
 		enum jaylink_target_interface iface,
 		enum jaylink_target_interface *prev_iface)
 {
@@ -257,18 +263,18 @@ JAYLINK_API int jaylink_select_interface(struct jaylink_device_handle *devh,
 }
 
 /**
- * Retrieve the available target interfaces.
- *
- * The target interfaces are stored in a 32-bit bit field where each individual
- * bit represents a target interface. A set bit indicates an available target
- * interface. See #jaylink_target_interface for a description of the target
- * interfaces and their bit positions.
+ * Select the target interface.
  *
  * @note This function must only be used if the device has the
  *       #JAYLINK_DEV_CAP_SELECT_TIF capability.
  *
+ * @warning This function may return a value for @p prev_iface which is not
+ *          covered by #jaylink_target_interface.
+ *
  * @param[in,out] devh Device handle.
- * @param[out] ifaces Target interfaces on success, and undefined on failure.
+ * @param[in] iface Target interface to select.
+ * @param[out] prev_iface Previously selected target interface on success, and
+ *                        undefined on failure. Can be NULL.
  *
  * @retval JAYLINK_OK Success.
  * @retval JAYLINK_ERR_ARG Invalid arguments.
@@ -276,11 +282,27 @@ JAYLINK_API int jaylink_select_interface(struct jaylink_device_handle *devh,
  * @retval JAYLINK_ERR_IO Input/output error.
  * @retval JAYLINK_ERR Other error conditions.
  *
- * @see jaylink_select_interface()
+ * @see jaylink_get_available_interfaces()
  *
  * @since 0.1.0
  */
-JAYLINK_API int jaylink_get_available_interfaces(
+JAYLINK_API int jaylink_select_interface(struct jaylink_device_handle *devh,
+		enum jaylink_target_interface iface,
+		enum jaylink_target_interface *prev_iface)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _select_interface(devh, iface, prev_iface);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+static int _get_available_interfaces(
 		struct jaylink_device_handle *devh, uint32_t *ifaces)
 {
 	int ret;
@@ -324,17 +346,18 @@ JAYLINK_API int jaylink_get_available_interfaces(
 }
 
 /**
- * Retrieve the selected target interface.
+ * Retrieve the available target interfaces.
+ *
+ * The target interfaces are stored in a 32-bit bit field where each individual
+ * bit represents a target interface. A set bit indicates an available target
+ * interface. See #jaylink_target_interface for a description of the target
+ * interfaces and their bit positions.
  *
  * @note This function must only be used if the device has the
  *       #JAYLINK_DEV_CAP_SELECT_TIF capability.
  *
- * @warning This function may return a value for @p iface which is not covered
- *          by #jaylink_target_interface.
- *
  * @param[in,out] devh Device handle.
- * @param[out] iface Selected target interface on success, and undefined on
- *                   failure.
+ * @param[out] ifaces Target interfaces on success, and undefined on failure.
  *
  * @retval JAYLINK_OK Success.
  * @retval JAYLINK_ERR_ARG Invalid arguments.
@@ -346,7 +369,22 @@ JAYLINK_API int jaylink_get_available_interfaces(
  *
  * @since 0.1.0
  */
-JAYLINK_API int jaylink_get_selected_interface(
+JAYLINK_API int jaylink_get_available_interfaces(
+		struct jaylink_device_handle *devh, uint32_t *ifaces)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _get_available_interfaces(devh, ifaces);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+static int _get_selected_interface(
 		struct jaylink_device_handle *devh,
 		enum jaylink_target_interface *iface)
 {
@@ -391,9 +429,17 @@ JAYLINK_API int jaylink_get_selected_interface(
 }
 
 /**
- * Clear the target reset signal.
+ * Retrieve the selected target interface.
+ *
+ * @note This function must only be used if the device has the
+ *       #JAYLINK_DEV_CAP_SELECT_TIF capability.
+ *
+ * @warning This function may return a value for @p iface which is not covered
+ *          by #jaylink_target_interface.
  *
  * @param[in,out] devh Device handle.
+ * @param[out] iface Selected target interface on success, and undefined on
+ *                   failure.
  *
  * @retval JAYLINK_OK Success.
  * @retval JAYLINK_ERR_ARG Invalid arguments.
@@ -401,9 +447,27 @@ JAYLINK_API int jaylink_get_selected_interface(
  * @retval JAYLINK_ERR_IO Input/output error.
  * @retval JAYLINK_ERR Other error conditions.
  *
+ * @see jaylink_select_interface()
+ *
  * @since 0.1.0
  */
-JAYLINK_API int jaylink_clear_reset(struct jaylink_device_handle *devh)
+JAYLINK_API int jaylink_get_selected_interface(
+		struct jaylink_device_handle *devh,
+		enum jaylink_target_interface *iface)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _get_selected_interface(devh, iface);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+static int _clear_reset(struct jaylink_device_handle *devh)
 {
 	int ret;
 	struct jaylink_context *ctx;
@@ -435,7 +499,7 @@ JAYLINK_API int jaylink_clear_reset(struct jaylink_device_handle *devh)
 }
 
 /**
- * Set the target reset signal.
+ * Clear the target reset signal.
  *
  * @param[in,out] devh Device handle.
  *
@@ -447,7 +511,21 @@ JAYLINK_API int jaylink_clear_reset(struct jaylink_device_handle *devh)
  *
  * @since 0.1.0
  */
-JAYLINK_API int jaylink_set_reset(struct jaylink_device_handle *devh)
+JAYLINK_API int jaylink_clear_reset(struct jaylink_device_handle *devh)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _clear_reset(devh);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+static int _set_reset(struct jaylink_device_handle *devh)
 {
 	int ret;
 	struct jaylink_context *ctx;
@@ -479,17 +557,9 @@ JAYLINK_API int jaylink_set_reset(struct jaylink_device_handle *devh)
 }
 
 /**
- * Set the target power supply.
- *
- * If enabled, the target is supplied with 5 V from pin 19 of the 20-pin
- * JTAG / SWD connector.
- *
- * @note This function must only be used if the device has the
- *       #JAYLINK_DEV_CAP_SET_TARGET_POWER capability.
+ * Set the target reset signal.
  *
  * @param[in,out] devh Device handle.
- * @param[in] enable Determines whether to enable or disable the target power
- *                   supply.
  *
  * @retval JAYLINK_OK Success.
  * @retval JAYLINK_ERR_ARG Invalid arguments.
@@ -499,7 +569,21 @@ JAYLINK_API int jaylink_set_reset(struct jaylink_device_handle *devh)
  *
  * @since 0.1.0
  */
-JAYLINK_API int jaylink_set_target_power(struct jaylink_device_handle *devh,
+JAYLINK_API int jaylink_set_reset(struct jaylink_device_handle *devh)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _set_reset(devh);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+static int _set_target_power(struct jaylink_device_handle *devh,
 		bool enable)
 {
 	int ret;
@@ -531,3 +615,81 @@ JAYLINK_API int jaylink_set_target_power(struct jaylink_device_handle *devh,
 
 	return JAYLINK_OK;
 }
+
+/**
+ * Set the target power supply.
+ *
+ * If enabled, the target is supplied with 5 V from pin 19 of the 20-pin
+ * JTAG / SWD connector.
+ *
+ * @note This function must only be used if the device has the
+ *       #JAYLINK_DEV_CAP_SET_TARGET_POWER capability.
+ *
+ * @param[in,out] devh Device handle.
+ * @param[in] enable Determines whether to enable or disable the target power
+ *                   supply.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @since 0.1.0
+ */
+JAYLINK_API int jaylink_set_target_power(struct jaylink_device_handle *devh,
+		bool enable)
+{
+	int ret;
+
+	if (!devh)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = _set_target_power(devh, enable);
+	thread_mutex_unlock(&devh->lock);
+
+	return ret;
+}
+
+/**
+ * Add the clearing of the target reset signal to a command queue.
+ *
+ * @param[in,out] queue Queue.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @see jaylink_queue_execute()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_queue_clear_reset(struct jaylink_queue *queue)
+{
+	if (!queue)
+		return JAYLINK_ERR_ARG;
+
+	return queue_add_command(queue, CMD_CLEAR_RESET);
+}
+
+/**
+ * Add the setting of the target reset signal to a command queue.
+ *
+ * @param[in,out] queue Queue.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @see jaylink_queue_execute()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_queue_set_reset(struct jaylink_queue *queue)
+{
+	if (!queue)
+		return JAYLINK_ERR_ARG;
+
+	return queue_add_command(queue, CMD_SET_RESET);
+}
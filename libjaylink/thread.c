@@ -0,0 +1,226 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+#include <stdbool.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "libjaylink-internal.h"
+
+/**
+ * @file
+ *
+ * Threads and thread synchronization.
+ *
+ * The atomic operations are based on the GCC built-in functions, which are
+ * also provided by Clang and MinGW.
+ */
+
+/**
+ * Initialize a mutex.
+ *
+ * The mutex is recursive, which means that it can be locked by the thread
+ * that holds it again. It must be unlocked as often as it was locked.
+ *
+ * @param[out] mutex Mutex.
+ *
+ * @return Whether the mutex was initialized successfully.
+ */
+JAYLINK_PRIV bool thread_mutex_init(struct thread_mutex *mutex)
+{
+#ifdef _WIN32
+	/* Critical sections are always recursive. */
+	InitializeCriticalSection(&mutex->cs);
+#else
+	pthread_mutexattr_t attr;
+	int ret;
+
+	if (pthread_mutexattr_init(&attr))
+		return false;
+
+	ret = pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+
+	if (!ret)
+		ret = pthread_mutex_init(&mutex->mutex, &attr);
+
+	pthread_mutexattr_destroy(&attr);
+
+	if (ret)
+		return false;
+#endif
+
+	return true;
+}
+
+/**
+ * Destroy a mutex.
+ *
+ * @param[in,out] mutex Mutex. It must not be locked.
+ */
+JAYLINK_PRIV void thread_mutex_destroy(struct thread_mutex *mutex)
+{
+#ifdef _WIN32
+	DeleteCriticalSection(&mutex->cs);
+#else
+	pthread_mutex_destroy(&mutex->mutex);
+#endif
+}
+
+/**
+ * Lock a mutex.
+ *
+ * @param[in,out] mutex Mutex.
+ */
+JAYLINK_PRIV void thread_mutex_lock(struct thread_mutex *mutex)
+{
+#ifdef _WIN32
+	EnterCriticalSection(&mutex->cs);
+#else
+	pthread_mutex_lock(&mutex->mutex);
+#endif
+}
+
+/**
+ * Unlock a mutex.
+ *
+ * @param[in,out] mutex Mutex.
+ */
+JAYLINK_PRIV void thread_mutex_unlock(struct thread_mutex *mutex)
+{
+#ifdef _WIN32
+	LeaveCriticalSection(&mutex->cs);
+#else
+	pthread_mutex_unlock(&mutex->mutex);
+#endif
+}
+
+/**
+ * Increment a value atomically.
+ *
+ * @param[in,out] value Value.
+ *
+ * @return The incremented value.
+ */
+JAYLINK_PRIV size_t thread_atomic_inc(size_t *value)
+{
+	return __atomic_add_fetch(value, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Decrement a value atomically.
+ *
+ * @param[in,out] value Value.
+ *
+ * @return The decremented value.
+ */
+JAYLINK_PRIV size_t thread_atomic_dec(size_t *value)
+{
+	return __atomic_sub_fetch(value, 1, __ATOMIC_ACQ_REL);
+}
+
+/**
+ * Decrement a value atomically unless it is one.
+ *
+ * This allows to release a reference without a lock unless it is the last
+ * one.
+ *
+ * @param[in,out] value Value.
+ *
+ * @return Whether the value was decremented.
+ */
+JAYLINK_PRIV bool thread_atomic_dec_unless_one(size_t *value)
+{
+	size_t tmp;
+
+	tmp = __atomic_load_n(value, __ATOMIC_RELAXED);
+
+	while (tmp > 1) {
+		if (__atomic_compare_exchange_n(value, &tmp, tmp - 1, true,
+				__ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			return true;
+	}
+
+	return false;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI thread_start(LPVOID arg)
+#else
+static void *thread_start(void *arg)
+#endif
+{
+	struct thread *thread;
+
+	thread = arg;
+	thread->function(thread->arg);
+
+#ifdef _WIN32
+	return 0;
+#else
+	return NULL;
+#endif
+}
+
+/**
+ * Create a thread.
+ *
+ * @param[out] thread Thread. The structure must remain valid until the thread
+ *                    is joined.
+ * @param[in] function Function to be executed by the thread.
+ * @param[in,out] arg Argument passed to the function.
+ *
+ * @return Whether the thread was created successfully.
+ */
+JAYLINK_PRIV bool thread_create(struct thread *thread,
+		thread_function function, void *arg)
+{
+	thread->function = function;
+	thread->arg = arg;
+
+#ifdef _WIN32
+	thread->handle = CreateThread(NULL, 0, thread_start, thread, 0, NULL);
+
+	if (!thread->handle)
+		return false;
+#else
+	if (pthread_create(&thread->thread, NULL, thread_start, thread))
+		return false;
+#endif
+
+	return true;
+}
+
+/**
+ * Wait for a thread to terminate and release its resources.
+ *
+ * @param[in,out] thread Thread.
+ */
+JAYLINK_PRIV void thread_join(struct thread *thread)
+{
+#ifdef _WIN32
+	WaitForSingleObject(thread->handle, INFINITE);
+	CloseHandle(thread->handle);
+#else
+	pthread_join(thread->thread, NULL);
+#endif
+}
@@ -38,7 +38,9 @@
  * Open a device.
  *
  * This function must be called before any other function of the transport
- * abstraction layer for the given device handle is called.
+ * abstraction layer for the given device handle is called. It selects the
+ * transport operations of the device handle according to the host interface of
+ * the device.
  *
  * @param[in,out] devh Device handle.
  *
@@ -48,16 +50,22 @@
  */
 JAYLINK_PRIV int transport_open(struct jaylink_device_handle *devh)
 {
-	int ret;
-
+	/*
+	 * Select the transport operations once for the lifetime of the device
+	 * handle in order to avoid the host interface dispatch on every
+	 * operation.
+	 */
 	switch (devh->dev->iface) {
 #ifdef HAVE_LIBUSB
 	case JAYLINK_HIF_USB:
-		ret = transport_usb_open(devh);
+		devh->transport = &transport_usb_ops;
 		break;
 #endif
 	case JAYLINK_HIF_TCP:
-		ret = transport_tcp_open(devh);
+		devh->transport = &transport_tcp_ops;
+		break;
+	case JAYLINK_HIF_CUSTOM:
+		devh->transport = &transport_custom_ops;
 		break;
 	default:
 		log_err(devh->dev->ctx, "BUG: Invalid host interface: %u.",
@@ -65,7 +73,11 @@ JAYLINK_PRIV int transport_open(struct jaylink_device_handle *devh)
 		return JAYLINK_ERR;
 	}
 
-	return ret;
+	devh->batch = false;
+	devh->capture = NULL;
+	stats_init(devh);
+
+	return devh->transport->open(devh);
 }
 
 /**
@@ -81,24 +93,9 @@ JAYLINK_PRIV int transport_open(struct jaylink_device_handle *devh)
  */
 JAYLINK_PRIV int transport_close(struct jaylink_device_handle *devh)
 {
-	int ret;
+	capture_close(devh);
 
-	switch (devh->dev->iface) {
-#ifdef HAVE_LIBUSB
-	case JAYLINK_HIF_USB:
-		ret = transport_usb_close(devh);
-		break;
-#endif
-	case JAYLINK_HIF_TCP:
-		ret = transport_tcp_close(devh);
-		break;
-	default:
-		log_err(devh->dev->ctx, "BUG: Invalid host interface: %u.",
-			devh->dev->iface);
-		return JAYLINK_ERR;
-	}
-
-	return ret;
+	return devh->transport->close(devh);
 }
 
 /**
@@ -121,22 +118,17 @@ JAYLINK_PRIV int transport_start_write(struct jaylink_device_handle *devh,
 {
 	int ret;
 
-	switch (devh->dev->iface) {
-#ifdef HAVE_LIBUSB
-	case JAYLINK_HIF_USB:
-		ret = transport_usb_start_write(devh, length, has_command);
-		break;
-#endif
-	case JAYLINK_HIF_TCP:
-		ret = transport_tcp_start_write(devh, length, has_command);
-		break;
-	default:
-		log_err(devh->dev->ctx, "BUG: Invalid host interface: %u.",
-			devh->dev->iface);
-		return JAYLINK_ERR;
-	}
+	ret = devh->transport->start_write(devh, length, has_command);
 
-	return ret;
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	if (has_command)
+		stats_start_command(devh);
+
+	capture_start_write(devh, length, has_command);
+
+	return JAYLINK_OK;
 }
 
 /**
@@ -157,20 +149,10 @@ JAYLINK_PRIV int transport_start_read(struct jaylink_device_handle *devh,
 {
 	int ret;
 
-	switch (devh->dev->iface) {
-#ifdef HAVE_LIBUSB
-	case JAYLINK_HIF_USB:
-		ret = transport_usb_start_read(devh, length);
-		break;
-#endif
-	case JAYLINK_HIF_TCP:
-		ret = transport_tcp_start_read(devh, length);
-		break;
-	default:
-		log_err(devh->dev->ctx, "BUG: Invalid host interface: %u.",
-			devh->dev->iface);
-		return JAYLINK_ERR;
-	}
+	ret = devh->transport->start_read(devh, length);
+
+	if (ret == JAYLINK_OK)
+		capture_start_read(devh, length);
 
 	return ret;
 }
@@ -200,24 +182,18 @@ JAYLINK_PRIV int transport_start_write_read(struct jaylink_device_handle *devh,
 {
 	int ret;
 
-	switch (devh->dev->iface) {
-#ifdef HAVE_LIBUSB
-	case JAYLINK_HIF_USB:
-		ret = transport_usb_start_write_read(devh, write_length,
-			read_length, has_command);
-		break;
-#endif
-	case JAYLINK_HIF_TCP:
-		ret = transport_tcp_start_write_read(devh, write_length,
-			read_length, has_command);
-		break;
-	default:
-		log_err(devh->dev->ctx, "BUG: Invalid host interface: %u.",
-			devh->dev->iface);
-		return JAYLINK_ERR;
-	}
+	ret = devh->transport->start_write_read(devh, write_length,
+		read_length, has_command);
 
-	return ret;
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	if (has_command)
+		stats_start_command(devh);
+
+	capture_start_write_read(devh, write_length, read_length, has_command);
+
+	return JAYLINK_OK;
 }
 
 /**
@@ -248,22 +224,55 @@ JAYLINK_PRIV int transport_write(struct jaylink_device_handle *devh,
 {
 	int ret;
 
-	switch (devh->dev->iface) {
-#ifdef HAVE_LIBUSB
-	case JAYLINK_HIF_USB:
-		ret = transport_usb_write(devh, buffer, length);
-		break;
-#endif
-	case JAYLINK_HIF_TCP:
-		ret = transport_tcp_write(devh, buffer, length);
-		break;
-	default:
-		log_err(devh->dev->ctx, "BUG: Invalid host interface: %u.",
-			devh->dev->iface);
-		return JAYLINK_ERR;
+	ret = devh->transport->write(devh, buffer, length);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	stats_write(devh, buffer, length);
+	capture_write(devh, buffer, length);
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Write data from multiple buffers to a device.
+ *
+ * This function is equivalent to consecutive calls of transport_write() for
+ * each buffer. However, depending on the host interface, the data is sent to
+ * the device directly from the buffers without copying it into the internal
+ * buffer first.
+ *
+ * @param[in,out] devh Device handle.
+ * @param[in] iov Array of buffers to write data from.
+ * @param[in] iovcnt Number of buffers, at most #TRANSPORT_MAX_IOVEC.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR Other error conditions.
+ */
+JAYLINK_PRIV int transport_writev(struct jaylink_device_handle *devh,
+		const struct transport_iovec *iov, size_t iovcnt)
+{
+	int ret;
+	size_t i;
+
+	if (!iovcnt || iovcnt > TRANSPORT_MAX_IOVEC)
+		return JAYLINK_ERR_ARG;
+
+	ret = devh->transport->writev(devh, iov, iovcnt);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	for (i = 0; i < iovcnt; i++) {
+		stats_write(devh, iov[i].buffer, iov[i].length);
+		capture_write(devh, iov[i].buffer, iov[i].length);
 	}
 
-	return ret;
+	return JAYLINK_OK;
 }
 
 /**
@@ -290,20 +299,153 @@ JAYLINK_PRIV int transport_read(struct jaylink_device_handle *devh,
 {
 	int ret;
 
-	switch (devh->dev->iface) {
-#ifdef HAVE_LIBUSB
-	case JAYLINK_HIF_USB:
-		ret = transport_usb_read(devh, buffer, length);
-		break;
-#endif
-	case JAYLINK_HIF_TCP:
-		ret = transport_tcp_read(devh, buffer, length);
-		break;
-	default:
-		log_err(devh->dev->ctx, "BUG: Invalid host interface: %u.",
-			devh->dev->iface);
-		return JAYLINK_ERR;
-	}
+	ret = devh->transport->read(devh, buffer, length);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	stats_read(devh, length);
+	capture_read(devh, buffer, length);
+
+	return JAYLINK_OK;
+}
+
+/**
+ * Start a batch of write operations for a device.
+ *
+ * In batch mode, the data of all subsequent write operations is collected and
+ * sent to the device at once when transport_end_batch() is called. This
+ * allows to send several commands to the device with a single transfer. Only
+ * transport_start_write() and transport_write() must be used in batch mode.
+ *
+ * @note Depending on the host interface, the data may be sent to the device
+ *       before the batch is ended.
+ *
+ * @param[in,out] devh Device handle.
+ */
+JAYLINK_PRIV void transport_start_batch(struct jaylink_device_handle *devh)
+{
+	devh->batch = true;
+}
+
+/**
+ * End a batch of write operations for a device.
+ *
+ * @param[in,out] devh Device handle.
+ * @param[in] discard Determines whether the collected data should be
+ *                    discarded instead of being sent to the device.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG The batch was discarded or the last write operation
+ *                         of the batch is incomplete.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR Other error conditions.
+ */
+JAYLINK_PRIV int transport_end_batch(struct jaylink_device_handle *devh,
+		bool discard)
+{
+	devh->batch = false;
+
+	return devh->transport->end_batch(devh, discard);
+}
+
+/**
+ * Send the data of a batch of write operations without blocking.
+ *
+ * This function ends a batch like transport_end_batch() but sends the
+ * collected data only as far as possible without blocking. It must be called
+ * again until the data is sent completely, usually when one of the file
+ * descriptors of the device handle is ready. No other operation must be
+ * started in the meantime.
+ *
+ * @param[in,out] devh Device handle.
+ * @param[out] done Indicates whether the data was sent completely on success,
+ *                  and undefined on failure.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG The last write operation of the batch is
+ *                         incomplete.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR Other error conditions.
+ */
+JAYLINK_PRIV int transport_progress_batch(struct jaylink_device_handle *devh,
+		bool *done)
+{
+	devh->batch = false;
+
+	return devh->transport->progress_batch(devh, done);
+}
+
+/**
+ * Receive the data of a read operation without blocking.
+ *
+ * The data of the read operation started with transport_start_read() is
+ * received into the internal buffer as far as possible without blocking. The
+ * function must be called again until the data is received completely. After
+ * that, the data is read with transport_read() without blocking.
+ *
+ * @param[in,out] devh Device handle.
+ * @param[out] done Indicates whether the data was received completely on
+ *                  success, and undefined on failure.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR Other error conditions.
+ */
+JAYLINK_PRIV int transport_progress_read(struct jaylink_device_handle *devh,
+		bool *done)
+{
+	return devh->transport->progress_read(devh, done);
+}
+
+/**
+ * Get the file descriptors of a device.
+ *
+ * The file descriptors allow to integrate a device into an event loop, for
+ * example based on poll() or epoll. When one of the file descriptors is ready
+ * for the requested events, the operations submitted with
+ * jaylink_queue_submit() make progress with jaylink_queue_progress().
+ *
+ * The events of the file descriptors depend on the current state of the
+ * device handle and therefore they must be retrieved again after each call
+ * of jaylink_queue_progress().
+ *
+ * @note For USB devices, the file descriptors are those of the libusb
+ *       context, which is shared by all devices of the libjaylink context.
+ *       Monitoring them once is sufficient for all USB devices.
+ *
+ * @param[in,out] devh Device handle.
+ * @param[out] fds Array to store the file descriptors on success. Its content
+ *                 is undefined on failure. Can be NULL to query the number of
+ *                 file descriptors only.
+ * @param[in,out] num_fds Number of elements of @p fds. On success, the value
+ *                        gets updated with the number of file descriptors of
+ *                        the device. The value is undefined on failure.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments or @p fds is too small.
+ * @retval JAYLINK_ERR_NOT_SUPPORTED The device has no file descriptors, for
+ *                                   example because it uses a custom
+ *                                   transport.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_get_pollfds(struct jaylink_device_handle *devh,
+		struct jaylink_pollfd *fds, size_t *num_fds)
+{
+	int ret;
+
+	if (!devh || !num_fds)
+		return JAYLINK_ERR_ARG;
+
+	thread_mutex_lock(&devh->lock);
+	ret = devh->transport->get_pollfds(devh, fds, num_fds);
+	thread_mutex_unlock(&devh->lock);
 
 	return ret;
 }
@@ -0,0 +1,400 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libjaylink.h"
+#include "libjaylink-internal.h"
+
+/**
+ * @file
+ *
+ * Transport abstraction layer (custom transport).
+ *
+ * The write operations of a batch are collected in the buffer of the device
+ * handle and passed to the custom transport when the batch is ended. This
+ * allows to discard a batch without sending a part of it. Each write operation
+ * is stored with a header which contains its length and whether it contains a
+ * command.
+ */
+
+/** @cond PRIVATE */
+/** Size of the header of a write operation of a batch in bytes. */
+#define BATCH_HEADER_SIZE	5
+/** @endcond */
+
+static bool adjust_buffer(struct jaylink_device_handle *devh, size_t size)
+{
+	uint8_t *buffer;
+
+	if (size <= devh->buffer_size)
+		return true;
+
+	buffer = realloc(devh->buffer, size);
+
+	if (!buffer) {
+		log_err(devh->dev->ctx, "Failed to adjust buffer size to %zu "
+			"bytes.", size);
+		return false;
+	}
+
+	devh->buffer = buffer;
+	devh->buffer_size = size;
+
+	return true;
+}
+
+static int transport_custom_open(struct jaylink_device_handle *devh)
+{
+	int ret;
+	struct jaylink_device *dev;
+	struct jaylink_context *ctx;
+
+	dev = devh->dev;
+	ctx = dev->ctx;
+
+	log_dbg(ctx, "Trying to open device (custom transport).");
+
+	devh->buffer = NULL;
+	devh->buffer_size = 0;
+	devh->write_length = 0;
+	devh->write_pos = 0;
+
+	if (dev->custom_ops->open) {
+		ret = dev->custom_ops->open(dev->custom_data);
+
+		if (ret != JAYLINK_OK) {
+			log_err(ctx, "Failed to open device: %s.",
+				jaylink_strerror(ret));
+			return ret;
+		}
+	}
+
+	log_dbg(ctx, "Device opened successfully.");
+
+	return JAYLINK_OK;
+}
+
+static int transport_custom_close(struct jaylink_device_handle *devh)
+{
+	int ret;
+	struct jaylink_device *dev;
+	struct jaylink_context *ctx;
+
+	dev = devh->dev;
+	ctx = dev->ctx;
+
+	log_dbg(ctx, "Closing device (custom transport).");
+
+	free(devh->buffer);
+
+	if (dev->custom_ops->close) {
+		ret = dev->custom_ops->close(dev->custom_data);
+
+		if (ret != JAYLINK_OK) {
+			log_err(ctx, "Failed to close device: %s.",
+				jaylink_strerror(ret));
+			return ret;
+		}
+	}
+
+	log_dbg(ctx, "Device closed successfully.");
+
+	return JAYLINK_OK;
+}
+
+static int transport_custom_start_write(struct jaylink_device_handle *devh,
+		size_t length, bool has_command)
+{
+	if (!length)
+		return JAYLINK_ERR_ARG;
+
+	log_dbgio(devh->dev->ctx, "Starting write operation (length = %zu "
+		"bytes).", length);
+
+	if (devh->batch) {
+		if (devh->write_length > 0)
+			log_warn(devh->dev->ctx, "Last write operation was not "
+				"performed.");
+
+		if (!adjust_buffer(devh, devh->write_pos + BATCH_HEADER_SIZE +
+				length))
+			return JAYLINK_ERR_MALLOC;
+
+		buffer_set_u32(devh->buffer, length, devh->write_pos);
+		devh->buffer[devh->write_pos + 4] = has_command;
+		devh->write_pos += BATCH_HEADER_SIZE;
+		devh->write_length = length;
+
+		return JAYLINK_OK;
+	}
+
+	return devh->dev->custom_ops->start_write(devh->dev->custom_data,
+		length, has_command);
+}
+
+static int transport_custom_start_read(struct jaylink_device_handle *devh,
+		size_t length)
+{
+	if (!length)
+		return JAYLINK_ERR_ARG;
+
+	log_dbgio(devh->dev->ctx, "Starting read operation (length = %zu "
+		"bytes).", length);
+
+	return devh->dev->custom_ops->start_read(devh->dev->custom_data,
+		length);
+}
+
+static int transport_custom_start_write_read(
+		struct jaylink_device_handle *devh, size_t write_length,
+		size_t read_length, bool has_command)
+{
+	if (!read_length || !write_length)
+		return JAYLINK_ERR_ARG;
+
+	log_dbgio(devh->dev->ctx, "Starting write / read operation (length = "
+		"%zu / %zu bytes).", write_length, read_length);
+
+	return devh->dev->custom_ops->start_write_read(devh->dev->custom_data,
+		write_length, read_length, has_command);
+}
+
+/* Store the data of a write operation of a batch in the buffer. */
+static int write_batch(struct jaylink_device_handle *devh,
+		const uint8_t *buffer, size_t length)
+{
+	if (length > devh->write_length) {
+		log_err(devh->dev->ctx, "Requested to write %zu bytes but only "
+			"%zu bytes are expected for the write operation.",
+			length, devh->write_length);
+		return JAYLINK_ERR_ARG;
+	}
+
+	memcpy(devh->buffer + devh->write_pos, buffer, length);
+
+	devh->write_length -= length;
+	devh->write_pos += length;
+
+	log_dbgio(devh->dev->ctx, "Wrote %zu bytes into buffer.", length);
+
+	return JAYLINK_OK;
+}
+
+static int transport_custom_write(struct jaylink_device_handle *devh,
+		const uint8_t *buffer, size_t length)
+{
+	if (devh->batch)
+		return write_batch(devh, buffer, length);
+
+	return devh->dev->custom_ops->write(devh->dev->custom_data, buffer,
+		length);
+}
+
+static int transport_custom_writev(struct jaylink_device_handle *devh,
+		const struct transport_iovec *iov, size_t iovcnt)
+{
+	int ret;
+	size_t i;
+
+	for (i = 0; i < iovcnt; i++) {
+		if (!iov[i].length)
+			continue;
+
+		ret = transport_custom_write(devh, iov[i].buffer,
+			iov[i].length);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+	}
+
+	return JAYLINK_OK;
+}
+
+static int transport_custom_read(struct jaylink_device_handle *devh,
+		uint8_t *buffer, size_t length)
+{
+	return devh->dev->custom_ops->read(devh->dev->custom_data, buffer,
+		length);
+}
+
+static int transport_custom_end_batch(struct jaylink_device_handle *devh,
+		bool discard)
+{
+	int ret;
+	const struct jaylink_transport_ops *ops;
+	size_t length;
+	size_t pos;
+	size_t tmp;
+
+	ops = devh->dev->custom_ops;
+	length = devh->write_pos;
+	devh->write_pos = 0;
+
+	if (devh->write_length > 0 && !discard) {
+		log_err(devh->dev->ctx, "Last write operation of the batch is "
+			"incomplete.");
+		discard = true;
+	}
+
+	devh->write_length = 0;
+
+	if (discard) {
+		log_dbgio(devh->dev->ctx, "Discarded %zu bytes of the batch.",
+			length);
+		return JAYLINK_ERR_ARG;
+	}
+
+	/* Pass the write operations of the batch to the custom transport. */
+	for (pos = 0; pos < length; pos += BATCH_HEADER_SIZE + tmp) {
+		tmp = buffer_get_u32(devh->buffer, pos);
+		ret = ops->start_write(devh->dev->custom_data, tmp,
+			devh->buffer[pos + 4]);
+
+		if (ret == JAYLINK_OK)
+			ret = ops->write(devh->dev->custom_data,
+				devh->buffer + pos + BATCH_HEADER_SIZE, tmp);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+	}
+
+	return JAYLINK_OK;
+}
+
+/*
+ * The operations of a custom transport may block. Therefore, operations
+ * without blocking are performed as blocking operations and complete
+ * immediately.
+ */
+static int transport_custom_progress_batch(struct jaylink_device_handle *devh,
+		bool *done)
+{
+	*done = true;
+
+	return transport_custom_end_batch(devh, false);
+}
+
+static int transport_custom_progress_read(struct jaylink_device_handle *devh,
+		bool *done)
+{
+	(void)devh;
+
+	/* The data is received by the read operations of the transport. */
+	*done = true;
+
+	return JAYLINK_OK;
+}
+
+static int transport_custom_get_pollfds(struct jaylink_device_handle *devh,
+		struct jaylink_pollfd *fds, size_t *num_fds)
+{
+	(void)devh;
+	(void)fds;
+	(void)num_fds;
+
+	return JAYLINK_ERR_NOT_SUPPORTED;
+}
+
+/** @private */
+JAYLINK_PRIV const struct transport_ops transport_custom_ops = {
+	.open = &transport_custom_open,
+	.close = &transport_custom_close,
+	.start_write = &transport_custom_start_write,
+	.start_read = &transport_custom_start_read,
+	.start_write_read = &transport_custom_start_write_read,
+	.write = &transport_custom_write,
+	.writev = &transport_custom_writev,
+	.read = &transport_custom_read,
+	.end_batch = &transport_custom_end_batch,
+	.progress_batch = &transport_custom_progress_batch,
+	.progress_read = &transport_custom_progress_read,
+	.get_pollfds = &transport_custom_get_pollfds
+};
+
+/**
+ * Register a custom transport.
+ *
+ * A device instance with host interface #JAYLINK_HIF_CUSTOM is allocated for
+ * the transport. The device instance can be opened with jaylink_open() and
+ * used like any other device instance. It is not part of the device discovery
+ * and therefore not returned by jaylink_get_devices().
+ *
+ * @param[in,out] ctx libjaylink context.
+ * @param[in] ops Operations of the transport. The structure must remain valid
+ *                as long as the device instance exists.
+ * @param[in] user_data User data to be passed to the operations. If the
+ *                      device instance is opened more than once, the user
+ *                      data is shared among all device handles.
+ * @param[out] dev Newly allocated device instance on success, and undefined
+ *                 on failure. The device instance must be unreferenced by the
+ *                 caller with jaylink_unref_device().
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_transport_register(struct jaylink_context *ctx,
+		const struct jaylink_transport_ops *ops, void *user_data,
+		struct jaylink_device **dev)
+{
+	struct jaylink_device *tmp;
+
+	if (!ctx || !ops || !dev)
+		return JAYLINK_ERR_ARG;
+
+	if (!ops->start_write || !ops->start_read || !ops->start_write_read)
+		return JAYLINK_ERR_ARG;
+
+	if (!ops->write || !ops->read)
+		return JAYLINK_ERR_ARG;
+
+	tmp = device_allocate(ctx);
+
+	if (!tmp) {
+		log_err(ctx, "Device instance malloc failed.");
+		return JAYLINK_ERR_MALLOC;
+	}
+
+	tmp->iface = JAYLINK_HIF_CUSTOM;
+	tmp->valid_serial_number = false;
+	tmp->has_mac_address = false;
+	tmp->has_product_name = false;
+	tmp->has_nickname = false;
+	tmp->has_hw_version = false;
+	tmp->custom_ops = ops;
+	tmp->custom_data = user_data;
+
+	if (!device_add(tmp)) {
+		log_err(ctx, "Failed to add device instance.");
+		free(tmp);
+		return JAYLINK_ERR_MALLOC;
+	}
+
+	log_dbg(ctx, "Registered custom transport.");
+
+	*dev = tmp;
+
+	return JAYLINK_OK;
+}
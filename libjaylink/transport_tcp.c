@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
@@ -31,6 +32,7 @@
 #include <sys/socket.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <arpa/inet.h>
 #endif
 
 #include "libjaylink.h"
@@ -59,9 +61,15 @@
 #define RECV_TIMEOUT	5000
 /** Timeout of a send operation in milliseconds. */
 #define SEND_TIMEOUT	5000
+/**
+ * Timeout of an operation without blocking in milliseconds.
+ *
+ * The time is measured since the last data transfer of the operation.
+ */
+#define PROGRESS_TIMEOUT	RECV_TIMEOUT
 
-/** String of the port number for the J-Link TCP/IP protocol. */
-#define PORT_STRING	"19020"
+/** Maximum length of the port number string including null-terminator. */
+#define PORT_STRING_MAX_LENGTH	6
 
 /** Size of the server's hello message in bytes. */
 #define SERVER_HELLO_SIZE	4
@@ -93,6 +101,10 @@ static int initialize_handle(struct jaylink_device_handle *devh)
 	devh->write_length = 0;
 	devh->write_pos = 0;
 
+	devh->sock_nonblocking = false;
+	devh->batch_pos = 0;
+	devh->progress_time = 0;
+
 	return JAYLINK_OK;
 }
 
@@ -101,17 +113,39 @@ static void cleanup_handle(struct jaylink_device_handle *devh)
 	free(devh->buffer);
 }
 
+static int set_blocking(struct jaylink_device_handle *devh, bool blocking)
+{
+	if (devh->sock_nonblocking != blocking)
+		return JAYLINK_OK;
+
+	if (!socket_set_blocking(devh->sock, blocking)) {
+		log_err(devh->dev->ctx, "Failed to set socket blocking mode.");
+		return JAYLINK_ERR_IO;
+	}
+
+	devh->sock_nonblocking = !blocking;
+
+	return JAYLINK_OK;
+}
+
 static int _recv(struct jaylink_device_handle *devh, uint8_t *buffer,
 		size_t length)
 {
+	int ret;
 	struct jaylink_context *ctx;
 	size_t tmp;
 
 	ctx = devh->dev->ctx;
+	ret = set_blocking(devh, true);
+
+	if (ret != JAYLINK_OK)
+		return ret;
 
 	while (length > 0) {
 		tmp = length;
 
+		devh->stats.tcp_recv_calls++;
+
 		if (!socket_recv(devh->sock, buffer, &tmp, 0)) {
 			log_err(ctx, "Failed to receive data from device.");
 			return JAYLINK_ERR_IO;
@@ -224,7 +258,7 @@ static int set_socket_timeouts(struct jaylink_device_handle *devh)
 	return JAYLINK_OK;
 }
 
-JAYLINK_PRIV int transport_tcp_open(struct jaylink_device_handle *devh)
+static int transport_tcp_open(struct jaylink_device_handle *devh)
 {
 	int ret;
 	struct jaylink_context *ctx;
@@ -233,6 +267,7 @@ JAYLINK_PRIV int transport_tcp_open(struct jaylink_device_handle *devh)
 	struct addrinfo *info;
 	struct addrinfo *rp;
 	int sock;
+	char port[PORT_STRING_MAX_LENGTH];
 
 	dev = devh->dev;
 	ctx = dev->ctx;
@@ -252,7 +287,8 @@ JAYLINK_PRIV int transport_tcp_open(struct jaylink_device_handle *devh)
 	hints.ai_socktype = SOCK_STREAM;
 	hints.ai_protocol = IPPROTO_TCP;
 
-	ret = getaddrinfo(dev->ipv4_address, PORT_STRING, &hints, &info);
+	snprintf(port, sizeof(port), "%u", dev->tcp_port);
+	ret = getaddrinfo(dev->ipv4_address, port, &hints, &info);
 
 	if (ret != 0) {
 		log_err(ctx, "Address lookup failed.");
@@ -305,7 +341,7 @@ JAYLINK_PRIV int transport_tcp_open(struct jaylink_device_handle *devh)
 	return JAYLINK_OK;
 }
 
-JAYLINK_PRIV int transport_tcp_close(struct jaylink_device_handle *devh)
+static int transport_tcp_close(struct jaylink_device_handle *devh)
 {
 	struct jaylink_context *ctx;
 
@@ -314,6 +350,9 @@ JAYLINK_PRIV int transport_tcp_close(struct jaylink_device_handle *devh)
 	log_dbg(ctx, "Closing device (IPv4 address = %s).",
 		devh->dev->ipv4_address);
 
+	if (!socket_close(devh->sock))
+		log_warn(ctx, "Failed to close socket.");
+
 	cleanup_handle(devh);
 
 	log_dbg(ctx, "Device closed successfully.");
@@ -321,7 +360,39 @@ JAYLINK_PRIV int transport_tcp_close(struct jaylink_device_handle *devh)
 	return JAYLINK_OK;
 }
 
-JAYLINK_PRIV int transport_tcp_start_write(struct jaylink_device_handle *devh,
+static bool adjust_buffer(struct jaylink_device_handle *devh, size_t size)
+{
+	struct jaylink_context *ctx;
+	uint8_t *buffer;
+	size_t num;
+
+	ctx = devh->dev->ctx;
+
+	/* Adjust buffer size to a multiple of BUFFER_SIZE bytes. */
+	num = size / BUFFER_SIZE;
+
+	if (size % BUFFER_SIZE > 0)
+		num++;
+
+	size = num * BUFFER_SIZE;
+	buffer = realloc(devh->buffer, size);
+
+	if (!buffer) {
+		log_err(ctx, "Failed to adjust buffer size to %zu bytes.",
+			size);
+		return false;
+	}
+
+	devh->buffer = buffer;
+	devh->buffer_size = size;
+	devh->stats.buffer_reallocs++;
+
+	log_dbg(ctx, "Adjusted buffer size to %zu bytes.", size);
+
+	return true;
+}
+
+static int transport_tcp_start_write(struct jaylink_device_handle *devh,
 		size_t length, bool has_command)
 {
 	struct jaylink_context *ctx;
@@ -334,25 +405,37 @@ JAYLINK_PRIV int transport_tcp_start_write(struct jaylink_device_handle *devh,
 	log_dbgio(ctx, "Starting write operation (length = %zu bytes).",
 		length);
 
-	if (devh->write_pos > 0)
-		log_warn(ctx, "Last write operation left %zu bytes in the "
-			"buffer.", devh->write_pos);
-
 	if (devh->write_length > 0)
 		log_warn(ctx, "Last write operation was not performed.");
 
+	/*
+	 * Append the write operation to the data of the previous write
+	 * operations in batch mode.
+	 */
+	if (devh->batch) {
+		if (devh->write_pos + 1 > devh->buffer_size) {
+			if (!adjust_buffer(devh, devh->write_pos + 1))
+				return JAYLINK_ERR_MALLOC;
+		}
+	} else {
+		if (devh->write_pos > 0)
+			log_warn(ctx, "Last write operation left %zu bytes in "
+				"the buffer.", devh->write_pos);
+
+		devh->write_pos = 0;
+	}
+
 	devh->write_length = length;
-	devh->write_pos = 0;
 
 	if (has_command) {
-		devh->buffer[0] = CMD_CLIENT;
+		devh->buffer[devh->write_pos] = CMD_CLIENT;
 		devh->write_pos++;
 	}
 
 	return JAYLINK_OK;
 }
 
-JAYLINK_PRIV int transport_tcp_start_read(struct jaylink_device_handle *devh,
+static int transport_tcp_start_read(struct jaylink_device_handle *devh,
 		size_t length)
 {
 	struct jaylink_context *ctx;
@@ -378,7 +461,7 @@ JAYLINK_PRIV int transport_tcp_start_read(struct jaylink_device_handle *devh,
 	return JAYLINK_OK;
 }
 
-JAYLINK_PRIV int transport_tcp_start_write_read(
+static int transport_tcp_start_write_read(
 		struct jaylink_device_handle *devh, size_t write_length,
 		size_t read_length, bool has_command)
 {
@@ -425,14 +508,21 @@ JAYLINK_PRIV int transport_tcp_start_write_read(
 static int _send(struct jaylink_device_handle *devh, const uint8_t *buffer,
 		size_t length)
 {
+	int ret;
 	struct jaylink_context *ctx;
 	size_t tmp;
 
 	ctx = devh->dev->ctx;
+	ret = set_blocking(devh, true);
+
+	if (ret != JAYLINK_OK)
+		return ret;
 
 	while (length > 0) {
 		tmp = length;
 
+		devh->stats.tcp_send_calls++;
+
 		if (!socket_send(devh->sock, buffer, &tmp, 0)) {
 			log_err(ctx, "Failed to send data to device.");
 			return JAYLINK_ERR_IO;
@@ -447,38 +537,46 @@ static int _send(struct jaylink_device_handle *devh, const uint8_t *buffer,
 	return JAYLINK_OK;
 }
 
-static bool adjust_buffer(struct jaylink_device_handle *devh, size_t size)
+static int _sendv(struct jaylink_device_handle *devh,
+		struct transport_iovec *iov, size_t iovcnt)
 {
+	int ret;
 	struct jaylink_context *ctx;
-	uint8_t *buffer;
-	size_t num;
+	size_t tmp;
 
 	ctx = devh->dev->ctx;
+	ret = set_blocking(devh, true);
 
-	/* Adjust buffer size to a multiple of BUFFER_SIZE bytes. */
-	num = size / BUFFER_SIZE;
+	if (ret != JAYLINK_OK)
+		return ret;
 
-	if (size % BUFFER_SIZE > 0)
-		num++;
+	while (iovcnt > 0) {
+		devh->stats.tcp_send_calls++;
 
-	size = num * BUFFER_SIZE;
-	buffer = realloc(devh->buffer, size);
+		if (!socket_sendv(devh->sock, iov, iovcnt, &tmp, 0)) {
+			log_err(ctx, "Failed to send data to device.");
+			return JAYLINK_ERR_IO;
+		}
 
-	if (!buffer) {
-		log_err(ctx, "Failed to adjust buffer size to %zu bytes.",
-			size);
-		return false;
-	}
+		log_dbgio(ctx, "Sent %zu bytes to device.", tmp);
 
-	devh->buffer = buffer;
-	devh->buffer_size = size;
+		/* Skip the buffers which were sent completely. */
+		while (iovcnt > 0 && tmp >= iov->length) {
+			tmp -= iov->length;
+			iov++;
+			iovcnt--;
+		}
 
-	log_dbg(ctx, "Adjusted buffer size to %zu bytes.", size);
+		if (iovcnt > 0) {
+			iov->buffer += tmp;
+			iov->length -= tmp;
+		}
+	}
 
-	return true;
+	return JAYLINK_OK;
 }
 
-JAYLINK_PRIV int transport_tcp_write(struct jaylink_device_handle *devh,
+static int transport_tcp_write(struct jaylink_device_handle *devh,
 		const uint8_t *buffer, size_t length)
 {
 	int ret;
@@ -496,9 +594,9 @@ JAYLINK_PRIV int transport_tcp_write(struct jaylink_device_handle *devh,
 
 	/*
 	 * Store data in the buffer if the expected number of bytes for the
-	 * write operation is not reached.
+	 * write operation is not reached or if batch mode is enabled.
 	 */
-	if (length < devh->write_length) {
+	if (length < devh->write_length || devh->batch) {
 		if (devh->write_pos + length > devh->buffer_size) {
 			if (!adjust_buffer(devh, devh->write_pos + length))
 				return JAYLINK_ERR_MALLOC;
@@ -549,7 +647,60 @@ JAYLINK_PRIV int transport_tcp_write(struct jaylink_device_handle *devh,
 	return _send(devh, buffer, length);
 }
 
-JAYLINK_PRIV int transport_tcp_read(struct jaylink_device_handle *devh,
+static int transport_tcp_writev(struct jaylink_device_handle *devh,
+		const struct transport_iovec *iov, size_t iovcnt)
+{
+	int ret;
+	struct jaylink_context *ctx;
+	struct transport_iovec tmp[TRANSPORT_MAX_IOVEC + 1];
+	size_t length;
+	size_t i;
+
+	ctx = devh->dev->ctx;
+	length = 0;
+
+	for (i = 0; i < iovcnt; i++)
+		length += iov[i].length;
+
+	if (length > devh->write_length) {
+		log_err(ctx, "Requested to write %zu bytes but only %zu bytes "
+			"are expected for the write operation.", length,
+			devh->write_length);
+		return JAYLINK_ERR_ARG;
+	}
+
+	if (length < devh->write_length || devh->batch) {
+		for (i = 0; i < iovcnt; i++) {
+			ret = transport_tcp_write(devh, iov[i].buffer,
+				iov[i].length);
+
+			if (ret != JAYLINK_OK)
+				return ret;
+		}
+
+		return JAYLINK_OK;
+	}
+
+	/*
+	 * Expected number of bytes for this write operation is reached and
+	 * therefore the write operation will be performed. The buffered data
+	 * and the data of all buffers is sent with a single message.
+	 */
+	devh->write_length = 0;
+
+	tmp[0].buffer = devh->buffer;
+	tmp[0].length = devh->write_pos;
+
+	for (i = 0; i < iovcnt; i++)
+		tmp[i + 1] = iov[i];
+
+	ret = _sendv(devh, tmp, iovcnt + 1);
+	devh->write_pos = 0;
+
+	return ret;
+}
+
+static int transport_tcp_read(struct jaylink_device_handle *devh,
 		uint8_t *buffer, size_t length)
 {
 	int ret;
@@ -599,3 +750,280 @@ JAYLINK_PRIV int transport_tcp_read(struct jaylink_device_handle *devh,
 
 	return JAYLINK_OK;
 }
+
+static int transport_tcp_end_batch(struct jaylink_device_handle *devh,
+		bool discard)
+{
+	size_t length;
+
+	length = devh->write_pos;
+	devh->write_pos = 0;
+
+	if (devh->write_length > 0 && !discard) {
+		log_err(devh->dev->ctx, "Last write operation of the batch is "
+			"incomplete.");
+		discard = true;
+	}
+
+	devh->write_length = 0;
+
+	if (discard) {
+		log_dbgio(devh->dev->ctx, "Discarded %zu bytes of the batch.",
+			length);
+		return JAYLINK_ERR_ARG;
+	}
+
+	if (!length)
+		return JAYLINK_OK;
+
+	return _send(devh, devh->buffer, length);
+}
+
+/*
+ * Check whether an operation without blocking timed out because no data was
+ * transferred for PROGRESS_TIMEOUT milliseconds.
+ */
+static int check_progress(struct jaylink_device_handle *devh, bool *done)
+{
+	if (util_get_time() - devh->progress_time > PROGRESS_TIMEOUT * 1000) {
+		log_err(devh->dev->ctx, "Operation timed out.");
+		devh->progress_time = 0;
+		return JAYLINK_ERR_TIMEOUT;
+	}
+
+	*done = false;
+
+	return JAYLINK_OK;
+}
+
+static int transport_tcp_progress_batch(struct jaylink_device_handle *devh,
+		bool *done)
+{
+	int ret;
+	struct jaylink_context *ctx;
+	size_t tmp;
+
+	ctx = devh->dev->ctx;
+
+	if (devh->write_length > 0) {
+		log_err(ctx, "Last write operation of the batch is "
+			"incomplete.");
+		ret = JAYLINK_ERR_ARG;
+	} else {
+		ret = set_blocking(devh, false);
+	}
+
+	if (!devh->progress_time)
+		devh->progress_time = util_get_time();
+
+	while (ret == JAYLINK_OK && devh->batch_pos < devh->write_pos) {
+		tmp = devh->write_pos - devh->batch_pos;
+
+		devh->stats.tcp_send_calls++;
+
+		if (!socket_send(devh->sock, devh->buffer + devh->batch_pos,
+				&tmp, 0)) {
+			if (!socket_would_block()) {
+				log_err(ctx, "Failed to send data to device.");
+				ret = JAYLINK_ERR_IO;
+				break;
+			}
+
+			ret = check_progress(devh, done);
+
+			if (ret == JAYLINK_OK)
+				return JAYLINK_OK;
+
+			break;
+		}
+
+		devh->batch_pos += tmp;
+		devh->progress_time = util_get_time();
+
+		log_dbgio(ctx, "Sent %zu bytes to device.", tmp);
+	}
+
+	/* The batch is discarded on failure. */
+	devh->write_length = 0;
+	devh->write_pos = 0;
+	devh->batch_pos = 0;
+	devh->progress_time = 0;
+
+	*done = true;
+
+	return ret;
+}
+
+static int transport_tcp_progress_read(struct jaylink_device_handle *devh,
+		bool *done)
+{
+	int ret;
+	struct jaylink_context *ctx;
+	size_t tmp;
+
+	ctx = devh->dev->ctx;
+
+	/* Receive the data at the beginning of the buffer. */
+	if (devh->read_pos > 0) {
+		memmove(devh->buffer, devh->buffer + devh->read_pos,
+			devh->bytes_available);
+		devh->read_pos = 0;
+	}
+
+	if (devh->read_length > devh->buffer_size) {
+		if (!adjust_buffer(devh, devh->read_length))
+			return JAYLINK_ERR_MALLOC;
+	}
+
+	ret = set_blocking(devh, false);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	if (!devh->progress_time)
+		devh->progress_time = util_get_time();
+
+	while (devh->bytes_available < devh->read_length) {
+		tmp = devh->read_length - devh->bytes_available;
+
+		devh->stats.tcp_recv_calls++;
+
+		if (!socket_recv(devh->sock, devh->buffer +
+				devh->bytes_available, &tmp, 0)) {
+			if (socket_would_block())
+				return check_progress(devh, done);
+
+			log_err(ctx, "Failed to receive data from device.");
+			devh->progress_time = 0;
+			return JAYLINK_ERR_IO;
+		} else if (!tmp) {
+			log_err(ctx, "Failed to receive data from device: "
+				"remote connection closed.");
+			devh->progress_time = 0;
+			return JAYLINK_ERR_IO;
+		}
+
+		devh->bytes_available += tmp;
+		devh->progress_time = util_get_time();
+
+		log_dbgio(ctx, "Received %zu bytes from device.", tmp);
+	}
+
+	devh->progress_time = 0;
+	*done = true;
+
+	return JAYLINK_OK;
+}
+
+static int transport_tcp_get_pollfds(struct jaylink_device_handle *devh,
+		struct jaylink_pollfd *fds, size_t *num_fds)
+{
+	if (!fds) {
+		*num_fds = 1;
+		return JAYLINK_OK;
+	}
+
+	if (*num_fds < 1)
+		return JAYLINK_ERR_ARG;
+
+	fds[0].fd = devh->sock;
+
+	/* Data of a batch is left to be sent. */
+	if (devh->write_pos > 0)
+		fds[0].events = JAYLINK_POLL_OUT;
+	else
+		fds[0].events = JAYLINK_POLL_IN;
+
+	*num_fds = 1;
+
+	return JAYLINK_OK;
+}
+
+/** @private */
+JAYLINK_PRIV const struct transport_ops transport_tcp_ops = {
+	.open = &transport_tcp_open,
+	.close = &transport_tcp_close,
+	.start_write = &transport_tcp_start_write,
+	.start_read = &transport_tcp_start_read,
+	.start_write_read = &transport_tcp_start_write_read,
+	.write = &transport_tcp_write,
+	.writev = &transport_tcp_writev,
+	.read = &transport_tcp_read,
+	.end_batch = &transport_tcp_end_batch,
+	.progress_batch = &transport_tcp_progress_batch,
+	.progress_read = &transport_tcp_progress_read,
+	.get_pollfds = &transport_tcp_get_pollfds
+};
+
+/**
+ * Allocate a device instance for a TCP/IP device at a given address.
+ *
+ * This allows to use a device which is not found by the device discovery, for
+ * example because it is located in a different subnet or because it is a
+ * server on the local host.
+ *
+ * @param[in,out] ctx libjaylink context.
+ * @param[in] address IPv4 address of the device in quad-dotted decimal format.
+ * @param[in] port TCP port of the device. Use 0 for the default port of the
+ *                 J-Link TCP/IP protocol.
+ * @param[out] dev Newly allocated device instance on success, and undefined
+ *                 on failure. The device instance must be unreferenced by the
+ *                 caller with jaylink_unref_device().
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_tcp_device_new(struct jaylink_context *ctx,
+		const char *address, uint16_t port, struct jaylink_device **dev)
+{
+	struct jaylink_device *tmp;
+	struct in_addr in;
+
+	if (!ctx || !address || !dev)
+		return JAYLINK_ERR_ARG;
+
+	if (inet_pton(AF_INET, address, &in) != 1)
+		return JAYLINK_ERR_ARG;
+
+	tmp = device_allocate(ctx);
+
+	if (!tmp) {
+		log_err(ctx, "Device instance malloc failed.");
+		return JAYLINK_ERR_MALLOC;
+	}
+
+	/*
+	 * Initialize all fields because they are compared with those of
+	 * discovered devices.
+	 */
+	tmp->iface = JAYLINK_HIF_TCP;
+	tmp->serial_number = 0;
+	tmp->valid_serial_number = false;
+	memset(tmp->mac_address, 0, sizeof(tmp->mac_address));
+	tmp->has_mac_address = false;
+	tmp->product_name[0] = '\0';
+	tmp->has_product_name = false;
+	tmp->nickname[0] = '\0';
+	tmp->has_nickname = false;
+	memset(&tmp->hw_version, 0, sizeof(tmp->hw_version));
+	tmp->has_hw_version = false;
+
+	inet_ntop(AF_INET, &in, tmp->ipv4_address, sizeof(tmp->ipv4_address));
+	tmp->tcp_port = port ? port : TRANSPORT_TCP_PORT;
+
+	if (!device_add(tmp)) {
+		log_err(ctx, "Failed to add device instance.");
+		free(tmp);
+		return JAYLINK_ERR_MALLOC;
+	}
+
+	log_dbg(ctx, "Allocated device instance (IPv4 address = %s, port = "
+		"%u).", tmp->ipv4_address, tmp->tcp_port);
+
+	*dev = tmp;
+
+	return JAYLINK_OK;
+}
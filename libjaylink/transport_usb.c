@@ -21,6 +21,9 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
+#ifndef _WIN32
+#include <poll.h>
+#endif
 
 #include "libjaylink.h"
 #include "libjaylink-internal.h"
@@ -43,6 +46,105 @@
 /** Chunk size in bytes in which data is transferred. */
 #define CHUNK_SIZE	2048
 
+/**
+ * Maximum number of asynchronous transfers per direction which are in flight
+ * at the same time.
+ */
+#define NUM_TRANSFERS	4
+
+/**
+ * Timeout of an asynchronous USB transfer in milliseconds.
+ *
+ * An asynchronous transfer can not be retried without breaking the order of
+ * the data of the other transfers in flight. Therefore, it gets the time of
+ * all attempts of a synchronous transfer at once.
+ */
+#define ASYNC_TIMEOUT	(USB_TIMEOUT * NUM_TIMEOUTS)
+
+/**
+ * Number of consecutive failures to handle events before waiting for an
+ * asynchronous transfer is given up.
+ */
+#define NUM_EVENT_ERRORS	3
+
+/** Asynchronous transfer state of a device handle. */
+struct usb_async {
+	/** Transfers, used as ring. */
+	struct libusb_transfer *transfers[NUM_TRANSFERS];
+	/** Completion flags of the transfers. */
+	int completed[NUM_TRANSFERS];
+	/** Receive buffers of the transfers. */
+	uint8_t buffer[NUM_TRANSFERS * CHUNK_SIZE];
+	/** Number of submitted transfers of an operation without blocking. */
+	size_t num_submitted;
+	/** Number of completed transfers of an operation without blocking. */
+	size_t num_completed;
+	/** Number of bytes requested by the receive transfers in flight. */
+	size_t requested;
+	/**
+	 * Indicates whether waiting for a transfer was given up while it is
+	 * still owned by libusb. No further transfers are performed and the
+	 * transfer state is not freed in this case.
+	 */
+	bool broken;
+};
+
+static bool allocate_async(struct jaylink_device_handle *devh)
+{
+	struct usb_async *async;
+	size_t i;
+
+	async = malloc(sizeof(struct usb_async));
+
+	if (!async)
+		return false;
+
+	for (i = 0; i < NUM_TRANSFERS; i++) {
+		async->transfers[i] = libusb_alloc_transfer(0);
+
+		if (!async->transfers[i])
+			break;
+	}
+
+	if (i < NUM_TRANSFERS) {
+		while (i > 0)
+			libusb_free_transfer(async->transfers[--i]);
+
+		free(async);
+		return false;
+	}
+
+	async->num_submitted = 0;
+	async->num_completed = 0;
+	async->requested = 0;
+	async->broken = false;
+
+	devh->usb_async = async;
+
+	return true;
+}
+
+static void free_async(struct jaylink_device_handle *devh)
+{
+	size_t i;
+
+	/*
+	 * A transfer which is still owned by libusb refers to the completion
+	 * flags and receive buffers. Leak the transfer state rather than
+	 * freeing memory which may still be accessed.
+	 */
+	if (devh->usb_async->broken) {
+		log_warn(devh->dev->ctx, "Leaking transfers which are still "
+			"pending.");
+		return;
+	}
+
+	for (i = 0; i < NUM_TRANSFERS; i++)
+		libusb_free_transfer(devh->usb_async->transfers[i]);
+
+	free(devh->usb_async);
+}
+
 static int initialize_handle(struct jaylink_device_handle *devh)
 {
 	int ret;
@@ -136,6 +238,12 @@ static int initialize_handle(struct jaylink_device_handle *devh)
 		return JAYLINK_ERR_MALLOC;
 	}
 
+	if (!allocate_async(devh)) {
+		log_err(ctx, "Asynchronous transfers malloc failed.");
+		free(devh->buffer);
+		return JAYLINK_ERR_MALLOC;
+	}
+
 	devh->read_length = 0;
 	devh->bytes_available = 0;
 	devh->read_pos = 0;
@@ -148,10 +256,11 @@ static int initialize_handle(struct jaylink_device_handle *devh)
 
 static void cleanup_handle(struct jaylink_device_handle *devh)
 {
+	free_async(devh);
 	free(devh->buffer);
 }
 
-JAYLINK_PRIV int transport_usb_open(struct jaylink_device_handle *devh)
+static int transport_usb_open(struct jaylink_device_handle *devh)
 {
 	int ret;
 	struct jaylink_device *dev;
@@ -198,7 +307,7 @@ JAYLINK_PRIV int transport_usb_open(struct jaylink_device_handle *devh)
 	return JAYLINK_OK;
 }
 
-JAYLINK_PRIV int transport_usb_close(struct jaylink_device_handle *devh)
+static int transport_usb_close(struct jaylink_device_handle *devh)
 {
 	int ret;
 	struct jaylink_device *dev;
@@ -227,7 +336,7 @@ JAYLINK_PRIV int transport_usb_close(struct jaylink_device_handle *devh)
 	return JAYLINK_OK;
 }
 
-JAYLINK_PRIV int transport_usb_start_write(struct jaylink_device_handle *devh,
+static int transport_usb_start_write(struct jaylink_device_handle *devh,
 		size_t length, bool has_command)
 {
 	struct jaylink_context *ctx;
@@ -241,20 +350,28 @@ JAYLINK_PRIV int transport_usb_start_write(struct jaylink_device_handle *devh,
 
 	log_dbgio(ctx, "Starting write operation (length = %zu bytes).", length);
 
-	if (devh->write_pos > 0)
-		log_warn(ctx, "Last write operation left %zu bytes in the "
-			"buffer.", devh->write_pos);
-
 	if (devh->write_length > 0)
 		log_warn(ctx, "Last write operation was not performed.");
 
 	devh->write_length = length;
+
+	/*
+	 * Append the write operation to the data of the previous write
+	 * operations in batch mode.
+	 */
+	if (devh->batch)
+		return JAYLINK_OK;
+
+	if (devh->write_pos > 0)
+		log_warn(ctx, "Last write operation left %zu bytes in the "
+			"buffer.", devh->write_pos);
+
 	devh->write_pos = 0;
 
 	return JAYLINK_OK;
 }
 
-JAYLINK_PRIV int transport_usb_start_read(struct jaylink_device_handle *devh,
+static int transport_usb_start_read(struct jaylink_device_handle *devh,
 		size_t length)
 {
 	struct jaylink_context *ctx;
@@ -280,7 +397,7 @@ JAYLINK_PRIV int transport_usb_start_read(struct jaylink_device_handle *devh,
 	return JAYLINK_OK;
 }
 
-JAYLINK_PRIV int transport_usb_start_write_read(
+static int transport_usb_start_write_read(
 		struct jaylink_device_handle *devh, size_t write_length,
 		size_t read_length, bool has_command)
 {
@@ -321,6 +438,21 @@ JAYLINK_PRIV int transport_usb_start_write_read(
 	return JAYLINK_OK;
 }
 
+/*
+ * Check whether the device handle can no longer be used for data transfers
+ * because waiting for a transfer was given up.
+ */
+static bool is_broken(struct jaylink_device_handle *devh)
+{
+	if (!devh->usb_async->broken)
+		return false;
+
+	log_err(devh->dev->ctx, "Device handle is unusable due to a pending "
+		"transfer.");
+
+	return true;
+}
+
 static int usb_recv(struct jaylink_device_handle *devh, uint8_t *buffer,
 		size_t *length)
 {
@@ -331,11 +463,15 @@ static int usb_recv(struct jaylink_device_handle *devh, uint8_t *buffer,
 
 	ctx = devh->dev->ctx;
 
+	if (is_broken(devh))
+		return JAYLINK_ERR_IO;
+
 	tries = NUM_TIMEOUTS;
 	transferred = 0;
 
 	while (tries > 0 && !transferred) {
 		/* Always request CHUNK_SIZE bytes from the device. */
+		devh->stats.usb_transfers++;
 		ret = libusb_bulk_transfer(devh->usb_devh, devh->endpoint_in,
 			(unsigned char *)buffer, CHUNK_SIZE, &transferred,
 			USB_TIMEOUT);
@@ -343,6 +479,7 @@ static int usb_recv(struct jaylink_device_handle *devh, uint8_t *buffer,
 		if (ret == LIBUSB_ERROR_TIMEOUT) {
 			log_warn(ctx, "Failed to receive data from "
 				"device: %s.", libusb_error_name(ret));
+			devh->stats.timeout_retries++;
 			tries--;
 			continue;
 		} else if (ret != LIBUSB_SUCCESS) {
@@ -390,13 +527,14 @@ static bool adjust_buffer(struct jaylink_device_handle *devh, size_t size)
 
 	devh->buffer = buffer;
 	devh->buffer_size = size;
+	devh->stats.buffer_reallocs++;
 
 	log_dbg(ctx, "Adjusted buffer size to %zu bytes.", size);
 
 	return true;
 }
 
-static int usb_send(struct jaylink_device_handle *devh, const uint8_t *buffer,
+static int bulk_send(struct jaylink_device_handle *devh, const uint8_t *buffer,
 		size_t length)
 {
 	int ret;
@@ -409,6 +547,7 @@ static int usb_send(struct jaylink_device_handle *devh, const uint8_t *buffer,
 
 	while (tries > 0 && length > 0) {
 		/* Send data in chunks of CHUNK_SIZE bytes to the device. */
+		devh->stats.usb_transfers++;
 		ret = libusb_bulk_transfer(devh->usb_devh, devh->endpoint_out,
 			(unsigned char *)buffer, MIN(CHUNK_SIZE, length),
 			&transferred, USB_TIMEOUT);
@@ -418,6 +557,7 @@ static int usb_send(struct jaylink_device_handle *devh, const uint8_t *buffer,
 		} else if (ret == LIBUSB_ERROR_TIMEOUT) {
 			log_warn(ctx, "Failed to send data to device: %s.",
 				libusb_error_name(ret));
+			devh->stats.timeout_retries++;
 			tries--;
 		} else {
 			log_err(ctx, "Failed to send data to device: %s.",
@@ -439,7 +579,291 @@ static int usb_send(struct jaylink_device_handle *devh, const uint8_t *buffer,
 	return JAYLINK_ERR_TIMEOUT;
 }
 
-JAYLINK_PRIV int transport_usb_write(struct jaylink_device_handle *devh,
+static void LIBUSB_CALL transfer_callback(struct libusb_transfer *transfer)
+{
+	*(int *)transfer->user_data = 1;
+}
+
+static bool submit_transfer(struct jaylink_device_handle *devh, size_t slot,
+		uint8_t endpoint, uint8_t *buffer, size_t length)
+{
+	int ret;
+	struct usb_async *async;
+
+	async = devh->usb_async;
+	async->completed[slot] = 0;
+
+	libusb_fill_bulk_transfer(async->transfers[slot], devh->usb_devh,
+		endpoint, (unsigned char *)buffer, length, &transfer_callback,
+		&async->completed[slot], ASYNC_TIMEOUT);
+
+	devh->stats.usb_transfers++;
+	ret = libusb_submit_transfer(async->transfers[slot]);
+
+	if (ret != LIBUSB_SUCCESS) {
+		log_err(devh->dev->ctx, "Failed to submit transfer: %s.",
+			libusb_error_name(ret));
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Wait for the completion of a transfer. If events can not be handled, the
+ * transfer is cancelled once and given up after NUM_EVENT_ERRORS consecutive
+ * failures. The transfer is still owned by libusb then and the device handle
+ * is marked as unusable.
+ */
+static int wait_transfer(struct jaylink_device_handle *devh, size_t slot)
+{
+	int ret;
+	struct usb_async *async;
+	size_t errors;
+	bool cancelled;
+
+	async = devh->usb_async;
+
+	if (async->broken)
+		return JAYLINK_ERR_IO;
+
+	errors = 0;
+	cancelled = false;
+
+	while (!async->completed[slot]) {
+		ret = libusb_handle_events_completed(devh->dev->ctx->usb_ctx,
+			&async->completed[slot]);
+
+		if (ret == LIBUSB_SUCCESS || ret == LIBUSB_ERROR_INTERRUPTED) {
+			errors = 0;
+			continue;
+		}
+
+		log_warn(devh->dev->ctx, "Failed to handle events: %s.",
+			libusb_error_name(ret));
+
+		if (!cancelled) {
+			libusb_cancel_transfer(async->transfers[slot]);
+			cancelled = true;
+		}
+
+		if (++errors == NUM_EVENT_ERRORS) {
+			log_err(devh->dev->ctx, "Giving up waiting for "
+				"transfer.");
+			async->broken = true;
+			return JAYLINK_ERR_IO;
+		}
+	}
+
+	return JAYLINK_OK;
+}
+
+/*
+ * Cancel the transfers which are still in flight and wait for their
+ * completion. The number of transfers in flight is given by @p num, starting
+ * with the transfer in @p slot.
+ */
+static void cancel_transfers(struct jaylink_device_handle *devh, size_t slot,
+		size_t num)
+{
+	size_t i;
+
+	for (i = 0; i < num; i++)
+		libusb_cancel_transfer(
+			devh->usb_async->transfers[(slot + i) % NUM_TRANSFERS]);
+
+	for (i = 0; i < num; i++)
+		wait_transfer(devh, (slot + i) % NUM_TRANSFERS);
+}
+
+static int transfer_status_to_error(struct jaylink_device_handle *devh,
+		const struct libusb_transfer *transfer, const char *direction)
+{
+	if (transfer->status == LIBUSB_TRANSFER_TIMED_OUT) {
+		log_err(devh->dev->ctx, "%s data %s device timed out.",
+			direction, transfer->endpoint & LIBUSB_ENDPOINT_IN ?
+			"from" : "to");
+		return JAYLINK_ERR_TIMEOUT;
+	}
+
+	log_err(devh->dev->ctx, "%s data %s device failed: transfer status "
+		"%u.", direction, transfer->endpoint & LIBUSB_ENDPOINT_IN ?
+		"from" : "to", transfer->status);
+
+	return JAYLINK_ERR;
+}
+
+/*
+ * Send data to the device with up to NUM_TRANSFERS asynchronous transfers of
+ * CHUNK_SIZE bytes in flight at the same time. This keeps the OUT endpoint
+ * busy instead of waiting for the completion of each chunk before the next
+ * one is submitted.
+ */
+static int async_send(struct jaylink_device_handle *devh, const uint8_t *buffer,
+		size_t length)
+{
+	int ret;
+	struct libusb_transfer *transfer;
+	size_t num_chunks;
+	size_t submitted;
+	size_t completed;
+	size_t offset;
+	size_t slot;
+
+	num_chunks = (length + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	submitted = 0;
+	completed = 0;
+
+	while (completed < num_chunks) {
+		while (submitted < num_chunks &&
+				submitted - completed < NUM_TRANSFERS) {
+			offset = submitted * CHUNK_SIZE;
+
+			/*
+			 * The data is not modified by an OUT transfer, but
+			 * libusb requires a non-const buffer.
+			 */
+			if (!submit_transfer(devh, submitted % NUM_TRANSFERS,
+					devh->endpoint_out,
+					(uint8_t *)buffer + offset,
+					MIN(CHUNK_SIZE, length - offset))) {
+				cancel_transfers(devh,
+					completed % NUM_TRANSFERS,
+					submitted - completed);
+				return JAYLINK_ERR;
+			}
+
+			submitted++;
+		}
+
+		slot = completed % NUM_TRANSFERS;
+		ret = wait_transfer(devh, slot);
+		transfer = devh->usb_async->transfers[slot];
+		completed++;
+
+		if (ret != JAYLINK_OK) {
+			cancel_transfers(devh, completed % NUM_TRANSFERS,
+				submitted - completed);
+			return ret;
+		}
+
+		if (transfer->status != LIBUSB_TRANSFER_COMPLETED ||
+				transfer->actual_length != transfer->length) {
+			cancel_transfers(devh, completed % NUM_TRANSFERS,
+				submitted - completed);
+			return transfer_status_to_error(devh, transfer,
+				"Sending");
+		}
+
+		log_dbgio(devh->dev->ctx, "Sent %i bytes to device.",
+			transfer->actual_length);
+	}
+
+	return JAYLINK_OK;
+}
+
+static int usb_send(struct jaylink_device_handle *devh, const uint8_t *buffer,
+		size_t length)
+{
+	if (is_broken(devh))
+		return JAYLINK_ERR_IO;
+
+	if (length > CHUNK_SIZE)
+		return async_send(devh, buffer, length);
+
+	return bulk_send(devh, buffer, length);
+}
+
+/*
+ * Receive data from the device with up to NUM_TRANSFERS asynchronous transfers
+ * of CHUNK_SIZE bytes in flight at the same time.
+ *
+ * A transfer may complete with less than CHUNK_SIZE bytes while the next
+ * transfers are already in flight. The data of the transfers is received in
+ * order nevertheless, but not at fixed offsets. Therefore, each transfer has
+ * its own receive buffer and the data is copied into the user provided buffer
+ * on completion. In order to never request more data than is expected, a
+ * transfer is only submitted if the data of all transfers in flight does not
+ * exceed the number of bytes left to be received.
+ *
+ * The number of received bytes is stored in @p received on success. The
+ * remaining data, which is always less than CHUNK_SIZE bytes, must be received
+ * separately.
+ */
+static int async_recv(struct jaylink_device_handle *devh, uint8_t *buffer,
+		size_t length, size_t *received)
+{
+	int ret;
+	struct usb_async *async;
+	struct libusb_transfer *transfer;
+	size_t requested;
+	size_t submitted;
+	size_t completed;
+	size_t slot;
+
+	async = devh->usb_async;
+
+	if (is_broken(devh))
+		return JAYLINK_ERR_IO;
+
+	submitted = 0;
+	completed = 0;
+	requested = 0;
+	*received = 0;
+
+	while (true) {
+		while (submitted - completed < NUM_TRANSFERS &&
+				*received + requested + CHUNK_SIZE <= length) {
+			slot = submitted % NUM_TRANSFERS;
+
+			if (!submit_transfer(devh, slot, devh->endpoint_in,
+					async->buffer + slot * CHUNK_SIZE,
+					CHUNK_SIZE)) {
+				cancel_transfers(devh,
+					completed % NUM_TRANSFERS,
+					submitted - completed);
+				return JAYLINK_ERR;
+			}
+
+			requested += CHUNK_SIZE;
+			submitted++;
+		}
+
+		if (submitted == completed)
+			break;
+
+		slot = completed % NUM_TRANSFERS;
+		ret = wait_transfer(devh, slot);
+		transfer = async->transfers[slot];
+		completed++;
+
+		if (ret != JAYLINK_OK) {
+			cancel_transfers(devh, completed % NUM_TRANSFERS,
+				submitted - completed);
+			return ret;
+		}
+
+		if (transfer->status != LIBUSB_TRANSFER_COMPLETED) {
+			cancel_transfers(devh, completed % NUM_TRANSFERS,
+				submitted - completed);
+			return transfer_status_to_error(devh, transfer,
+				"Receiving");
+		}
+
+		memcpy(buffer + *received, transfer->buffer,
+			transfer->actual_length);
+
+		requested -= CHUNK_SIZE;
+		*received += transfer->actual_length;
+
+		log_dbgio(devh->dev->ctx, "Received %i bytes from device.",
+			transfer->actual_length);
+	}
+
+	return JAYLINK_OK;
+}
+
+static int transport_usb_write(struct jaylink_device_handle *devh,
 		const uint8_t *buffer, size_t length)
 {
 	int ret;
@@ -459,9 +883,9 @@ JAYLINK_PRIV int transport_usb_write(struct jaylink_device_handle *devh,
 
 	/*
 	 * Store data in the buffer if the expected number of bytes for the
-	 * write operation is not reached.
+	 * write operation is not reached or if batch mode is enabled.
 	 */
-	if (length < devh->write_length) {
+	if (length < devh->write_length || devh->batch) {
 		if (devh->write_pos + length > devh->buffer_size) {
 			if (!adjust_buffer(devh, devh->write_pos + length))
 				return JAYLINK_ERR_MALLOC;
@@ -524,7 +948,111 @@ JAYLINK_PRIV int transport_usb_write(struct jaylink_device_handle *devh,
 	return usb_send(devh, buffer, length);
 }
 
-JAYLINK_PRIV int transport_usb_read(struct jaylink_device_handle *devh,
+static int transport_usb_writev(struct jaylink_device_handle *devh,
+		const struct transport_iovec *iov, size_t iovcnt)
+{
+	int ret;
+	struct jaylink_context *ctx;
+	const uint8_t *buffer;
+	size_t length;
+	size_t tmp;
+	size_t i;
+
+	ctx = devh->dev->ctx;
+	length = 0;
+
+	for (i = 0; i < iovcnt; i++)
+		length += iov[i].length;
+
+	if (length > devh->write_length) {
+		log_err(ctx, "Requested to write %zu bytes but only %zu bytes "
+			"are expected for the write operation.", length,
+			devh->write_length);
+		return JAYLINK_ERR_ARG;
+	}
+
+	if (length < devh->write_length || devh->batch) {
+		for (i = 0; i < iovcnt; i++) {
+			ret = transport_usb_write(devh, iov[i].buffer,
+				iov[i].length);
+
+			if (ret != JAYLINK_OK)
+				return ret;
+		}
+
+		return JAYLINK_OK;
+	}
+
+	/*
+	 * Expected number of bytes for this write operation is reached and
+	 * therefore the write operation will be performed.
+	 *
+	 * Data is sent directly from the buffers in multiples of CHUNK_SIZE
+	 * bytes. Only the data which is necessary to fill up the internal
+	 * buffer to a multiple of CHUNK_SIZE bytes and the remainder of each
+	 * buffer except the last one is copied into the internal buffer.
+	 */
+	devh->write_length = 0;
+	ret = JAYLINK_OK;
+
+	for (i = 0; i < iovcnt; i++) {
+		buffer = iov[i].buffer;
+		length = iov[i].length;
+
+		if (devh->write_pos % CHUNK_SIZE) {
+			tmp = MIN(length, CHUNK_SIZE -
+				(devh->write_pos % CHUNK_SIZE));
+
+			memcpy(devh->buffer + devh->write_pos, buffer, tmp);
+
+			devh->write_pos += tmp;
+			buffer += tmp;
+			length -= tmp;
+
+			if (devh->write_pos % CHUNK_SIZE)
+				continue;
+		}
+
+		if (devh->write_pos > 0) {
+			ret = usb_send(devh, devh->buffer, devh->write_pos);
+			devh->write_pos = 0;
+
+			if (ret != JAYLINK_OK)
+				return ret;
+		}
+
+		if (!length)
+			continue;
+
+		if (i == iovcnt - 1)
+			return usb_send(devh, buffer, length);
+
+		tmp = length - (length % CHUNK_SIZE);
+
+		if (tmp > 0) {
+			ret = usb_send(devh, buffer, tmp);
+
+			if (ret != JAYLINK_OK)
+				return ret;
+		}
+
+		/*
+		 * Store the remaining data in the internal buffer. Note that the
+		 * buffer size is at least CHUNK_SIZE bytes.
+		 */
+		memcpy(devh->buffer, buffer + tmp, length - tmp);
+		devh->write_pos = length - tmp;
+	}
+
+	if (devh->write_pos > 0) {
+		ret = usb_send(devh, devh->buffer, devh->write_pos);
+		devh->write_pos = 0;
+	}
+
+	return ret;
+}
+
+static int transport_usb_read(struct jaylink_device_handle *devh,
 		uint8_t *buffer, size_t length)
 {
 	int ret;
@@ -601,6 +1129,18 @@ JAYLINK_PRIV int transport_usb_read(struct jaylink_device_handle *devh,
 			devh->read_length -= tmp;
 
 			log_dbgio(ctx, "Read %zu bytes from buffer.", tmp);
+		} else if (length >= 2 * CHUNK_SIZE) {
+			ret = async_recv(devh, buffer, length, &bytes_received);
+
+			if (ret != JAYLINK_OK)
+				return ret;
+
+			buffer += bytes_received;
+			length -= bytes_received;
+			devh->read_length -= bytes_received;
+
+			log_dbgio(ctx, "Read %zu bytes from device.",
+				bytes_received);
 		} else {
 			ret = usb_recv(devh, buffer, &bytes_received);
 
@@ -618,3 +1158,337 @@ JAYLINK_PRIV int transport_usb_read(struct jaylink_device_handle *devh,
 
 	return JAYLINK_OK;
 }
+
+static int transport_usb_end_batch(struct jaylink_device_handle *devh,
+		bool discard)
+{
+	size_t length;
+
+	length = devh->write_pos;
+	devh->write_pos = 0;
+
+	if (devh->write_length > 0 && !discard) {
+		log_err(devh->dev->ctx, "Last write operation of the batch is "
+			"incomplete.");
+		discard = true;
+	}
+
+	devh->write_length = 0;
+
+	if (discard) {
+		log_dbgio(devh->dev->ctx, "Discarded %zu bytes of the batch.",
+			length);
+		return JAYLINK_ERR_ARG;
+	}
+
+	if (!length)
+		return JAYLINK_OK;
+
+	return usb_send(devh, devh->buffer, length);
+}
+
+/*
+ * Get the oldest transfer in flight of an operation without blocking if it is
+ * completed. Pending events are handled without blocking if necessary.
+ *
+ * Returns NULL if the transfer is not completed yet.
+ */
+static struct libusb_transfer *poll_transfer(
+		struct jaylink_device_handle *devh)
+{
+	int ret;
+	struct usb_async *async;
+	struct timeval tv;
+	size_t slot;
+
+	async = devh->usb_async;
+	slot = async->num_completed % NUM_TRANSFERS;
+
+	if (!async->completed[slot]) {
+		tv.tv_sec = 0;
+		tv.tv_usec = 0;
+
+		ret = libusb_handle_events_timeout_completed(
+			devh->dev->ctx->usb_ctx, &tv, NULL);
+
+		if (ret != LIBUSB_SUCCESS && ret != LIBUSB_ERROR_INTERRUPTED)
+			log_warn(devh->dev->ctx, "Failed to handle events: "
+				"%s.", libusb_error_name(ret));
+
+		if (!async->completed[slot])
+			return NULL;
+	}
+
+	async->num_completed++;
+
+	return async->transfers[slot];
+}
+
+/* Cancel the transfers of an operation without blocking. */
+static void abort_progress(struct jaylink_device_handle *devh)
+{
+	struct usb_async *async;
+
+	async = devh->usb_async;
+
+	cancel_transfers(devh, async->num_completed % NUM_TRANSFERS,
+		async->num_submitted - async->num_completed);
+
+	async->num_submitted = 0;
+	async->num_completed = 0;
+	async->requested = 0;
+}
+
+static int transport_usb_progress_batch(struct jaylink_device_handle *devh,
+		bool *done)
+{
+	struct usb_async *async;
+	struct libusb_transfer *transfer;
+	size_t num_chunks;
+	size_t offset;
+
+	async = devh->usb_async;
+
+	if (is_broken(devh)) {
+		devh->write_pos = 0;
+		return JAYLINK_ERR_IO;
+	}
+
+	if (devh->write_length > 0) {
+		log_err(devh->dev->ctx, "Last write operation of the batch is "
+			"incomplete.");
+		devh->write_length = 0;
+		devh->write_pos = 0;
+		return JAYLINK_ERR_ARG;
+	}
+
+	num_chunks = (devh->write_pos + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+	while (true) {
+		while (async->num_submitted < num_chunks &&
+				async->num_submitted - async->num_completed <
+				NUM_TRANSFERS) {
+			offset = async->num_submitted * CHUNK_SIZE;
+
+			if (!submit_transfer(devh,
+					async->num_submitted % NUM_TRANSFERS,
+					devh->endpoint_out,
+					devh->buffer + offset,
+					MIN(CHUNK_SIZE,
+					devh->write_pos - offset))) {
+				abort_progress(devh);
+				devh->write_pos = 0;
+				return JAYLINK_ERR;
+			}
+
+			async->num_submitted++;
+		}
+
+		if (async->num_completed == num_chunks)
+			break;
+
+		transfer = poll_transfer(devh);
+
+		if (!transfer) {
+			*done = false;
+			return JAYLINK_OK;
+		}
+
+		if (transfer->status != LIBUSB_TRANSFER_COMPLETED ||
+				transfer->actual_length != transfer->length) {
+			abort_progress(devh);
+			devh->write_pos = 0;
+			return transfer_status_to_error(devh, transfer,
+				"Sending");
+		}
+
+		log_dbgio(devh->dev->ctx, "Sent %i bytes to device.",
+			transfer->actual_length);
+	}
+
+	async->num_submitted = 0;
+	async->num_completed = 0;
+	devh->write_pos = 0;
+	*done = true;
+
+	return JAYLINK_OK;
+}
+
+/*
+ * Receive the data of a read operation into the internal buffer. Like with
+ * async_recv(), a transfer is only submitted if the data of all transfers in
+ * flight does not exceed the number of bytes left to be received. The
+ * remaining data is requested with a single transfer afterwards.
+ */
+static int transport_usb_progress_read(struct jaylink_device_handle *devh,
+		bool *done)
+{
+	struct usb_async *async;
+	struct libusb_transfer *transfer;
+	size_t in_flight;
+	size_t slot;
+	size_t tmp;
+
+	async = devh->usb_async;
+
+	if (is_broken(devh))
+		return JAYLINK_ERR_IO;
+
+	if (!async->num_submitted) {
+		/* Receive the data at the beginning of the buffer. */
+		if (devh->read_pos > 0) {
+			memmove(devh->buffer, devh->buffer + devh->read_pos,
+				devh->bytes_available);
+			devh->read_pos = 0;
+		}
+
+		if (devh->read_length > devh->buffer_size) {
+			if (!adjust_buffer(devh, devh->read_length))
+				return JAYLINK_ERR_MALLOC;
+		}
+	}
+
+	while (true) {
+		while (true) {
+			in_flight = async->num_submitted - async->num_completed;
+
+			if (in_flight == NUM_TRANSFERS)
+				break;
+
+			/*
+			 * Request the remaining data with a single transfer
+			 * once all other transfers are completed.
+			 */
+			if (devh->bytes_available + async->requested +
+					CHUNK_SIZE > devh->read_length) {
+				if (in_flight > 0 || devh->bytes_available >=
+						devh->read_length)
+					break;
+			}
+
+			slot = async->num_submitted % NUM_TRANSFERS;
+
+			if (!submit_transfer(devh, slot, devh->endpoint_in,
+					async->buffer + slot * CHUNK_SIZE,
+					CHUNK_SIZE)) {
+				abort_progress(devh);
+				return JAYLINK_ERR;
+			}
+
+			async->requested += CHUNK_SIZE;
+			async->num_submitted++;
+		}
+
+		if (async->num_submitted == async->num_completed)
+			break;
+
+		transfer = poll_transfer(devh);
+
+		if (!transfer) {
+			*done = false;
+			return JAYLINK_OK;
+		}
+
+		async->requested -= CHUNK_SIZE;
+
+		if (transfer->status != LIBUSB_TRANSFER_COMPLETED) {
+			abort_progress(devh);
+			return transfer_status_to_error(devh, transfer,
+				"Receiving");
+		}
+
+		tmp = MIN((size_t)transfer->actual_length,
+			devh->read_length - devh->bytes_available);
+
+		if (tmp < (size_t)transfer->actual_length)
+			log_warn(devh->dev->ctx, "Discarded %zu unexpected "
+				"bytes from device.",
+				transfer->actual_length - tmp);
+
+		memcpy(devh->buffer + devh->bytes_available, transfer->buffer,
+			tmp);
+		devh->bytes_available += tmp;
+
+		log_dbgio(devh->dev->ctx, "Received %i bytes from device.",
+			transfer->actual_length);
+	}
+
+	async->num_submitted = 0;
+	async->num_completed = 0;
+	*done = true;
+
+	return JAYLINK_OK;
+}
+
+static int transport_usb_get_pollfds(struct jaylink_device_handle *devh,
+		struct jaylink_pollfd *fds, size_t *num_fds)
+{
+#ifdef _WIN32
+	(void)devh;
+	(void)fds;
+	(void)num_fds;
+
+	/* libusb does not provide file descriptors on Windows. */
+	return JAYLINK_ERR_NOT_SUPPORTED;
+#else
+	int ret;
+	const struct libusb_pollfd **pollfds;
+	size_t num;
+	size_t i;
+
+	pollfds = libusb_get_pollfds(devh->dev->ctx->usb_ctx);
+
+	if (!pollfds) {
+		log_err(devh->dev->ctx, "Failed to get file descriptors.");
+		return JAYLINK_ERR;
+	}
+
+	num = 0;
+
+	while (pollfds[num])
+		num++;
+
+	ret = JAYLINK_OK;
+
+	if (fds && *num_fds < num) {
+		ret = JAYLINK_ERR_ARG;
+	} else if (fds) {
+		for (i = 0; i < num; i++) {
+			fds[i].fd = pollfds[i]->fd;
+			fds[i].events = 0;
+
+			if (pollfds[i]->events & POLLIN)
+				fds[i].events |= JAYLINK_POLL_IN;
+
+			if (pollfds[i]->events & POLLOUT)
+				fds[i].events |= JAYLINK_POLL_OUT;
+		}
+	}
+
+	*num_fds = num;
+
+#if LIBUSB_API_VERSION >= 0x01000104
+	libusb_free_pollfds(pollfds);
+#else
+	free(pollfds);
+#endif
+
+	return ret;
+#endif
+}
+
+/** @private */
+JAYLINK_PRIV const struct transport_ops transport_usb_ops = {
+	.open = &transport_usb_open,
+	.close = &transport_usb_close,
+	.start_write = &transport_usb_start_write,
+	.start_read = &transport_usb_start_read,
+	.start_write_read = &transport_usb_start_write_read,
+	.write = &transport_usb_write,
+	.writev = &transport_usb_writev,
+	.read = &transport_usb_read,
+	.end_batch = &transport_usb_end_batch,
+	.progress_batch = &transport_usb_progress_batch,
+	.progress_read = &transport_usb_progress_read,
+	.get_pollfds = &transport_usb_get_pollfds
+};
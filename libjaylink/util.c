@@ -17,9 +17,18 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdint.h>
 #include <stdbool.h>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <windows.h>
+#else
+#include <errno.h>
+#include <time.h>
+#endif
 
 #include "libjaylink.h"
+#include "libjaylink-internal.h"
 
 /**
  * @file
@@ -54,3 +63,52 @@ JAYLINK_API bool jaylink_has_cap(const uint8_t *caps, uint32_t cap)
 
 	return false;
 }
+
+/**
+ * Get the current time of a monotonic clock.
+ *
+ * The time is not related to the wall-clock time and is only suitable to
+ * measure time intervals.
+ *
+ * @return The current time in microseconds.
+ */
+JAYLINK_PRIV uint64_t util_get_time(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER counter;
+	LARGE_INTEGER frequency;
+
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+
+	return (counter.QuadPart / frequency.QuadPart) * 1000000 +
+		(counter.QuadPart % frequency.QuadPart) * 1000000 /
+		frequency.QuadPart;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+/**
+ * Suspend the calling thread.
+ *
+ * @param[in] usecs Minimum time to sleep in microseconds.
+ */
+JAYLINK_PRIV void util_sleep(uint64_t usecs)
+{
+#ifdef _WIN32
+	Sleep((usecs + 999) / 1000);
+#else
+	struct timespec ts;
+
+	ts.tv_sec = usecs / 1000000;
+	ts.tv_nsec = (usecs % 1000000) * 1000;
+
+	while (nanosleep(&ts, &ts) && errno == EINTR)
+		;
+#endif
+}
@@ -0,0 +1,674 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "libjaylink.h"
+#include "libjaylink-internal.h"
+
+/**
+ * @file
+ *
+ * Xilinx Serial Vector Format (XSVF) player.
+ *
+ * The commands are decoded one after another and played with the player core
+ * of the SVF player, see svf.c. Their scans are collected and transferred
+ * with a single JTAG I/O operation, and the TDO data is verified on the host.
+ *
+ * A data register scan which is repeated on a TDO mismatch, as configured with
+ * the XREPEAT command, requires the result of the scan before the TAP
+ * controllers leave the Exit1-DR state. Therefore, the pending scans are
+ * transferred after each attempt of such a scan.
+ *
+ * Multi-byte values and vectors are stored in big-endian byte order. The last
+ * byte of a vector contains its first bits.
+ */
+
+/** @cond PRIVATE */
+#define XCOMPLETE		0x00
+#define XTDOMASK		0x01
+#define XSIR			0x02
+#define XSDR			0x03
+#define XRUNTEST		0x04
+#define XREPEAT			0x07
+#define XSDRSIZE		0x08
+#define XSDRTDO			0x09
+#define XSETSDRMASKS		0x0a
+#define XSDRINC			0x0b
+#define XSDRB			0x0c
+#define XSDRC			0x0d
+#define XSDRE			0x0e
+#define XSDRTDOB		0x0f
+#define XSDRTDOC		0x10
+#define XSDRTDOE		0x11
+#define XSTATE			0x12
+#define XENDIR			0x13
+#define XENDDR			0x14
+#define XSIR2			0x15
+#define XCOMMENT		0x16
+#define XWAIT			0x17
+
+/** Number of TAP controller states. */
+#define NUM_TAP_STATES		16
+
+struct xsvf {
+	/** Player core. */
+	struct svf_player player;
+	/** File content. */
+	const uint8_t *data;
+	/** Size of the file in bytes. */
+	size_t length;
+	/** Position of the next byte to decode. */
+	size_t pos;
+	/** Length of data register scans in bits. */
+	size_t sdr_size;
+	/** Run test time after scans in microseconds. */
+	uint32_t run_test;
+	/** Number of times a scan is repeated on a TDO mismatch. */
+	uint8_t repeat;
+	/** TAP controller state after instruction register scans. */
+	enum jaylink_tap_state endir;
+	/** TAP controller state after data register scans. */
+	enum jaylink_tap_state enddr;
+	/** TDI data. */
+	uint8_t *tdi;
+	/** Expected TDO data. */
+	uint8_t *tdo;
+	/** Mask of the TDO bits to compare. */
+	uint8_t *mask;
+	/** Size of the TDI, TDO and mask buffers in bytes. */
+	size_t size;
+};
+/** @endcond */
+
+static int read_u8(struct xsvf *xsvf, uint8_t *value)
+{
+	if (xsvf->pos + 1 > xsvf->length)
+		return JAYLINK_ERR_PROTO;
+
+	*value = xsvf->data[xsvf->pos];
+	xsvf->pos++;
+
+	return JAYLINK_OK;
+}
+
+static int read_u16(struct xsvf *xsvf, uint16_t *value)
+{
+	const uint8_t *data;
+
+	if (xsvf->pos + 2 > xsvf->length)
+		return JAYLINK_ERR_PROTO;
+
+	data = xsvf->data + xsvf->pos;
+	*value = ((uint16_t)data[0] << 8) | data[1];
+	xsvf->pos += 2;
+
+	return JAYLINK_OK;
+}
+
+static int read_u32(struct xsvf *xsvf, uint32_t *value)
+{
+	const uint8_t *data;
+
+	if (xsvf->pos + 4 > xsvf->length)
+		return JAYLINK_ERR_PROTO;
+
+	data = xsvf->data + xsvf->pos;
+	*value = ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) |
+		((uint32_t)data[2] << 8) | data[3];
+	xsvf->pos += 4;
+
+	return JAYLINK_OK;
+}
+
+/*
+ * Reserve space for the specified number of bits in the TDI, TDO and mask
+ * buffers. Additional space is cleared such that no additional TDO bits are
+ * compared.
+ */
+static int reserve_vectors(struct xsvf *xsvf, size_t length)
+{
+	uint8_t **buffers[3];
+	uint8_t *tmp;
+	size_t size;
+	size_t i;
+
+	size = (length + 7) / 8;
+
+	if (size <= xsvf->size)
+		return JAYLINK_OK;
+
+	buffers[0] = &xsvf->tdi;
+	buffers[1] = &xsvf->tdo;
+	buffers[2] = &xsvf->mask;
+
+	for (i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++) {
+		tmp = realloc(*buffers[i], size);
+
+		if (!tmp)
+			return JAYLINK_ERR_MALLOC;
+
+		memset(tmp + xsvf->size, 0, size - xsvf->size);
+		*buffers[i] = tmp;
+	}
+
+	xsvf->size = size;
+
+	return JAYLINK_OK;
+}
+
+/* Read a vector and convert it into a bit vector. */
+static int read_vector(struct xsvf *xsvf, uint8_t *buffer, size_t length)
+{
+	const uint8_t *data;
+	size_t num_bytes;
+	size_t i;
+
+	num_bytes = (length + 7) / 8;
+
+	if (num_bytes > xsvf->length - xsvf->pos)
+		return JAYLINK_ERR_PROTO;
+
+	data = xsvf->data + xsvf->pos;
+
+	for (i = 0; i < num_bytes; i++)
+		buffer[i] = data[num_bytes - i - 1];
+
+	xsvf->pos += num_bytes;
+
+	return JAYLINK_OK;
+}
+
+static int read_state(struct xsvf *xsvf, enum jaylink_tap_state *state)
+{
+	int ret;
+	uint8_t value;
+
+	ret = read_u8(xsvf, &value);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	/* The encoding of the states matches the one of libjaylink. */
+	if (value >= NUM_TAP_STATES)
+		return JAYLINK_ERR_PROTO;
+
+	*state = value;
+
+	return JAYLINK_OK;
+}
+
+static int read_end_state(struct xsvf *xsvf, enum jaylink_tap_state pause,
+		enum jaylink_tap_state *state)
+{
+	int ret;
+	uint8_t value;
+
+	ret = read_u8(xsvf, &value);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	if (value == 0x00)
+		*state = JAYLINK_TAP_STATE_IDLE;
+	else if (value == 0x01)
+		*state = pause;
+	else
+		return JAYLINK_ERR_PROTO;
+
+	return JAYLINK_OK;
+}
+
+/*
+ * Perform a scan with the TDI data and wait in the Run-Test/Idle state
+ * afterwards if a run test time is specified. If the TDO data is compared,
+ * only the bits selected by the mask are verified.
+ */
+static int shift(struct xsvf *xsvf, bool ir, size_t length, bool compare,
+		enum jaylink_tap_state end_state, uint32_t run_test)
+{
+	int ret;
+	const uint8_t *tdo;
+
+	tdo = NULL;
+
+	if (compare && jaylink_bitvec_popcount(xsvf->mask, 0, length) > 0)
+		tdo = xsvf->tdo;
+
+	ret = svf_player_shift(&xsvf->player, ir, xsvf->tdi, tdo, xsvf->mask,
+		length, end_state);
+
+	if (ret != JAYLINK_OK || !run_test)
+		return ret;
+
+	ret = jaylink_jtag_scan_goto(xsvf->player.scan,
+		JAYLINK_TAP_STATE_IDLE);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	return svf_player_run(&xsvf->player, 0, run_test);
+}
+
+/*
+ * Perform a data register scan which is repeated on a TDO mismatch with the
+ * run test time increased by a quarter each time.
+ *
+ * Each attempt stays in the Exit1-DR state until the TDO data is verified. On
+ * a mismatch, the exception handling of XAPP058 moves through the Pause-DR and
+ * Exit2-DR states back into the Shift-DR state. This shifts one additional bit
+ * such that the data register is not updated with the scanned data, before
+ * the Run-Test/Idle state is entered for the increased run test time.
+ */
+static int shift_dr(struct xsvf *xsvf)
+{
+	int ret;
+	struct jaylink_context *ctx;
+	struct jaylink_jtag_scan *scan;
+	uint32_t run_test;
+	size_t i;
+
+	if (!xsvf->repeat || !xsvf->run_test ||
+			!jaylink_bitvec_popcount(xsvf->mask, 0, xsvf->sdr_size))
+		return shift(xsvf, false, xsvf->sdr_size, true, xsvf->enddr,
+			xsvf->run_test);
+
+	scan = xsvf->player.scan;
+	ctx = scan->devh->dev->ctx;
+
+	/* Verify the pending scans such that a mismatch is not mistaken. */
+	ret = svf_player_flush(&xsvf->player);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	run_test = xsvf->run_test;
+
+	for (i = 0; i <= xsvf->repeat; i++) {
+		ret = svf_player_shift(&xsvf->player, false, xsvf->tdi,
+			xsvf->tdo, xsvf->mask, xsvf->sdr_size,
+			JAYLINK_TAP_STATE_DR_EXIT1);
+
+		if (ret == JAYLINK_OK)
+			ret = svf_player_flush(&xsvf->player);
+
+		if (ret != JAYLINK_ERR_TARGET || i == xsvf->repeat)
+			break;
+
+		ret = jtag_scan_move(scan, JAYLINK_TAP_STATE_DR_PAUSE);
+
+		if (ret == JAYLINK_OK)
+			ret = jtag_scan_move(scan, JAYLINK_TAP_STATE_DR_SHIFT);
+
+		if (ret == JAYLINK_OK)
+			ret = jtag_scan_move(scan, JAYLINK_TAP_STATE_IDLE);
+
+		run_test += run_test / 4;
+		log_dbg(ctx, "Repeating scan with run test time of %u us.",
+			run_test);
+
+		if (ret == JAYLINK_OK)
+			ret = svf_player_run(&xsvf->player, 0, run_test);
+
+		if (ret != JAYLINK_OK)
+			return ret;
+	}
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	ret = jtag_scan_move(scan, xsvf->enddr);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	ret = jaylink_jtag_scan_goto(scan, JAYLINK_TAP_STATE_IDLE);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	return svf_player_run(&xsvf->player, 0, run_test);
+}
+
+static int handle_wait(struct xsvf *xsvf)
+{
+	int ret;
+	enum jaylink_tap_state wait_state;
+	enum jaylink_tap_state end_state;
+	uint32_t usecs;
+
+	ret = read_state(xsvf, &wait_state);
+
+	if (ret == JAYLINK_OK)
+		ret = read_state(xsvf, &end_state);
+
+	if (ret == JAYLINK_OK)
+		ret = read_u32(xsvf, &usecs);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	ret = jtag_scan_move(xsvf->player.scan, wait_state);
+
+	if (ret == JAYLINK_OK)
+		ret = svf_player_run(&xsvf->player, 0, usecs);
+
+	if (ret == JAYLINK_OK)
+		ret = jtag_scan_move(xsvf->player.scan, end_state);
+
+	return ret;
+}
+
+static int handle_state(struct xsvf *xsvf)
+{
+	int ret;
+	enum jaylink_tap_state state;
+
+	ret = read_state(xsvf, &state);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	/* The Test-Logic-Reset state is always entered with TMS high. */
+	if (state == JAYLINK_TAP_STATE_RESET)
+		return jaylink_jtag_scan_reset(xsvf->player.scan);
+
+	return jtag_scan_move(xsvf->player.scan, state);
+}
+
+static int handle_sir(struct xsvf *xsvf, uint8_t cmd)
+{
+	int ret;
+	uint8_t length8;
+	uint16_t length;
+
+	if (cmd == XSIR) {
+		ret = read_u8(xsvf, &length8);
+		length = length8;
+	} else {
+		ret = read_u16(xsvf, &length);
+	}
+
+	if (ret == JAYLINK_OK)
+		ret = reserve_vectors(xsvf, length);
+
+	if (ret == JAYLINK_OK)
+		ret = read_vector(xsvf, xsvf->tdi, length);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	if (!length)
+		return JAYLINK_OK;
+
+	return shift(xsvf, true, length, false, xsvf->endir, xsvf->run_test);
+}
+
+/*
+ * Handle the data register scans which consist of multiple parts without run
+ * test time and repetition.
+ */
+static int handle_sdr_part(struct xsvf *xsvf, uint8_t cmd)
+{
+	int ret;
+	enum jaylink_tap_state end_state;
+	bool compare;
+
+	compare = cmd == XSDRTDOB || cmd == XSDRTDOC || cmd == XSDRTDOE;
+	ret = read_vector(xsvf, xsvf->tdi, xsvf->sdr_size);
+
+	if (ret == JAYLINK_OK && compare)
+		ret = read_vector(xsvf, xsvf->tdo, xsvf->sdr_size);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	if (cmd == XSDRE || cmd == XSDRTDOE)
+		end_state = xsvf->enddr;
+	else
+		end_state = JAYLINK_TAP_STATE_DR_SHIFT;
+
+	if (!xsvf->sdr_size)
+		return JAYLINK_OK;
+
+	return shift(xsvf, false, xsvf->sdr_size, compare, end_state, 0);
+}
+
+static int handle_command(struct xsvf *xsvf, uint8_t cmd)
+{
+	int ret;
+	uint32_t value;
+
+	switch (cmd) {
+	case XTDOMASK:
+		return read_vector(xsvf, xsvf->mask, xsvf->sdr_size);
+	case XSIR:
+	case XSIR2:
+		return handle_sir(xsvf, cmd);
+	case XSDR:
+	case XSDRTDO:
+		ret = read_vector(xsvf, xsvf->tdi, xsvf->sdr_size);
+
+		/* XSDR compares with the TDO data of the last XSDRTDO. */
+		if (ret == JAYLINK_OK && cmd == XSDRTDO)
+			ret = read_vector(xsvf, xsvf->tdo, xsvf->sdr_size);
+
+		if (ret != JAYLINK_OK || !xsvf->sdr_size)
+			return ret;
+
+		return shift_dr(xsvf);
+	case XRUNTEST:
+		return read_u32(xsvf, &xsvf->run_test);
+	case XREPEAT:
+		return read_u8(xsvf, &xsvf->repeat);
+	case XSDRSIZE:
+		ret = read_u32(xsvf, &value);
+
+		if (ret == JAYLINK_OK)
+			ret = reserve_vectors(xsvf, value);
+
+		if (ret == JAYLINK_OK)
+			xsvf->sdr_size = value;
+
+		return ret;
+	case XSDRB:
+	case XSDRC:
+	case XSDRE:
+	case XSDRTDOB:
+	case XSDRTDOC:
+	case XSDRTDOE:
+		return handle_sdr_part(xsvf, cmd);
+	case XSTATE:
+		return handle_state(xsvf);
+	case XENDIR:
+		return read_end_state(xsvf, JAYLINK_TAP_STATE_IR_PAUSE,
+			&xsvf->endir);
+	case XENDDR:
+		return read_end_state(xsvf, JAYLINK_TAP_STATE_DR_PAUSE,
+			&xsvf->enddr);
+	case XCOMMENT:
+		while (xsvf->pos < xsvf->length && xsvf->data[xsvf->pos])
+			xsvf->pos++;
+
+		if (xsvf->pos == xsvf->length)
+			return JAYLINK_ERR_PROTO;
+
+		xsvf->pos++;
+		return JAYLINK_OK;
+	case XWAIT:
+		return handle_wait(xsvf);
+	case XSETSDRMASKS:
+	case XSDRINC:
+		return JAYLINK_ERR_NOT_SUPPORTED;
+	default:
+		return JAYLINK_ERR_PROTO;
+	}
+}
+
+/**
+ * Play XSVF data.
+ *
+ * The scans of consecutive commands are collected by the scan engine and
+ * transferred with a single JTAG I/O operation. The expected TDO data is
+ * verified on the host after each transfer. Pending operations of the scan
+ * engine are transferred as well.
+ *
+ * The XSETSDRMASKS and XSDRINC commands are not supported.
+ *
+ * @param[in,out] scan Scan engine.
+ * @param[in] data XSVF data.
+ * @param[in] length Length of the XSVF data in bytes.
+ * @param[in] frequency TCK frequency in Hz, or 0 if unknown. It is used to
+ *                      convert wait times into TCK cycles. If unknown, wait
+ *                      times are waited on the host after all pending scans
+ *                      are transferred.
+ * @param[out] offset Offset of the failed command in bytes on failure, and
+ *                    undefined on success. Can be NULL.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR_PROTO Invalid command.
+ * @retval JAYLINK_ERR_NOT_SUPPORTED Unsupported command.
+ * @retval JAYLINK_ERR_DEV_NO_MEMORY Not enough memory on the device to perform
+ *                                   the operation.
+ * @retval JAYLINK_ERR_DEV Unspecified device error.
+ * @retval JAYLINK_ERR_TARGET TDO data does not match the expected values.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @see jaylink_xsvf_play_file()
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_xsvf_play(struct jaylink_jtag_scan *scan,
+		const uint8_t *data, size_t length, uint32_t frequency,
+		size_t *offset)
+{
+	int ret;
+	struct jaylink_context *ctx;
+	struct xsvf xsvf;
+	uint8_t cmd;
+
+	if (!scan || (!data && length > 0))
+		return JAYLINK_ERR_ARG;
+
+	ctx = scan->devh->dev->ctx;
+
+	svf_player_init(&xsvf.player, scan, frequency);
+	xsvf.data = data;
+	xsvf.length = length;
+	xsvf.pos = 0;
+	xsvf.sdr_size = 0;
+	xsvf.run_test = 0;
+	xsvf.repeat = 0;
+	xsvf.endir = JAYLINK_TAP_STATE_IDLE;
+	xsvf.enddr = JAYLINK_TAP_STATE_IDLE;
+	xsvf.tdi = NULL;
+	xsvf.tdo = NULL;
+	xsvf.mask = NULL;
+	xsvf.size = 0;
+	ret = JAYLINK_OK;
+
+	while (xsvf.pos < xsvf.length) {
+		xsvf.player.position = xsvf.pos;
+		cmd = xsvf.data[xsvf.pos];
+		xsvf.pos++;
+
+		if (cmd == XCOMPLETE)
+			break;
+
+		ret = handle_command(&xsvf, cmd);
+
+		if (ret != JAYLINK_OK)
+			break;
+	}
+
+	if (ret == JAYLINK_OK)
+		ret = svf_player_flush(&xsvf.player);
+
+	if (ret == JAYLINK_ERR_PROTO)
+		log_err(ctx, "Invalid XSVF command at offset %zu.",
+			xsvf.player.position);
+	else if (ret != JAYLINK_OK)
+		log_err(ctx, "XSVF command at offset %zu failed: %s.",
+			xsvf.player.position, jaylink_strerror(ret));
+
+	if (ret != JAYLINK_OK && offset)
+		*offset = xsvf.player.position;
+
+	svf_player_free(&xsvf.player);
+	free(xsvf.tdi);
+	free(xsvf.tdo);
+	free(xsvf.mask);
+
+	return ret;
+}
+
+/**
+ * Play an XSVF file.
+ *
+ * The file is mapped into memory if supported by the system and played like
+ * with jaylink_xsvf_play().
+ *
+ * @param[in,out] scan Scan engine.
+ * @param[in] filename Name of the XSVF file.
+ * @param[in] frequency TCK frequency in Hz, or 0 if unknown.
+ * @param[out] offset Offset of the failed command in bytes on failure, and
+ *                    undefined on success. Can be NULL.
+ *
+ * @retval JAYLINK_OK Success.
+ * @retval JAYLINK_ERR_ARG Invalid arguments.
+ * @retval JAYLINK_ERR_MALLOC Memory allocation error.
+ * @retval JAYLINK_ERR_TIMEOUT A timeout occurred.
+ * @retval JAYLINK_ERR_IO Input/output error.
+ * @retval JAYLINK_ERR_PROTO Invalid command.
+ * @retval JAYLINK_ERR_NOT_SUPPORTED Unsupported command.
+ * @retval JAYLINK_ERR_DEV_NO_MEMORY Not enough memory on the device to perform
+ *                                   the operation.
+ * @retval JAYLINK_ERR_DEV Unspecified device error.
+ * @retval JAYLINK_ERR_TARGET TDO data does not match the expected values.
+ * @retval JAYLINK_ERR Other error conditions.
+ *
+ * @since 0.2.0
+ */
+JAYLINK_API int jaylink_xsvf_play_file(struct jaylink_jtag_scan *scan,
+		const char *filename, uint32_t frequency, size_t *offset)
+{
+	int ret;
+	const uint8_t *data;
+	size_t length;
+
+	if (!scan || !filename)
+		return JAYLINK_ERR_ARG;
+
+	ret = svf_map_file(scan->devh->dev->ctx, filename, &data, &length);
+
+	if (ret != JAYLINK_OK)
+		return ret;
+
+	ret = jaylink_xsvf_play(scan, data, length, frequency, offset);
+	svf_unmap_file(data, length);
+
+	return ret;
+}
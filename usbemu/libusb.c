@@ -0,0 +1,879 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "libusb.h"
+
+/**
+ * @file
+ *
+ * Stand-in for libusb-1.0 without a device attached.
+ *
+ * The stand-in provides a single J-Link device. Opening the device connects to
+ * a server on the local host which serves the USB protocol via TCP/IP, i.e.
+ * commands and responses without any framing, see the --usb option of
+ * jaylink-emu. Data of the OUT endpoint is sent to the server and data of the
+ * IN endpoint is received from it. Like on USB, an IN transfer completes with
+ * the data available at that time and may be shorter than requested.
+ *
+ * The port of the server is taken from the environment variable
+ * JAYLINK_USBEMU_PORT. Asynchronous transfers are processed in the order of
+ * their submission when events are handled.
+ */
+
+/** Default port of the server, the port of the J-Link TCP/IP protocol. */
+#define DEFAULT_PORT		19020
+
+/** Environment variable with the port of the server. */
+#define PORT_VARIABLE		"JAYLINK_USBEMU_PORT"
+
+/** USB Vendor ID (VID) and Product ID (PID) of the device. */
+#define VENDOR_ID		0x1366
+#define PRODUCT_ID		0x0101
+
+/** Index of the string descriptor for the serial number. */
+#define SERIAL_NUMBER_INDEX	3
+
+/** Serial number of the device, padded with zeros like on a device. */
+#define SERIAL_NUMBER		"000123456789"
+
+/** Bus number and address of the device. */
+#define BUS_NUMBER		1
+#define DEVICE_ADDRESS		1
+
+/** Device of a context. */
+struct libusb_device {
+	libusb_context *ctx;
+	size_t ref_count;
+};
+
+/** Asynchronous transfer with its private state. */
+struct transfer {
+	/** Public part of the transfer, must be the first member. */
+	struct libusb_transfer transfer;
+	/** Next submitted transfer. */
+	struct transfer *next;
+	/** Time in milliseconds when the transfer times out, or 0. */
+	uint64_t deadline;
+	/** Indicates whether the transfer was cancelled. */
+	bool cancelled;
+	/** Indicates whether the transfer is submitted. */
+	bool submitted;
+};
+
+struct libusb_device_handle {
+	libusb_device *dev;
+	/** Connection to the server. */
+	int fd;
+	/** Indicates whether an IN transfer is waiting for data. */
+	bool in_waiting;
+	/** Next open device handle. */
+	libusb_device_handle *next;
+};
+
+struct libusb_context {
+	/** The only device. */
+	libusb_device dev;
+	/** Open device handles. */
+	libusb_device_handle *handles;
+	/** Submitted transfers in the order of their submission. */
+	struct transfer *transfers;
+};
+
+static const struct libusb_endpoint_descriptor endpoints[] = {
+	{0x81},
+	{0x01}
+};
+
+static const struct libusb_interface_descriptor interface_desc = {
+	LIBUSB_CLASS_VENDOR_SPEC,
+	LIBUSB_CLASS_VENDOR_SPEC,
+	2,
+	endpoints
+};
+
+static const struct libusb_interface interface = {
+	&interface_desc,
+	1
+};
+
+static struct libusb_config_descriptor config_desc = {
+	1,
+	&interface
+};
+
+static uint64_t get_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint16_t get_port(void)
+{
+	const char *str;
+	unsigned long port;
+	char *end;
+
+	str = getenv(PORT_VARIABLE);
+
+	if (!str)
+		return DEFAULT_PORT;
+
+	port = strtoul(str, &end, 10);
+
+	if (*end != '\0' || !port || port > UINT16_MAX)
+		return DEFAULT_PORT;
+
+	return port;
+}
+
+int libusb_init(libusb_context **ctx)
+{
+	libusb_context *context;
+
+	if (!ctx)
+		return LIBUSB_ERROR_NOT_SUPPORTED;
+
+	context = malloc(sizeof(libusb_context));
+
+	if (!context)
+		return LIBUSB_ERROR_NO_MEM;
+
+	context->dev.ctx = context;
+	context->dev.ref_count = 1;
+	context->handles = NULL;
+	context->transfers = NULL;
+
+	*ctx = context;
+
+	return LIBUSB_SUCCESS;
+}
+
+void libusb_exit(libusb_context *ctx)
+{
+	while (ctx->handles)
+		libusb_close(ctx->handles);
+
+	free(ctx);
+}
+
+const char *libusb_error_name(int code)
+{
+	switch (code) {
+	case LIBUSB_SUCCESS:
+		return "LIBUSB_SUCCESS";
+	case LIBUSB_ERROR_IO:
+		return "LIBUSB_ERROR_IO";
+	case LIBUSB_ERROR_INVALID_PARAM:
+		return "LIBUSB_ERROR_INVALID_PARAM";
+	case LIBUSB_ERROR_NO_DEVICE:
+		return "LIBUSB_ERROR_NO_DEVICE";
+	case LIBUSB_ERROR_NOT_FOUND:
+		return "LIBUSB_ERROR_NOT_FOUND";
+	case LIBUSB_ERROR_BUSY:
+		return "LIBUSB_ERROR_BUSY";
+	case LIBUSB_ERROR_TIMEOUT:
+		return "LIBUSB_ERROR_TIMEOUT";
+	case LIBUSB_ERROR_OVERFLOW:
+		return "LIBUSB_ERROR_OVERFLOW";
+	case LIBUSB_ERROR_INTERRUPTED:
+		return "LIBUSB_ERROR_INTERRUPTED";
+	case LIBUSB_ERROR_NO_MEM:
+		return "LIBUSB_ERROR_NO_MEM";
+	case LIBUSB_ERROR_NOT_SUPPORTED:
+		return "LIBUSB_ERROR_NOT_SUPPORTED";
+	default:
+		return "LIBUSB_ERROR_OTHER";
+	}
+}
+
+ssize_t libusb_get_device_list(libusb_context *ctx, libusb_device ***list)
+{
+	*list = malloc(2 * sizeof(libusb_device *));
+
+	if (!*list)
+		return LIBUSB_ERROR_NO_MEM;
+
+	(*list)[0] = libusb_ref_device(&ctx->dev);
+	(*list)[1] = NULL;
+
+	return 1;
+}
+
+void libusb_free_device_list(libusb_device **list, int unref_devices)
+{
+	size_t i;
+
+	if (!list)
+		return;
+
+	if (unref_devices) {
+		for (i = 0; list[i]; i++)
+			libusb_unref_device(list[i]);
+	}
+
+	free(list);
+}
+
+/*
+ * The device is part of its context and is released together with it.
+ * Therefore, only the references are counted.
+ */
+libusb_device *libusb_ref_device(libusb_device *dev)
+{
+	dev->ref_count++;
+
+	return dev;
+}
+
+void libusb_unref_device(libusb_device *dev)
+{
+	if (dev)
+		dev->ref_count--;
+}
+
+uint8_t libusb_get_bus_number(libusb_device *dev)
+{
+	(void)dev;
+
+	return BUS_NUMBER;
+}
+
+uint8_t libusb_get_device_address(libusb_device *dev)
+{
+	(void)dev;
+
+	return DEVICE_ADDRESS;
+}
+
+int libusb_get_port_numbers(libusb_device *dev, uint8_t *port_numbers,
+		int port_numbers_len)
+{
+	(void)dev;
+
+	if (port_numbers_len < 1)
+		return LIBUSB_ERROR_OVERFLOW;
+
+	port_numbers[0] = 1;
+
+	return 1;
+}
+
+int libusb_get_device_descriptor(libusb_device *dev,
+		struct libusb_device_descriptor *desc)
+{
+	(void)dev;
+
+	desc->idVendor = VENDOR_ID;
+	desc->idProduct = PRODUCT_ID;
+	desc->iSerialNumber = SERIAL_NUMBER_INDEX;
+
+	return LIBUSB_SUCCESS;
+}
+
+int libusb_get_active_config_descriptor(libusb_device *dev,
+		struct libusb_config_descriptor **config)
+{
+	(void)dev;
+
+	*config = &config_desc;
+
+	return LIBUSB_SUCCESS;
+}
+
+void libusb_free_config_descriptor(struct libusb_config_descriptor *config)
+{
+	(void)config;
+}
+
+int libusb_open(libusb_device *dev, libusb_device_handle **dev_handle)
+{
+	libusb_device_handle *devh;
+	struct sockaddr_in addr;
+	int opt;
+
+	devh = malloc(sizeof(libusb_device_handle));
+
+	if (!devh)
+		return LIBUSB_ERROR_NO_MEM;
+
+	devh->fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	if (devh->fd < 0) {
+		free(devh);
+		return LIBUSB_ERROR_IO;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(get_port());
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (connect(devh->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(devh->fd);
+		free(devh);
+		return LIBUSB_ERROR_NO_DEVICE;
+	}
+
+	opt = 1;
+	setsockopt(devh->fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+	devh->dev = libusb_ref_device(dev);
+	devh->in_waiting = false;
+	devh->next = dev->ctx->handles;
+	dev->ctx->handles = devh;
+	*dev_handle = devh;
+
+	return LIBUSB_SUCCESS;
+}
+
+void libusb_close(libusb_device_handle *dev_handle)
+{
+	libusb_device_handle **devh;
+	struct transfer **item;
+
+	devh = &dev_handle->dev->ctx->handles;
+
+	while (*devh != dev_handle)
+		devh = &(*devh)->next;
+
+	*devh = dev_handle->next;
+
+	/* Drop the transfers of the device handle which are still submitted. */
+	item = &dev_handle->dev->ctx->transfers;
+
+	while (*item) {
+		if ((*item)->transfer.dev_handle == dev_handle) {
+			(*item)->submitted = false;
+			*item = (*item)->next;
+		} else {
+			item = &(*item)->next;
+		}
+	}
+
+	close(dev_handle->fd);
+	libusb_unref_device(dev_handle->dev);
+	free(dev_handle);
+}
+
+int libusb_claim_interface(libusb_device_handle *dev_handle,
+		int interface_number)
+{
+	(void)dev_handle;
+
+	if (interface_number)
+		return LIBUSB_ERROR_NOT_FOUND;
+
+	return LIBUSB_SUCCESS;
+}
+
+int libusb_release_interface(libusb_device_handle *dev_handle,
+		int interface_number)
+{
+	(void)dev_handle;
+
+	if (interface_number)
+		return LIBUSB_ERROR_NOT_FOUND;
+
+	return LIBUSB_SUCCESS;
+}
+
+int libusb_get_string_descriptor_ascii(libusb_device_handle *dev_handle,
+		uint8_t desc_index, unsigned char *data, int length)
+{
+	int ret;
+
+	(void)dev_handle;
+
+	if (desc_index != SERIAL_NUMBER_INDEX)
+		return LIBUSB_ERROR_INVALID_PARAM;
+
+	ret = strlen(SERIAL_NUMBER);
+
+	if (length <= ret)
+		return LIBUSB_ERROR_OVERFLOW;
+
+	memcpy(data, SERIAL_NUMBER, ret + 1);
+
+	return ret;
+}
+
+static int send_data(int fd, const unsigned char *data, int length)
+{
+	ssize_t ret;
+	int pos;
+
+	pos = 0;
+
+	while (pos < length) {
+		ret = send(fd, data + pos, length - pos, MSG_NOSIGNAL);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+
+		if (ret < 0 && errno == EPIPE)
+			return LIBUSB_ERROR_NO_DEVICE;
+
+		if (ret < 0)
+			return LIBUSB_ERROR_IO;
+
+		pos += ret;
+	}
+
+	return LIBUSB_SUCCESS;
+}
+
+/*
+ * Receive the data which is available without blocking. Returns the number of
+ * received bytes, 0 if no data is available, or a negative error code.
+ */
+static int recv_data(int fd, unsigned char *data, int length)
+{
+	ssize_t ret;
+
+	do {
+		ret = recv(fd, data, length, MSG_DONTWAIT);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		return 0;
+
+	if (ret < 0)
+		return LIBUSB_ERROR_IO;
+
+	/* The server closed the connection. */
+	if (!ret)
+		return LIBUSB_ERROR_NO_DEVICE;
+
+	return ret;
+}
+
+/*
+ * Wait for data of a device handle for at most @p timeout milliseconds, or
+ * without timeout if @p timeout is negative.
+ */
+static int wait_data(int fd, int timeout)
+{
+	struct pollfd pfd;
+	int ret;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+
+	ret = poll(&pfd, 1, timeout);
+
+	if (ret < 0 && errno == EINTR)
+		return LIBUSB_ERROR_INTERRUPTED;
+
+	if (ret < 0)
+		return LIBUSB_ERROR_IO;
+
+	return ret;
+}
+
+int libusb_bulk_transfer(libusb_device_handle *dev_handle,
+		unsigned char endpoint, unsigned char *data, int length,
+		int *actual_length, unsigned int timeout)
+{
+	int ret;
+
+	*actual_length = 0;
+
+	if (!(endpoint & LIBUSB_ENDPOINT_IN)) {
+		ret = send_data(dev_handle->fd, data, length);
+
+		if (ret == LIBUSB_SUCCESS)
+			*actual_length = length;
+
+		return ret;
+	}
+
+	ret = wait_data(dev_handle->fd, timeout ? (int)timeout : -1);
+
+	if (ret < 0)
+		return ret;
+
+	if (!ret)
+		return LIBUSB_ERROR_TIMEOUT;
+
+	ret = recv_data(dev_handle->fd, data, length);
+
+	if (ret < 0)
+		return ret;
+
+	*actual_length = ret;
+
+	return LIBUSB_SUCCESS;
+}
+
+struct libusb_transfer *libusb_alloc_transfer(int iso_packets)
+{
+	struct transfer *transfer;
+
+	if (iso_packets)
+		return NULL;
+
+	transfer = calloc(1, sizeof(struct transfer));
+
+	if (!transfer)
+		return NULL;
+
+	return &transfer->transfer;
+}
+
+void libusb_free_transfer(struct libusb_transfer *transfer)
+{
+	free(transfer);
+}
+
+int libusb_submit_transfer(struct libusb_transfer *transfer)
+{
+	struct transfer *tmp;
+	struct transfer **item;
+
+	tmp = (struct transfer *)transfer;
+
+	if (tmp->submitted)
+		return LIBUSB_ERROR_BUSY;
+
+	if (transfer->type != LIBUSB_TRANSFER_TYPE_BULK)
+		return LIBUSB_ERROR_NOT_SUPPORTED;
+
+	tmp->next = NULL;
+	tmp->deadline = 0;
+	tmp->cancelled = false;
+	tmp->submitted = true;
+
+	if (transfer->timeout)
+		tmp->deadline = get_time() + transfer->timeout;
+
+	transfer->actual_length = 0;
+
+	item = &transfer->dev_handle->dev->ctx->transfers;
+
+	while (*item)
+		item = &(*item)->next;
+
+	*item = tmp;
+
+	return LIBUSB_SUCCESS;
+}
+
+int libusb_cancel_transfer(struct libusb_transfer *transfer)
+{
+	struct transfer *tmp;
+
+	tmp = (struct transfer *)transfer;
+
+	if (!tmp->submitted || tmp->cancelled)
+		return LIBUSB_ERROR_NOT_FOUND;
+
+	tmp->cancelled = true;
+
+	return LIBUSB_SUCCESS;
+}
+
+/*
+ * Try to complete a submitted transfer without blocking. Returns whether the
+ * transfer is completed.
+ */
+static bool process_transfer(struct transfer *transfer, uint64_t now)
+{
+	struct libusb_transfer *t;
+	libusb_device_handle *devh;
+	int ret;
+
+	t = &transfer->transfer;
+	devh = t->dev_handle;
+
+	if (transfer->cancelled) {
+		t->status = LIBUSB_TRANSFER_CANCELLED;
+		return true;
+	}
+
+	if (!(t->endpoint & LIBUSB_ENDPOINT_IN)) {
+		ret = send_data(devh->fd, t->buffer, t->length);
+
+		if (ret == LIBUSB_SUCCESS) {
+			t->status = LIBUSB_TRANSFER_COMPLETED;
+			t->actual_length = t->length;
+		} else if (ret == LIBUSB_ERROR_NO_DEVICE) {
+			t->status = LIBUSB_TRANSFER_NO_DEVICE;
+		} else {
+			t->status = LIBUSB_TRANSFER_ERROR;
+		}
+
+		return true;
+	}
+
+	/* The data is received by the IN transfers in their order. */
+	if (devh->in_waiting)
+		return false;
+
+	ret = recv_data(devh->fd, t->buffer, t->length);
+
+	if (ret > 0) {
+		t->status = LIBUSB_TRANSFER_COMPLETED;
+		t->actual_length = ret;
+		return true;
+	} else if (ret == LIBUSB_ERROR_NO_DEVICE) {
+		t->status = LIBUSB_TRANSFER_NO_DEVICE;
+		return true;
+	} else if (ret < 0) {
+		t->status = LIBUSB_TRANSFER_ERROR;
+		return true;
+	}
+
+	if (transfer->deadline && now >= transfer->deadline) {
+		t->status = LIBUSB_TRANSFER_TIMED_OUT;
+		return true;
+	}
+
+	devh->in_waiting = true;
+
+	return false;
+}
+
+/*
+ * Complete all transfers which can be completed without blocking and invoke
+ * their callbacks. Returns the number of completed transfers.
+ */
+static size_t process_transfers(libusb_context *ctx)
+{
+	struct transfer *completed;
+	struct transfer **tail;
+	struct transfer **item;
+	struct transfer *transfer;
+	libusb_device_handle *devh;
+	uint64_t now;
+	size_t num;
+
+	for (devh = ctx->handles; devh; devh = devh->next)
+		devh->in_waiting = false;
+
+	completed = NULL;
+	tail = &completed;
+	item = &ctx->transfers;
+	now = get_time();
+
+	while (*item) {
+		transfer = *item;
+
+		if (!process_transfer(transfer, now)) {
+			item = &transfer->next;
+			continue;
+		}
+
+		*item = transfer->next;
+		transfer->submitted = false;
+		transfer->next = NULL;
+		*tail = transfer;
+		tail = &transfer->next;
+	}
+
+	num = 0;
+
+	/*
+	 * The callbacks are invoked after all transfers were processed because
+	 * they may submit new transfers.
+	 */
+	while (completed) {
+		transfer = completed;
+		completed = transfer->next;
+		transfer->next = NULL;
+		transfer->transfer.callback(&transfer->transfer);
+		num++;
+	}
+
+	return num;
+}
+
+/*
+ * Get the time in milliseconds until the next transfer times out, or -1 if
+ * no transfer has a timeout.
+ */
+static int get_next_timeout(const libusb_context *ctx, uint64_t now)
+{
+	const struct transfer *transfer;
+	uint64_t next;
+
+	next = 0;
+
+	for (transfer = ctx->transfers; transfer; transfer = transfer->next) {
+		if (!transfer->deadline)
+			continue;
+
+		if (!next || transfer->deadline < next)
+			next = transfer->deadline;
+	}
+
+	if (!next)
+		return -1;
+
+	if (next <= now)
+		return 0;
+
+	return next - now;
+}
+
+/*
+ * Wait until a handle with a waiting IN transfer has data, or at most
+ * @p timeout milliseconds if @p timeout is not negative.
+ */
+static int wait_events(libusb_context *ctx, int timeout)
+{
+	struct pollfd pfds[1];
+	libusb_device_handle *devh;
+	int ret;
+
+	for (devh = ctx->handles; devh; devh = devh->next) {
+		if (devh->in_waiting)
+			break;
+	}
+
+	if (!devh) {
+		if (timeout > 0)
+			poll(NULL, 0, timeout);
+
+		return LIBUSB_SUCCESS;
+	}
+
+	/* Only the handle with the first waiting IN transfer is polled. */
+	pfds[0].fd = devh->fd;
+	pfds[0].events = POLLIN;
+
+	ret = poll(pfds, 1, timeout);
+
+	if (ret < 0 && errno == EINTR)
+		return LIBUSB_ERROR_INTERRUPTED;
+
+	if (ret < 0)
+		return LIBUSB_ERROR_IO;
+
+	return LIBUSB_SUCCESS;
+}
+
+/*
+ * Handle events until at least one transfer is completed, @p completed is
+ * set, or @p timeout milliseconds elapsed. A negative timeout waits forever
+ * as long as there are submitted transfers.
+ */
+static int handle_events(libusb_context *ctx, int timeout, int *completed)
+{
+	uint64_t start;
+	uint64_t now;
+	int next;
+	int ret;
+
+	start = get_time();
+
+	while (true) {
+		if (completed && *completed)
+			return LIBUSB_SUCCESS;
+
+		if (process_transfers(ctx) > 0)
+			return LIBUSB_SUCCESS;
+
+		if (!ctx->transfers && timeout < 0)
+			return LIBUSB_SUCCESS;
+
+		now = get_time();
+
+		if (timeout >= 0 && now - start >= (uint64_t)timeout)
+			return LIBUSB_SUCCESS;
+
+		next = get_next_timeout(ctx, now);
+
+		if (timeout >= 0 && (next < 0 ||
+				(uint64_t)next > timeout - (now - start)))
+			next = timeout - (now - start);
+
+		ret = wait_events(ctx, next);
+
+		if (ret != LIBUSB_SUCCESS)
+			return ret;
+	}
+}
+
+int libusb_handle_events_timeout_completed(libusb_context *ctx,
+		struct timeval *tv, int *completed)
+{
+	return handle_events(ctx, tv->tv_sec * 1000 + tv->tv_usec / 1000,
+		completed);
+}
+
+int libusb_handle_events_completed(libusb_context *ctx, int *completed)
+{
+	return handle_events(ctx, -1, completed);
+}
+
+const struct libusb_pollfd **libusb_get_pollfds(libusb_context *ctx)
+{
+	const struct libusb_pollfd **pollfds;
+	struct libusb_pollfd *pollfd;
+	libusb_device_handle *devh;
+	size_t num;
+	size_t i;
+
+	num = 0;
+
+	for (devh = ctx->handles; devh; devh = devh->next)
+		num++;
+
+	pollfds = malloc((num + 1) * sizeof(struct libusb_pollfd *) +
+		num * sizeof(struct libusb_pollfd));
+
+	if (!pollfds)
+		return NULL;
+
+	pollfd = (struct libusb_pollfd *)(pollfds + num + 1);
+	i = 0;
+
+	for (devh = ctx->handles; devh; devh = devh->next) {
+		pollfd[i].fd = devh->fd;
+		pollfd[i].events = POLLIN;
+		pollfds[i] = &pollfd[i];
+		i++;
+	}
+
+	pollfds[num] = NULL;
+
+	return pollfds;
+}
+
+void libusb_free_pollfds(const struct libusb_pollfd **pollfds)
+{
+	free(pollfds);
+}
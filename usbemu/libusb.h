@@ -0,0 +1,204 @@
+/*
+ * This file is part of the libjaylink project.
+ *
+ * Copyright (C) 2017 Marc Schink <jaylink-dev@marcschink.de>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JAYLINK_USBEMU_LIBUSB_H
+#define JAYLINK_USBEMU_LIBUSB_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/time.h>
+
+/**
+ * @file
+ *
+ * Stand-in for libusb-1.0 without a device attached.
+ *
+ * Only the subset of the libusb API used by libjaylink is provided. There is a
+ * single device whose bulk endpoints are connected to a server which serves the
+ * USB protocol via TCP/IP, see libusb.c.
+ */
+
+/** Version of the libusb API provided by the stand-in. */
+#define LIBUSB_API_VERSION	0x01000104
+
+#define LIBUSB_CALL
+
+/** Class code of vendor-specific interfaces. */
+#define LIBUSB_CLASS_VENDOR_SPEC	0xff
+
+/** Direction bit of the address of an IN endpoint. */
+#define LIBUSB_ENDPOINT_IN		0x80
+
+/** Error codes. */
+enum libusb_error {
+	LIBUSB_SUCCESS = 0,
+	LIBUSB_ERROR_IO = -1,
+	LIBUSB_ERROR_INVALID_PARAM = -2,
+	LIBUSB_ERROR_NO_DEVICE = -4,
+	LIBUSB_ERROR_NOT_FOUND = -5,
+	LIBUSB_ERROR_BUSY = -6,
+	LIBUSB_ERROR_TIMEOUT = -7,
+	LIBUSB_ERROR_OVERFLOW = -8,
+	LIBUSB_ERROR_INTERRUPTED = -10,
+	LIBUSB_ERROR_NO_MEM = -11,
+	LIBUSB_ERROR_NOT_SUPPORTED = -12,
+	LIBUSB_ERROR_OTHER = -99
+};
+
+/** Status of a transfer. */
+enum libusb_transfer_status {
+	LIBUSB_TRANSFER_COMPLETED,
+	LIBUSB_TRANSFER_ERROR,
+	LIBUSB_TRANSFER_TIMED_OUT,
+	LIBUSB_TRANSFER_CANCELLED,
+	LIBUSB_TRANSFER_STALL,
+	LIBUSB_TRANSFER_NO_DEVICE,
+	LIBUSB_TRANSFER_OVERFLOW
+};
+
+/** Bulk transfer type. */
+#define LIBUSB_TRANSFER_TYPE_BULK	2
+
+struct libusb_context;
+struct libusb_device;
+struct libusb_device_handle;
+struct libusb_transfer;
+
+typedef struct libusb_context libusb_context;
+typedef struct libusb_device libusb_device;
+typedef struct libusb_device_handle libusb_device_handle;
+
+/** Device descriptor. */
+struct libusb_device_descriptor {
+	uint16_t idVendor;
+	uint16_t idProduct;
+	uint8_t iSerialNumber;
+};
+
+/** Endpoint descriptor. */
+struct libusb_endpoint_descriptor {
+	uint8_t bEndpointAddress;
+};
+
+/** Interface descriptor. */
+struct libusb_interface_descriptor {
+	uint8_t bInterfaceClass;
+	uint8_t bInterfaceSubClass;
+	uint8_t bNumEndpoints;
+	const struct libusb_endpoint_descriptor *endpoint;
+};
+
+/** Interface with its alternate settings. */
+struct libusb_interface {
+	const struct libusb_interface_descriptor *altsetting;
+	int num_altsetting;
+};
+
+/** Configuration descriptor. */
+struct libusb_config_descriptor {
+	uint8_t bNumInterfaces;
+	const struct libusb_interface *interface;
+};
+
+/** Callback of an asynchronous transfer. */
+typedef void (LIBUSB_CALL *libusb_transfer_cb_fn)(
+	struct libusb_transfer *transfer);
+
+/** Asynchronous transfer. */
+struct libusb_transfer {
+	libusb_device_handle *dev_handle;
+	uint8_t flags;
+	unsigned char endpoint;
+	unsigned char type;
+	unsigned int timeout;
+	enum libusb_transfer_status status;
+	int length;
+	int actual_length;
+	libusb_transfer_cb_fn callback;
+	void *user_data;
+	unsigned char *buffer;
+	int num_iso_packets;
+};
+
+/** File descriptor to be polled for events. */
+struct libusb_pollfd {
+	int fd;
+	short events;
+};
+
+int libusb_init(libusb_context **ctx);
+void libusb_exit(libusb_context *ctx);
+const char *libusb_error_name(int code);
+
+ssize_t libusb_get_device_list(libusb_context *ctx, libusb_device ***list);
+void libusb_free_device_list(libusb_device **list, int unref_devices);
+libusb_device *libusb_ref_device(libusb_device *dev);
+void libusb_unref_device(libusb_device *dev);
+uint8_t libusb_get_bus_number(libusb_device *dev);
+uint8_t libusb_get_device_address(libusb_device *dev);
+int libusb_get_port_numbers(libusb_device *dev, uint8_t *port_numbers,
+		int port_numbers_len);
+int libusb_get_device_descriptor(libusb_device *dev,
+		struct libusb_device_descriptor *desc);
+int libusb_get_active_config_descriptor(libusb_device *dev,
+		struct libusb_config_descriptor **config);
+void libusb_free_config_descriptor(struct libusb_config_descriptor *config);
+
+int libusb_open(libusb_device *dev, libusb_device_handle **dev_handle);
+void libusb_close(libusb_device_handle *dev_handle);
+int libusb_claim_interface(libusb_device_handle *dev_handle,
+		int interface_number);
+int libusb_release_interface(libusb_device_handle *dev_handle,
+		int interface_number);
+int libusb_get_string_descriptor_ascii(libusb_device_handle *dev_handle,
+		uint8_t desc_index, unsigned char *data, int length);
+
+int libusb_bulk_transfer(libusb_device_handle *dev_handle,
+		unsigned char endpoint, unsigned char *data, int length,
+		int *actual_length, unsigned int timeout);
+
+struct libusb_transfer *libusb_alloc_transfer(int iso_packets);
+void libusb_free_transfer(struct libusb_transfer *transfer);
+int libusb_submit_transfer(struct libusb_transfer *transfer);
+int libusb_cancel_transfer(struct libusb_transfer *transfer);
+
+int libusb_handle_events_timeout_completed(libusb_context *ctx,
+		struct timeval *tv, int *completed);
+int libusb_handle_events_completed(libusb_context *ctx, int *completed);
+
+const struct libusb_pollfd **libusb_get_pollfds(libusb_context *ctx);
+void libusb_free_pollfds(const struct libusb_pollfd **pollfds);
+
+static inline void libusb_fill_bulk_transfer(struct libusb_transfer *transfer,
+		libusb_device_handle *dev_handle, unsigned char endpoint,
+		unsigned char *buffer, int length,
+		libusb_transfer_cb_fn callback, void *user_data,
+		unsigned int timeout)
+{
+	transfer->dev_handle = dev_handle;
+	transfer->endpoint = endpoint;
+	transfer->type = LIBUSB_TRANSFER_TYPE_BULK;
+	transfer->timeout = timeout;
+	transfer->buffer = buffer;
+	transfer->length = length;
+	transfer->user_data = user_data;
+	transfer->callback = callback;
+}
+
+#endif /* JAYLINK_USBEMU_LIBUSB_H */